@@ -0,0 +1,240 @@
+#include "clahe.pencil.h"
+#include <pencil.h>
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include "tile_hist.pencil.h"
+
+#define CLAHE_PARTS 16  // blocks of rows of the equalizeHist histogram
+
+// dst = lut[src]
+static void equalize_apply( const int rows
+                          , const int cols
+                          , const int src_step
+                          , const uint8_t src[static const restrict rows][src_step]
+                          , const uint8_t lut[static const restrict TILE_HIST_BINS]
+                          , const int dst_step
+                          , uint8_t dst[static const restrict rows][dst_step]    //out
+                          )
+{
+#pragma scop
+    __pencil_assume(rows     >  0);
+    __pencil_assume(cols     >  0);
+    __pencil_assume(src_step >= cols);
+    __pencil_assume(dst_step >= cols);
+
+    __pencil_kill(dst);
+
+    #pragma pencil independent
+    for(int q = 0; q < rows; ++q)
+    {
+        #pragma pencil independent
+        for(int w = 0; w < cols; ++w)
+            dst[q][w] = lut[src[q][w]];
+    }
+#pragma endscop
+}
+
+/* Clips every tile histogram at clip_limit (0: no clipping) and hands the
+ * clipped pixels back evenly, one more to each of the first residual bins,
+ * then lut = round(cdf * scale). Matches cv::CLAHE of OpenCV 2.4. The luts
+ * are stored as floats, which the interpolation gathers without
+ * conversions. */
+static void clahe_lut( const int tiles
+                     , const int clip_limit
+                     , const float scale
+                     , int hist[static const restrict tiles][TILE_HIST_BINS]
+                     , float lut[static const restrict tiles][TILE_HIST_BINS]    //out
+                     )
+{
+#pragma scop
+    __pencil_assume(tiles      >  0);
+    __pencil_assume(clip_limit >= 0);
+
+    __pencil_kill(lut);
+
+    #pragma pencil independent
+    for(int t = 0; t < tiles; ++t)
+    {
+        if ( clip_limit > 0 )
+        {
+            int clipped = 0;
+            for(int b = 0; b < TILE_HIST_BINS; ++b)
+            {
+                clipped += imax(hist[t][b] - clip_limit, 0);
+                hist[t][b] = imin(hist[t][b], clip_limit);
+            }
+            const int batch    = clipped / TILE_HIST_BINS;
+            const int residual = clipped % TILE_HIST_BINS;
+
+            #pragma pencil independent
+            for(int b = 0; b < TILE_HIST_BINS; ++b)
+                hist[t][b] += batch + (b < residual);
+        }
+
+        int sum = 0;
+        for(int b = 0; b < TILE_HIST_BINS; ++b)
+        {
+            sum += hist[t][b];
+            lut[t][b] = iclampi((int)rintf(sum * scale), 0, 255);
+        }
+    }
+#pragma endscop
+}
+
+/* Bilinear interpolation between the luts of the four tiles around each
+ * pixel, one pass over the image. Tile centres are at (t + 0.5) tile sizes;
+ * column x takes the luts at offsets left[x] and right[x] of a row of tiles
+ * at fraction weight[x] from the left one. The float operations follow
+ * cv::CLAHE of OpenCV 2.4 so the roundings match: the row fraction comes
+ * from a division by tile_rows, and the four products, each with the
+ * product of its two weights, are summed in turn (unfused: -std=c99 keeps
+ * gcc from contracting them). */
+static void clahe_interpolate( const int rows
+                             , const int cols
+                             , const int src_step
+                             , const uint8_t src[static const restrict rows][src_step]
+                             , const int tiles_y
+                             , const int tiles_x
+                             , const float lut[static const restrict tiles_y][tiles_x * TILE_HIST_BINS]
+                             , const int tile_rows
+                             , const int left[static const restrict cols]
+                             , const int right[static const restrict cols]
+                             , const float weight[static const restrict cols]
+                             , const int dst_step
+                             , uint8_t dst[static const restrict rows][dst_step]    //out
+                             )
+{
+#pragma scop
+    __pencil_assume(rows     >  0);
+    __pencil_assume(cols     >  0);
+    __pencil_assume(src_step >= cols);
+    __pencil_assume(dst_step >= cols);
+    __pencil_assume(tiles_y  >  0);
+    __pencil_assume(tiles_x  >  0);
+    __pencil_assume(tile_rows > 0);
+
+    __pencil_kill(dst);
+
+    #pragma pencil independent
+    for(int q = 0; q < rows; ++q)
+    {
+        const float y      = (float)q / tile_rows - 0.5f;
+        const int   top    = (int)floorf(y);
+        const float below  = y - top;
+        const float above  = 1.0f - below;
+        const int   upper  = imax(top, 0);
+        const int   lower  = imin(top + 1, tiles_y - 1);
+
+        #pragma pencil independent
+        for(int w = 0; w < cols; ++w)
+        {
+            const int v = src[q][w];
+            const float x = weight[w];
+            float res = lut[upper][left[w]  + v] * ((1.0f - x) * above);
+            res      += lut[upper][right[w] + v] * (x * above);
+            res      += lut[lower][left[w]  + v] * ((1.0f - x) * below);
+            res      += lut[lower][right[w] + v] * (x * below);
+            dst[q][w] = iclampi((int)rintf(res), 0, 255);
+        }
+    }
+#pragma endscop
+}
+
+void pencil_equalizeHist( const int rows
+                        , const int cols
+                        , const int src_step
+                        , const uint8_t src[]
+                        , const int dst_step
+                        , uint8_t dst[]
+                        )
+{
+    // Privatised histogram of blocks of rows, see pencil_calcHist()
+    const int parts     = rows < CLAHE_PARTS ? rows : CLAHE_PARTS;
+    const int tile_rows = (rows + parts - 1) / parts;
+    int (*sub)[1][TILE_HIST_WAYS][TILE_HIST_BINS] = malloc(sizeof(int) * parts * TILE_HIST_WAYS * TILE_HIST_BINS);
+    int (*tiles)[1][TILE_HIST_BINS] = malloc(sizeof(int) * parts * TILE_HIST_BINS);
+    assert( sub && tiles );
+    tile_hist( rows, cols, src_step, (const uint8_t(*)[src_step])src, parts, 1, tile_rows, cols, PENCIL_BORDER_CONSTANT, sub, tiles );
+
+    int hist[TILE_HIST_BINS] = { 0 };
+    for ( int p = 0; p < parts; p++ )
+        for ( int b = 0; b < TILE_HIST_BINS; b++ )
+            hist[b] += tiles[p][0][b];
+    free(sub);
+    free(tiles);
+
+    // Like cv::equalizeHist: the lowest value present maps to 0, the cdf
+    // beyond it is stretched over [0, 255]
+    uint8_t lut[TILE_HIST_BINS] = { 0 };
+    int low = 0;
+    while ( !hist[low] )
+        low++;
+    const int total = rows * cols;
+    if ( hist[low] == total )
+    {
+        for ( int b = 0; b < TILE_HIST_BINS; b++ )
+            lut[b] = low;
+    }
+    else
+    {
+        const float scale = (TILE_HIST_BINS - 1.f) / (total - hist[low]);
+        int sum = 0;
+        for ( int b = low + 1; b < TILE_HIST_BINS; b++ )
+        {
+            sum += hist[b];
+            lut[b] = iclampi((int)rintf(sum * scale), 0, 255);
+        }
+    }
+
+    equalize_apply( rows, cols, src_step, (const uint8_t(*)[src_step])src, lut, dst_step, (uint8_t(*)[dst_step])dst );
+}
+
+void pencil_clahe( const int rows
+                 , const int cols
+                 , const int src_step
+                 , const uint8_t src[]
+                 , const int dst_step
+                 , uint8_t dst[]
+                 , const double clip_limit
+                 , const int tiles_y
+                 , const int tiles_x
+                 )
+{
+    // Like cv::CLAHE, an image that does not split evenly is histogrammed as
+    // if padded with BORDER_REFLECT_101 to whole tiles
+    const int even      = rows % tiles_y == 0 && cols % tiles_x == 0;
+    const int tile_rows = (rows + (even ? 0 : tiles_y - rows % tiles_y)) / tiles_y;
+    const int tile_cols = (cols + (even ? 0 : tiles_x - cols % tiles_x)) / tiles_x;
+    const int tile_total = tile_rows * tile_cols;
+    const int limit = clip_limit > 0 ? imax((int)(clip_limit * tile_total / TILE_HIST_BINS), 1) : 0;
+
+    int (*sub)[tiles_x][TILE_HIST_WAYS][TILE_HIST_BINS] = malloc(sizeof(int) * tiles_y * tiles_x * TILE_HIST_WAYS * TILE_HIST_BINS);
+    int (*hist)[tiles_x][TILE_HIST_BINS] = malloc(sizeof(int) * tiles_y * tiles_x * TILE_HIST_BINS);
+    float (*lut)[tiles_x][TILE_HIST_BINS] = malloc(sizeof(float) * tiles_y * tiles_x * TILE_HIST_BINS);
+    int *left = malloc(sizeof(int) * cols), *right = malloc(sizeof(int) * cols);
+    float *weight = malloc(sizeof(float) * cols);
+    assert( sub && hist && lut && left && right && weight );
+
+    tile_hist( rows, cols, src_step, (const uint8_t(*)[src_step])src, tiles_y, tiles_x, tile_rows, tile_cols, PENCIL_BORDER_REFLECT_101, sub, hist );
+    clahe_lut( tiles_y * tiles_x, limit, (float)(TILE_HIST_BINS - 1) / tile_total
+             , (int(*)[TILE_HIST_BINS])hist, (float(*)[TILE_HIST_BINS])lut );
+
+    for ( int w = 0; w < cols; w++ )
+    {
+        const float x = (float)w / tile_cols - 0.5f;
+        const int   l = (int)floorf(x);
+        weight[w] = x - l;
+        left[w]   = imax(l, 0) * TILE_HIST_BINS;
+        right[w]  = imin(l + 1, tiles_x - 1) * TILE_HIST_BINS;
+    }
+    clahe_interpolate( rows, cols, src_step, (const uint8_t(*)[src_step])src, tiles_y, tiles_x, (const float(*)[tiles_x * TILE_HIST_BINS])lut
+                     , tile_rows, left, right, weight, dst_step, (uint8_t(*)[dst_step])dst );
+
+    free(sub);
+    free(hist);
+    free(lut);
+    free(left);
+    free(right);
+    free(weight);
+}
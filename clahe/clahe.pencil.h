@@ -0,0 +1,37 @@
+#ifndef CLAHE_PENCIL_H
+#define CLAHE_PENCIL_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    // Histogram equalisation of an 8-bit image, like cv::equalizeHist
+    void pencil_equalizeHist( const int rows
+                            , const int cols
+                            , const int src_step
+                            , const uint8_t src[]
+                            , const int dst_step
+                            , uint8_t dst[]    //out
+                            );
+
+    // Contrast limited adaptive histogram equalisation over tiles_y x tiles_x
+    // tiles, like cv::createCLAHE(clip_limit, cv::Size(tiles_x, tiles_y)).
+    // A clip_limit <= 0 disables clipping.
+    void pencil_clahe( const int rows
+                     , const int cols
+                     , const int src_step
+                     , const uint8_t src[]
+                     , const int dst_step
+                     , uint8_t dst[]    //out
+                     , const double clip_limit
+                     , const int tiles_y
+                     , const int tiles_x
+                     );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -0,0 +1,162 @@
+#include "utility.hpp"
+#include "clahe.pencil.h"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/ocl/ocl.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <prl.h>
+#include <chrono>
+
+// Global equalisation when clip_limit < 0, CLAHE otherwise
+void time_clahe( const std::vector<carp::record_t>& pool, const std::vector<double>& clip_limits, const cv::Size& tiles, int iteration )
+{
+    bool first_execution_opencv = true, first_execution_pencil = true;
+
+    carp::Timing timing("clahe");
+
+    for ( int q=0; q<iteration; q++ ) {
+        for ( auto & item : pool ) {
+            for ( auto & clip_limit : clip_limits ) {
+                // acquiring the image for the test
+                cv::Mat cpu_gray;
+                cv::cvtColor( item.cpuimg(), cpu_gray, CV_RGB2GRAY );
+
+                cv::Mat cpu_result, gpu_result, pen_result;
+                std::chrono::duration<double> elapsed_time_cpu, elapsed_time_gpu_p_copy;
+
+                {
+                    const auto cpu_start = std::chrono::high_resolution_clock::now();
+                    if ( clip_limit < 0 )
+                        cv::equalizeHist( cpu_gray, cpu_result );
+                    else
+                        cv::createCLAHE( clip_limit, tiles )->apply( cpu_gray, cpu_result );
+                    const auto cpu_end = std::chrono::high_resolution_clock::now();
+                    elapsed_time_cpu = cpu_end - cpu_start;
+                }
+                {
+                    // Execute the kernel at least once before starting to take time measurements so that the OpenCV kernel gets compiled. The following run is not included in time measurements.
+                    if (first_execution_opencv)
+                    {
+                        cv::ocl::oclMat gpu_gray(cpu_gray);
+                        cv::ocl::oclMat result;
+                        cv::ocl::equalizeHist( gpu_gray, result );
+                        cv::ocl::createCLAHE( 40, tiles )->apply( gpu_gray, result );
+                        first_execution_opencv = false;
+                    }
+
+                    const auto gpu_start_copy = std::chrono::high_resolution_clock::now();
+                    cv::ocl::oclMat gpu_gray(cpu_gray);
+                    cv::ocl::oclMat result;
+                    if ( clip_limit < 0 )
+                        cv::ocl::equalizeHist( gpu_gray, result );
+                    else
+                        cv::ocl::createCLAHE( clip_limit, tiles )->apply( gpu_gray, result );
+                    gpu_result = result;
+                    const auto gpu_end_copy = std::chrono::high_resolution_clock::now();
+                    elapsed_time_gpu_p_copy = gpu_end_copy - gpu_start_copy;
+                }
+                {
+                    pen_result = cv::Mat(cpu_gray.size(), CV_8U);
+
+                    if (first_execution_pencil)
+                    {
+                        pencil_equalizeHist( cpu_gray.rows, cpu_gray.cols, cpu_gray.step1(), cpu_gray.ptr(), pen_result.step1(), pen_result.ptr() );
+                        first_execution_pencil = false;
+                    }
+
+                    prl_timings_reset();
+                    prl_timings_start();
+                    if ( clip_limit < 0 )
+                        pencil_equalizeHist( cpu_gray.rows, cpu_gray.cols, cpu_gray.step1(), cpu_gray.ptr(), pen_result.step1(), pen_result.ptr() );
+                    else
+                        pencil_clahe( cpu_gray.rows, cpu_gray.cols, cpu_gray.step1(), cpu_gray.ptr(), pen_result.step1(), pen_result.ptr()
+                                    , clip_limit, tiles.height, tiles.width
+                                    );
+                    prl_timings_stop();
+                    // Dump execution times for PENCIL code.
+                    prl_timings_dump();
+                }
+                // Verifying the results. The OpenCL CLAHE interpolates with
+                // its own roundings, allow it 1 LSB.
+                if ( (cv::norm(cpu_result, gpu_result, cv::NORM_INF) > 1) || (cv::norm(cpu_result, pen_result, cv::NORM_INF) > 0) ) {
+                    std::cerr << "ERROR: Results don't match. Writing calculated images." << std::endl;
+                    std::cerr << "GPU-CPU max error:" << cv::norm(gpu_result, cpu_result, cv::NORM_INF) << std::endl;
+                    std::cerr << "PEN-CPU max error:" << cv::norm(pen_result, cpu_result, cv::NORM_INF) << std::endl;
+
+                    cv::imwrite( "clahe_cpu.png", cpu_result );
+                    cv::imwrite( "clahe_gpu.png", gpu_result );
+                    cv::imwrite( "clahe_pen.png", pen_result );
+                    throw std::runtime_error("The OpenCL or PENCIL results are not equivalent with the C++ results.");
+                }
+                // Dump execution times for OpenCV calls.
+                timing.print( elapsed_time_cpu, elapsed_time_gpu_p_copy );
+            }
+        }
+    }
+}
+
+void time_clahe_tiles( const std::vector<carp::record_t>& pool, const std::vector<double>& clip_limits, const std::vector<int>& grids )
+{
+    std::cout << "Measuring CLAHE against cv::createCLAHE" << std::endl;
+    std::cout << "  clip limit  tiles  OpenCV (ms)  PENCIL (ms)" << std::endl;
+
+    for ( auto & clip_limit : clip_limits ) {
+        for ( auto & grid : grids ) {
+            cv::Ptr<cv::CLAHE> clahe = cv::createCLAHE( clip_limit, cv::Size(grid, grid) );
+            std::chrono::duration<double,std::milli> elapsed_time_cpu(0), elapsed_time_pen(0);
+
+            for ( auto & item : pool ) {
+                cv::Mat cpu_gray;
+                cv::cvtColor( item.cpuimg(), cpu_gray, CV_RGB2GRAY );
+
+                cv::Mat cpu_result, pen_result( cpu_gray.size(), CV_8U );
+                {
+                    const auto cpu_start = std::chrono::high_resolution_clock::now();
+                    clahe->apply( cpu_gray, cpu_result );
+                    const auto cpu_end = std::chrono::high_resolution_clock::now();
+                    elapsed_time_cpu += cpu_end - cpu_start;
+                }
+                {
+                    const auto pen_start = std::chrono::high_resolution_clock::now();
+                    pencil_clahe( cpu_gray.rows, cpu_gray.cols, cpu_gray.step1(), cpu_gray.ptr(), pen_result.step1(), pen_result.ptr()
+                                , clip_limit, grid, grid
+                                );
+                    const auto pen_end = std::chrono::high_resolution_clock::now();
+                    elapsed_time_pen += pen_end - pen_start;
+                }
+                if ( cv::norm(cpu_result, pen_result, cv::NORM_INF) > 0 )
+                    throw std::runtime_error("The PENCIL results are not equivalent with the C++ results.");
+            }
+            std::cout << std::fixed << std::setprecision(3);
+            std::cout << std::setw(12) << clip_limit << " " << std::setw(6) << grid << " "
+                      << std::setw(12) << elapsed_time_cpu.count() << " " << std::setw(12) << elapsed_time_pen.count() << std::endl;
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    prl_init((prl_init_flags)(PRL_TARGET_DEVICE_DYNAMIC | PRL_PROFILING_ENABLED));
+
+    try {
+	std::cout << "This executable is iterating over all the files passed to it as an argument. " << std::endl;
+
+	auto pool = carp::get_pool(argc, argv);
+
+#ifdef RUN_ONLY_ONE_EXPERIMENT
+        time_clahe( pool, { 2 }, cv::Size(8, 8), 1 );
+#else
+        time_clahe( pool, { -1, 2, 40 }, cv::Size(8, 8), 25 );
+        time_clahe_tiles( pool, { 0, 2, 4, 40 }, { 2, 4, 8, 16 } );
+#endif
+
+        prl_shutdown();
+        return EXIT_SUCCESS;
+    }catch(const std::exception& e) {
+        std::cout << e.what() << std::endl;
+
+        prl_shutdown();
+        return EXIT_FAILURE;
+    }
+}
@@ -1,6 +1,11 @@
 #include "dilate.pencil.h"
 
 #include <pencil.h>
+#include "border.pencil.h"
+#include "morph_lines.pencil.h"
+
+// Direct dilation, one pass per non-zero element. For small sparse elements
+// it is cheaper than splitting them into lines.
 
 static void dilate( const int rows
                   , const int cols
@@ -14,6 +19,8 @@ static void dilate( const int rows
                   , const unsigned char se[static const restrict se_rows][se_step]
                   , const int anchor_row
                   , const int anchor_col
+                  , const int border_type
+                  , const unsigned char border_value
                   )
 {
 #pragma scop
@@ -21,8 +28,6 @@ static void dilate( const int rows
     __pencil_assume(cols       >  0);
     __pencil_assume(step       >= cols);
     __pencil_assume(dilate_step>= cols);
-    __pencil_assume(se_rows    <= 9);
-    __pencil_assume(se_cols    <= 9);
     __pencil_assume(se_rows    > 0);
     __pencil_assume(se_cols    > 0);
     __pencil_assume(se_step    >= se_cols);
@@ -32,27 +37,56 @@ static void dilate( const int rows
     __pencil_assume(anchor_col < se_cols);
 
     __pencil_kill(dilate);
-
-    #pragma pencil independent
-    for ( int q = 0; q < rows; q++ )
     {
+        // Every tap of the pixels in [top, bottom) x [left, right) is inside the image
+        const int top    = imin(anchor_row, rows);
+        const int bottom = imax(rows - (se_rows - 1 - anchor_row), top);
+        const int left   = imin(anchor_col, cols);
+        const int right  = imax(cols - (se_cols - 1 - anchor_col), left);
+
         #pragma pencil independent
-        for ( int w = 0; w < cols; w++ )
+        for ( int q = top; q < bottom; q++ )
         {
-            unsigned char sup = 0;
-            #pragma pencil independent reduction(max: sup)
+            #pragma pencil independent
+            for ( int w = left; w < right; w++ )
+                dilate[q][w] = 0;
+
             for ( int e = 0; e < se_rows; e++ )
             {
-                #pragma pencil independent reduction(max: sup)
                 for ( int r = 0; r < se_cols; r++ )
                 {
-                    int candidate_row = iclampi(q - anchor_row + e, 0, rows - 1);
-                    int candidate_col = iclampi(w - anchor_col + r, 0, cols - 1);
+                    if ( se[e][r] != 0 )
+                    {
+                        #pragma pencil independent
+                        for ( int w = left; w < right; w++ )
+                            dilate[q][w] = ubmax(dilate[q][w], cpu_gray[q - anchor_row + e][w - anchor_col + r]);
+                    }
+                }
+            }
+        }
 
-                    sup = (se[e][r]!=0) ? ubmax(sup, cpu_gray[candidate_row][candidate_col]) : sup;
+        // Halo: whole rows above and below the interior, left and right strips beside it
+        #pragma pencil independent
+        for ( int q = 0; q < rows; q++ )
+        {
+            const int halo_row = q < top || q >= bottom;
+            #pragma pencil independent
+            for ( int i = 0; i < (halo_row ? cols : left + cols - right); i++ )
+            {
+                const int w = (halo_row || i < left) ? i : right + i - left;
+                unsigned char sup = 0;
+                #pragma pencil independent reduction(max: sup)
+                for ( int e = 0; e < se_rows; e++ )
+                {
+                    #pragma pencil independent reduction(max: sup)
+                    for ( int r = 0; r < se_cols; r++ )
+                    {
+                        unsigned char candidate = border_fetch(cpu_gray, q - anchor_row + e, w - anchor_col + r, rows, cols, border_type, border_value);
+                        sup = (se[e][r]!=0) ? ubmax(sup, candidate) : sup;
+                    }
                 }
+                dilate[q][w] = sup;
             }
-            dilate[q][w] = sup;
         }
     }
 #pragma endscop
@@ -72,11 +106,46 @@ void pencil_dilate( const int rows
                   , const int anchor_col
                   )
 {
+    pencil_dilate_border( rows, cols, cpu_step, cpu_gray, dilate_step, pdilate
+                        , se_rows, se_cols, se_step, se
+                        , anchor_row, anchor_col
+                        , PENCIL_BORDER_REPLICATE, 0
+                        );
+}
+
+void pencil_dilate_border( const int rows
+                         , const int cols
+                         , const int cpu_step
+                         , const uint8_t cpu_gray[]
+                         , const int dilate_step
+                         , uint8_t pdilate[]
+                         , const int se_rows
+                         , const int se_cols
+                         , const int se_step
+                         , const uint8_t se[]
+                         , const int anchor_row
+                         , const int anchor_col
+                         , const int border_type
+                         , const uint8_t border_value
+                         )
+{
+    morph_plan plan;
+    if ( morph_plan_init(&plan, se_rows, se_cols, se_step, se, anchor_row, anchor_col) )
+    {
+        const int done = plan.count > 0 && plan.cost < plan.taps
+                      && morph_apply( &plan, 0, rows, cols, cpu_step, cpu_gray, dilate_step, pdilate
+                                    , border_type, border_value
+                                    );
+        morph_plan_free(&plan);
+        if ( done )
+            return;
+    }
     dilate( rows, cols
           , cpu_step   , (const unsigned char(*)[cpu_step   ])cpu_gray
           , dilate_step, (      unsigned char(*)[dilate_step])pdilate
           , se_rows, se_cols
           , se_step    , (const unsigned char(*)[se_step    ])se
           , anchor_row, anchor_col
+          , border_type, border_value
           );
 }
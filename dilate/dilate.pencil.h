@@ -1,4 +1,5 @@
 #include <stdint.h>
+#include "border.pencil.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -18,6 +19,23 @@ void pencil_dilate( const int rows
                   , const int anchor_y
                   );
 
+// border_type is one of PENCIL_BORDER_*, border_value is used by PENCIL_BORDER_CONSTANT
+void pencil_dilate_border( const int rows
+                         , const int cols
+                         , const int cpu_step
+                         , const uint8_t cpu_gray[]
+                         , const int dilate_step
+                         , uint8_t pdilate[]
+                         , const int se_rows
+                         , const int se_cols
+                         , const int se_step
+                         , const uint8_t se[]
+                         , const int anchor_x
+                         , const int anchor_y
+                         , const int border_type
+                         , const uint8_t border_value
+                         );
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -10,87 +10,104 @@
 
 void time_dilate( const std::vector<carp::record_t>& pool, const std::vector<int>& elemsizes, int iteration )
 {
-    bool first_execution_opencv = true, first_execution_pencil = true;
+    carp::time_morphology( pool, "dilate", elemsizes, iteration
+                         , []( const cv::Mat & gray, const cv::Mat & structuring_element, cv::Point anchor ) -> cv::Mat {
+                               cv::Mat result;
+                               cv::dilate( gray, result, structuring_element, anchor, 1, cv::BORDER_CONSTANT );
+                               return result;
+                           }
+                         , []( const cv::Mat & gray, const cv::Mat & structuring_element, cv::Point anchor ) -> cv::Mat {
+                               cv::ocl::oclMat gpu_gray(gray);
+                               cv::ocl::oclMat result;
+                               cv::ocl::dilate( gpu_gray, result, structuring_element, anchor, 1, cv::BORDER_CONSTANT );
+                               return result;
+                           }
+                         , []( const cv::Mat & gray, const cv::Mat & structuring_element, cv::Point anchor ) -> cv::Mat {
+                               cv::Mat result( gray.size(), CV_8U );
+                               // cv::dilate pads BORDER_CONSTANT with the neutral element of max
+                               pencil_dilate_border( gray.rows, gray.cols, gray.step1(), gray.ptr()
+                                                   , result.step1(), result.ptr()
+                                                   , structuring_element.rows, structuring_element.cols, structuring_element.step1(), structuring_element.ptr()
+                                                   , anchor.x, anchor.y
+                                                   , PENCIL_BORDER_CONSTANT, 0
+                                                   );
+                               return result;
+                           }
+                         );
+}
 
-    carp::Timing timing("dilate image");
+void time_dilate_borders( const std::vector<carp::record_t>& pool, const std::vector<int>& elemsizes )
+{
+    const auto element = []( int elemsize ) { return cv::getStructuringElement( cv::MORPH_ELLIPSE, cv::Size(elemsize, elemsize) ); };
+
+    carp::time_borders( pool, "dilate", "ksize", elemsizes, CV_8U, 0
+                      , [&]( const cv::Mat & src, int elemsize, int border ) -> cv::Mat {
+                            const cv::Point anchor( elemsize/2, elemsize/2 );
+                            cv::Mat result;
+                            if ( border == cv::BORDER_WRAP )
+                                return carp::wrap_filter( src, elemsize, [&]( const cv::Mat & padded, cv::Mat & dst ) { cv::dilate( padded, dst, element(elemsize), anchor, 1, cv::BORDER_REPLICATE ); } );
+                            cv::dilate( src, result, element(elemsize), anchor, 1, border, cv::Scalar(0) );
+                            return result;
+                        }
+                      , [&]( const cv::Mat & src, int elemsize, int border ) -> cv::Mat {
+                            const cv::Mat structuring_element = element(elemsize);
+                            cv::Mat result( src.size(), CV_8U );
+                            pencil_dilate_border( src.rows, src.cols, src.step1(), src.ptr()
+                                                , result.step1(), result.ptr()
+                                                , structuring_element.rows, structuring_element.cols, structuring_element.step1(), structuring_element.ptr()
+                                                , elemsize/2, elemsize/2
+                                                , border, 0
+                                                );
+                            return result;
+                        }
+                      );
+}
 
-    for ( int q=0; q<iteration; q++ ) {
-        for ( auto & item : pool ) {
-            for ( auto & elemsize : elemsizes ) {
-                // acquiring the image for the test
-                cv::Mat cpu_gray;
-                cv::cvtColor( item.cpuimg(), cpu_gray, CV_RGB2GRAY );
+void time_dilate_scaling( const std::vector<carp::record_t>& pool, const std::vector<int>& elemsizes )
+{
+    std::cout << "Measuring dilate scaling with the structuring element size" << std::endl;
+    std::cout << "      shape  ksize  OpenCV (ms)  PENCIL (ms)" << std::endl;
+
+    const std::vector<std::pair<const char*, int>> shapes = { {"RECT"   , cv::MORPH_RECT   }
+                                                            , {"CROSS"  , cv::MORPH_CROSS  }
+                                                            , {"ELLIPSE", cv::MORPH_ELLIPSE}
+                                                            };
 
-                cv::Point anchor( elemsize/2, elemsize/2 );
-                cv::Size ksize(elemsize, elemsize);
-                cv::Mat structuring_element = cv::getStructuringElement( cv::MORPH_ELLIPSE, ksize, anchor );
+    for ( auto & shape : shapes ) {
+        for ( auto & elemsize : elemsizes ) {
+            cv::Point anchor( elemsize/2, elemsize/2 );
+            cv::Mat structuring_element = cv::getStructuringElement( shape.second, cv::Size(elemsize, elemsize), anchor );
 
-                cv::Mat cpu_result, gpu_result, pen_result;
-                std::chrono::duration<double> elapsed_time_cpu, elapsed_time_gpu_p_copy;
+            std::chrono::duration<double,std::milli> elapsed_time_cpu(0), elapsed_time_pen(0);
 
+            for ( auto & item : pool ) {
+                cv::Mat cpu_gray;
+                cv::cvtColor( item.cpuimg(), cpu_gray, CV_RGB2GRAY );
+
+                cv::Mat cpu_result, pen_result( cpu_gray.size(), CV_8U );
                 {
                     const auto cpu_start = std::chrono::high_resolution_clock::now();
-                    cv::dilate( cpu_gray, cpu_result, structuring_element, anchor, 1, cv::BORDER_CONSTANT );
+                    cv::dilate( cpu_gray, cpu_result, structuring_element, anchor, 1, cv::BORDER_CONSTANT, cv::Scalar(0) );
                     const auto cpu_end = std::chrono::high_resolution_clock::now();
-                    elapsed_time_cpu = cpu_end - cpu_start;
+                    elapsed_time_cpu += cpu_end - cpu_start;
                 }
                 {
-                    // Execute the kernel at least once before starting to take time measurements so that the OpenCV kernel gets compiled. The following run is not included in time measurements.
-                    if (first_execution_opencv)
-                    {
-                        cv::ocl::oclMat gpu_gray(cpu_gray);
-                        cv::ocl::oclMat result;
-                        cv::ocl::dilate( gpu_gray, result, structuring_element, anchor, 1, cv::BORDER_CONSTANT );
-                        first_execution_opencv = false;
-                    }
-
-                    const auto gpu_start_copy = std::chrono::high_resolution_clock::now();
-                    cv::ocl::oclMat gpu_gray(cpu_gray);
-                    cv::ocl::oclMat result;
-                    cv::ocl::dilate( gpu_gray, result, structuring_element, anchor, 1, cv::BORDER_CONSTANT );
-                    gpu_result = result;
-                    const auto gpu_end_copy = std::chrono::high_resolution_clock::now();
-                    elapsed_time_gpu_p_copy = gpu_end_copy - gpu_start_copy;
-                }
-                {
-                    pen_result = cv::Mat(cpu_gray.size(), CV_8U);
-
-                    if (first_execution_pencil)
-                    {
-                        pencil_dilate( cpu_gray.rows, cpu_gray.cols, cpu_gray.step1(), cpu_gray.ptr(), pen_result.step1(), pen_result.ptr(), structuring_element.rows, structuring_element.cols, structuring_element.step1(), structuring_element.ptr(), anchor.x, anchor.y);
-                        first_execution_pencil = false;
-                    }
-
-                    prl_timings_reset();
-                    prl_timings_start();
-                    pencil_dilate( cpu_gray.rows, cpu_gray.cols, cpu_gray.step1(), cpu_gray.ptr()
-                                 , pen_result.step1(), pen_result.ptr()
-                                 , structuring_element.rows, structuring_element.cols, structuring_element.step1(), structuring_element.ptr()
-                                 , anchor.x, anchor.y
-                                 );
-                    prl_timings_stop();
-                    // Dump execution times for PENCIL code.
-                    prl_timings_dump();
-                }
-                // Verifying the results
-                if ( (cv::norm(cpu_result - gpu_result) > 0.01) || (cv::norm(cpu_result - pen_result) > 0.01) ) {
-                    std::cerr << "ERROR: Results don't match. Writing calculated images." << std::endl;
-                    std::cerr << "CPU norm:" << cv::norm(cpu_result) << std::endl;
-                    std::cerr << "GPU norm:" << cv::norm(gpu_result) << std::endl;
-                    std::cerr << "PEN norm:" << cv::norm(pen_result) << std::endl;
-                    std::cerr << "GPU-CPU norm:" << cv::norm(gpu_result, cpu_result) << std::endl;
-                    std::cerr << "PEN-CPU norm:" << cv::norm(pen_result, cpu_result) << std::endl;
-
-                    cv::imwrite( "dilate_cpu.png", cpu_result );
-                    cv::imwrite( "dilate_gpu.png", gpu_result );
-                    cv::imwrite( "dilate_pen.png", pen_result );
-                    cv::imwrite( "dilate_cpugpu.png", cv::abs(cpu_result-gpu_result) );
-                    cv::imwrite( "dilate_cpupen.png", cv::abs(cpu_result-pen_result) );
-                    throw std::runtime_error("The OpenCL or PENCIL results are not equivalent with the C++ results.");
+                    const auto pen_start = std::chrono::high_resolution_clock::now();
+                    pencil_dilate_border( cpu_gray.rows, cpu_gray.cols, cpu_gray.step1(), cpu_gray.ptr()
+                                        , pen_result.step1(), pen_result.ptr()
+                                        , structuring_element.rows, structuring_element.cols, structuring_element.step1(), structuring_element.ptr()
+                                        , anchor.x, anchor.y
+                                        , PENCIL_BORDER_CONSTANT, 0
+                                        );
+                    const auto pen_end = std::chrono::high_resolution_clock::now();
+                    elapsed_time_pen += pen_end - pen_start;
                 }
-                // Dump execution times for OpenCV calls.
-                timing.print( elapsed_time_cpu, elapsed_time_gpu_p_copy );
+                if ( cv::norm(cpu_result, pen_result, cv::NORM_INF) > 0 )
+                    throw std::runtime_error("The PENCIL results are not equivalent with the C++ results.");
             }
+            std::cout << std::fixed << std::setprecision(3);
+            std::cout << std::setw(11) << shape.first << " " << std::setw(6) << elemsize << " "
+                      << std::setw(12) << elapsed_time_cpu.count() << " " << std::setw(12) << elapsed_time_pen.count() << std::endl;
         }
     }
 }
@@ -108,6 +125,8 @@ int main(int argc, char* argv[])
         time_dilate( pool, { 5 }, 1 );
 #else
         time_dilate( pool, { 3, 5 }, 25 );
+        time_dilate_borders( pool, { 3, 5, 9, 15 } );
+        time_dilate_scaling( pool, { 3, 5, 9, 15, 31, 51, 101 } );
 #endif
 
         prl_shutdown();
@@ -1,6 +1,41 @@
 #include "filter2D.pencil.h"
 
 #include <pencil.h>
+#include "border.pencil.h"
+#include "separable.pencil.h"
+#include "fft.pencil.h"
+#include "half.pencil.h"
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+
+/* Largest number of separable terms a kernel is split into before falling
+ * back to the direct 2D convolution. 1 only routes exactly separable kernels. */
+#ifndef FILTER2D_MAX_RANK
+#define FILTER2D_MAX_RANK 2
+#endif
+
+/* Relative residual below which the factorisation is considered exact. */
+#ifndef FILTER2D_RANK_TOLERANCE
+#define FILTER2D_RANK_TOLERANCE 1e-6f
+#endif
+
+/* Cost of the extra pass over the image of a separable term, in taps. */
+#ifndef FILTER2D_PASS_COST
+#define FILTER2D_PASS_COST 4
+#endif
+
+/* Rows per call of the generic 8-bit convolution: its 32-bit sums are kept
+ * for a strip of this many rows rather than for the whole image. */
+#ifndef FILTER2D_U8_STRIP
+#define FILTER2D_U8_STRIP 16
+#endif
+
+/* Largest FFT tile edge of the FFT convolution. Bounds its working set to
+ * a few tiles whatever the image size. */
+#ifndef FILTER2D_FFT_MAX_SIZE
+#define FILTER2D_FFT_MAX_SIZE 256
+#endif
 
 static void filter2D( const int rows
                     , const int cols
@@ -10,12 +45,14 @@ static void filter2D( const int rows
                     , const int kernel_cols
                     , const int kernel_step
                     , const float kernel_[static const restrict kernel_rows][kernel_step]
+                    , const int border_type
+                    , const float border_value
                     , float conv[static const restrict rows][step]
                     )
 {
 #pragma scop
-    __pencil_assume(kernel_rows <=  8);
-    __pencil_assume(kernel_cols <=  8);
+    __pencil_assume(kernel_rows <= FILTER2D_MAX_KERNEL);
+    __pencil_assume(kernel_cols <= FILTER2D_MAX_KERNEL);
     __pencil_assume(kernel_rows >=  3);
     __pencil_assume(kernel_cols >=  3);
     __pencil_assume(   1 <= rows);
@@ -23,25 +60,86 @@ static void filter2D( const int rows
     __pencil_assume(cols <= step);
     __pencil_assume(   1 <= kernel_rows);
     __pencil_assume(   1 <= kernel_cols);
-    __pencil_assume(cols <= kernel_step);
+    __pencil_assume(kernel_cols <= kernel_step);
 
     __pencil_kill(conv);
     {
+        const int anchor_row = kernel_rows / 2;
+        const int anchor_col = kernel_cols / 2;
+
+        // Every tap of the pixels in [top, bottom) x [left, right) is inside the image
+        const int top    = imin(anchor_row, rows);
+        const int bottom = imax(rows - (kernel_rows - 1 - anchor_row), top);
+        const int left   = imin(anchor_col, cols);
+        const int right  = imax(cols - (kernel_cols - 1 - anchor_col), left);
+
+        #pragma pencil independent
+        for ( int q = top; q < bottom; q++ )
+        {
+            #pragma pencil independent
+            for ( int w = left; w < right; w++ )
+                conv[q][w] = 0.;
+
+            for ( int e = 0; e < kernel_rows; e++ )
+            {
+                for ( int r = 0; r < kernel_cols; r++ )
+                {
+                    #pragma pencil independent
+                    for ( int w = left; w < right; w++ )
+                        conv[q][w] += src[q + e - anchor_row][w + r - anchor_col] * kernel_[e][r];
+                }
+            }
+        }
+
+        // Rows above and below the interior: only the row index needs
+        // extrapolating for their inner columns, once per kernel row
+        #pragma pencil independent
+        for ( int i = 0; i < top + rows - bottom; i++ )
+        {
+            const int q = i < top ? i : bottom + i - top;
+            #pragma pencil independent
+            for ( int w = left; w < right; w++ )
+                conv[q][w] = 0.;
+
+            for ( int e = 0; e < kernel_rows; e++ )
+            {
+                const int p = q + e - anchor_row;
+                if ( border_outside(p, rows, border_type) )
+                {
+                    float fill = 0.;
+                    for ( int r = 0; r < kernel_cols; r++ )
+                        fill += border_value * kernel_[e][r];
+                    #pragma pencil independent
+                    for ( int w = left; w < right; w++ )
+                        conv[q][w] += fill;
+                }
+                else
+                {
+                    const int row = border_index(p, rows, border_type);
+                    for ( int r = 0; r < kernel_cols; r++ )
+                    {
+                        #pragma pencil independent
+                        for ( int w = left; w < right; w++ )
+                            conv[q][w] += src[row][w + r - anchor_col] * kernel_[e][r];
+                    }
+                }
+            }
+        }
+
+        // Left and right edge columns of every row
         #pragma pencil independent
         for ( int q = 0; q < rows; q++ )
         {
             #pragma pencil independent
-            for ( int w = 0; w < cols; w++ )
+            for ( int i = 0; i < left + cols - right; i++ )
             {
+                const int w = i < left ? i : right + i - left;
                 float prod = 0.;
-                #pragma pencil indepenent reduction(+: prod)
                 for ( int e = 0; e < kernel_rows; e++ )
                 {
                     for ( int r = 0; r < kernel_cols; r++ )
                     {
-                        int row = iclampi( q + e - kernel_rows / 2, 0, rows-1 );
-                        int col = iclampi( w + r - kernel_cols / 2, 0, cols-1 );
-                        prod += src[row][col] * kernel_[e][r];
+                        prod += border_fetch(src, q + e - anchor_row, w + r - anchor_col, rows, cols, border_type, border_value) * kernel_[e][r];
                     }
                 }
                 conv[q][w] = prod;
@@ -53,6 +151,604 @@ static void filter2D( const int rows
 #pragma endscop
 }
 
+/* filter2D() of an image of channels interleaved elements per pixel. The
+ * taps step over whole pixels, so the column loops run over the elements
+ * of every channel at once. */
+static void filter2D_cn( const int rows
+                       , const int cols
+                       , const int channels
+                       , const int step
+                       , const float src[static const restrict rows][step]
+                       , const int kernel_rows
+                       , const int kernel_cols
+                       , const int kernel_step
+                       , const float kernel_[static const restrict kernel_rows][kernel_step]
+                       , const int border_type
+                       , const float border_value
+                       , float conv[static const restrict rows][step]
+                       )
+{
+#pragma scop
+    __pencil_assume(kernel_rows <= FILTER2D_MAX_KERNEL);
+    __pencil_assume(kernel_cols <= FILTER2D_MAX_KERNEL);
+    __pencil_assume(   1 <= rows);
+    __pencil_assume(   1 <= cols);
+    __pencil_assume(   1 <= channels);
+    __pencil_assume(cols * channels <= step);
+    __pencil_assume(   1 <= kernel_rows);
+    __pencil_assume(   1 <= kernel_cols);
+    __pencil_assume(kernel_cols <= kernel_step);
+
+    __pencil_kill(conv);
+    {
+        const int anchor_row = kernel_rows / 2;
+        const int anchor_col = kernel_cols / 2;
+
+        // Every tap of the pixels in [top, bottom) x [left, right) is inside the image
+        const int top    = imin(anchor_row, rows);
+        const int bottom = imax(rows - (kernel_rows - 1 - anchor_row), top);
+        const int left   = imin(anchor_col, cols);
+        const int right  = imax(cols - (kernel_cols - 1 - anchor_col), left);
+
+        // Rows above and below the interior extrapolate the row index once
+        // per kernel row
+        #pragma pencil independent
+        for ( int q = 0; q < rows; q++ )
+        {
+            #pragma pencil independent
+            for ( int w = left * channels; w < right * channels; w++ )
+                conv[q][w] = 0.;
+
+            for ( int e = 0; e < kernel_rows; e++ )
+            {
+                const int p = q + e - anchor_row;
+                if ( border_outside(p, rows, border_type) )
+                {
+                    float fill = 0.;
+                    for ( int r = 0; r < kernel_cols; r++ )
+                        fill += border_value * kernel_[e][r];
+                    #pragma pencil independent
+                    for ( int w = left * channels; w < right * channels; w++ )
+                        conv[q][w] += fill;
+                }
+                else
+                {
+                    const int row = q >= top && q < bottom ? p : border_index(p, rows, border_type);
+                    for ( int r = 0; r < kernel_cols; r++ )
+                    {
+                        #pragma pencil independent
+                        for ( int w = left * channels; w < right * channels; w++ )
+                            conv[q][w] += src[row][w + (r - anchor_col) * channels] * kernel_[e][r];
+                    }
+                }
+            }
+        }
+
+        // Left and right edge pixels of every row
+        #pragma pencil independent
+        for ( int q = 0; q < rows; q++ )
+        {
+            #pragma pencil independent
+            for ( int i = 0; i < (left + cols - right) * channels; i++ )
+            {
+                const int x = i / channels;
+                const int w = x < left ? x : right + x - left;
+                const int c = i % channels;
+                float prod = 0.;
+                for ( int e = 0; e < kernel_rows; e++ )
+                {
+                    const int p = q + e - anchor_row;
+                    for ( int r = 0; r < kernel_cols; r++ )
+                    {
+                        const int o = w + r - anchor_col;
+                        prod += ( border_outside(p, rows, border_type) || border_outside(o, cols, border_type) ? border_value
+                                : src[border_index(p, rows, border_type)][border_index(o, cols, border_type) * channels + c] ) * kernel_[e][r];
+                    }
+                }
+                conv[q][w * channels + c] = prod;
+            }
+        }
+    }
+    __pencil_kill(src);
+    __pencil_kill(kernel_);
+#pragma endscop
+}
+
+/* 8-bit 2D convolution in fixed point (see filter2D_u8_kernel) of the
+ * strip_rows rows from first_row on, written to conv. Sums are accumulated tap
+ * by tap over whole rows in 32 bits in acc, one row per strip row, then
+ * rounded and saturated. */
+static void filter2D_u8( const int rows
+                       , const int cols
+                       , const int step
+                       , const uint8_t src[static const restrict rows][step]
+                       , const int kernel_rows
+                       , const int kernel_cols
+                       , const int16_t kernel_[static const restrict kernel_rows][kernel_cols]
+                       , const int shift
+                       , const int border_type
+                       , const int border_value
+                       , const int first_row
+                       , const int strip_rows
+                       , int acc[static const restrict strip_rows][step]
+                       , uint8_t conv[static const restrict strip_rows][step]
+                       )
+{
+#pragma scop
+    __pencil_assume(kernel_rows <= FILTER2D_MAX_KERNEL);
+    __pencil_assume(kernel_cols <= FILTER2D_MAX_KERNEL);
+    __pencil_assume(   1 <= kernel_rows);
+    __pencil_assume(   1 <= kernel_cols);
+    __pencil_assume(   1 <= rows);
+    __pencil_assume(   1 <= cols);
+    __pencil_assume(cols <= step);
+    __pencil_assume(   1 <= shift);
+    __pencil_assume(   0 <= first_row);
+    __pencil_assume(   1 <= strip_rows);
+    __pencil_assume(first_row + strip_rows <= rows);
+
+    __pencil_kill(acc);
+    __pencil_kill(conv);
+    {
+        const int anchor_row = kernel_rows / 2;
+        const int anchor_col = kernel_cols / 2;
+        const int top    = imin(anchor_row, rows);
+        const int bottom = imax(rows - (kernel_rows - 1 - anchor_row), top);
+        const int left   = imin(anchor_col, cols);
+        const int right  = imax(cols - (kernel_cols - 1 - anchor_col), left);
+        const int round  = 1 << (shift - 1);
+
+        #pragma pencil independent
+        for ( int i = 0; i < strip_rows; i++ )
+        {
+            const int q = first_row + i;
+            const int halo_row = q < top || q >= bottom;
+            if ( !halo_row )
+            {
+                #pragma pencil independent
+                for ( int w = left; w < right; w++ )
+                    acc[i][w] = round;
+                for ( int e = 0; e < kernel_rows; e++ )
+                {
+                    for ( int r = 0; r < kernel_cols; r++ )
+                    {
+                        #pragma pencil independent
+                        for ( int w = left; w < right; w++ )
+                            acc[i][w] += src[q + e - anchor_row][w + r - anchor_col] * kernel_[e][r];
+                    }
+                }
+            }
+            #pragma pencil independent
+            for ( int j = 0; j < (halo_row ? cols : left + cols - right); j++ )
+            {
+                const int w = (halo_row || j < left) ? j : right + j - left;
+                int prod = round;
+                for ( int e = 0; e < kernel_rows; e++ )
+                    for ( int r = 0; r < kernel_cols; r++ )
+                        prod += border_fetch(src, q + e - anchor_row, w + r - anchor_col, rows, cols, border_type, border_value) * kernel_[e][r];
+                acc[i][w] = prod;
+            }
+            #pragma pencil independent
+            for ( int w = 0; w < cols; w++ )
+                conv[i][w] = iclampi(acc[i][w] >> shift, 0, 255);
+        }
+    }
+    __pencil_kill(acc);
+    __pencil_kill(src);
+    __pencil_kill(kernel_);
+#pragma endscop
+}
+
+#define FILTER2D_PASTE(name, size) name##size
+#define FILTER2D_NAME(name, size) FILTER2D_PASTE(name, size)
+
+#define FILTER2D_SIZE 3
+#include "filter2D.pencil.detail.h"
+#undef FILTER2D_SIZE
+#define FILTER2D_SIZE 5
+#include "filter2D.pencil.detail.h"
+#undef FILTER2D_SIZE
+#define FILTER2D_SIZE 7
+#include "filter2D.pencil.detail.h"
+#undef FILTER2D_SIZE
+
+static void filter2D_accumulate( const int rows
+                               , const int cols
+                               , const int step
+                               , const float src[static const restrict rows][step]
+                               , float conv[static const restrict rows][step]
+                               )
+{
+#pragma scop
+    __pencil_assume(   1 <= rows);
+    __pencil_assume(   1 <= cols);
+    __pencil_assume(cols <= step);
+
+    #pragma pencil independent
+    for ( int q = 0; q < rows; q++ )
+    {
+        #pragma pencil independent
+        for ( int w = 0; w < cols; w++ )
+            conv[q][w] += src[q][w];
+    }
+    __pencil_kill(src);
+#pragma endscop
+}
+
+/* Splits the kernel into a sum of outer products col_factor[t] * row_factor[t]^T
+ * by cross approximation with full pivoting, which is exact once the residual
+ * vanishes. Returns the number of terms, or 0 if the
+ * kernel needs more than FILTER2D_MAX_RANK of them. */
+static int filter2D_factorise( const int kernel_rows
+                             , const int kernel_cols
+                             , const int kernel_step
+                             , const float kernel_[]
+                             , float col_factor[FILTER2D_MAX_RANK][FILTER2D_MAX_KERNEL]
+                             , float row_factor[FILTER2D_MAX_RANK][FILTER2D_MAX_KERNEL]
+                             )
+{
+    float residual[FILTER2D_MAX_KERNEL][FILTER2D_MAX_KERNEL];
+    float scale = 0.f;
+    for ( int e = 0; e < kernel_rows; e++ )
+        for ( int r = 0; r < kernel_cols; r++ )
+        {
+            residual[e][r] = kernel_[e * kernel_step + r];
+            scale = fmaxf(scale, fabsf(residual[e][r]));
+        }
+
+    for ( int t = 0; ; t++ )
+    {
+        int pivot_row = 0, pivot_col = 0;
+        for ( int e = 0; e < kernel_rows; e++ )
+            for ( int r = 0; r < kernel_cols; r++ )
+                if ( fabsf(residual[e][r]) > fabsf(residual[pivot_row][pivot_col]) )
+                {
+                    pivot_row = e;
+                    pivot_col = r;
+                }
+
+        if ( fabsf(residual[pivot_row][pivot_col]) <= FILTER2D_RANK_TOLERANCE * scale )
+            return t;
+        if ( t == FILTER2D_MAX_RANK )
+            return 0;
+
+        const float pivot = residual[pivot_row][pivot_col];
+        for ( int e = 0; e < kernel_rows; e++ )
+            col_factor[t][e] = residual[e][pivot_col];
+        for ( int r = 0; r < kernel_cols; r++ )
+            row_factor[t][r] = residual[pivot_row][r] / pivot;
+        for ( int e = 0; e < kernel_rows; e++ )
+            for ( int r = 0; r < kernel_cols; r++ )
+                residual[e][r] -= col_factor[t][e] * row_factor[t][r];
+    }
+}
+
+// Sum of rank two-pass separable filters
+static void filter2D_separable( const int rows
+                              , const int cols
+                              , const int channels
+                              , const int step
+                              , const float src[]
+                              , const int kernel_rows
+                              , const int kernel_cols
+                              , const int rank
+                              , const float col_factor[FILTER2D_MAX_RANK][FILTER2D_MAX_KERNEL]
+                              , const float row_factor[FILTER2D_MAX_RANK][FILTER2D_MAX_KERNEL]
+                              , const int border_type
+                              , const float border_value
+                              , float conv[]
+                              )
+{
+    float (*temp)[step] = rank > 1 ? (float (*)[step])malloc(sizeof(float)*rows*step) : NULL;
+    assert( rank == 1 || temp );
+    for ( int t = 0; t < rank; t++ )
+    {
+        // Rows outside the image are constant after the horizontal pass
+        float border_valueY = 0.f;
+        for ( int r = 0; r < kernel_cols; r++ )
+            border_valueY += border_value * row_factor[t][r];
+
+        separable_filter( rows, cols, channels, step, (const float (*)[step])src
+                        , kernel_cols, row_factor[t]
+                        , kernel_rows, col_factor[t]
+                        , border_type, border_value, border_valueY
+                        , t == 0 ? (float (*)[step])conv : temp
+                        );
+        if ( t > 0 )
+            filter2D_accumulate( rows, cols * channels, step, (const float (*)[step])temp, (float (*)[step])conv );
+    }
+    free(temp);
+}
+
+/* Converts the kernel to 16-bit taps scaled by 2^shift and returns shift. The
+ * shift is as large as the 16-bit taps and the 32-bit sums over 8-bit pixels
+ * allow, for at most 2^-shift-1 rounding error per tap. */
+static int filter2D_u8_kernel( const int kernel_rows
+                             , const int kernel_cols
+                             , const int kernel_step
+                             , const float kernel_[]
+                             , int16_t fixed[]
+                             )
+{
+    float max_tap = 0.f, sum_taps = 0.f;
+    for ( int e = 0; e < kernel_rows; e++ )
+        for ( int r = 0; r < kernel_cols; r++ )
+        {
+            max_tap   = fmaxf(max_tap, fabsf(kernel_[e * kernel_step + r]));
+            sum_taps += fabsf(kernel_[e * kernel_step + r]);
+        }
+
+    int shift = 1;
+    while ( shift < 24 && ldexpf(max_tap, shift + 1) < 32767.f && ldexpf(sum_taps, shift + 1) * 255.f < (float)(1 << 30) )
+        shift++;
+
+    for ( int e = 0; e < kernel_rows; e++ )
+        for ( int r = 0; r < kernel_cols; r++ )
+            fixed[e * kernel_cols + r] = (int16_t)lrintf(ldexpf(kernel_[e * kernel_step + r], shift));
+    return shift;
+}
+
+/* FFT convolution by overlap-save: the image is cut into n x n tiles that
+ * overlap by the kernel size minus one, each tile is transformed, multiplied
+ * with the kernel spectrum and transformed back, and the part not affected by
+ * the circular wrap-around is stored. Tiles are gathered with border_fetch()
+ * so every border mode works unchanged.
+ *
+ * Every pass is a fft_complex_rows() so the butterflies run over whole rows:
+ * the real tile is packed as even rows + i odd rows into a half length
+ * transform along the columns, unpacked to the n/2+1 non redundant
+ * frequencies, transposed and transformed along the (former) rows. */
+struct pencil_filter2D_fft_plan
+{
+    int kernel_rows;
+    int kernel_cols;
+    int n;                 // tile edge, power of two
+    int half;              // n/2
+    int spectrum_step;     // n/2+1 non redundant frequencies
+    fft_table table;       // length n
+    fft_table table_half;  // length n/2
+    float *unpack_re;      // exp(-2 pi i k / n), k <= n/2
+    float *unpack_im;
+    float *kernel_re;      // n x spectrum_step, scaled for the inverse
+    float *kernel_im;
+    float *tile_re;        // half x n: even tile rows
+    float *tile_im;        //           odd tile rows
+    float *column_re;      // spectrum_step x n
+    float *column_im;
+    float *spectrum_re;    // n x spectrum_step
+    float *spectrum_im;
+};
+
+// Butterflies per output pixel of an n x n tile
+static float filter2D_fft_cost( const int n, const int kernel_rows, const int kernel_cols )
+{
+    int log2n = 0;
+    while ( (1 << log2n) < n )
+        log2n++;
+    return (float)n * n * log2n / ((float)(n - kernel_rows + 1) * (n - kernel_cols + 1));
+}
+
+static int filter2D_fft_size( const int kernel_rows, const int kernel_cols )
+{
+    int best = 0;
+    for ( int n = 8; n <= FILTER2D_FFT_MAX_SIZE; n *= 2 )
+        if ( n > kernel_rows && n > kernel_cols && (!best || filter2D_fft_cost(n, kernel_rows, kernel_cols) < filter2D_fft_cost(best, kernel_rows, kernel_cols)) )
+            best = n;
+    return best;
+}
+
+// tile_re/tile_im (packed real tile) -> spectrum_re/spectrum_im
+static void filter2D_fft_forward( pencil_filter2D_fft_plan *plan )
+{
+    const int n    = plan->n;
+    const int half = plan->half;
+    const int s    = plan->spectrum_step;
+
+    fft_complex_rows( &plan->table_half, n, n, plan->tile_re, plan->tile_im, 0 );
+
+    // Z = E + i O with E, O the spectra of the even and odd rows: X[k] = E[k] + W^k O[k]
+    for ( int k = 0; k < s; k++ )
+    {
+        const float *zr = plan->tile_re + (k % half) * n, *zr_ = plan->tile_re + ((half - k) % half) * n;
+        const float *zi = plan->tile_im + (k % half) * n, *zi_ = plan->tile_im + ((half - k) % half) * n;
+        const float wr = plan->unpack_re[k];
+        const float wi = plan->unpack_im[k];
+        float *xr = plan->column_re + k * n;
+        float *xi = plan->column_im + k * n;
+        for ( int j = 0; j < n; j++ )
+        {
+            const float er = 0.5f * (zr[j] + zr_[j]);
+            const float ei = 0.5f * (zi[j] - zi_[j]);
+            const float or_ = 0.5f * (zi[j] + zi_[j]);
+            const float oi = 0.5f * (zr_[j] - zr[j]);
+            xr[j] = er + wr * or_ - wi * oi;
+            xi[j] = ei + wr * oi + wi * or_;
+        }
+    }
+
+    for ( int j = 0; j < n; j++ )
+        for ( int k = 0; k < s; k++ )
+        {
+            plan->spectrum_re[j * s + k] = plan->column_re[k * n + j];
+            plan->spectrum_im[j * s + k] = plan->column_im[k * n + j];
+        }
+    fft_complex_rows( &plan->table, s, s, plan->spectrum_re, plan->spectrum_im, 0 );
+}
+
+// spectrum_re/spectrum_im -> tile_re/tile_im (packed real tile, scaled by n * n/2)
+static void filter2D_fft_inverse( pencil_filter2D_fft_plan *plan )
+{
+    const int n    = plan->n;
+    const int half = plan->half;
+    const int s    = plan->spectrum_step;
+
+    fft_complex_rows( &plan->table, s, s, plan->spectrum_re, plan->spectrum_im, 1 );
+    for ( int k = 0; k < s; k++ )
+        for ( int j = 0; j < n; j++ )
+        {
+            plan->column_re[k * n + j] = plan->spectrum_re[j * s + k];
+            plan->column_im[k * n + j] = plan->spectrum_im[j * s + k];
+        }
+
+    // E[k] = (X[k] + conj X[n/2-k]) / 2, O[k] = (X[k] - conj X[n/2-k]) / (2 W^k), Z = E + i O
+    for ( int k = 0; k < half; k++ )
+    {
+        const float *xr = plan->column_re + k * n, *xr_ = plan->column_re + (half - k) * n;
+        const float *xi = plan->column_im + k * n, *xi_ = plan->column_im + (half - k) * n;
+        const float wr =  plan->unpack_re[k];
+        const float wi = -plan->unpack_im[k];
+        float *zr = plan->tile_re + k * n;
+        float *zi = plan->tile_im + k * n;
+        for ( int j = 0; j < n; j++ )
+        {
+            const float er = 0.5f * (xr[j] + xr_[j]);
+            const float ei = 0.5f * (xi[j] - xi_[j]);
+            const float dr = 0.5f * (xr[j] - xr_[j]);
+            const float di = 0.5f * (xi[j] + xi_[j]);
+            const float or_ = dr * wr - di * wi;
+            const float oi = dr * wi + di * wr;
+            zr[j] = er - oi;
+            zi[j] = ei + or_;
+        }
+    }
+    fft_complex_rows( &plan->table_half, n, n, plan->tile_re, plan->tile_im, 1 );
+}
+
+pencil_filter2D_fft_plan * pencil_filter2D_fft_plan_create( const int kernel_rows
+                                                          , const int kernel_cols
+                                                          , const int kernel_step
+                                                          , const float kernel_[]
+                                                          )
+{
+    const int n = filter2D_fft_size( kernel_rows, kernel_cols );
+    if ( !n )
+        return NULL;
+
+    pencil_filter2D_fft_plan *plan = (pencil_filter2D_fft_plan *)calloc(1, sizeof(pencil_filter2D_fft_plan));
+    if ( !plan )
+        return NULL;
+    const int half = n / 2;
+    const int s    = half + 1;
+    plan->kernel_rows   = kernel_rows;
+    plan->kernel_cols   = kernel_cols;
+    plan->n             = n;
+    plan->half          = half;
+    plan->spectrum_step = s;
+    plan->unpack_re     = (float *)malloc(sizeof(float) * s);
+    plan->unpack_im     = (float *)malloc(sizeof(float) * s);
+    plan->kernel_re     = (float *)malloc(sizeof(float) * n * s);
+    plan->kernel_im     = (float *)malloc(sizeof(float) * n * s);
+    plan->tile_re       = (float *)malloc(sizeof(float) * half * n);
+    plan->tile_im       = (float *)malloc(sizeof(float) * half * n);
+    plan->column_re     = (float *)malloc(sizeof(float) * s * n);
+    plan->column_im     = (float *)malloc(sizeof(float) * s * n);
+    plan->spectrum_re   = (float *)malloc(sizeof(float) * n * s);
+    plan->spectrum_im   = (float *)malloc(sizeof(float) * n * s);
+    if ( !fft_table_init(&plan->table, n) || !fft_table_init(&plan->table_half, half)
+      || !plan->unpack_re || !plan->unpack_im || !plan->kernel_re || !plan->kernel_im || !plan->tile_re || !plan->tile_im
+      || !plan->column_re || !plan->column_im || !plan->spectrum_re || !plan->spectrum_im )
+    {
+        pencil_filter2D_fft_plan_destroy( plan );
+        return NULL;
+    }
+    for ( int k = 0; k < s; k++ )
+    {
+        plan->unpack_re[k] = (float)cos(-2. * 3.14159265358979323846 * k / n);
+        plan->unpack_im[k] = (float)sin(-2. * 3.14159265358979323846 * k / n);
+    }
+
+    // filter2D is a correlation: convolve with the flipped kernel, scaled for the unnormalised inverse
+    const float scale = 2.f / ((float)n * n);
+    memset( plan->tile_re, 0, sizeof(float) * half * n );
+    memset( plan->tile_im, 0, sizeof(float) * half * n );
+    for ( int e = 0; e < kernel_rows; e++ )
+    {
+        float *row = (e % 2 ? plan->tile_im : plan->tile_re) + (e / 2) * n;
+        for ( int r = 0; r < kernel_cols; r++ )
+            row[r] = kernel_[(kernel_rows - 1 - e) * kernel_step + kernel_cols - 1 - r] * scale;
+    }
+    filter2D_fft_forward( plan );
+    memcpy( plan->kernel_re, plan->spectrum_re, sizeof(float) * n * s );
+    memcpy( plan->kernel_im, plan->spectrum_im, sizeof(float) * n * s );
+    return plan;
+}
+
+void pencil_filter2D_fft_plan_destroy( pencil_filter2D_fft_plan *plan )
+{
+    if ( !plan )
+        return;
+    fft_table_free( &plan->table );
+    fft_table_free( &plan->table_half );
+    free(plan->unpack_re);
+    free(plan->unpack_im);
+    free(plan->kernel_re);
+    free(plan->kernel_im);
+    free(plan->tile_re);
+    free(plan->tile_im);
+    free(plan->column_re);
+    free(plan->column_im);
+    free(plan->spectrum_re);
+    free(plan->spectrum_im);
+    free(plan);
+}
+
+void pencil_filter2D_fft( pencil_filter2D_fft_plan *plan
+                        , const int rows
+                        , const int cols
+                        , const int step
+                        , const float src_[]
+                        , const int border_type
+                        , const float border_value
+                        , float conv_[]
+                        )
+{
+    const float (*src)[step] = (const float (*)[step])src_;
+    float (*conv)[step] = (float (*)[step])conv_;
+    const int n          = plan->n;
+    const int valid_rows = n - plan->kernel_rows + 1;
+    const int valid_cols = n - plan->kernel_cols + 1;
+    const int anchor_row = plan->kernel_rows / 2;
+    const int anchor_col = plan->kernel_cols / 2;
+    const int spectrum   = n * plan->spectrum_step;
+
+    for ( int ty = 0; ty < rows; ty += valid_rows )
+    {
+        for ( int tx = 0; tx < cols; tx += valid_cols )
+        {
+            const int r0 = ty - anchor_row;
+            const int c0 = tx - anchor_col;
+            for ( int i = 0; i < n; i++ )
+            {
+                float *tile_row = (i % 2 ? plan->tile_im : plan->tile_re) + (i / 2) * n;
+                if ( r0 + i >= 0 && r0 + i < rows && c0 >= 0 && c0 + n <= cols )
+                    memcpy( tile_row, &src[r0 + i][c0], sizeof(float) * n );
+                else
+                    for ( int j = 0; j < n; j++ )
+                        tile_row[j] = border_fetch(src, r0 + i, c0 + j, rows, cols, border_type, border_value);
+            }
+
+            filter2D_fft_forward( plan );
+            for ( int k = 0; k < spectrum; k++ )
+            {
+                const float re = plan->spectrum_re[k] * plan->kernel_re[k] - plan->spectrum_im[k] * plan->kernel_im[k];
+                const float im = plan->spectrum_re[k] * plan->kernel_im[k] + plan->spectrum_im[k] * plan->kernel_re[k];
+                plan->spectrum_re[k] = re;
+                plan->spectrum_im[k] = im;
+            }
+            filter2D_fft_inverse( plan );
+
+            const int out_rows = imin(valid_rows, rows - ty);
+            const int out_cols = imin(valid_cols, cols - tx);
+            for ( int u = 0; u < out_rows; u++ )
+            {
+                const int i = u + plan->kernel_rows - 1;
+                const float *tile_row = (i % 2 ? plan->tile_im : plan->tile_re) + (i / 2) * n;
+                memcpy( &conv[ty + u][tx], tile_row + plan->kernel_cols - 1, sizeof(float) * out_cols );
+            }
+        }
+    }
+}
+
 void pencil_filter2D( const int rows
                     , const int cols
                     , const int step
@@ -64,8 +760,282 @@ void pencil_filter2D( const int rows
                     , float conv[]
                     )
 {
+    pencil_filter2D_border( rows, cols, step, src, kernel_rows, kernel_cols, kernel_step, kernel_, PENCIL_BORDER_REPLICATE, 0.f, conv );
+}
+
+/* Rank of the separable passes replacing the kernel, 0 if the direct or FFT
+ * convolution is cheaper. */
+static int filter2D_separable_rank( const int kernel_rows
+                                  , const int kernel_cols
+                                  , const int kernel_step
+                                  , const float kernel_[]
+                                  , float col_factor[FILTER2D_MAX_RANK][FILTER2D_MAX_KERNEL]
+                                  , float row_factor[FILTER2D_MAX_RANK][FILTER2D_MAX_KERNEL]
+                                  )
+{
+    const int rank = filter2D_factorise( kernel_rows, kernel_cols, kernel_step, kernel_, col_factor, row_factor );
+    return rank > 0 && rank * (kernel_rows + kernel_cols + FILTER2D_PASS_COST) < kernel_rows * kernel_cols ? rank : 0;
+}
+
+/* True if the FFT convolution beats the direct taps for the kernel size. */
+static int filter2D_use_fft( const int kernel_rows, const int kernel_cols )
+{
+    const int n = filter2D_fft_size( kernel_rows, kernel_cols );
+    return n && FILTER2D_FFT_COST * filter2D_fft_cost(n, kernel_rows, kernel_cols) < kernel_rows * kernel_cols;
+}
+
+void pencil_filter2D_border( const int rows
+                           , const int cols
+                           , const int step
+                           , const float src[]
+                           , const int kernel_rows
+                           , const int kernel_cols
+                           , const int kernel_step
+                           , const float kernel_[]
+                           , const int border_type
+                           , const float border_value
+                           , float conv[]
+                           )
+{
+    // The factors below are sized for FILTER2D_MAX_KERNEL taps
+    assert( kernel_rows <= FILTER2D_MAX_KERNEL && kernel_cols <= FILTER2D_MAX_KERNEL );
+
+    // Low rank kernels (Sobel, box, Gaussian, ...) are cheaper as separable passes
+    {
+        float col_factor[FILTER2D_MAX_RANK][FILTER2D_MAX_KERNEL];
+        float row_factor[FILTER2D_MAX_RANK][FILTER2D_MAX_KERNEL];
+        const int rank = filter2D_separable_rank( kernel_rows, kernel_cols, kernel_step, kernel_, col_factor, row_factor );
+        if ( rank )
+        {
+            filter2D_separable( rows, cols, 1, step, src, kernel_rows, kernel_cols, rank, col_factor, row_factor, border_type, border_value, conv );
+            return;
+        }
+    }
+
+    // Large full rank kernels: FFT convolution once it beats the direct taps
+    if ( filter2D_use_fft(kernel_rows, kernel_cols) )
+    {
+        pencil_filter2D_fft_plan *plan = pencil_filter2D_fft_plan_create( kernel_rows, kernel_cols, kernel_step, kernel_ );
+        if ( plan )
+        {
+            pencil_filter2D_fft( plan, rows, cols, step, src, border_type, border_value, conv );
+            pencil_filter2D_fft_plan_destroy( plan );
+            return;
+        }
+    }
+
+    pencil_filter2D_direct( rows, cols, step, src, kernel_rows, kernel_cols, kernel_step, kernel_, border_type, border_value, conv );
+}
+
+void pencil_filter2D_direct( const int rows
+                           , const int cols
+                           , const int step
+                           , const float src[]
+                           , const int kernel_rows
+                           , const int kernel_cols
+                           , const int kernel_step
+                           , const float kernel_[]
+                           , const int border_type
+                           , const float border_value
+                           , float conv[]
+                           )
+{
+#define FILTER2D_CASE(size) case size: FILTER2D_NAME(filter2D_, size)( rows, cols, step, (const float (*)[step])src, kernel_step, (const float (*)[kernel_step])kernel_, border_type, border_value, (float (*)[step])conv ); return;
+    // Square kernels of the common sizes use the specialised, fully unrolled versions
+    if ( kernel_rows == kernel_cols )
+    {
+        switch ( kernel_rows )
+        {
+        FILTER2D_CASE(3)
+        FILTER2D_CASE(5)
+        FILTER2D_CASE(7)
+        }
+    }
+#undef FILTER2D_CASE
     filter2D(        rows,        cols,        step, (const float (*)[       step])src
             , kernel_rows, kernel_cols, kernel_step, (const float (*)[kernel_step])kernel_
+            , border_type, border_value
             ,                                        (      float (*)[       step])conv
             );
 }
+
+void pencil_filter2D_cn( const int rows
+                       , const int cols
+                       , const int channels
+                       , const int step
+                       , const float src[]
+                       , const int kernel_rows
+                       , const int kernel_cols
+                       , const int kernel_step
+                       , const float kernel_[]
+                       , const int border_type
+                       , const float border_value
+                       , float conv[]
+                       )
+{
+    assert( channels > 0 );
+    assert( kernel_rows <= FILTER2D_MAX_KERNEL && kernel_cols <= FILTER2D_MAX_KERNEL );
+    if ( channels == 1 )
+    {
+        pencil_filter2D_border( rows, cols, step, src, kernel_rows, kernel_cols, kernel_step, kernel_, border_type, border_value, conv );
+        return;
+    }
+
+    {
+        float col_factor[FILTER2D_MAX_RANK][FILTER2D_MAX_KERNEL];
+        float row_factor[FILTER2D_MAX_RANK][FILTER2D_MAX_KERNEL];
+        const int rank = filter2D_separable_rank( kernel_rows, kernel_cols, kernel_step, kernel_, col_factor, row_factor );
+        if ( rank )
+        {
+            filter2D_separable( rows, cols, channels, step, src, kernel_rows, kernel_cols, rank, col_factor, row_factor, border_type, border_value, conv );
+            return;
+        }
+    }
+
+    // The FFT tiles hold a single channel: each goes through a plane of its own
+    if ( filter2D_use_fft(kernel_rows, kernel_cols) )
+    {
+        pencil_filter2D_fft_plan *plan = pencil_filter2D_fft_plan_create( kernel_rows, kernel_cols, kernel_step, kernel_ );
+        if ( plan )
+        {
+            float *plane = (float *)malloc(sizeof(float) * rows * cols * 2);
+            assert( plane );
+            float *plane_conv = plane + rows * cols;
+            for ( int c = 0; c < channels; c++ )
+            {
+                for ( int q = 0; q < rows; q++ )
+                    for ( int w = 0; w < cols; w++ )
+                        plane[q * cols + w] = src[q * step + w * channels + c];
+                pencil_filter2D_fft( plan, rows, cols, cols, plane, border_type, border_value, plane_conv );
+                for ( int q = 0; q < rows; q++ )
+                    for ( int w = 0; w < cols; w++ )
+                        conv[q * step + w * channels + c] = plane_conv[q * cols + w];
+            }
+            free(plane);
+            pencil_filter2D_fft_plan_destroy( plan );
+            return;
+        }
+    }
+
+    filter2D_cn(        rows,        cols, channels,   step, (const float (*)[       step])src
+               , kernel_rows, kernel_cols, kernel_step,      (const float (*)[kernel_step])kernel_
+               , border_type, border_value
+               ,                                             (      float (*)[       step])conv
+               );
+}
+
+void pencil_filter2D_u8( const int rows
+                       , const int cols
+                       , const int step
+                       , const uint8_t src[]
+                       , const int kernel_rows
+                       , const int kernel_cols
+                       , const int kernel_step
+                       , const float kernel_[]
+                       , const int border_type
+                       , const uint8_t border_value
+                       , uint8_t conv[]
+                       )
+{
+    assert( kernel_rows <= FILTER2D_MAX_KERNEL && kernel_cols <= FILTER2D_MAX_KERNEL );
+
+    // The direct cost grows with the taps while the float engines do not, so
+    // large kernels convert to float and go through the usual dispatcher
+    if ( kernel_rows * kernel_cols > FILTER2D_U8_MAX_TAPS )
+    {
+        float *src_float  = (float *)calloc(rows * step, sizeof(float));
+        float *conv_float = (float *)malloc(sizeof(float) * rows * step);
+        assert( src_float && conv_float );
+        for ( int q = 0; q < rows; q++ )
+            for ( int w = 0; w < cols; w++ )
+                src_float[q * step + w] = src[q * step + w];
+        pencil_filter2D_border( rows, cols, step, src_float, kernel_rows, kernel_cols, kernel_step, kernel_, border_type, border_value, conv_float );
+        for ( int q = 0; q < rows; q++ )
+            for ( int w = 0; w < cols; w++ )
+                conv[q * step + w] = iclampi((int)lrintf(conv_float[q * step + w]), 0, 255);
+        free(src_float);
+        free(conv_float);
+        return;
+    }
+
+    int16_t fixed[kernel_rows * kernel_cols];
+    const int shift = filter2D_u8_kernel( kernel_rows, kernel_cols, kernel_step, kernel_, fixed );
+
+#define FILTER2D_CASE(size) case size: FILTER2D_NAME(filter2D_u8_, size)( rows, cols, step, (const uint8_t (*)[step])src, (const int16_t (*)[size])fixed, shift, border_type, border_value, (uint8_t (*)[step])conv ); return;
+    if ( kernel_rows == kernel_cols )
+    {
+        switch ( kernel_rows )
+        {
+        FILTER2D_CASE(3)
+        FILTER2D_CASE(5)
+        FILTER2D_CASE(7)
+        }
+    }
+#undef FILTER2D_CASE
+    int *acc = (int *)malloc(sizeof(int) * imin(FILTER2D_U8_STRIP, rows) * step);
+    assert( acc );
+    for ( int first_row = 0; first_row < rows; first_row += FILTER2D_U8_STRIP )
+    {
+        const int strip_rows = imin(FILTER2D_U8_STRIP, rows - first_row);
+        filter2D_u8( rows, cols, step, (const uint8_t (*)[step])src
+                   , kernel_rows, kernel_cols, (const int16_t (*)[kernel_cols])fixed, shift
+                   , border_type, border_value
+                   , first_row, strip_rows, (int (*)[step])acc
+                   , (uint8_t (*)[step])(conv + first_row * step)
+                   );
+    }
+    free(acc);
+}
+
+typedef struct
+{
+    int kernel_rows;
+    int kernel_cols;
+    int kernel_step;
+    const float *kernel;
+    int border_type;
+    float border_value;
+    pencil_filter2D_fft_plan *plan; // shared by all the strips when not NULL
+} filter2D_f16_arguments;
+
+static void filter2D_f16_strip( const int rows, const int cols, const int step, const float src[], float conv[], const void *arguments )
+{
+    const filter2D_f16_arguments *a = (const filter2D_f16_arguments *)arguments;
+    if ( a->plan )
+        pencil_filter2D_fft( a->plan, rows, cols, step, src, a->border_type, a->border_value, conv );
+    else
+        pencil_filter2D_border( rows, cols, step, src, a->kernel_rows, a->kernel_cols, a->kernel_step, a->kernel, a->border_type, a->border_value, conv );
+}
+
+void pencil_filter2D_f16( const int rows
+                        , const int cols
+                        , const int step
+                        , const uint16_t src[]
+                        , const int kernel_rows
+                        , const int kernel_cols
+                        , const int kernel_step
+                        , const float kernel_[]
+                        , const int border_type
+                        , const float border_value
+                        , uint16_t conv[]
+                        )
+{
+    assert( kernel_rows <= FILTER2D_MAX_KERNEL && kernel_cols <= FILTER2D_MAX_KERNEL );
+    filter2D_f16_arguments arguments = { kernel_rows, kernel_cols, kernel_step, kernel_, border_type, border_value, NULL };
+
+    // Route once so that the FFT kernel spectrum is not recomputed per strip
+    {
+        float col_factor[FILTER2D_MAX_RANK][FILTER2D_MAX_KERNEL];
+        float row_factor[FILTER2D_MAX_RANK][FILTER2D_MAX_KERNEL];
+        if ( !filter2D_separable_rank(kernel_rows, kernel_cols, kernel_step, kernel_, col_factor, row_factor) && filter2D_use_fft(kernel_rows, kernel_cols) )
+            arguments.plan = pencil_filter2D_fft_plan_create( kernel_rows, kernel_cols, kernel_step, kernel_ );
+    }
+
+    // The FFT convolution works on n x n tiles, give it several per strip
+    const int anchor_row = kernel_rows / 2;
+    half_strips( rows, cols, step, src, conv, anchor_row, kernel_rows - 1 - anchor_row, border_type, border_value
+               , arguments.plan ? 4 * arguments.plan->n : 0, filter2D_f16_strip, &arguments );
+
+    if ( arguments.plan )
+        pencil_filter2D_fft_plan_destroy( arguments.plan );
+}
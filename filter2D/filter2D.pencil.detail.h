@@ -0,0 +1,229 @@
+//Implementation file. Included multiple times with different FILTER2D_SIZE defines
+
+// filter2D specialised for a FILTER2D_SIZE x FILTER2D_SIZE kernel. The taps are
+// copied to a local array with constant bounds so the tap loops unroll fully and
+// the coefficients stay in registers; the column loop is the vectorised one.
+//
+// The interior slides a window of FILTER2D_SIZE + 1 source rows down the image
+// two output rows at a time, so every source element loaded serves both rows.
+// Each row is summed in the same order as the single row loop, which takes the
+// last row of an odd interior. Past FILTER2D_WINDOW_MAX_SIZE the unrolled taps
+// of a row pair are more than the host compiler will still vectorise, so those
+// kernels go one row at a time and rely on their rows staying in cache.
+
+#ifndef FILTER2D_WINDOW_MAX_SIZE
+#define FILTER2D_WINDOW_MAX_SIZE 5
+#endif
+
+static void FILTER2D_NAME(filter2D_, FILTER2D_SIZE)( const int rows
+                                                   , const int cols
+                                                   , const int step
+                                                   , const float src[static const restrict rows][step]
+                                                   , const int kernel_step
+                                                   , const float kernel_[static const restrict FILTER2D_SIZE][kernel_step]
+                                                   , const int border_type
+                                                   , const float border_value
+                                                   , float conv[static const restrict rows][step]
+                                                   )
+{
+#pragma scop
+    __pencil_assume(   1 <= rows);
+    __pencil_assume(   1 <= cols);
+    __pencil_assume(cols <= step);
+    __pencil_assume(FILTER2D_SIZE <= kernel_step);
+
+    __pencil_kill(conv);
+    {
+        const int anchor = FILTER2D_SIZE / 2;
+        const int top    = imin(anchor, rows);
+        const int bottom = imax(rows - anchor, top);
+        const int left   = imin(anchor, cols);
+        const int right  = imax(cols - anchor, left);
+        float k[FILTER2D_SIZE][FILTER2D_SIZE];
+        for ( int e = 0; e < FILTER2D_SIZE; e++ )
+            for ( int r = 0; r < FILTER2D_SIZE; r++ )
+                k[e][r] = kernel_[e][r];
+
+#if FILTER2D_SIZE <= FILTER2D_WINDOW_MAX_SIZE
+        const int paired = top + (bottom - top) / 2 * 2;
+
+        #pragma pencil independent
+        for ( int q = top; q < paired; q += 2 )
+        {
+            #pragma pencil independent
+            for ( int w = left; w < right; w++ )
+            {
+                float prod_0 = 0.;
+                float prod_1 = 0.;
+                for ( int e = 0; e < FILTER2D_SIZE; e++ )
+                    for ( int r = 0; r < FILTER2D_SIZE; r++ )
+                    {
+                        prod_0 += src[q + e     - anchor][w + r - anchor] * k[e][r];
+                        prod_1 += src[q + e + 1 - anchor][w + r - anchor] * k[e][r];
+                    }
+                conv[q    ][w] = prod_0;
+                conv[q + 1][w] = prod_1;
+            }
+        }
+#else
+        const int paired = top;
+#endif
+
+        #pragma pencil independent
+        for ( int q = paired; q < bottom; q++ )
+        {
+            #pragma pencil independent
+            for ( int w = left; w < right; w++ )
+            {
+                float prod = 0.;
+                for ( int e = 0; e < FILTER2D_SIZE; e++ )
+                    for ( int r = 0; r < FILTER2D_SIZE; r++ )
+                        prod += src[q + e - anchor][w + r - anchor] * k[e][r];
+                conv[q][w] = prod;
+            }
+        }
+
+        // Rows above and below the interior: the row index is extrapolated once
+        // per kernel row, taps on rows outside a constant border weigh nothing
+        // and their border value goes into fill
+        #pragma pencil independent
+        for ( int i = 0; i < top + rows - bottom; i++ )
+        {
+            const int q = i < top ? i : bottom + i - top;
+            int   row[FILTER2D_SIZE];
+            float kq[FILTER2D_SIZE][FILTER2D_SIZE];
+            float fill = 0.;
+            for ( int e = 0; e < FILTER2D_SIZE; e++ )
+            {
+                const int outside = border_outside(q + e - anchor, rows, border_type);
+                row[e] = border_index(q + e - anchor, rows, border_type);
+                for ( int r = 0; r < FILTER2D_SIZE; r++ )
+                {
+                    kq[e][r] = outside ? 0.f : k[e][r];
+                    fill    += outside ? border_value * k[e][r] : 0.f;
+                }
+            }
+            #pragma pencil independent
+            for ( int w = left; w < right; w++ )
+            {
+                float prod = fill;
+                for ( int e = 0; e < FILTER2D_SIZE; e++ )
+                    for ( int r = 0; r < FILTER2D_SIZE; r++ )
+                        prod += src[row[e]][w + r - anchor] * kq[e][r];
+                conv[q][w] = prod;
+            }
+        }
+
+        // Left and right edge columns of every row
+        #pragma pencil independent
+        for ( int q = 0; q < rows; q++ )
+        {
+            #pragma pencil independent
+            for ( int i = 0; i < left + cols - right; i++ )
+            {
+                const int w = i < left ? i : right + i - left;
+                float prod = 0.;
+                for ( int e = 0; e < FILTER2D_SIZE; e++ )
+                    for ( int r = 0; r < FILTER2D_SIZE; r++ )
+                        prod += border_fetch(src, q + e - anchor, w + r - anchor, rows, cols, border_type, border_value) * k[e][r];
+                conv[q][w] = prod;
+            }
+        }
+    }
+    __pencil_kill(src);
+    __pencil_kill(kernel_);
+#pragma endscop
+}
+
+// 8-bit version: kernel_ holds fixed point taps scaled by 2^shift, sums are
+// 32-bit and rounded to nearest before saturating to 8 bits.
+
+static void FILTER2D_NAME(filter2D_u8_, FILTER2D_SIZE)( const int rows
+                                                      , const int cols
+                                                      , const int step
+                                                      , const uint8_t src[static const restrict rows][step]
+                                                      , const int16_t kernel_[static const restrict FILTER2D_SIZE][FILTER2D_SIZE]
+                                                      , const int shift
+                                                      , const int border_type
+                                                      , const int border_value
+                                                      , uint8_t conv[static const restrict rows][step]
+                                                      )
+{
+#pragma scop
+    __pencil_assume(   1 <= rows);
+    __pencil_assume(   1 <= cols);
+    __pencil_assume(cols <= step);
+    __pencil_assume(   1 <= shift);
+
+    __pencil_kill(conv);
+    {
+        const int anchor = FILTER2D_SIZE / 2;
+        const int top    = imin(anchor, rows);
+        const int bottom = imax(rows - anchor, top);
+        const int left   = imin(anchor, cols);
+        const int right  = imax(cols - anchor, left);
+        const int round  = 1 << (shift - 1);
+        int16_t k[FILTER2D_SIZE][FILTER2D_SIZE];
+        for ( int e = 0; e < FILTER2D_SIZE; e++ )
+            for ( int r = 0; r < FILTER2D_SIZE; r++ )
+                k[e][r] = kernel_[e][r];
+
+#if FILTER2D_SIZE <= FILTER2D_WINDOW_MAX_SIZE
+        const int paired = top + (bottom - top) / 2 * 2;
+
+        #pragma pencil independent
+        for ( int q = top; q < paired; q += 2 )
+        {
+            #pragma pencil independent
+            for ( int w = left; w < right; w++ )
+            {
+                int prod_0 = round;
+                int prod_1 = round;
+                for ( int e = 0; e < FILTER2D_SIZE; e++ )
+                    for ( int r = 0; r < FILTER2D_SIZE; r++ )
+                    {
+                        prod_0 += src[q + e     - anchor][w + r - anchor] * k[e][r];
+                        prod_1 += src[q + e + 1 - anchor][w + r - anchor] * k[e][r];
+                    }
+                conv[q    ][w] = iclampi(prod_0 >> shift, 0, 255);
+                conv[q + 1][w] = iclampi(prod_1 >> shift, 0, 255);
+            }
+        }
+#else
+        const int paired = top;
+#endif
+
+        #pragma pencil independent
+        for ( int q = paired; q < bottom; q++ )
+        {
+            #pragma pencil independent
+            for ( int w = left; w < right; w++ )
+            {
+                int prod = round;
+                for ( int e = 0; e < FILTER2D_SIZE; e++ )
+                    for ( int r = 0; r < FILTER2D_SIZE; r++ )
+                        prod += src[q + e - anchor][w + r - anchor] * k[e][r];
+                conv[q][w] = iclampi(prod >> shift, 0, 255);
+            }
+        }
+
+        #pragma pencil independent
+        for ( int q = 0; q < rows; q++ )
+        {
+            const int halo_row = q < top || q >= bottom;
+            #pragma pencil independent
+            for ( int i = 0; i < (halo_row ? cols : left + cols - right); i++ )
+            {
+                const int w = (halo_row || i < left) ? i : right + i - left;
+                int prod = round;
+                for ( int e = 0; e < FILTER2D_SIZE; e++ )
+                    for ( int r = 0; r < FILTER2D_SIZE; r++ )
+                        prod += border_fetch(src, q + e - anchor, w + r - anchor, rows, cols, border_type, border_value) * k[e][r];
+                conv[q][w] = iclampi(prod >> shift, 0, 255);
+            }
+        }
+    }
+    __pencil_kill(src);
+    __pencil_kill(kernel_);
+#pragma endscop
+}
@@ -1,3 +1,23 @@
+#include <stdint.h>
+#include "border.pencil.h"
+
+/* Largest kernel edge accepted by pencil_filter2D, larger ones fail an
+ * assertion. */
+#define FILTER2D_MAX_KERNEL 64
+
+/* Cost of an FFT butterfly relative to a direct tap: pencil_filter2D uses the
+ * FFT convolution once the butterflies per pixel times this are fewer than the
+ * kernel taps. Measured with time_filter2D_fft_crossover (test_filter2D). */
+#ifndef FILTER2D_FFT_COST
+#define FILTER2D_FFT_COST 7.0f
+#endif
+
+/* Largest kernel pencil_filter2D_u8 convolves in fixed point, see
+ * time_filter2D_u8 (test_filter2D). */
+#ifndef FILTER2D_U8_MAX_TAPS
+#define FILTER2D_U8_MAX_TAPS 49
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -5,6 +25,61 @@ extern "C" {
                         , const int kernel_rows, const int kernel_cols, const int kernel_step, const float kernel[]
                         , float conv[]
                         );
+
+    // border_type is one of PENCIL_BORDER_*, border_value is used by PENCIL_BORDER_CONSTANT
+    void pencil_filter2D_border( const int        rows, const int        cols, const int        step, const float src[]
+                               , const int kernel_rows, const int kernel_cols, const int kernel_step, const float kernel[]
+                               , const int border_type, const float border_value
+                               , float conv[]
+                               );
+
+    // Interleaved image of channels floats per pixel, step counting floats:
+    // every channel is convolved as by pencil_filter2D_border, sharing the
+    // separable or direct passes. Kernels for the FFT convolution go through
+    // it one channel at a time.
+    void pencil_filter2D_cn( const int        rows, const int        cols, const int    channels, const int step, const float src[]
+                           , const int kernel_rows, const int kernel_cols, const int kernel_step, const float kernel[]
+                           , const int border_type, const float border_value
+                           , float conv[]
+                           );
+
+    // 8-bit in, 8-bit out in fixed point: 16-bit taps, 32-bit sums, rounded to
+    // nearest and saturated. Kernels of more than FILTER2D_U8_MAX_TAPS taps
+    // are computed in float by pencil_filter2D_border and rounded instead.
+    void pencil_filter2D_u8( const int        rows, const int        cols, const int        step, const uint8_t src[]
+                           , const int kernel_rows, const int kernel_cols, const int kernel_step, const float   kernel[]
+                           , const int border_type, const uint8_t border_value
+                           , uint8_t conv[]
+                           );
+
+    // Half precision storage: src and conv hold IEEE half bit patterns, the
+    // arithmetic is in float as in pencil_filter2D_border.
+    void pencil_filter2D_f16( const int        rows, const int        cols, const int        step, const uint16_t src[]
+                            , const int kernel_rows, const int kernel_cols, const int kernel_step, const float    kernel[]
+                            , const int border_type, const float border_value
+                            , uint16_t conv[]
+                            );
+
+    // Direct 2D convolution, bypassing the separable and FFT routing
+    void pencil_filter2D_direct( const int        rows, const int        cols, const int        step, const float src[]
+                               , const int kernel_rows, const int kernel_cols, const int kernel_step, const float kernel[]
+                               , const int border_type, const float border_value
+                               , float conv[]
+                               );
+
+    // FFT convolution. A plan holds the kernel spectrum and the tile buffers, so
+    // applying one kernel to many images transforms the kernel only once.
+    // A plan must not be used by two calls at the same time.
+    typedef struct pencil_filter2D_fft_plan pencil_filter2D_fft_plan;
+
+    pencil_filter2D_fft_plan * pencil_filter2D_fft_plan_create( const int kernel_rows, const int kernel_cols, const int kernel_step, const float kernel[] );
+    void pencil_filter2D_fft_plan_destroy( pencil_filter2D_fft_plan * plan );
+
+    void pencil_filter2D_fft( pencil_filter2D_fft_plan * plan
+                            , const int rows, const int cols, const int step, const float src[]
+                            , const int border_type, const float border_value
+                            , float conv[]
+                            );
 #ifdef __cplusplus
 } // extern "C"
 #endif
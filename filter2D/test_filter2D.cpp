@@ -7,6 +7,7 @@
 
 #include <prl.h>
 #include <chrono>
+#include <map>
 
 void time_filter2D( const std::vector<carp::record_t>& pool, int iteration )
 {
@@ -96,6 +97,403 @@ void time_filter2D( const std::vector<carp::record_t>& pool, int iteration )
     }
 }
 
+void time_filter2D_borders( const std::vector<carp::record_t>& pool, const std::vector<int>& sizes )
+{
+    std::map<int, cv::Mat> kernels;
+    for ( auto & size : sizes ) {
+        kernels[size].create( size, size, CV_32F );
+        cv::randu( kernels[size], -1.f, 1.f );
+    }
+
+    carp::time_borders( pool, "2D filter", "ksize", sizes, CV_32F, 0.001
+                      , [&]( const cv::Mat & src, int size, int border ) -> cv::Mat {
+                            cv::Mat result;
+                            if ( border == cv::BORDER_WRAP )
+                                return carp::wrap_filter( src, size, [&]( const cv::Mat & padded, cv::Mat & dst ) { cv::filter2D( padded, dst, -1, kernels[size], cv::Point(-1,-1), 0.0, cv::BORDER_REPLICATE ); } );
+                            cv::filter2D( src, result, -1, kernels[size], cv::Point(-1,-1), 0.0, border );
+                            return result;
+                        }
+                      , [&]( const cv::Mat & src, int size, int border ) -> cv::Mat {
+                            cv::Mat result( src.size(), CV_32F );
+                            pencil_filter2D_border( src.rows, src.cols, src.step1(), src.ptr<float>()
+                                                  , size, size, kernels[size].step1(), kernels[size].ptr<float>()
+                                                  , border, 0.f
+                                                  , result.ptr<float>()
+                                                  );
+                            return result;
+                        }
+                      );
+}
+
+void time_filter2D_sizes( const std::vector<carp::record_t>& pool, const std::vector<int>& sizes )
+{
+    std::cout << "Measuring 2D filter throughput per kernel size" << std::endl;
+    std::cout << " ksize  OpenCV (Mpix/s)  PENCIL (Mpix/s)  max error" << std::endl;
+
+    for ( auto & size : sizes ) {
+        cv::Mat kernel( size, size, CV_32F );
+        cv::randu( kernel, -1.f, 1.f );
+
+        std::chrono::duration<double> elapsed_time_cpu(0), elapsed_time_pen(0);
+        double pixels = 0, max_error = 0;
+
+        for ( auto & item : pool ) {
+            cv::Mat cpu_gray;
+            cv::cvtColor( item.cpuimg(), cpu_gray, CV_RGB2GRAY );
+            cpu_gray.convertTo( cpu_gray, CV_32F, 1.0/255. );
+
+            cv::Mat cpu_result, pen_result( cpu_gray.size(), CV_32F );
+            {
+                const auto cpu_start = std::chrono::high_resolution_clock::now();
+                cv::filter2D( cpu_gray, cpu_result, -1, kernel, cv::Point(-1,-1), 0.0, cv::BORDER_REPLICATE );
+                const auto cpu_end = std::chrono::high_resolution_clock::now();
+                elapsed_time_cpu += cpu_end - cpu_start;
+            }
+            {
+                const auto pen_start = std::chrono::high_resolution_clock::now();
+                pencil_filter2D( cpu_gray.rows, cpu_gray.cols, cpu_gray.step1(), cpu_gray.ptr<float>()
+                               , kernel.rows, kernel.cols, kernel.step1(), kernel.ptr<float>()
+                               , pen_result.ptr<float>()
+                               );
+                const auto pen_end = std::chrono::high_resolution_clock::now();
+                elapsed_time_pen += pen_end - pen_start;
+            }
+            pixels += cpu_gray.total();
+            max_error = std::max( max_error, cv::norm(cpu_result, pen_result, cv::NORM_INF) );
+        }
+        std::cout << std::fixed << std::setprecision(1);
+        std::cout << std::setw(6) << size << " "
+                  << std::setw(16) << pixels / elapsed_time_cpu.count() * 1e-6 << " "
+                  << std::setw(16) << pixels / elapsed_time_pen.count() * 1e-6 << " "
+                  << std::setprecision(6) << std::setw(10) << max_error << std::endl;
+
+        if ( max_error > 0.001 )
+            throw std::runtime_error("The PENCIL results are not equivalent with the C++ results.");
+    }
+}
+
+void time_filter2D_separable( const std::vector<carp::record_t>& pool )
+{
+    std::cout << "Measuring 2D filter on low rank kernels" << std::endl;
+    std::cout << "      kernel  OpenCV (ms)  PENCIL (ms)  error norm" << std::endl;
+
+    std::vector<std::pair<const char*, cv::Mat>> kernels;
+    {
+        cv::Mat kx, ky, random(7, 7, CV_32F);
+        cv::getDerivKernels( kx, ky, 1, 0, 5, false, CV_32F );
+        kernels.emplace_back( "sobel 5x5"   , ky * kx.t() );
+        kernels.emplace_back( "box 7x7"     , cv::Mat::ones(7, 7, CV_32F) / 49.f );
+        cv::Mat g = cv::getGaussianKernel( 7, 1.5, CV_32F );
+        kernels.emplace_back( "gauss 7x7"   , g * g.t() );
+        cv::Mat h1 = cv::getGaussianKernel( 8, 1.0, CV_32F );
+        cv::Mat h2 = cv::getGaussianKernel( 8, 2.5, CV_32F );
+        kernels.emplace_back( "DoG 8x8"     , h2 * h2.t() - h1 * h1.t() );
+        cv::randu( random, -1.f, 1.f );
+        kernels.emplace_back( "random 7x7"  , random );
+    }
+
+    for ( auto & kernel : kernels ) {
+        std::chrono::duration<double,std::milli> elapsed_time_cpu(0), elapsed_time_pen(0);
+        double max_error = 0;
+
+        for ( auto & item : pool ) {
+            cv::Mat cpu_gray;
+            cv::cvtColor( item.cpuimg(), cpu_gray, CV_RGB2GRAY );
+            cpu_gray.convertTo( cpu_gray, CV_32F, 1.0/255. );
+
+            cv::Mat cpu_result, pen_result( cpu_gray.size(), CV_32F );
+            {
+                const auto cpu_start = std::chrono::high_resolution_clock::now();
+                cv::filter2D( cpu_gray, cpu_result, -1, kernel.second, cv::Point(-1,-1), 0.0, cv::BORDER_REPLICATE );
+                const auto cpu_end = std::chrono::high_resolution_clock::now();
+                elapsed_time_cpu += cpu_end - cpu_start;
+            }
+            {
+                const auto pen_start = std::chrono::high_resolution_clock::now();
+                pencil_filter2D( cpu_gray.rows, cpu_gray.cols, cpu_gray.step1(), cpu_gray.ptr<float>()
+                               , kernel.second.rows, kernel.second.cols, kernel.second.step1(), kernel.second.ptr<float>()
+                               , pen_result.ptr<float>()
+                               );
+                const auto pen_end = std::chrono::high_resolution_clock::now();
+                elapsed_time_pen += pen_end - pen_start;
+            }
+            max_error = std::max( max_error, cv::norm(pen_result - cpu_result) );
+        }
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << std::setw(12) << kernel.first << " "
+                  << std::setw(12) << elapsed_time_cpu.count() << " " << std::setw(12) << elapsed_time_pen.count() << " "
+                  << std::setw(11) << max_error << std::endl;
+
+        if ( max_error > 0.01 )
+            throw std::runtime_error("The PENCIL results are not equivalent with the C++ results.");
+    }
+}
+
+void time_filter2D_fft_crossover( const std::vector<carp::record_t>& pool, const std::vector<int>& sizes )
+{
+    std::cout << "Measuring the direct / FFT crossover of 2D filter" << std::endl;
+    std::cout << " ksize  OpenCV (ms)  direct (ms)     FFT (ms)  FFT max error" << std::endl;
+
+    int crossover = -1;
+
+    for ( auto & size : sizes ) {
+        cv::Mat kernel( size, size, CV_32F );
+        cv::randu( kernel, -1.f, 1.f );
+        kernel /= size;
+
+        // One plan per kernel: the kernel spectrum is reused for every image
+        pencil_filter2D_fft_plan * plan = pencil_filter2D_fft_plan_create( kernel.rows, kernel.cols, kernel.step1(), kernel.ptr<float>() );
+        if (!plan)
+            throw std::runtime_error("Could not create the FFT convolution plan.");
+
+        std::chrono::duration<double,std::milli> elapsed_time_cpu(0), elapsed_time_direct(0), elapsed_time_fft(0);
+        double max_error = 0;
+
+        for ( auto & item : pool ) {
+            cv::Mat cpu_gray;
+            cv::cvtColor( item.cpuimg(), cpu_gray, CV_RGB2GRAY );
+            cpu_gray.convertTo( cpu_gray, CV_32F, 1.0/255. );
+
+            cv::Mat cpu_result, direct_result( cpu_gray.size(), CV_32F ), fft_result( cpu_gray.size(), CV_32F );
+            {
+                const auto cpu_start = std::chrono::high_resolution_clock::now();
+                cv::filter2D( cpu_gray, cpu_result, -1, kernel, cv::Point(-1,-1), 0.0, cv::BORDER_REPLICATE );
+                const auto cpu_end = std::chrono::high_resolution_clock::now();
+                elapsed_time_cpu += cpu_end - cpu_start;
+            }
+            {
+                const auto direct_start = std::chrono::high_resolution_clock::now();
+                pencil_filter2D_direct( cpu_gray.rows, cpu_gray.cols, cpu_gray.step1(), cpu_gray.ptr<float>()
+                                      , kernel.rows, kernel.cols, kernel.step1(), kernel.ptr<float>()
+                                      , PENCIL_BORDER_REPLICATE, 0.f
+                                      , direct_result.ptr<float>()
+                                      );
+                const auto direct_end = std::chrono::high_resolution_clock::now();
+                elapsed_time_direct += direct_end - direct_start;
+            }
+            {
+                const auto fft_start = std::chrono::high_resolution_clock::now();
+                pencil_filter2D_fft( plan, cpu_gray.rows, cpu_gray.cols, cpu_gray.step1(), cpu_gray.ptr<float>()
+                                   , PENCIL_BORDER_REPLICATE, 0.f
+                                   , fft_result.ptr<float>()
+                                   );
+                const auto fft_end = std::chrono::high_resolution_clock::now();
+                elapsed_time_fft += fft_end - fft_start;
+            }
+            max_error = std::max( max_error, cv::norm(cpu_result, fft_result, cv::NORM_INF) );
+            max_error = std::max( max_error, cv::norm(cpu_result, direct_result, cv::NORM_INF) );
+        }
+        pencil_filter2D_fft_plan_destroy( plan );
+
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << std::setw(6) << size << " "
+                  << std::setw(12) << elapsed_time_cpu.count() << " " << std::setw(12) << elapsed_time_direct.count() << " "
+                  << std::setw(12) << elapsed_time_fft.count() << " " << std::setw(14) << max_error << std::endl;
+
+        if ( (crossover < 0) && (elapsed_time_fft < elapsed_time_direct) )
+            crossover = size;
+
+        if ( max_error > 0.001 )
+            throw std::runtime_error("The PENCIL results are not equivalent with the C++ results.");
+    }
+    std::cout << "Measured FFT crossover kernel size: " << crossover
+              << " (FILTER2D_FFT_COST = " << FILTER2D_FFT_COST << ")" << std::endl;
+}
+
+void time_filter2D_u8( const std::vector<carp::record_t>& pool, const std::vector<int>& sizes )
+{
+    std::cout << "Measuring 8-bit fixed point 2D filter against the float path" << std::endl;
+    std::cout << " ksize  float (ms)  u8 (ms)  float (Mpix/s)  u8 (Mpix/s)  float (GB/s)  u8 (GB/s)  LSB vs float  LSB vs OpenCV" << std::endl;
+
+    for ( auto & size : sizes ) {
+        // A random sharpening kernel: signed taps, unit gain
+        cv::Mat kernel( size, size, CV_32F );
+        cv::randu( kernel, -1.f, 1.f );
+        kernel /= size * size;
+        kernel.at<float>(size / 2, size / 2) += 1.f - cv::sum(kernel)[0];
+
+        std::chrono::duration<double> elapsed_time_float(0), elapsed_time_u8(0);
+        double pixels = 0, error_float = 0, error_cpu = 0;
+
+        for ( auto & item : pool ) {
+            cv::Mat cpu_gray;
+            cv::cvtColor( item.cpuimg(), cpu_gray, CV_RGB2GRAY );
+
+            cv::Mat cpu_result, float_result, u8_result( cpu_gray.size(), CV_8U );
+            cv::filter2D( cpu_gray, cpu_result, -1, kernel, cv::Point(-1,-1), 0.0, cv::BORDER_REPLICATE );
+            {
+                // The float path as time_filter2D uses it: convert, filter, convert back
+                const auto float_start = std::chrono::high_resolution_clock::now();
+                cv::Mat gray_float, conv_float( cpu_gray.size(), CV_32F );
+                cpu_gray.convertTo( gray_float, CV_32F, 1.0/255. );
+                pencil_filter2D_border( gray_float.rows, gray_float.cols, gray_float.step1(), gray_float.ptr<float>()
+                                      , kernel.rows, kernel.cols, kernel.step1(), kernel.ptr<float>()
+                                      , PENCIL_BORDER_REPLICATE, 0.f
+                                      , conv_float.ptr<float>()
+                                      );
+                conv_float.convertTo( float_result, CV_8U, 255. );
+                const auto float_end = std::chrono::high_resolution_clock::now();
+                elapsed_time_float += float_end - float_start;
+            }
+            {
+                const auto u8_start = std::chrono::high_resolution_clock::now();
+                pencil_filter2D_u8( cpu_gray.rows, cpu_gray.cols, cpu_gray.step1(), cpu_gray.ptr<uint8_t>()
+                                  , kernel.rows, kernel.cols, kernel.step1(), kernel.ptr<float>()
+                                  , PENCIL_BORDER_REPLICATE, 0
+                                  , u8_result.ptr<uint8_t>()
+                                  );
+                const auto u8_end = std::chrono::high_resolution_clock::now();
+                elapsed_time_u8 += u8_end - u8_start;
+            }
+            pixels += cpu_gray.total();
+            error_float = std::max( error_float, cv::norm(float_result, u8_result, cv::NORM_INF) );
+            error_cpu   = std::max( error_cpu  , cv::norm(cpu_result  , u8_result, cv::NORM_INF) );
+        }
+        // Bytes moved per pixel: one read and one write, 4 bytes each in float, 1 in u8.
+        // The u8 kernels keep their 32-bit sums for a strip of rows only, in cache
+        std::cout << std::fixed << std::setprecision(2);
+        std::cout << std::setw(6) << size << " "
+                  << std::setw(11) << elapsed_time_float.count() * 1e3 << " " << std::setw(8) << elapsed_time_u8.count() * 1e3 << " "
+                  << std::setw(15) << pixels / elapsed_time_float.count() * 1e-6 << " " << std::setw(12) << pixels / elapsed_time_u8.count() * 1e-6 << " "
+                  << std::setw(12) << 8 * pixels / elapsed_time_float.count() * 1e-9 << " " << std::setw(10) << 2 * pixels / elapsed_time_u8.count() * 1e-9 << " "
+                  << std::setprecision(0) << std::setw(13) << error_float << " " << std::setw(14) << error_cpu << std::endl;
+
+        if ( error_float > 1 || error_cpu > 1 )
+            throw std::runtime_error("The 8-bit PENCIL results are not within 1 LSB of the float results.");
+    }
+}
+
+void time_filter2D_f16( const std::vector<carp::record_t>& pool, const std::vector<int>& sizes )
+{
+    std::cout << "Measuring half precision storage of 2D filter against float" << std::endl;
+    std::cout << " ksize  float (ms)  half (ms)  float (Mpix/s)  half (Mpix/s)  float (GB/s)  half (GB/s)  max error" << std::endl;
+
+    for ( auto & size : sizes ) {
+        cv::Mat kernel( size, size, CV_32F );
+        cv::randu( kernel, -1.f, 1.f );
+        kernel /= size;
+
+        std::chrono::duration<double> elapsed_time_float(0), elapsed_time_half(0);
+        double pixels = 0, max_error = 0;
+
+        for ( auto & item : pool ) {
+            cv::Mat cpu_gray;
+            cv::cvtColor( item.cpuimg(), cpu_gray, CV_RGB2GRAY );
+            cpu_gray.convertTo( cpu_gray, CV_32F, 1.0/255. );
+
+            const carp::half_mat half_gray( cpu_gray );
+            cv::Mat float_result( cpu_gray.size(), CV_32F );
+            carp::half_mat half_result( cpu_gray.rows, cpu_gray.cols );
+            {
+                const auto float_start = std::chrono::high_resolution_clock::now();
+                pencil_filter2D_border( cpu_gray.rows, cpu_gray.cols, cpu_gray.step1(), cpu_gray.ptr<float>()
+                                      , kernel.rows, kernel.cols, kernel.step1(), kernel.ptr<float>()
+                                      , PENCIL_BORDER_REPLICATE, 0.f
+                                      , float_result.ptr<float>()
+                                      );
+                const auto float_end = std::chrono::high_resolution_clock::now();
+                elapsed_time_float += float_end - float_start;
+            }
+            {
+                const auto half_start = std::chrono::high_resolution_clock::now();
+                pencil_filter2D_f16( half_gray.rows(), half_gray.cols(), half_gray.step1(), half_gray.ptr()
+                                   , kernel.rows, kernel.cols, kernel.step1(), kernel.ptr<float>()
+                                   , PENCIL_BORDER_REPLICATE, 0.f
+                                   , half_result.ptr()
+                                   );
+                const auto half_end = std::chrono::high_resolution_clock::now();
+                elapsed_time_half += half_end - half_start;
+            }
+            pixels += cpu_gray.total();
+            max_error = std::max( max_error, cv::norm(float_result, half_result.to_mat(), cv::NORM_INF) );
+        }
+        // Bytes moved per pixel: one read and one write, 4 bytes each in float, 2 in half
+        std::cout << std::fixed << std::setprecision(2);
+        std::cout << std::setw(6) << size << " "
+                  << std::setw(11) << elapsed_time_float.count() * 1e3 << " " << std::setw(10) << elapsed_time_half.count() * 1e3 << " "
+                  << std::setw(15) << pixels / elapsed_time_float.count() * 1e-6 << " " << std::setw(14) << pixels / elapsed_time_half.count() * 1e-6 << " "
+                  << std::setw(12) << 8 * pixels / elapsed_time_float.count() * 1e-9 << " " << std::setw(11) << 4 * pixels / elapsed_time_half.count() * 1e-9 << " "
+                  << std::setprecision(6) << std::setw(10) << max_error << std::endl;
+
+        // Half precision rounding of the source and of the result, 2^-11 each
+        if ( max_error > 0.002 )
+            throw std::runtime_error("The half precision PENCIL results are not equivalent with the float results.");
+    }
+}
+
+// The colour image at once against cv::split, a pencil_filter2D_border per
+// plane and cv::merge
+void time_filter2D_cn( const std::vector<carp::record_t>& pool )
+{
+    std::cout << "Measuring 2D filter of interleaved channels against split planes" << std::endl;
+    std::cout << "        kernel  channels  interleaved (ms)  split (ms)  max error" << std::endl;
+
+    std::vector<std::pair<const char*, cv::Mat>> kernels;
+    {
+        cv::Mat random(9, 9, CV_32F);
+        cv::randu( random, -1.f, 1.f );
+        kernels.emplace_back( "random 9x9"    , random / 81.f );
+        cv::Mat g = cv::getGaussianKernel( 17, 3.0, CV_32F );
+        kernels.emplace_back( "gauss 17x17"   , g * g.t() );
+        cv::Mat big(45, 45, CV_32F);
+        cv::randu( big, -1.f, 1.f );
+        kernels.emplace_back( "random 45x45"  , big / 2025.f );
+    }
+
+    for ( auto & kernel : kernels ) {
+        for ( int channels : { 3, 4 } ) {
+            std::chrono::duration<double,std::milli> elapsed_time_cn(0), elapsed_time_split(0);
+            double max_error = 0;
+
+            for ( auto & item : pool ) {
+                cv::Mat cpu_color;
+                if ( channels == 4 )
+                    cv::cvtColor( item.cpuimg(), cpu_color, CV_RGB2RGBA );
+                else
+                    cpu_color = item.cpuimg();
+                cpu_color.convertTo( cpu_color, CV_32FC(channels), 1.0/255. );
+
+                cv::Mat cn_result( cpu_color.size(), CV_32FC(channels) ), split_result;
+                {
+                    const auto cn_start = std::chrono::high_resolution_clock::now();
+                    pencil_filter2D_cn( cpu_color.rows, cpu_color.cols, channels, cpu_color.step1(), cpu_color.ptr<float>()
+                                      , kernel.second.rows, kernel.second.cols, kernel.second.step1(), kernel.second.ptr<float>()
+                                      , cv::BORDER_REPLICATE, 0.f
+                                      , cn_result.ptr<float>()
+                                      );
+                    const auto cn_end = std::chrono::high_resolution_clock::now();
+                    elapsed_time_cn += cn_end - cn_start;
+                }
+                {
+                    const auto split_start = std::chrono::high_resolution_clock::now();
+                    std::vector<cv::Mat> planes;
+                    cv::split( cpu_color, planes );
+                    for ( auto & plane : planes ) {
+                        cv::Mat filtered( plane.size(), CV_32F );
+                        pencil_filter2D_border( plane.rows, plane.cols, plane.step1(), plane.ptr<float>()
+                                              , kernel.second.rows, kernel.second.cols, kernel.second.step1(), kernel.second.ptr<float>()
+                                              , cv::BORDER_REPLICATE, 0.f
+                                              , filtered.ptr<float>()
+                                              );
+                        plane = filtered;
+                    }
+                    cv::merge( planes, split_result );
+                    const auto split_end = std::chrono::high_resolution_clock::now();
+                    elapsed_time_split += split_end - split_start;
+                }
+                max_error = std::max( max_error, cv::norm(cn_result, split_result, cv::NORM_INF) );
+            }
+            std::cout << std::fixed << std::setprecision(3);
+            std::cout << std::setw(14) << kernel.first << " " << std::setw(9) << channels << " "
+                      << std::setw(17) << elapsed_time_cn.count() << " " << std::setw(11) << elapsed_time_split.count() << " "
+                      << std::setw(10) << max_error << std::endl;
+
+            if ( max_error > 1e-5 )
+                throw std::runtime_error("The interleaved PENCIL results are not equivalent with the per plane results.");
+        }
+    }
+}
+
 int main(int argc, char* argv[])
 {
     prl_init((prl_init_flags)(PRL_TARGET_DEVICE_DYNAMIC | PRL_PROFILING_ENABLED));
@@ -108,6 +506,13 @@ int main(int argc, char* argv[])
     time_filter2D( pool, 1 );
 #else
     time_filter2D( pool, 22 );
+    time_filter2D_sizes( pool, {3, 4, 5, 6, 7, 8} );
+    time_filter2D_borders( pool, {3, 5, 8} );
+    time_filter2D_separable( pool );
+    time_filter2D_fft_crossover( pool, {5, 7, 8, 9, 11, 15, 21, 31, 45, 63} );
+    time_filter2D_u8( pool, {3, 4, 5, 7, 9, 15} );
+    time_filter2D_f16( pool, {3, 5, 7, 9, 15, 31} );
+    time_filter2D_cn( pool );
 #endif
 
     prl_shutdown();
@@ -1,79 +1,534 @@
 #include "gaussian.pencil.h"
 #include <pencil.h>
+#include "border.pencil.h"
+#include "separable.pencil.h"
+#include "half.pencil.h"
 #include <assert.h>
-
-#if !__PENCIL__
+#include <math.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Fraction bits of the 8-bit path's taps. A centre tap of 1 << 14 still fits
+ * in 16 bits, and the column sums of 16-bit rows in 32 bits. */
+#define GAUSSIAN_U8_BITS 14
+
+/* Output rows per strip of the 8-bit path. Only the strip and its vertical
+ * halo are kept after the horizontal pass, not the whole image. */
+#ifndef GAUSSIAN_U8_STRIP
+#define GAUSSIAN_U8_STRIP 32
 #endif
 
-static void gaussian( const int rows
-                    , const int cols
-                    , const int step
-                    , const float src[static const restrict rows][step]
-                    , const int kernelX_length
-                    , const float kernelX[static const restrict kernelX_length]
-                    , const int kernelY_length
-                    , const float kernelY[static const restrict kernelY_length]
-                    , float conv[static const restrict rows][step]
-                    )
+/* Column block width of the vertical recursive passes. */
+#ifndef GAUSSIAN_IIR_BLOCK
+#define GAUSSIAN_IIR_BLOCK 64
+#endif
+
+static void gaussian_row( const int rows
+                        , const int cols
+                        , const int step
+                        , const float src[static const restrict rows][step]
+                        , const int kernel_length
+                        , const float kernel[static const restrict kernel_length]
+                        , const int border_type
+                        , const float border_value
+                        , float dst[static const restrict rows][step]
+                        )
 {
 #pragma scop
-    __pencil_assume(rows         >  0);
-    __pencil_assume(cols         >  0);
-    __pencil_assume(step         >= cols);
-    __pencil_assume(kernelX_length >  0);
-    __pencil_assume(kernelX_length <= 64);
-    __pencil_assume(kernelY_length >  0);
-    __pencil_assume(kernelY_length <= 64);
-    
-    __pencil_kill(conv);
+    __pencil_assume(rows          >  0);
+    __pencil_assume(cols          >  0);
+    __pencil_assume(step          >= cols);
+    __pencil_assume(kernel_length >  0);
+    __pencil_assume(kernel_length <= 64);
+
+    __pencil_kill(dst);
     {
-#if __PENCIL__
-        float temp[rows][step];
-#else
-        float (*temp)[step] = (float (*)[step])malloc(sizeof(float)*rows*step);
-#endif
+        const int half  = kernel_length / 2;
+        const int left  = imin(half, cols);
+        const int right = imax(cols - (kernel_length - 1 - half), left);
+
         #pragma pencil independent
         for ( int q = 0; q < rows; q++ )
         {
             #pragma pencil independent
-            for ( int w = 0; w < cols; w++ )
+            for ( int w = left; w < right; w++ )
+            {
+                float prod = 0.;
+                #pragma pencil independent reduction (+: prod);
+                for ( int r = 0; r < kernel_length; r++ )
+                    prod += src[q][w + r - half] * kernel[r];
+                dst[q][w] = prod;
+            }
+            #pragma pencil independent
+            for ( int i = 0; i < left + cols - right; i++ )
+            {
+                const int w = (i < left) ? i : right + i - left;
+                float prod = 0.;
+                #pragma pencil independent reduction (+: prod);
+                for ( int r = 0; r < kernel_length; r++ )
+                    prod += border_fetch(src, q, w + r - half, rows, cols, border_type, border_value) * kernel[r];
+                dst[q][w] = prod;
+            }
+        }
+    }
+    __pencil_kill(src);
+#pragma endscop
+}
+
+static void gaussian_col( const int rows
+                        , const int cols
+                        , const int step
+                        , const float src[static const restrict rows][step]
+                        , const int kernel_length
+                        , const float kernel[static const restrict kernel_length]
+                        , const int border_type
+                        , const float border_value
+                        , float dst[static const restrict rows][step]
+                        )
+{
+#pragma scop
+    __pencil_assume(rows          >  0);
+    __pencil_assume(cols          >  0);
+    __pencil_assume(step          >= cols);
+    __pencil_assume(kernel_length >  0);
+    __pencil_assume(kernel_length <= 64);
+
+    __pencil_kill(dst);
+    {
+        const int half   = kernel_length / 2;
+        const int top    = imin(half, rows);
+        const int bottom = imax(rows - (kernel_length - 1 - half), top);
+
+        #pragma pencil independent
+        for ( int q = 0; q < rows; q++ )
+        {
+            if ( q >= top && q < bottom )
+            {
+                #pragma pencil independent
+                for ( int w = 0; w < cols; w++ )
+                {
+                    float prod = 0.;
+                    #pragma pencil independent reduction (+: prod);
+                    for ( int e = 0; e < kernel_length; e++ )
+                        prod += src[q + e - half][w] * kernel[e];
+                    dst[q][w] = prod;
+                }
+            }
+            else
+            {
+                // Extrapolate the row index once per tap, not per pixel
+                #pragma pencil independent
+                for ( int w = 0; w < cols; w++ )
+                    dst[q][w] = 0.;
+                for ( int e = 0; e < kernel_length; e++ )
+                {
+                    const int p = q + e - half;
+                    const int row = border_index(p, rows, border_type);
+                    const int outside = border_outside(p, rows, border_type);
+                    #pragma pencil independent
+                    for ( int w = 0; w < cols; w++ )
+                        dst[q][w] += (outside ? border_value : src[row][w]) * kernel[e];
+                }
+            }
+        }
+    }
+    __pencil_kill(src);
+#pragma endscop
+}
+
+/* 8-bit separable passes in fixed point: 16-bit taps summing to
+ * 1 << GAUSSIAN_U8_BITS (see gaussian_u8_kernel) and 32-bit sums, accumulated
+ * tap by tap over whole rows in acc. The row pass leaves the source rows
+ * first_row to first_row + temp_rows - 1, extrapolated with border_type,
+ * rounded to src * 256 in 16 bits. The column pass reads rows rows plus the
+ * kernel_length - 1 of its halo from it and rounds back to 8 bits. */
+static void gaussian_u8_row( const int rows
+                           , const int cols
+                           , const int step
+                           , const uint8_t src[static const restrict rows][step]
+                           , const int first_row
+                           , const int temp_rows
+                           , const int kernel_length
+                           , const int16_t kernel[static const restrict kernel_length]
+                           , const int border_type
+                           , const int border_value
+                           , int acc[static const restrict temp_rows][step]
+                           , uint16_t dst[static const restrict temp_rows][step]
+                           )
+{
+#pragma scop
+    __pencil_assume(rows          >  0);
+    __pencil_assume(cols          >  0);
+    __pencil_assume(step          >= cols);
+    __pencil_assume(temp_rows     >  0);
+    __pencil_assume(kernel_length >  0);
+    __pencil_assume(kernel_length <= 64);
+
+    __pencil_kill(acc);
+    __pencil_kill(dst);
+    {
+        const int half  = kernel_length / 2;
+        const int left  = imin(half, cols);
+        const int right = imax(cols - (kernel_length - 1 - half), left);
+        const int round = 1 << (GAUSSIAN_U8_BITS - 8 - 1);
+
+        #pragma pencil independent
+        for ( int t = 0; t < temp_rows; t++ )
+        {
+            const int p = first_row + t;
+            const int q = border_index(p, rows, border_type);
+            if ( border_outside(p, rows, border_type) )
             {
-                float prod1 = 0.;
-                #pragma pencil independent reduction (+: prod1);
-                for ( int r = 0; r < kernelX_length; r++ )
+                // The taps sum to a power of two: constant rows come out exact
+                #pragma pencil independent
+                for ( int w = 0; w < cols; w++ )
+                    dst[t][w] = border_value << 8;
+            }
+            else
+            {
+                #pragma pencil independent
+                for ( int w = left; w < right; w++ )
+                    acc[t][w] = round + src[q][w - half] * kernel[0];
+                for ( int r = 1; r < kernel_length; r++ )
+                {
+                    #pragma pencil independent
+                    for ( int w = left; w < right; w++ )
+                        acc[t][w] += src[q][w + r - half] * kernel[r];
+                }
+                #pragma pencil independent
+                for ( int i = 0; i < left + cols - right; i++ )
                 {
-                    int row1 = q;
-                    int col1 = iclampi(w + r - kernelX_length / 2, 0, cols-1);
-                    prod1 += src[row1][col1] * kernelX[r];
+                    const int w = (i < left) ? i : right + i - left;
+                    int prod = round;
+                    for ( int r = 0; r < kernel_length; r++ )
+                        prod += border_fetch(src, q, w + r - half, rows, cols, border_type, border_value) * kernel[r];
+                    acc[t][w] = prod;
                 }
-                temp[q][w] = prod1;
+                #pragma pencil independent
+                for ( int w = 0; w < cols; w++ )
+                    dst[t][w] = acc[t][w] >> (GAUSSIAN_U8_BITS - 8);
             }
         }
+    }
+    __pencil_kill(acc);
+    __pencil_kill(src);
+#pragma endscop
+}
+
+static void gaussian_u8_col( const int rows
+                           , const int cols
+                           , const int step
+                           , const int kernel_length
+                           , const uint16_t src[static const restrict rows + kernel_length - 1][step]
+                           , const int16_t kernel[static const restrict kernel_length]
+                           , int acc[static const restrict rows][step]
+                           , uint8_t dst[static const restrict rows][step]
+                           )
+{
+#pragma scop
+    __pencil_assume(rows          >  0);
+    __pencil_assume(cols          >  0);
+    __pencil_assume(step          >= cols);
+    __pencil_assume(kernel_length >  0);
+    __pencil_assume(kernel_length <= 64);
+
+    __pencil_kill(acc);
+    __pencil_kill(dst);
+    {
+        const int round = 1 << (GAUSSIAN_U8_BITS + 8 - 1);
+
         #pragma pencil independent
         for ( int q = 0; q < rows; q++ )
         {
             #pragma pencil independent
             for ( int w = 0; w < cols; w++ )
+                acc[q][w] = round + src[q][w] * kernel[0];
+            for ( int e = 1; e < kernel_length; e++ )
             {
-                float prod2 = 0.;
-                #pragma pencil independent reduction (+: prod2);
-                for ( int e = 0; e < kernelY_length; e++ )
+                #pragma pencil independent
+                for ( int w = 0; w < cols; w++ )
+                    acc[q][w] += src[q + e][w] * kernel[e];
+            }
+            #pragma pencil independent
+            for ( int w = 0; w < cols; w++ )
+                dst[q][w] = imin(acc[q][w] >> (GAUSSIAN_U8_BITS + 8), 255);
+        }
+    }
+    __pencil_kill(acc);
+    __pencil_kill(src);
+#pragma endscop
+}
+
+#define GAUSSIAN_PASTE(name, taps) name##taps
+#define GAUSSIAN_NAME(name, taps) GAUSSIAN_PASTE(name, taps)
+
+#define GAUSSIAN_TAPS 3
+#include "gaussian.pencil.detail.h"
+#undef GAUSSIAN_TAPS
+#define GAUSSIAN_TAPS 5
+#include "gaussian.pencil.detail.h"
+#undef GAUSSIAN_TAPS
+#define GAUSSIAN_TAPS 7
+#include "gaussian.pencil.detail.h"
+#undef GAUSSIAN_TAPS
+#define GAUSSIAN_TAPS 9
+#include "gaussian.pencil.detail.h"
+#undef GAUSSIAN_TAPS
+#define GAUSSIAN_TAPS 11
+#include "gaussian.pencil.detail.h"
+#undef GAUSSIAN_TAPS
+#define GAUSSIAN_TAPS 13
+#include "gaussian.pencil.detail.h"
+#undef GAUSSIAN_TAPS
+#define GAUSSIAN_TAPS 15
+#include "gaussian.pencil.detail.h"
+#undef GAUSSIAN_TAPS
+
+// Length of the specialised pass for this kernel, 0 if only the generic loop applies.
+static int gaussian_specialisation( const int kernel_length, const float kernel[] )
+{
+    if ( kernel_length < 3 || kernel_length > 15 || kernel_length % 2 == 0 )
+        return 0;
+    for ( int r = 0; r < kernel_length / 2; r++ )
+        if ( kernel[r] != kernel[kernel_length - 1 - r] )
+            return 0;
+    return kernel_length;
+}
+
+#define GAUSSIAN_PASS_CASE(pass, taps) case taps: GAUSSIAN_NAME(pass, taps)( rows, cols, step, src, kernel, border_type, border_value, dst ); break;
+
+static void gaussian_row_pass( const int rows, const int cols, const int step, const float src[][step]
+                             , const int kernel_length, const float kernel[]
+                             , const int border_type, const float border_value, float dst[][step] )
+{
+    switch ( gaussian_specialisation(kernel_length, kernel) )
+    {
+    GAUSSIAN_PASS_CASE(gaussian_row_,  3)
+    GAUSSIAN_PASS_CASE(gaussian_row_,  5)
+    GAUSSIAN_PASS_CASE(gaussian_row_,  7)
+    GAUSSIAN_PASS_CASE(gaussian_row_,  9)
+    GAUSSIAN_PASS_CASE(gaussian_row_, 11)
+    GAUSSIAN_PASS_CASE(gaussian_row_, 13)
+    GAUSSIAN_PASS_CASE(gaussian_row_, 15)
+    default: gaussian_row( rows, cols, step, src, kernel_length, kernel, border_type, border_value, dst ); break;
+    }
+}
+
+static void gaussian_col_pass( const int rows, const int cols, const int step, const float src[][step]
+                             , const int kernel_length, const float kernel[]
+                             , const int border_type, const float border_value, float dst[][step] )
+{
+    switch ( gaussian_specialisation(kernel_length, kernel) )
+    {
+    GAUSSIAN_PASS_CASE(gaussian_col_,  3)
+    GAUSSIAN_PASS_CASE(gaussian_col_,  5)
+    GAUSSIAN_PASS_CASE(gaussian_col_,  7)
+    GAUSSIAN_PASS_CASE(gaussian_col_,  9)
+    GAUSSIAN_PASS_CASE(gaussian_col_, 11)
+    GAUSSIAN_PASS_CASE(gaussian_col_, 13)
+    GAUSSIAN_PASS_CASE(gaussian_col_, 15)
+    default: gaussian_col( rows, cols, step, src, kernel_length, kernel, border_type, border_value, dst ); break;
+    }
+}
+
+#undef GAUSSIAN_PASS_CASE
+
+static void gaussian_u8_row_pass( const int rows, const int cols, const int step, const uint8_t src[][step]
+                                , const int first_row, const int temp_rows
+                                , const int kernel_length, const float kernel_float[], const int16_t kernel[]
+                                , const int border_type, const int border_value, int acc[][step], uint16_t dst[][step] )
+{
+#define GAUSSIAN_PASS_CASE(pass, taps) case taps: GAUSSIAN_NAME(pass, taps)( rows, cols, step, src, first_row, temp_rows, kernel, border_type, border_value, dst ); break;
+    switch ( gaussian_specialisation(kernel_length, kernel_float) )
+    {
+    GAUSSIAN_PASS_CASE(gaussian_u8_row_,  3)
+    GAUSSIAN_PASS_CASE(gaussian_u8_row_,  5)
+    GAUSSIAN_PASS_CASE(gaussian_u8_row_,  7)
+    GAUSSIAN_PASS_CASE(gaussian_u8_row_,  9)
+    GAUSSIAN_PASS_CASE(gaussian_u8_row_, 11)
+    GAUSSIAN_PASS_CASE(gaussian_u8_row_, 13)
+    GAUSSIAN_PASS_CASE(gaussian_u8_row_, 15)
+    default: gaussian_u8_row( rows, cols, step, src, first_row, temp_rows, kernel_length, kernel, border_type, border_value, acc, dst ); break;
+    }
+#undef GAUSSIAN_PASS_CASE
+}
+
+static void gaussian_u8_col_pass( const int rows, const int cols, const int step, const uint16_t src[][step]
+                                , const int kernel_length, const float kernel_float[], const int16_t kernel[]
+                                , int acc[][step], uint8_t dst[][step] )
+{
+#define GAUSSIAN_PASS_CASE(pass, taps) case taps: GAUSSIAN_NAME(pass, taps)( rows, cols, step, src, kernel, dst ); break;
+    switch ( gaussian_specialisation(kernel_length, kernel_float) )
+    {
+    GAUSSIAN_PASS_CASE(gaussian_u8_col_,  3)
+    GAUSSIAN_PASS_CASE(gaussian_u8_col_,  5)
+    GAUSSIAN_PASS_CASE(gaussian_u8_col_,  7)
+    GAUSSIAN_PASS_CASE(gaussian_u8_col_,  9)
+    GAUSSIAN_PASS_CASE(gaussian_u8_col_, 11)
+    GAUSSIAN_PASS_CASE(gaussian_u8_col_, 13)
+    GAUSSIAN_PASS_CASE(gaussian_u8_col_, 15)
+    default: gaussian_u8_col( rows, cols, step, kernel_length, src, kernel, acc, dst ); break;
+    }
+#undef GAUSSIAN_PASS_CASE
+}
+
+// Rounds a normalised, non negative kernel to taps that sum to exactly
+// 1 << GAUSSIAN_U8_BITS, so flat regions keep their value. The rounding error
+// goes to the centre tap.
+static void gaussian_u8_kernel( const int kernel_length, const float kernel[], int16_t fixed[] )
+{
+    int sum = 0;
+    for ( int i = 0; i < kernel_length; i++ )
+    {
+        assert( kernel[i] >= 0 );
+        fixed[i] = (int16_t)lrintf(ldexpf(kernel[i], GAUSSIAN_U8_BITS));
+        sum += fixed[i];
+    }
+    fixed[kernel_length / 2] += (1 << GAUSSIAN_U8_BITS) - sum;
+    assert( fixed[kernel_length / 2] >= 0 );
+}
+
+
+
+/* Young - van Vliet recursive Gaussian. coeff[] holds B, a1, a2, a3 followed by
+ * the Triggs - Sdika boundary matrix (premultiplied with B, row major). */
+#define GAUSSIAN_IIR_COEFFS 13
+
+static void gaussian_iir( const int rows
+                        , const int cols
+                        , const int step
+                        , const float src[static const restrict rows][step]
+                        , const float coeffX[static const restrict GAUSSIAN_IIR_COEFFS]
+                        , const float coeffY[static const restrict GAUSSIAN_IIR_COEFFS]
+                        , float conv[static const restrict rows][step]
+                        )
+{
+#pragma scop
+    __pencil_assume(rows >  0);
+    __pencil_assume(cols >  0);
+    __pencil_assume(step >= cols);
+
+    __pencil_kill(conv);
+    {
+#if __PENCIL__
+        float tail[3][step];
+#else
+        float (*tail)[step] = (float (*)[step])malloc(sizeof(float)*3*step);
+        assert( tail );
+#endif
+        // Horizontal causal and anticausal passes, one row per work item.
+        #pragma pencil independent
+        for ( int q = 0; q < rows; q++ )
+        {
+            conv[q][0] = src[q][0];
+            for ( int w = 1; w < cols; w++ )
+            {
+                conv[q][w] = coeffX[0] * src[q][w]
+                           + coeffX[1] * conv[q][w-1]
+                           + coeffX[2] * conv[q][imax(w-2, 0)]
+                           + coeffX[3] * conv[q][imax(w-3, 0)];
+            }
+
+            float xn = src[q][cols-1];
+            float u0 = conv[q][cols-1]          - xn;
+            float u1 = conv[q][imax(cols-2, 0)] - xn;
+            float u2 = conv[q][imax(cols-3, 0)] - xn;
+            float y0 = coeffX[ 4] * u0 + coeffX[ 5] * u1 + coeffX[ 6] * u2 + xn;
+            float y1 = coeffX[ 7] * u0 + coeffX[ 8] * u1 + coeffX[ 9] * u2 + xn;
+            float y2 = coeffX[10] * u0 + coeffX[11] * u1 + coeffX[12] * u2 + xn;
+            conv[q][cols-1] = y0;
+            for ( int w = cols - 2; w >= 0; w-- )
+            {
+                float y = coeffX[0] * conv[q][w] + coeffX[1] * y0 + coeffX[2] * y1 + coeffX[3] * y2;
+                conv[q][w] = y;
+                y2 = y1;
+                y1 = y0;
+                y0 = y;
+            }
+        }
+
+        // Vertical passes, in place, one block of columns per work item.
+        #pragma pencil independent
+        for ( int b = 0; b < (cols + GAUSSIAN_IIR_BLOCK - 1) / GAUSSIAN_IIR_BLOCK; b++ )
+        {
+            #pragma pencil independent
+            for ( int w = b * GAUSSIAN_IIR_BLOCK; w < imin((b + 1) * GAUSSIAN_IIR_BLOCK, cols); w++ )
+                tail[0][w] = conv[rows-1][w];
+
+            for ( int q = 1; q < rows; q++ )
+            {
+                #pragma pencil independent
+                for ( int w = b * GAUSSIAN_IIR_BLOCK; w < imin((b + 1) * GAUSSIAN_IIR_BLOCK, cols); w++ )
                 {
-                    int row2 = iclampi(q + e - kernelY_length / 2, 0, rows-1);
-                    int col2 = w;
-                    prod2 += temp[row2][col2] * kernelY[e];
+                    conv[q][w] = coeffY[0] * conv[q][w]
+                               + coeffY[1] * conv[q-1][w]
+                               + coeffY[2] * conv[imax(q-2, 0)][w]
+                               + coeffY[3] * conv[imax(q-3, 0)][w];
+                }
+            }
+
+            #pragma pencil independent
+            for ( int w = b * GAUSSIAN_IIR_BLOCK; w < imin((b + 1) * GAUSSIAN_IIR_BLOCK, cols); w++ )
+            {
+                float xn = tail[0][w];
+                float u0 = conv[rows-1][w]          - xn;
+                float u1 = conv[imax(rows-2, 0)][w] - xn;
+                float u2 = conv[imax(rows-3, 0)][w] - xn;
+                conv[rows-1][w] = coeffY[ 4] * u0 + coeffY[ 5] * u1 + coeffY[ 6] * u2 + xn;
+                tail[1][w]      = coeffY[ 7] * u0 + coeffY[ 8] * u1 + coeffY[ 9] * u2 + xn;
+                tail[2][w]      = coeffY[10] * u0 + coeffY[11] * u1 + coeffY[12] * u2 + xn;
+            }
+
+            for ( int q = rows - 2; q >= 0; q-- )
+            {
+                #pragma pencil independent
+                for ( int w = b * GAUSSIAN_IIR_BLOCK; w < imin((b + 1) * GAUSSIAN_IIR_BLOCK, cols); w++ )
+                {
+                    float y1 = conv[q+1][w];
+                    float y2 = (q + 2 < rows) ? conv[q+2][w] : tail[q+3-rows][w];
+                    float y3 = (q + 3 < rows) ? conv[q+3][w] : tail[q+4-rows][w];
+                    conv[q][w] = coeffY[0] * conv[q][w] + coeffY[1] * y1 + coeffY[2] * y2 + coeffY[3] * y3;
                 }
-                conv[q][w] = prod2;
             }
         }
 #if !__PENCIL__
-        free(temp);
+        free(tail);
 #endif
     }
+    __pencil_kill(src);
 #pragma endscop
 }
 
+static void gaussian_iir_coefficients( const float sigma, float coeff[GAUSSIAN_IIR_COEFFS] )
+{
+    // Young & van Vliet, "Recursive implementation of the Gaussian filter", 1995
+    const double s  = sigma;
+    const double q  = (s >= 2.5) ? 0.98711 * s - 0.96330 : 3.97156 - 4.14554 * sqrt(1. - 0.26891 * s);
+    const double b0 = 1.57825 + 2.44413 * q + 1.4281 * q * q + 0.422205 * q * q * q;
+    const double a1 = (2.44413 * q + 2.85619 * q * q + 1.26661 * q * q * q) / b0;
+    const double a2 = -(1.4281 * q * q + 1.26661 * q * q * q) / b0;
+    const double a3 = (0.422205 * q * q * q) / b0;
+    const double B  = 1. - (a1 + a2 + a3);
+
+    // Triggs & Sdika, "Boundary conditions for Young - van Vliet recursive filtering", 2006
+    const double m = B / ((1. + a1 - a2 + a3) * (1. - a1 - a2 - a3) * (1. + a2 + (a1 - a3) * a3));
+
+    coeff[ 0] = B;
+    coeff[ 1] = a1;
+    coeff[ 2] = a2;
+    coeff[ 3] = a3;
+    coeff[ 4] = m * (-a3 * a1 + 1. - a3 * a3 - a2);
+    coeff[ 5] = m * (a3 + a1) * (a2 + a3 * a1);
+    coeff[ 6] = m * a3 * (a1 + a3 * a2);
+    coeff[ 7] = m * (a1 + a3 * a2);
+    coeff[ 8] = -m * (a2 - 1.) * (a2 + a3 * a1);
+    coeff[ 9] = -m * a3 * (a3 * a1 + a3 * a3 + a2 - 1.);
+    coeff[10] = m * (a3 * a1 + a2 + a1 * a1 - a2 * a2);
+    coeff[11] = m * (a1 * a2 + a3 * a2 * a2 - a1 * a3 * a3 - a3 * a3 * a3 - a3 * a2 + a3);
+    coeff[12] = m * a3 * (a1 + a3 * a2);
+}
+
 void pencil_gaussian( const int rows
                     , const int cols
                     , const int step
@@ -85,9 +540,232 @@ void pencil_gaussian( const int rows
                     , float conv[]
                     )
 {
-    gaussian( rows, cols, step, (const float(*)[step])src
-            , kernelX_length, kernelX
-            , kernelY_length, kernelY
-            , (float(*)[step])conv
-            );
+    pencil_gaussian_border( rows, cols, step, src
+                          , kernelX_length, kernelX
+                          , kernelY_length, kernelY
+                          , PENCIL_BORDER_REPLICATE, 0.f
+                          , conv
+                          );
+}
+
+void pencil_gaussian_border( const int rows
+                           , const int cols
+                           , const int step
+                           , const float src[]
+                           , const int kernelX_length
+                           , const float kernelX[]
+                           , const int kernelY_length
+                           , const float kernelY[]
+                           , const int border_type
+                           , const float border_value
+                           , float conv[]
+                           )
+{
+    // Rows outside the image are constant border_value rows after the horizontal pass
+    float border_valueY = 0.f;
+    for ( int r = 0; r < kernelX_length; r++ )
+        border_valueY += border_value * kernelX[r];
+
+    // Neither kernel has a specialised pass: a single fused launch is cheaper.
+    if ( !gaussian_specialisation(kernelX_length, kernelX) && !gaussian_specialisation(kernelY_length, kernelY) )
+    {
+        separable_filter( rows, cols, 1, step, (const float(*)[step])src
+                        , kernelX_length, kernelX
+                        , kernelY_length, kernelY
+                        , border_type, border_value, border_valueY
+                        , (float(*)[step])conv
+                        );
+        return;
+    }
+
+    float (*temp)[step] = (float (*)[step])malloc(sizeof(float)*rows*step);
+    assert( temp );
+    gaussian_row_pass( rows, cols, step, (const float(*)[step])src, kernelX_length, kernelX, border_type, border_value, temp );
+    gaussian_col_pass( rows, cols, step, (const float(*)[step])temp, kernelY_length, kernelY, border_type, border_valueY, (float(*)[step])conv );
+    free(temp);
+}
+
+void pencil_gaussian_cn( const int rows
+                       , const int cols
+                       , const int channels
+                       , const int step
+                       , const float src[]
+                       , const int kernelX_length
+                       , const float kernelX[]
+                       , const int kernelY_length
+                       , const float kernelY[]
+                       , const int border_type
+                       , const float border_value
+                       , float conv[]
+                       )
+{
+    assert( channels > 0 );
+    assert( kernelX_length <= 64 && kernelY_length <= 64 );
+    if ( channels == 1 )
+    {
+        pencil_gaussian_border( rows, cols, step, src, kernelX_length, kernelX, kernelY_length, kernelY, border_type, border_value, conv );
+        return;
+    }
+
+    float border_valueY = 0.f;
+    for ( int r = 0; r < kernelX_length; r++ )
+        border_valueY += border_value * kernelX[r];
+
+    // The horizontal taps step over pixels, the vertical pass over whole rows
+    separable_filter( rows, cols, channels, step, (const float(*)[step])src
+                    , kernelX_length, kernelX
+                    , kernelY_length, kernelY
+                    , border_type, border_value, border_valueY
+                    , (float(*)[step])conv
+                    );
+}
+
+void pencil_gaussian_iir( const int rows
+                        , const int cols
+                        , const int step
+                        , const float src[]
+                        , const float sigmaX
+                        , const float sigmaY
+                        , float conv[]
+                        )
+{
+    float coeffX[GAUSSIAN_IIR_COEFFS];
+    float coeffY[GAUSSIAN_IIR_COEFFS];
+
+    gaussian_iir_coefficients( sigmaX, coeffX );
+    gaussian_iir_coefficients( sigmaY, coeffY );
+
+    gaussian_iir( rows, cols, step, (const float(*)[step])src
+                , coeffX, coeffY
+                , (float(*)[step])conv
+                );
+}
+
+static void gaussian_kernel( const int length, const float sigma, float kernel[] )
+{
+    double sum = 0.;
+
+    for ( int i = 0; i < length; i++ )
+    {
+        const double x = i - (length - 1) * 0.5;
+        kernel[i] = exp( -x * x / (2. * sigma * sigma) );
+        sum += kernel[i];
+    }
+    for ( int i = 0; i < length; i++ )
+        kernel[i] /= sum;
+}
+
+void pencil_GaussianBlur( const int rows
+                        , const int cols
+                        , const int step
+                        , const float src[]
+                        , const int kernelX_length
+                        , const int kernelY_length
+                        , const float sigmaX
+                        , const float sigmaY
+                        , float conv[]
+                        )
+{
+    assert( sigmaX > 0 );
+    assert( kernelX_length > 0 && kernelX_length % 2 == 1 );
+    assert( kernelY_length > 0 && kernelY_length % 2 == 1 );
+
+    const float sigma_x = sigmaX;
+    const float sigma_y = (sigmaY > 0) ? sigmaY : sigmaX;
+
+    // The recursive filter approximates the untruncated Gaussian: only use it
+    // when the requested kernels span at least +-3 sigma.
+    if ( sigma_x >= GAUSSIAN_IIR_CROSSOVER_SIGMA && (kernelX_length - 1) / 2 >= 3 * sigma_x
+      && sigma_y >= GAUSSIAN_IIR_CROSSOVER_SIGMA && (kernelY_length - 1) / 2 >= 3 * sigma_y
+       )
+    {
+        pencil_gaussian_iir( rows, cols, step, src, sigma_x, sigma_y, conv );
+    }
+    else
+    {
+        assert( kernelX_length <= 64 && kernelY_length <= 64 );
+
+        float kernelX[kernelX_length];
+        float kernelY[kernelY_length];
+        gaussian_kernel( kernelX_length, sigma_x, kernelX );
+        gaussian_kernel( kernelY_length, sigma_y, kernelY );
+        pencil_gaussian( rows, cols, step, src, kernelX_length, kernelX, kernelY_length, kernelY, conv );
+    }
+}
+
+void pencil_gaussian_u8( const int rows
+                       , const int cols
+                       , const int step
+                       , const uint8_t src[]
+                       , const int kernelX_length
+                       , const float kernelX[]
+                       , const int kernelY_length
+                       , const float kernelY[]
+                       , const int border_type
+                       , const uint8_t border_value
+                       , uint8_t conv[]
+                       )
+{
+    assert( kernelX_length <= 64 && kernelY_length <= 64 );
+
+    int16_t fixedX[kernelX_length];
+    int16_t fixedY[kernelY_length];
+    gaussian_u8_kernel( kernelX_length, kernelX, fixedX );
+    gaussian_u8_kernel( kernelY_length, kernelY, fixedY );
+
+    // Each strip's horizontal pass starts with the kernelY_length - 1 halo rows
+    // it shares with the previous strip, which are moved up instead of redone
+    const int halfY = kernelY_length / 2;
+    const int halo  = kernelY_length - 1;
+    const int strip = imin(GAUSSIAN_U8_STRIP, rows);
+    uint16_t *temp = (uint16_t *)malloc(sizeof(uint16_t) * (strip + halo) * step);
+    int      *acc  = (int      *)malloc(sizeof(int     ) * (strip + halo) * step);
+    assert( temp && acc );
+    for ( int first_row = 0; first_row < rows; first_row += strip )
+    {
+        const int strip_rows = imin(strip, rows - first_row);
+        const int kept = first_row ? halo : 0;
+        if ( kept )
+            memmove( temp, temp + strip * step, sizeof(uint16_t) * halo * step );
+        gaussian_u8_row_pass( rows, cols, step, (const uint8_t(*)[step])src, first_row - halfY + kept, strip_rows + halo - kept
+                            , kernelX_length, kernelX, fixedX, border_type, border_value, (int(*)[step])acc, (uint16_t(*)[step])(temp + kept * step) );
+        gaussian_u8_col_pass( strip_rows, cols, step, (const uint16_t(*)[step])temp
+                            , kernelY_length, kernelY, fixedY, (int(*)[step])acc, (uint8_t(*)[step])(conv + first_row * step) );
+    }
+    free(temp);
+    free(acc);
+}
+
+typedef struct
+{
+    int kernelX_length;
+    const float *kernelX;
+    int kernelY_length;
+    const float *kernelY;
+    int border_type;
+    float border_value;
+} gaussian_f16_arguments;
+
+static void gaussian_f16_strip( const int rows, const int cols, const int step, const float src[], float conv[], const void *arguments )
+{
+    const gaussian_f16_arguments *a = (const gaussian_f16_arguments *)arguments;
+    pencil_gaussian_border( rows, cols, step, src, a->kernelX_length, a->kernelX, a->kernelY_length, a->kernelY, a->border_type, a->border_value, conv );
+}
+
+void pencil_gaussian_f16( const int rows
+                        , const int cols
+                        , const int step
+                        , const uint16_t src[]
+                        , const int kernelX_length
+                        , const float kernelX[]
+                        , const int kernelY_length
+                        , const float kernelY[]
+                        , const int border_type
+                        , const float border_value
+                        , uint16_t conv[]
+                        )
+{
+    const gaussian_f16_arguments arguments = { kernelX_length, kernelX, kernelY_length, kernelY, border_type, border_value };
+    const int half = kernelY_length / 2;
+    half_strips( rows, cols, step, src, conv, half, kernelY_length - 1 - half, border_type, border_value, 0, gaussian_f16_strip, &arguments );
 }
@@ -0,0 +1,231 @@
+//Implementation file. Included multiple times with different GAUSSIAN_TAPS defines
+
+// Separable passes specialised for a symmetric kernel of GAUSSIAN_TAPS (odd) taps.
+// Mirrored taps are folded (one multiply per pair) and only the border frame
+// of GAUSSIAN_TAPS/2 pixels is extrapolated.
+
+static void GAUSSIAN_NAME(gaussian_row_, GAUSSIAN_TAPS)( const int rows
+                                                       , const int cols
+                                                       , const int step
+                                                       , const float src[static const restrict rows][step]
+                                                       , const float kernel[static const restrict GAUSSIAN_TAPS]
+                                                       , const int border_type
+                                                       , const float border_value
+                                                       , float dst[static const restrict rows][step]
+                                                       )
+{
+#pragma scop
+    __pencil_assume(rows >  0);
+    __pencil_assume(cols >  0);
+    __pencil_assume(step >= cols);
+
+    __pencil_kill(dst);
+    {
+        const int half  = GAUSSIAN_TAPS / 2;
+        const int left  = imin(half, cols);
+        const int right = imax(cols - half, left);
+        float k[GAUSSIAN_TAPS / 2 + 1];
+        for ( int r = 0; r <= GAUSSIAN_TAPS / 2; r++ )
+            k[r] = kernel[r];
+
+        #pragma pencil independent
+        for ( int q = 0; q < rows; q++ )
+        {
+            #pragma pencil independent
+            for ( int w = left; w < right; w++ )
+            {
+                float prod = src[q][w] * k[half];
+                for ( int r = 0; r < GAUSSIAN_TAPS / 2; r++ )
+                    prod += ( src[q][w + r - half] + src[q][w + half - r] ) * k[r];
+                dst[q][w] = prod;
+            }
+            #pragma pencil independent
+            for ( int i = 0; i < left + cols - right; i++ )
+            {
+                const int w = (i < left) ? i : right + i - left;
+                float prod = src[q][w] * k[half];
+                for ( int r = 0; r < GAUSSIAN_TAPS / 2; r++ )
+                    prod += ( border_fetch(src, q, w + r - half, rows, cols, border_type, border_value)
+                            + border_fetch(src, q, w + half - r, rows, cols, border_type, border_value) ) * k[r];
+                dst[q][w] = prod;
+            }
+        }
+    }
+    __pencil_kill(src);
+#pragma endscop
+}
+
+static void GAUSSIAN_NAME(gaussian_col_, GAUSSIAN_TAPS)( const int rows
+                                                       , const int cols
+                                                       , const int step
+                                                       , const float src[static const restrict rows][step]
+                                                       , const float kernel[static const restrict GAUSSIAN_TAPS]
+                                                       , const int border_type
+                                                       , const float border_value
+                                                       , float dst[static const restrict rows][step]
+                                                       )
+{
+#pragma scop
+    __pencil_assume(rows >  0);
+    __pencil_assume(cols >  0);
+    __pencil_assume(step >= cols);
+
+    __pencil_kill(dst);
+    {
+        const int half = GAUSSIAN_TAPS / 2;
+        float k[GAUSSIAN_TAPS / 2 + 1];
+        for ( int e = 0; e <= GAUSSIAN_TAPS / 2; e++ )
+            k[e] = kernel[e];
+
+        #pragma pencil independent
+        for ( int q = 0; q < rows; q++ )
+        {
+            if ( q >= half && q < rows - half )
+            {
+                #pragma pencil independent
+                for ( int w = 0; w < cols; w++ )
+                {
+                    float prod = src[q][w] * k[half];
+                    for ( int e = 0; e < GAUSSIAN_TAPS / 2; e++ )
+                        prod += ( src[q + e - half][w] + src[q + half - e][w] ) * k[e];
+                    dst[q][w] = prod;
+                }
+            }
+            else
+            {
+                // Extrapolate the row indices once per tap, not per pixel
+                int   above[GAUSSIAN_TAPS / 2], below[GAUSSIAN_TAPS / 2];
+                float fill = 0.;
+                float ka[GAUSSIAN_TAPS / 2], kb[GAUSSIAN_TAPS / 2];
+                for ( int e = 0; e < GAUSSIAN_TAPS / 2; e++ )
+                {
+                    const int outside_above = border_outside(q + e - half, rows, border_type);
+                    const int outside_below = border_outside(q + half - e, rows, border_type);
+                    above[e] = border_index(q + e - half, rows, border_type);
+                    below[e] = border_index(q + half - e, rows, border_type);
+                    ka[e]    = outside_above ? 0.f : k[e];
+                    kb[e]    = outside_below ? 0.f : k[e];
+                    fill    += (outside_above + outside_below) * border_value * k[e];
+                }
+                #pragma pencil independent
+                for ( int w = 0; w < cols; w++ )
+                {
+                    float prod = fill + src[q][w] * k[half];
+                    for ( int e = 0; e < GAUSSIAN_TAPS / 2; e++ )
+                        prod += src[above[e]][w] * ka[e] + src[below[e]][w] * kb[e];
+                    dst[q][w] = prod;
+                }
+            }
+        }
+    }
+    __pencil_kill(src);
+#pragma endscop
+}
+
+// 8-bit passes with the same folding, over the strips of gaussian_u8_row and
+// gaussian_u8_col: kernel holds 16-bit taps summing to 1 << GAUSSIAN_U8_BITS
+// and each pixel is summed in 32 bits.
+
+static void GAUSSIAN_NAME(gaussian_u8_row_, GAUSSIAN_TAPS)( const int rows
+                                                          , const int cols
+                                                          , const int step
+                                                          , const uint8_t src[static const restrict rows][step]
+                                                          , const int first_row
+                                                          , const int temp_rows
+                                                          , const int16_t kernel[static const restrict GAUSSIAN_TAPS]
+                                                          , const int border_type
+                                                          , const int border_value
+                                                          , uint16_t dst[static const restrict temp_rows][step]
+                                                          )
+{
+#pragma scop
+    __pencil_assume(rows      >  0);
+    __pencil_assume(cols      >  0);
+    __pencil_assume(step      >= cols);
+    __pencil_assume(temp_rows >  0);
+
+    __pencil_kill(dst);
+    {
+        const int half  = GAUSSIAN_TAPS / 2;
+        const int left  = imin(half, cols);
+        const int right = imax(cols - half, left);
+        const int round = 1 << (GAUSSIAN_U8_BITS - 8 - 1);
+        int16_t k[GAUSSIAN_TAPS / 2 + 1];
+        for ( int r = 0; r <= GAUSSIAN_TAPS / 2; r++ )
+            k[r] = kernel[r];
+
+        #pragma pencil independent
+        for ( int t = 0; t < temp_rows; t++ )
+        {
+            const int p = first_row + t;
+            const int q = border_index(p, rows, border_type);
+            if ( border_outside(p, rows, border_type) )
+            {
+                #pragma pencil independent
+                for ( int w = 0; w < cols; w++ )
+                    dst[t][w] = border_value << 8;
+            }
+            else
+            {
+                #pragma pencil independent
+                for ( int w = left; w < right; w++ )
+                {
+                    int prod = round + src[q][w] * k[half];
+                    for ( int r = 0; r < GAUSSIAN_TAPS / 2; r++ )
+                        prod += ( src[q][w + r - half] + src[q][w + half - r] ) * k[r];
+                    dst[t][w] = prod >> (GAUSSIAN_U8_BITS - 8);
+                }
+                #pragma pencil independent
+                for ( int i = 0; i < left + cols - right; i++ )
+                {
+                    const int w = (i < left) ? i : right + i - left;
+                    int prod = round + src[q][w] * k[half];
+                    for ( int r = 0; r < GAUSSIAN_TAPS / 2; r++ )
+                        prod += ( border_fetch(src, q, w + r - half, rows, cols, border_type, border_value)
+                                + border_fetch(src, q, w + half - r, rows, cols, border_type, border_value) ) * k[r];
+                    dst[t][w] = prod >> (GAUSSIAN_U8_BITS - 8);
+                }
+            }
+        }
+    }
+    __pencil_kill(src);
+#pragma endscop
+}
+
+static void GAUSSIAN_NAME(gaussian_u8_col_, GAUSSIAN_TAPS)( const int rows
+                                                          , const int cols
+                                                          , const int step
+                                                          , const uint16_t src[static const restrict rows + GAUSSIAN_TAPS - 1][step]
+                                                          , const int16_t kernel[static const restrict GAUSSIAN_TAPS]
+                                                          , uint8_t dst[static const restrict rows][step]
+                                                          )
+{
+#pragma scop
+    __pencil_assume(rows >  0);
+    __pencil_assume(cols >  0);
+    __pencil_assume(step >= cols);
+
+    __pencil_kill(dst);
+    {
+        const int half  = GAUSSIAN_TAPS / 2;
+        const int round = 1 << (GAUSSIAN_U8_BITS + 8 - 1);
+        int16_t k[GAUSSIAN_TAPS / 2 + 1];
+        for ( int e = 0; e <= GAUSSIAN_TAPS / 2; e++ )
+            k[e] = kernel[e];
+
+        #pragma pencil independent
+        for ( int q = 0; q < rows; q++ )
+        {
+            #pragma pencil independent
+            for ( int w = 0; w < cols; w++ )
+            {
+                int prod = round + src[q + half][w] * k[half];
+                for ( int e = 0; e < GAUSSIAN_TAPS / 2; e++ )
+                    prod += ( src[q + e][w] + src[q + 2 * half - e][w] ) * k[e];
+                dst[q][w] = imin(prod >> (GAUSSIAN_U8_BITS + 8), 255);
+            }
+        }
+    }
+    __pencil_kill(src);
+#pragma endscop
+}
@@ -1,3 +1,12 @@
+#include <stdint.h>
+#include "border.pencil.h"
+
+/* Smallest sigma for which pencil_GaussianBlur switches to the recursive
+ * filter. Measured with time_gaussian_crossover (test_gaussian). */
+#ifndef GAUSSIAN_IIR_CROSSOVER_SIGMA
+#define GAUSSIAN_IIR_CROSSOVER_SIGMA 3.0f
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -11,6 +20,89 @@ void pencil_gaussian( const int rows
                     , const float kernelY[]
                     , float conv[]
                     );
+
+// border_type is one of PENCIL_BORDER_*, border_value is used by PENCIL_BORDER_CONSTANT
+void pencil_gaussian_border( const int rows
+                           , const int cols
+                           , const int step
+                           , const float src[]
+                           , const int kernelX_length
+                           , const float kernelX[]
+                           , const int kernelY_length
+                           , const float kernelY[]
+                           , const int border_type
+                           , const float border_value
+                           , float conv[]
+                           );
+
+// Interleaved image of channels floats per pixel, step counting floats: every
+// channel is filtered as by pencil_gaussian_border, in the same passes.
+void pencil_gaussian_cn( const int rows
+                       , const int cols
+                       , const int channels
+                       , const int step
+                       , const float src[]
+                       , const int kernelX_length
+                       , const float kernelX[]
+                       , const int kernelY_length
+                       , const float kernelY[]
+                       , const int border_type
+                       , const float border_value
+                       , float conv[]
+                       );
+
+// 8-bit in, 8-bit out in fixed point: 16-bit taps, 32-bit sums, a 16-bit
+// intermediate, rounded to nearest. The kernels must be normalised and not
+// negative.
+void pencil_gaussian_u8( const int rows
+                       , const int cols
+                       , const int step
+                       , const uint8_t src[]
+                       , const int kernelX_length
+                       , const float kernelX[]
+                       , const int kernelY_length
+                       , const float kernelY[]
+                       , const int border_type
+                       , const uint8_t border_value
+                       , uint8_t conv[]
+                       );
+
+// Half precision storage: src and conv hold IEEE half bit patterns, the
+// arithmetic is in float as in pencil_gaussian_border.
+void pencil_gaussian_f16( const int rows
+                        , const int cols
+                        , const int step
+                        , const uint16_t src[]
+                        , const int kernelX_length
+                        , const float kernelX[]
+                        , const int kernelY_length
+                        , const float kernelY[]
+                        , const int border_type
+                        , const float border_value
+                        , uint16_t conv[]
+                        );
+
+// Recursive (IIR) Gaussian: constant cost per pixel regardless of sigma.
+void pencil_gaussian_iir( const int rows
+                        , const int cols
+                        , const int step
+                        , const float src[]
+                        , const float sigmaX
+                        , const float sigmaY
+                        , float conv[]
+                        );
+
+// cv::GaussianBlur-like entry point: picks the FIR or the IIR implementation.
+void pencil_GaussianBlur( const int rows
+                        , const int cols
+                        , const int step
+                        , const float src[]
+                        , const int kernelX_length
+                        , const int kernelY_length
+                        , const float sigmaX
+                        , const float sigmaY
+                        , float conv[]
+                        );
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -1,49 +1,330 @@
 #include "histogram.pencil.h"
 #include <pencil.h>
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include "tile_hist.pencil.h"
 
-void atomic_inc(int *v);
-
-#ifndef __PENCIL__
-void atomic_inc(int *v)
-{
-    (*v)++;
-}
-#endif
-
-static void calcHist( const int rows
-                    , const int cols
-                    , const int step
-                    , const unsigned char image[static const restrict rows][step]
-                    , int hist[static const restrict HISTOGRAM_BINS]    //out
-                    )
+// hist = sum of the sub histograms (of size counters each), bin by bin
+static void calcHist_reduce( const int parts
+                           , const int ways
+                           , const int total
+                           , const int size
+                           , const int sub[static const restrict parts][ways][size]
+                           , int hist[static const restrict total]    //out
+                           )
 {
 #pragma scop
-    __pencil_assume(rows >  0);
-    __pencil_assume(cols >  0);
-    __pencil_assume(step >= cols);
+    __pencil_assume(parts > 0);
+    __pencil_assume(ways  > 0);
+    __pencil_assume(total > 0);
+    __pencil_assume(size  >= total);
 
     __pencil_kill(hist);
 
     #pragma pencil independent
-    for(int b = 0; b < HISTOGRAM_BINS; ++b)
+    for(int b = 0; b < total; ++b)
         hist[b] = 0;
 
-    #pragma pencil independent
-    for(int r = 0; r < rows; ++r)
-    {
-        #pragma pencil independent
-        for(int c = 0; c < cols; ++c)
+    for(int p = 0; p < parts; ++p)
+        for(int w = 0; w < ways; ++w)
         {
-            unsigned char pixel = image[r][c];
-            atomic_inc(&hist[pixel]);
+            #pragma pencil independent
+            for(int b = 0; b < total; ++b)
+                hist[b] += sub[p][w][b];
         }
-    }
+#pragma endscop
+}
+
+// lut entry of the values outside the range: any sum of HISTOGRAM_MAX_DIMS
+// entries holding one of them is negative
+#define HISTOGRAM_OUTSIDE (-(1 << 28))
+
+#define HIST_TYPE  uint8_t
+#define HIST_FLOAT 0
+#define HIST_NAME  calcHist_u8_1d
+#define HIST_DIMS  1
+#include "histogram.pencil.detail.h"
+#undef HIST_NAME
+#undef HIST_DIMS
+#define HIST_NAME  calcHist_u8_2d
+#define HIST_DIMS  2
+#include "histogram.pencil.detail.h"
+#undef HIST_NAME
+#undef HIST_DIMS
+#define HIST_NAME  calcHist_u8_3d
+#define HIST_DIMS  3
+#include "histogram.pencil.detail.h"
+#undef HIST_NAME
+#undef HIST_DIMS
+#undef HIST_TYPE
+#undef HIST_FLOAT
+
+#define HIST_TYPE  float
+#define HIST_FLOAT 1
+#define HIST_NAME  calcHist_f32_1d
+#define HIST_DIMS  1
+#include "histogram.pencil.detail.h"
+#undef HIST_NAME
+#undef HIST_DIMS
+#define HIST_NAME  calcHist_f32_2d
+#define HIST_DIMS  2
+#include "histogram.pencil.detail.h"
+#undef HIST_NAME
+#undef HIST_DIMS
+#define HIST_NAME  calcHist_f32_3d
+#define HIST_DIMS  3
+#include "histogram.pencil.detail.h"
+#undef HIST_NAME
+#undef HIST_DIMS
+#undef HIST_TYPE
+#undef HIST_FLOAT
+
+/* One histogram per channel in a single pass over the interleaved pixels:
+ * lut[k] maps the values of channel k to bins [k * bins, (k + 1) * bins) of
+ * the sub histograms, or to the spare bin channels * bins, which also counts
+ * the masked pixels without a branch. */
+static void calcHist_channels( const int rows
+                             , const int cols
+                             , const int channels
+                             , const int step
+                             , const uint8_t image[static const restrict rows][step]
+                             , const int use_mask
+                             , const int mask_step
+                             , const uint8_t mask[static const restrict rows][mask_step]
+                             , const int bins
+                             , const int lut[static const restrict channels][256]
+                             , const int parts
+                             , const int way_mask
+                             , int sub[static const restrict parts][way_mask + 1][channels * bins + 1]    //out
+                             )
+{
+#pragma scop
+    __pencil_assume(rows     >  0);
+    __pencil_assume(cols     >  0);
+    __pencil_assume(channels >  0);
+    __pencil_assume(step     >= cols * channels);
+    __pencil_assume(bins     >  0);
+    __pencil_assume(parts    >  0);
+    __pencil_assume(parts    <= rows);
+    __pencil_assume(way_mask >= 0);
+
+    __pencil_kill(sub);
 
-    __pencil_kill(image);
+    #pragma pencil independent
+    for(int p = 0; p < parts; ++p)
+    {
+        const int first = p * rows / parts;
+        const int last  = (p + 1) * rows / parts;
+
+        for(int w = 0; w <= way_mask; ++w)
+            for(int b = 0; b <= channels * bins; ++b)
+                sub[p][w][b] = 0;
+
+        for(int r = first; r < last; ++r)
+            for(int c = 0; c < cols; ++c)
+            {
+                const int counted = !use_mask || mask[r][c] != 0;
+                for(int k = 0; k < channels; ++k)
+                    sub[p][c & way_mask][use_mask ? (lut[k][image[r][c * channels + k]] & -counted) | (channels * bins & (counted - 1))
+                                                  : lut[k][image[r][c * channels + k]]]++;
+            }
+    }
 #pragma endscop
 }
 
+/* Number of blocks of rows and of interleaved sub histograms for total
+ * bins: interleaving only pays for small histograms, and the private copies
+ * are kept within HISTOGRAM_PRIVATE_COUNTERS counters. */
+static void calcHist_layout( const int rows, const int total, int *parts, int *ways )
+{
+    *ways  = total <= HISTOGRAM_WAYS_MAX_BINS ? HISTOGRAM_WAYS : 1;
+    *parts = HISTOGRAM_PRIVATE_COUNTERS / (*ways * (total + 1));
+    *parts = imax(imin(*parts, imin(rows, HISTOGRAM_PARTS)), 1);
+}
+
+/* lut[value] = bin * stride for the values whose bin floor(value * scale +
+ * offset) is in [0, bins), HISTOGRAM_OUTSIDE for the others, like the tables
+ * of cv::calcHist with uniform ranges. */
+static void calcHist_lut( const int bins, const float low, const float high, const int stride, int lut[256] )
+{
+    const double scale  = bins / ((double)high - low);
+    const double offset = -scale * low;
+    for ( int v = 0; v < 256; v++ )
+    {
+        const double x = v * scale + offset;
+        lut[v] = x >= 0 && x < bins ? (int)x * stride : HISTOGRAM_OUTSIDE;
+    }
+}
+
+// Sums the sub histograms, of size counters each, into hist and frees them
+static void calcHist_finish( const int parts, const int ways, const int total, const int size, int *sub, int hist[] )
+{
+    calcHist_reduce( parts, ways, total, size, (const int(*)[ways][size])sub, hist );
+    free(sub);
+}
+
+/* Each of parts blocks of rows is a tile with private histograms, see
+ * tile_hist.pencil.h. */
 void pencil_calcHist( const int rows, const int cols, const int step, const unsigned char image[], int hist[HISTOGRAM_BINS])
 {
-    calcHist( rows, cols, step, (const unsigned char(*)[step])image, hist);
+    const int parts     = rows < HISTOGRAM_PARTS ? rows : HISTOGRAM_PARTS;
+    const int tile_rows = (rows + parts - 1) / parts;
+    int (*sub)[1][TILE_HIST_WAYS][TILE_HIST_BINS] = malloc(sizeof(int) * parts * TILE_HIST_WAYS * TILE_HIST_BINS);
+    int *tiles = malloc(sizeof(int) * parts * TILE_HIST_BINS);
+    assert( sub && tiles );
+
+    tile_hist( rows, cols, step, (const uint8_t(*)[step])image, parts, 1, tile_rows, cols, PENCIL_BORDER_CONSTANT
+             , sub, (int(*)[1][TILE_HIST_BINS])tiles );
+    calcHist_finish( parts, 1, HISTOGRAM_BINS, HISTOGRAM_BINS, tiles, hist );
+    free(sub);
+}
+
+void pencil_calcHist_u8( const int rows
+                       , const int cols
+                       , const int channels
+                       , const int step
+                       , const uint8_t image[]
+                       , const int mask_step
+                       , const uint8_t mask[]
+                       , const int dims
+                       , const int channel[]
+                       , const int bins[]
+                       , const float ranges[]
+                       , int hist[]
+                       )
+{
+    assert( dims >= 1 && dims <= HISTOGRAM_MAX_DIMS );
+    for ( int d = 0; d < dims; d++ )
+        assert( channel[d] >= 0 && channel[d] < channels && bins[d] > 0 );
+
+    // The 256 bin histogram of a plain image counts the values themselves
+    if ( channels == 1 && !mask && dims == 1 && bins[0] == HISTOGRAM_BINS && ranges[0] == 0 && ranges[1] == HISTOGRAM_BINS )
+    {
+        pencil_calcHist( rows, cols, step, image, hist );
+        return;
+    }
+
+    int lut[HISTOGRAM_MAX_DIMS][256];
+    int total = 1;
+    for ( int d = dims - 1; d >= 0; d-- )
+    {
+        calcHist_lut( bins[d], ranges[2 * d], ranges[2 * d + 1], total, lut[d] );
+        total *= bins[d];
+    }
+
+    int parts, ways;
+    calcHist_layout( rows, total, &parts, &ways );
+    int *sub = malloc(sizeof(int) * parts * ways * (total + 1));
+    assert( sub );
+
+    // Without a mask, a zero step keeps the mask argument in bounds
+    const int use_mask = mask != NULL;
+    const int mstep = use_mask ? mask_step : 0;
+    const uint8_t *mptr = use_mask ? mask : image;
+    switch ( dims )
+    {
+    case 1:
+        calcHist_u8_1d( rows, cols, channels, step, (const uint8_t(*)[step])image, use_mask, mstep, (const uint8_t(*)[mstep])mptr
+                      , channel, (const int(*)[256])lut, total, parts, ways - 1, (int(*)[ways][total + 1])sub );
+        break;
+    case 2:
+        calcHist_u8_2d( rows, cols, channels, step, (const uint8_t(*)[step])image, use_mask, mstep, (const uint8_t(*)[mstep])mptr
+                      , channel, (const int(*)[256])lut, total, parts, ways - 1, (int(*)[ways][total + 1])sub );
+        break;
+    default:
+        calcHist_u8_3d( rows, cols, channels, step, (const uint8_t(*)[step])image, use_mask, mstep, (const uint8_t(*)[mstep])mptr
+                      , channel, (const int(*)[256])lut, total, parts, ways - 1, (int(*)[ways][total + 1])sub );
+    }
+    calcHist_finish( parts, ways, total, total + 1, sub, hist );
+}
+
+void pencil_calcHist_f32( const int rows
+                        , const int cols
+                        , const int channels
+                        , const int step
+                        , const float image[]
+                        , const int mask_step
+                        , const uint8_t mask[]
+                        , const int dims
+                        , const int channel[]
+                        , const int bins[]
+                        , const float ranges[]
+                        , int hist[]
+                        )
+{
+    assert( dims >= 1 && dims <= HISTOGRAM_MAX_DIMS );
+    for ( int d = 0; d < dims; d++ )
+        assert( channel[d] >= 0 && channel[d] < channels && bins[d] > 0 );
+
+    int stride[HISTOGRAM_MAX_DIMS];
+    double scale[HISTOGRAM_MAX_DIMS][2];
+    int total = 1;
+    for ( int d = dims - 1; d >= 0; d-- )
+    {
+        scale[d][0] = bins[d] / ((double)ranges[2 * d + 1] - ranges[2 * d]);
+        scale[d][1] = -scale[d][0] * ranges[2 * d];
+        stride[d]   = total;
+        total      *= bins[d];
+    }
+
+    int parts, ways;
+    calcHist_layout( rows, total, &parts, &ways );
+    int *sub = malloc(sizeof(int) * parts * ways * (total + 1));
+    assert( sub );
+
+    const int use_mask = mask != NULL;
+    const int mstep = use_mask ? mask_step : 0;
+    const uint8_t *mptr = use_mask ? mask : (const uint8_t *)image;
+    switch ( dims )
+    {
+    case 1:
+        calcHist_f32_1d( rows, cols, channels, step, (const float(*)[step])image, use_mask, mstep, (const uint8_t(*)[mstep])mptr
+                       , channel, bins, stride, (const double(*)[2])scale, total, parts, ways - 1, (int(*)[ways][total + 1])sub );
+        break;
+    case 2:
+        calcHist_f32_2d( rows, cols, channels, step, (const float(*)[step])image, use_mask, mstep, (const uint8_t(*)[mstep])mptr
+                       , channel, bins, stride, (const double(*)[2])scale, total, parts, ways - 1, (int(*)[ways][total + 1])sub );
+        break;
+    default:
+        calcHist_f32_3d( rows, cols, channels, step, (const float(*)[step])image, use_mask, mstep, (const uint8_t(*)[mstep])mptr
+                       , channel, bins, stride, (const double(*)[2])scale, total, parts, ways - 1, (int(*)[ways][total + 1])sub );
+    }
+    calcHist_finish( parts, ways, total, total + 1, sub, hist );
+}
+
+void pencil_calcHist_channels_u8( const int rows
+                                , const int cols
+                                , const int channels
+                                , const int step
+                                , const uint8_t image[]
+                                , const int mask_step
+                                , const uint8_t mask[]
+                                , const int bins
+                                , const float low
+                                , const float high
+                                , int hist[]
+                                )
+{
+    assert( channels >= 1 && channels <= HISTOGRAM_MAX_CHANNELS && bins > 0 );
+
+    int lut[HISTOGRAM_MAX_CHANNELS][256];
+    for ( int k = 0; k < channels; k++ )
+    {
+        calcHist_lut( bins, low, high, 1, lut[k] );
+        for ( int v = 0; v < 256; v++ )
+            lut[k][v] = lut[k][v] >= 0 ? k * bins + lut[k][v] : channels * bins;
+    }
+
+    int parts, ways;
+    calcHist_layout( rows, channels * bins, &parts, &ways );
+    int *sub = malloc(sizeof(int) * parts * ways * (channels * bins + 1));
+    assert( sub );
+
+    const int use_mask = mask != NULL;
+    const int mstep = use_mask ? mask_step : 0;
+    const uint8_t *mptr = use_mask ? mask : image;
+    calcHist_channels( rows, cols, channels, step, (const uint8_t(*)[step])image, use_mask, mstep, (const uint8_t(*)[mstep])mptr
+                     , bins, (const int(*)[256])lut, parts, ways - 1, (int(*)[ways][channels * bins + 1])sub );
+    calcHist_finish( parts, ways, channels * bins, channels * bins + 1, sub, hist );
 }
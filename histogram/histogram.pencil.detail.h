@@ -0,0 +1,94 @@
+//Implementation file. Included multiple times with different HIST_* defines:
+//  HIST_NAME   name of the function
+//  HIST_TYPE   element type of the image
+//  HIST_DIMS   number of dimensions of the histogram, 1 to HISTOGRAM_MAX_DIMS
+//  HIST_FLOAT  0: bins through lut (uint8_t images), 1: through scale
+//
+// Counts the pixels of parts blocks of rows into sub histograms like
+// tile_hist, way_mask + 1 interleaved ones per block of rows. The bin of a
+// pixel is sum over d of bin(d) * stride[d], bin(d) coming from channel
+// channel[d] of the pixel: lut[d][value] already holds bin(d) * stride[d],
+// or HISTOGRAM_OUTSIDE for values outside the range; float values map to
+// floor(value * scale[d][0] + scale[d][1]). Like cv::calcHist, values whose
+// bin is not in [0, bins[d]) are skipped, without clamping the range ends.
+// With use_mask, pixels with a zero mask byte are too, counting into the
+// spare bin total instead: a random mask would mispredict a branch.
+
+static void HIST_NAME( const int rows
+                     , const int cols
+                     , const int channels
+                     , const int step
+                     , const HIST_TYPE image[static const restrict rows][step]
+                     , const int use_mask
+                     , const int mask_step
+                     , const uint8_t mask[static const restrict rows][mask_step]
+                     , const int channel[static const restrict HIST_DIMS]
+#if HIST_FLOAT
+                     , const int bins[static const restrict HIST_DIMS]
+                     , const int stride[static const restrict HIST_DIMS]
+                     , const double scale[static const restrict HIST_DIMS][2]
+#else
+                     , const int lut[static const restrict HIST_DIMS][256]
+#endif
+                     , const int total
+                     , const int parts
+                     , const int way_mask
+                     , int sub[static const restrict parts][way_mask + 1][total + 1]    //out
+                     )
+{
+#pragma scop
+    __pencil_assume(rows     >  0);
+    __pencil_assume(cols     >  0);
+    __pencil_assume(channels >  0);
+    __pencil_assume(step     >= cols * channels);
+    __pencil_assume(total    >  0);
+    __pencil_assume(parts    >  0);
+    __pencil_assume(parts    <= rows);
+    __pencil_assume(way_mask >= 0);
+
+    __pencil_kill(sub);
+
+    #pragma pencil independent
+    for(int p = 0; p < parts; ++p)
+    {
+        const int first = p * rows / parts;
+        const int last  = (p + 1) * rows / parts;
+
+        for(int w = 0; w <= way_mask; ++w)
+            for(int b = 0; b <= total; ++b)
+                sub[p][w][b] = 0;
+
+        for(int r = first; r < last; ++r)
+        {
+            for(int c = 0; c < cols; ++c)
+            {
+                int inside = 1;
+                int index  = 0;
+#if HIST_FLOAT
+                for(int d = 0; d < HIST_DIMS; ++d)
+                {
+                    const double x = image[r][c * channels + channel[d]] * scale[d][0] + scale[d][1];
+                    // floor(x) is in [0, bins[d]) exactly when x is, NaN in neither;
+                    // the skipped values are not converted
+                    const int in_range = (x >= 0) & (x < bins[d]);
+                    inside = inside & in_range;
+                    index += (in_range ? (int)x : 0) * stride[d];
+                }
+#else
+                for(int d = 0; d < HIST_DIMS; ++d)
+                    index += lut[d][image[r][c * channels + channel[d]]];
+                inside = inside & (index >= 0);
+#endif
+                if ( use_mask )
+                {
+                    // -inside is all ones for the counted pixels; a ?: compiles to a branch
+                    inside = inside & (mask[r][c] != 0);
+                    sub[p][c & way_mask][(index & -inside) | (total & (inside - 1))]++;
+                }
+                else if ( inside )
+                    sub[p][c & way_mask][index]++;
+            }
+        }
+    }
+#pragma endscop
+}
@@ -1,12 +1,26 @@
 #ifndef HISTOGRAM_PENCIL_H
 #define HISTOGRAM_PENCIL_H
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
     #define HISTOGRAM_BINS 256
 
+    // Blocks of rows with private histograms, and interleaved sub histograms
+    // within each block
+    #define HISTOGRAM_PARTS 16
+    #define HISTOGRAM_WAYS  4
+    // Histograms with more bins are not interleaved, and the private copies
+    // of all blocks hold at most HISTOGRAM_PRIVATE_COUNTERS counters
+    #define HISTOGRAM_WAYS_MAX_BINS    1024
+    #define HISTOGRAM_PRIVATE_COUNTERS (1 << 18)
+
+    #define HISTOGRAM_MAX_DIMS     3
+    #define HISTOGRAM_MAX_CHANNELS 4
+
     void pencil_calcHist( const int rows
                         , const int cols
                         , const int step
@@ -14,6 +28,57 @@ extern "C" {
                         , int hist[HISTOGRAM_BINS]    //out
                         );
 
+    // Histogram of dims of the channels interleaved in the image, like
+    // cv::calcHist with uniform ranges: dimension d has bins[d] bins over
+    // [ranges[2d], ranges[2d+1]) of channel channel[d], values whose bin
+    // falls outside are not counted. hist is dense, the last dimension
+    // varying fastest. Pixels with a zero mask byte are skipped, mask may be
+    // NULL. Steps are in elements. dims must be at most HISTOGRAM_MAX_DIMS
+    // and every channel[d] less than channels, or an assertion fails.
+    void pencil_calcHist_u8( const int rows
+                           , const int cols
+                           , const int channels
+                           , const int step
+                           , const uint8_t image[]
+                           , const int mask_step
+                           , const uint8_t mask[]
+                           , const int dims
+                           , const int channel[]
+                           , const int bins[]
+                           , const float ranges[]
+                           , int hist[]    //out
+                           );
+
+    void pencil_calcHist_f32( const int rows
+                            , const int cols
+                            , const int channels
+                            , const int step
+                            , const float image[]
+                            , const int mask_step
+                            , const uint8_t mask[]
+                            , const int dims
+                            , const int channel[]
+                            , const int bins[]
+                            , const float ranges[]
+                            , int hist[]    //out
+                            );
+
+    // The 1-D histograms of all channels in one pass, the histogram of
+    // channel k in hist[k * bins, (k + 1) * bins), for at most
+    // HISTOGRAM_MAX_CHANNELS channels
+    void pencil_calcHist_channels_u8( const int rows
+                                    , const int cols
+                                    , const int channels
+                                    , const int step
+                                    , const uint8_t image[]
+                                    , const int mask_step
+                                    , const uint8_t mask[]
+                                    , const int bins
+                                    , const float low
+                                    , const float high
+                                    , int hist[]    //out
+                                    );
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -87,6 +87,159 @@ void time_histogram( const std::vector<carp::record_t>& pool, size_t iterations)
     }
 }
 
+void time_histogram_entropy( const std::vector<carp::record_t>& pool, size_t iterations )
+{
+    std::cout << "Measuring histograms of uniform and low-entropy images" << std::endl;
+    std::cout << "        input  OpenCV (ms)  PENCIL (ms)  OpenCV (Mpix/s)  PENCIL (Mpix/s)" << std::endl;
+
+    const std::vector<const char*> inputs = { "uniform", "natural", "low entropy", "constant" };
+
+    for ( size_t input = 0; input < inputs.size(); input++ ) {
+        std::chrono::duration<double> elapsed_time_cpu(0), elapsed_time_pen(0);
+        double pixels = 0;
+
+        for ( auto & item : pool ) {
+            cv::Mat cpu_gray, cpuimg;
+            cv::cvtColor( item.cpuimg(), cpu_gray, CV_RGB2GRAY );
+            switch ( input ) {
+            case 0: // every bin equally likely
+                cpuimg.create( cpu_gray.size(), CV_8U );
+                cv::randu( cpuimg, 0, 256 );
+                break;
+            case 1:
+                cpuimg = cpu_gray;
+                break;
+            case 2: { // sky-like: one dominant value with sparse detail
+                cv::Mat noise( cpu_gray.size(), CV_8U );
+                cv::randu( noise, 0, 256 );
+                cpuimg = cv::Mat( cpu_gray.size(), CV_8U, cv::Scalar(12) );
+                cpu_gray.copyTo( cpuimg, noise < 8 );
+                break;
+            }
+            default:
+                cpuimg = cv::Mat::zeros( cpu_gray.size(), CV_8U );
+            }
+
+            cv::Mat cpu_result, pen_result( 1, HISTOGRAM_BINS, CV_32S );
+            for ( size_t i = 0; i < iterations; ++i ) {
+                {
+                    cv::Mat tmp;
+                    const int channels = 0;
+                    const int histSize = 256;
+                    const float range[] = {0, 256};
+                    const float* ranges[] = {range};
+                    const auto start = std::chrono::high_resolution_clock::now();
+                    cv::calcHist( &cpuimg, 1, &channels, cv::Mat(), tmp, 1, &histSize, ranges);
+                    const auto end = std::chrono::high_resolution_clock::now();
+                    tmp = tmp.t();
+                    tmp.convertTo(cpu_result, CV_32S);
+                    elapsed_time_cpu += end - start;
+                }
+                {
+                    const auto start = std::chrono::high_resolution_clock::now();
+                    pencil_calcHist( cpuimg.rows, cpuimg.cols, cpuimg.step1(), cpuimg.ptr<uint8_t>(), pen_result.ptr<int>() );
+                    const auto end = std::chrono::high_resolution_clock::now();
+                    elapsed_time_pen += end - start;
+                }
+                pixels += cpuimg.total();
+                if ( cv::norm(pen_result - cpu_result) > 0.01 )
+                    throw std::runtime_error("The PENCIL results are not equivalent with the CPU results.");
+            }
+        }
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << std::setw(13) << inputs[input] << " "
+                  << std::setw(12) << elapsed_time_cpu.count() * 1e3 << " " << std::setw(12) << elapsed_time_pen.count() * 1e3 << " "
+                  << std::setw(16) << pixels / elapsed_time_cpu.count() * 1e-6 << " " << std::setw(16) << pixels / elapsed_time_pen.count() * 1e-6 << std::endl;
+    }
+}
+
+// cv::calcHist with uniform ranges, as CV_32S
+static cv::Mat opencv_histogram( const cv::Mat & image, const cv::Mat & mask, const std::vector<int> & channels, const std::vector<int> & bins, const std::vector<float> & ranges )
+{
+    std::vector<const float*> range_ptrs;
+    for ( size_t d = 0; d < channels.size(); d++ )
+        range_ptrs.push_back( &ranges[2 * d] );
+    cv::Mat hist, result;
+    cv::calcHist( &image, 1, channels.data(), mask, hist, channels.size(), bins.data(), range_ptrs.data() );
+    hist.convertTo( result, CV_32S );
+    return result;
+}
+
+void time_histogram_general( const std::vector<carp::record_t>& pool, size_t iterations )
+{
+    std::cout << "Measuring multi-channel, N-dimensional, masked and float histograms" << std::endl;
+    std::cout << "            histogram  OpenCV (ms)  PENCIL (ms)" << std::endl;
+
+    const std::vector<const char*> cases = { "RGB per channel", "hue-saturation 30x32", "RGB 8x8x8", "gray 64 masked", "float 100" };
+
+    for ( size_t test = 0; test < cases.size(); test++ ) {
+        std::chrono::duration<double> elapsed_time_cpu(0), elapsed_time_pen(0);
+
+        for ( auto & item : pool ) {
+            cv::Mat cpu_rgb = item.cpuimg(), cpu_gray, cpu_hsv, cpu_float, cpu_mask;
+            cv::cvtColor( cpu_rgb, cpu_gray, CV_RGB2GRAY );
+            cv::cvtColor( cpu_rgb, cpu_hsv, CV_RGB2HSV );
+            cpu_gray.convertTo( cpu_float, CV_32F, 1.0/255. );
+            cpu_mask.create( cpu_gray.size(), CV_8U );
+            cv::randu( cpu_mask, 0, 2 );
+
+            std::vector<int> channels, bins;
+            std::vector<float> ranges;
+            const cv::Mat *image = &cpu_gray, *mask = nullptr;
+            switch ( test ) {
+            case 0: image = &cpu_rgb;   channels = { 0 };       bins = { 256 };       ranges = { 0, 256 };                 break;
+            case 1: image = &cpu_hsv;   channels = { 0, 1 };    bins = { 30, 32 };    ranges = { 0, 180, 0, 256 };         break;
+            case 2: image = &cpu_rgb;   channels = { 0, 1, 2 }; bins = { 8, 8, 8 };   ranges = { 0, 256, 0, 256, 0, 256 }; break;
+            case 3: mask = &cpu_mask;   channels = { 0 };       bins = { 64 };        ranges = { 0, 256 };                 break;
+            default: image = &cpu_float; channels = { 0 };      bins = { 100 };       ranges = { 0, 1 };
+            }
+            const int cn = image->channels();
+
+            for ( size_t i = 0; i < iterations; ++i ) {
+                cv::Mat cpu_result, pen_result;
+                {
+                    const auto start = std::chrono::high_resolution_clock::now();
+                    if ( test == 0 ) {
+                        std::vector<cv::Mat> per_channel;
+                        for ( int k = 0; k < cn; k++ )
+                            per_channel.push_back( opencv_histogram( *image, cv::Mat(), { k }, bins, ranges ).t() );
+                        cv::vconcat( per_channel, cpu_result );
+                    } else
+                        cpu_result = opencv_histogram( *image, mask ? *mask : cv::Mat(), channels, bins, ranges );
+                    const auto end = std::chrono::high_resolution_clock::now();
+                    elapsed_time_cpu += end - start;
+                }
+                {
+                    std::vector<int> sizes = bins;
+                    if ( test == 0 )
+                        sizes = { cn, bins[0] };
+                    pen_result.create( sizes.size(), sizes.data(), CV_32S );
+                    const uint8_t *mask_ptr = mask ? mask->ptr<uint8_t>() : nullptr;
+                    const int mask_step = mask ? mask->step1() : 0;
+
+                    const auto start = std::chrono::high_resolution_clock::now();
+                    if ( test == 0 )
+                        pencil_calcHist_channels_u8( image->rows, image->cols, cn, image->step1(), image->ptr<uint8_t>(), mask_step, mask_ptr
+                                                   , bins[0], ranges[0], ranges[1], pen_result.ptr<int>() );
+                    else if ( image->depth() == CV_32F )
+                        pencil_calcHist_f32( image->rows, image->cols, cn, image->step1(), image->ptr<float>(), mask_step, mask_ptr
+                                           , channels.size(), channels.data(), bins.data(), ranges.data(), pen_result.ptr<int>() );
+                    else
+                        pencil_calcHist_u8( image->rows, image->cols, cn, image->step1(), image->ptr<uint8_t>(), mask_step, mask_ptr
+                                          , channels.size(), channels.data(), bins.data(), ranges.data(), pen_result.ptr<int>() );
+                    const auto end = std::chrono::high_resolution_clock::now();
+                    elapsed_time_pen += end - start;
+                }
+                if ( cv::norm( pen_result, cpu_result, cv::NORM_INF ) > 0 )
+                    throw std::runtime_error("The PENCIL histogram is not equivalent with the OpenCV one.");
+            }
+        }
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << std::setw(21) << cases[test] << " "
+                  << std::setw(12) << elapsed_time_cpu.count() * 1e3 << " " << std::setw(12) << elapsed_time_pen.count() * 1e3 << std::endl;
+    }
+}
+
 int main(int argc, char* argv[])
 {
     prl_init((prl_init_flags)(PRL_TARGET_DEVICE_DYNAMIC | PRL_PROFILING_ENABLED));
@@ -103,6 +256,10 @@ int main(int argc, char* argv[])
 #endif
 
     time_histogram( pool, num_iterations );
+#ifndef RUN_ONLY_ONE_EXPERIMENT
+    time_histogram_entropy( pool, 10 );
+    time_histogram_general( pool, 10 );
+#endif
 
     prl_shutdown();
     return EXIT_SUCCESS;
@@ -0,0 +1,69 @@
+#ifndef BINARY_PENCIL_H
+#define BINARY_PENCIL_H
+
+/* Binary images packed 1 bit per pixel for the bitwise morphology.
+ *
+ * Each row is binary_words(cols) 64-bit words; pixel w is bit w % 64 of word
+ * w / 64, and the bits past cols in the last word are zero. Packing sets the
+ * pixels whose byte is non-zero, unpacking writes 0 and 255 (the masks
+ * produced by cv::threshold and cv::inRange).
+ *
+ * binary_pack_row() and binary_unpack_row() use AVX2 byte compares and
+ * shuffles when the compiler targets them, 32 pixels per instruction, and
+ * plain bit loops otherwise. They run on the host only: ppcg (which defines
+ * __PENCIL__) never sees the intrinsics.
+ */
+#include <stdint.h>
+#if defined(__AVX2__) && !__PENCIL__
+#define BINARY_AVX2 1
+#include <immintrin.h>
+#endif
+
+static inline int binary_words( const int cols )
+{
+    return (cols + 63) / 64;
+}
+
+static inline void binary_pack_row( const int cols, const uint8_t src[], uint64_t dst[] )
+{
+    int k = 0;
+#if BINARY_AVX2
+    const __m256i zero = _mm256_setzero_si256();
+    for ( ; 64 * k + 64 <= cols; k++ )
+    {
+        const __m256i lo = _mm256_loadu_si256((const __m256i *)(src + 64 * k));
+        const __m256i hi = _mm256_loadu_si256((const __m256i *)(src + 64 * k + 32));
+        const uint32_t zeros_lo = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, zero));
+        const uint32_t zeros_hi = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, zero));
+        dst[k] = ~((uint64_t)zeros_hi << 32 | zeros_lo);
+    }
+#endif
+    for ( ; 64 * k < cols; k++ )
+    {
+        uint64_t word = 0;
+        for ( int b = 0; b < 64 && 64 * k + b < cols; b++ )
+            word |= (uint64_t)(src[64 * k + b] != 0) << b;
+        dst[k] = word;
+    }
+}
+
+static inline void binary_unpack_row( const int cols, const uint64_t src[], uint8_t dst[] )
+{
+    int w = 0;
+#if BINARY_AVX2
+    // Byte i of a 32 pixel group tests bit i % 8 of byte i / 8
+    const __m256i spread = _mm256_setr_epi8( 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1
+                                           , 2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3 );
+    const __m256i bits = _mm256_set1_epi64x((long long)0x8040201008040201ull);
+    for ( ; w + 32 <= cols; w += 32 )
+    {
+        const uint32_t group = (uint32_t)(src[w / 64] >> (w % 64));
+        const __m256i bytes = _mm256_shuffle_epi8(_mm256_set1_epi32((int)group), spread);
+        _mm256_storeu_si256( (__m256i *)(dst + w), _mm256_cmpeq_epi8(_mm256_and_si256(bytes, bits), bits) );
+    }
+#endif
+    for ( ; w < cols; w++ )
+        dst[w] = (src[w / 64] >> (w % 64)) & 1 ? 255 : 0;
+}
+
+#endif /* BINARY_PENCIL_H */
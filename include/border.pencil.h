@@ -0,0 +1,50 @@
+#ifndef BORDER_PENCIL_H
+#define BORDER_PENCIL_H
+
+/* Border extrapolation shared by the stencil kernels.
+ *
+ * The values match cv::BORDER_* so the harnesses can pass OpenCV border
+ * types straight through. Kernels compute the interior with unclamped
+ * loops and use border_index() only for the halo around it.
+ */
+#define PENCIL_BORDER_CONSTANT    0
+#define PENCIL_BORDER_REPLICATE   1
+#define PENCIL_BORDER_WRAP        3
+#define PENCIL_BORDER_REFLECT_101 4
+
+/* Maps coordinate p (possibly outside [0, len)) into the image like
+ * cv::borderInterpolate: REFLECT_101 and WRAP fold p as many times as it
+ * takes, so halos deeper than the image extrapolate exactly. For
+ * PENCIL_BORDER_CONSTANT the index is clamped so it can always be read; use
+ * border_outside() to substitute the border value. */
+#define border_index(p, len, mode)                                                      \
+    ( ((p) >= 0 && (p) < (len)) ? (p)                                                   \
+    : ((mode) == PENCIL_BORDER_REFLECT_101) ? border_reflect_101(p, len)                \
+    : ((mode) == PENCIL_BORDER_WRAP)        ? border_wrap(p, len)                       \
+    : iclampi((p), 0, (len) - 1) )
+
+/* p modulo len, in [0, len) for negative p too. */
+#define border_wrap(p, len) ((((p) % (len)) + (len)) % (len))
+
+/* p reflected about 0 and len-1 without repeating them: the period is
+ * 2*len-2, the second half of which runs backwards. */
+#define border_reflect_101(p, len) \
+    ( (len) == 1 ? 0 : border_mirror(border_wrap(p, 2 * (len) - 2), len) )
+#define border_mirror(m, len) ((m) < (len) ? (m) : 2 * (len) - 2 - (m))
+
+/* Gathers (warpAffine, remap) saturate the integer part of their source
+ * coordinates to this range, like the 16-bit maps OpenCV interpolates
+ * through, before extrapolating it. Far points fold the same way as in
+ * OpenCV and stay clear of int overflow. */
+#define BORDER_COORD_MIN (-32768)
+#define BORDER_COORD_MAX 32767
+
+/* True if coordinate p takes the constant border value. */
+#define border_outside(p, len, mode) ((mode) == PENCIL_BORDER_CONSTANT && ((p) < 0 || (p) >= (len)))
+
+/* Reads img[row][col] of a rows x cols image, extrapolating with mode. */
+#define border_fetch(img, row, col, rows, cols, mode, value)                            \
+    ( (border_outside(row, rows, mode) || border_outside(col, cols, mode)) ? (value)    \
+    : img[border_index(row, rows, mode)][border_index(col, cols, mode)] )
+
+#endif /* BORDER_PENCIL_H */
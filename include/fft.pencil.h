@@ -0,0 +1,105 @@
+#ifndef FFT_PENCIL_H
+#define FFT_PENCIL_H
+
+/* Radix-2 complex FFT on split (re, im) arrays used by the FFT convolution
+ * engines. Host code: it is called from outside the scop regions.
+ *
+ * fft_complex_rows() transforms n points which are rows of width values each
+ * (one independent transform per column), so every butterfly is a contiguous
+ * loop over a row and vectorises whatever n is. It is unnormalised; inverse
+ * != 0 conjugates the twiddles.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+typedef struct
+{
+    int    n;
+    int   *bitrev;     // n entries
+    float *twiddle_re; // twiddles of the butterfly of span 2h start at h-1
+    float *twiddle_im;
+} fft_table;
+
+// n must be a power of two. Returns 0 on allocation failure.
+static int fft_table_init( fft_table *table, const int n )
+{
+    int log2n = 0;
+    while ( (1 << log2n) < n )
+        log2n++;
+
+    table->n          = n;
+    table->bitrev     = (int   *)malloc(sizeof(int) * n);
+    table->twiddle_re = (float *)malloc(sizeof(float) * n);
+    table->twiddle_im = (float *)malloc(sizeof(float) * n);
+    if ( !table->bitrev || !table->twiddle_re || !table->twiddle_im )
+        return 0;
+
+    for ( int i = 0; i < n; i++ )
+    {
+        int r = 0;
+        for ( int b = 0; b < log2n; b++ )
+            r |= ((i >> b) & 1) << (log2n - 1 - b);
+        table->bitrev[i] = r;
+    }
+    for ( int h = 1; h < n; h *= 2 )
+        for ( int j = 0; j < h; j++ )
+        {
+            const double angle = -3.14159265358979323846 * j / h;
+            table->twiddle_re[h - 1 + j] = (float)cos(angle);
+            table->twiddle_im[h - 1 + j] = (float)sin(angle);
+        }
+    return 1;
+}
+
+static void fft_table_free( fft_table *table )
+{
+    free(table->bitrev);
+    free(table->twiddle_re);
+    free(table->twiddle_im);
+}
+
+static void fft_complex_rows( const fft_table *table, const int width, const int stride, float re[], float im[], const int inverse )
+{
+    const int n = table->n;
+    const float sign = inverse ? -1.f : 1.f;
+
+    for ( int i = 0; i < n; i++ )
+    {
+        const int j = table->bitrev[i];
+        if ( i < j )
+        {
+            float *restrict ri = re + i * stride, *restrict rj = re + j * stride;
+            float *restrict ii = im + i * stride, *restrict ij = im + j * stride;
+            for ( int w = 0; w < width; w++ )
+            {
+                const float tr = ri[w]; ri[w] = rj[w]; rj[w] = tr;
+                const float ti = ii[w]; ii[w] = ij[w]; ij[w] = ti;
+            }
+        }
+    }
+    for ( int h = 1; h < n; h *= 2 )
+    {
+        for ( int i = 0; i < n; i += 2 * h )
+        {
+            for ( int j = 0; j < h; j++ )
+            {
+                const float wr = table->twiddle_re[h - 1 + j];
+                const float wi = table->twiddle_im[h - 1 + j] * sign;
+                float *restrict ar = re + (i + j) * stride, *restrict br = re + (i + j + h) * stride;
+                float *restrict ai = im + (i + j) * stride, *restrict bi = im + (i + j + h) * stride;
+                for ( int w = 0; w < width; w++ )
+                {
+                    const float tr = br[w] * wr - bi[w] * wi;
+                    const float ti = br[w] * wi + bi[w] * wr;
+                    br[w] = ar[w] - tr;
+                    bi[w] = ai[w] - ti;
+                    ar[w] += tr;
+                    ai[w] += ti;
+                }
+            }
+        }
+    }
+}
+
+#endif /* FFT_PENCIL_H */
@@ -0,0 +1,188 @@
+#ifndef HALF_PENCIL_H
+#define HALF_PENCIL_H
+
+/* IEEE 754 half precision storage for the float kernels.
+ *
+ * Halves are stored as their uint16_t bit patterns and all the arithmetic
+ * stays in float. half_to_float() and float_to_half() convert one element,
+ * with the F16C instructions when the compiler targets them and otherwise
+ * with branch free integer code rounding the same way (to nearest even,
+ * saturating to infinity).
+ *
+ * half_to_float_row() and float_to_half_row() convert whole rows on the
+ * host, with F16C when the compiler targets it (gcc does not vectorise the
+ * element-wise conversions by itself). half_strips() uses them to run a
+ * float stencil over a half image one cache sized strip of rows at a time.
+ *
+ * None of these are PENCIL: ppcg (which defines __PENCIL__) never sees the
+ * F16C intrinsics, and the bit casts stay out of the scops. Inside a scop,
+ * half_value() decodes with plain arithmetic instead.
+ */
+#include <stdint.h>
+#include <math.h>
+#if defined(__F16C__) && !__PENCIL__
+#define HALF_F16C 1
+#include <immintrin.h>
+#endif
+
+typedef union { uint32_t u; float f; } half_bits;
+
+static inline float half_to_float( const uint16_t h )
+{
+#if HALF_F16C
+    return _cvtsh_ss(h);
+#else
+    const half_bits denorm_magic = { 113u << 23 };
+    half_bits o, denorm;
+
+    o.u = (uint32_t)(h & 0x7fff) << 13;
+    const uint32_t exponent = o.u & 0x0f800000u;
+    o.u += (127 - 15) << 23;
+    // Denormals: renormalise through the float unit
+    denorm.u = o.u + (1u << 23);
+    denorm.f -= denorm_magic.f;
+
+    o.u = exponent == 0x0f800000u ? o.u + ((128 - 16) << 23)
+        : exponent == 0           ? denorm.u
+        : o.u;
+    o.u |= (uint32_t)(h & 0x8000) << 16;
+    return o.f;
+#endif
+}
+
+static inline uint16_t float_to_half( const float x )
+{
+#if HALF_F16C
+    return _cvtss_sh(x, _MM_FROUND_TO_NEAREST_INT);
+#else
+    const half_bits denorm_magic = { ((127 - 15) + (23 - 10) + 1) << 23 };
+    half_bits f, denorm;
+
+    f.f = x;
+    const uint32_t sign = f.u & 0x80000000u;
+    f.u ^= sign;
+    // Results below the smallest normal half: let the float adder round
+    denorm.f = f.f + denorm_magic.f;
+    const uint32_t denormal = denorm.u - denorm_magic.u;
+    const uint32_t normal   = (f.u + ((uint32_t)(15 - 127) << 23) + 0xfff + ((f.u >> 13) & 1)) >> 13;
+    const uint32_t special  = f.u > (255u << 23) ? 0x7e00 : 0x7c00;
+
+    const uint32_t o = f.u >= ((127u + 16) << 23) ? special
+                     : f.u < (113u << 23)         ? denormal
+                     : normal;
+    return (uint16_t)(o | (sign >> 16));
+#endif
+}
+
+/* Rows of the table of half_value(), one per sign and exponent. */
+#define HALF_SCALE_SIZE 64
+
+/* Fills the table of half_value(). Row h >> 10 holds the power of two that
+ * scales the significand of half h and the implicit leading one at that
+ * scale, both signed: 2^-24 and 0 for the denormals, 2^(e - 25) and 2^(e - 15)
+ * for exponent e of the normals, 0 and infinity for the rest. */
+static inline void half_scale_init( float scale[HALF_SCALE_SIZE][2] )
+{
+    for ( int h = 0; h < HALF_SCALE_SIZE; h++ )
+    {
+        const int   e    = h & 0x1f;
+        const float sign = h & 0x20 ? -1.f : 1.f;
+        scale[h][0] = e == 0x1f ? 0.f : sign * ldexpf(1.f, (e ? e : 1) - 25);
+        scale[h][1] = sign * (e == 0x1f ? INFINITY : e ? ldexpf(1.f, e - 15) : 0.f);
+    }
+}
+
+/* Half h as a float, in PENCIL arithmetic for use in the scops, with scale
+ * from half_scale_init(). Exact, except that NaNs decode to infinities. */
+#define half_value(h, scale) ( (float)((h) & 0x3ff) * (scale)[(h) >> 10][0] + (scale)[(h) >> 10][1] )
+
+static inline void half_to_float_row( const int n, const uint16_t src[], float dst[] )
+{
+    int i = 0;
+#if HALF_F16C
+    for ( ; i + 8 <= n; i += 8 )
+        _mm256_storeu_ps( dst + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(src + i))) );
+#endif
+    for ( ; i < n; i++ )
+        dst[i] = half_to_float(src[i]);
+}
+
+static inline void float_to_half_row( const int n, const float src[], uint16_t dst[] )
+{
+    int i = 0;
+#if HALF_F16C
+    for ( ; i + 8 <= n; i += 8 )
+        _mm_storeu_si128( (__m128i *)(dst + i), _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT) );
+#endif
+    for ( ; i < n; i++ )
+        dst[i] = float_to_half(src[i]);
+}
+
+#ifndef __cplusplus
+/* The strip driver is for the .pencil.c files, the conversions above are
+ * also used by the C++ harness (carp::half_mat). */
+#include <pencil.h>
+#include <assert.h>
+#include <stdlib.h>
+#include "border.pencil.h"
+
+/* Floats per strip buffer of half_strips(): the source and result strips
+ * together stay within a typical L2 cache. */
+#ifndef HALF_STRIP_PIXELS
+#define HALF_STRIP_PIXELS (1 << 17)
+#endif
+
+/* Filters rows x cols of float src into dst (both with row stride step),
+ * handling the column borders itself. */
+typedef void (*half_strip_filter)( const int rows, const int cols, const int step, const float src[], float dst[], const void *arguments );
+
+/* Runs filter over a half image strip by strip. Each strip is converted to
+ * float together with halo_top rows above and halo_bottom rows below it;
+ * rows outside the image are extrapolated with border_type, so only the
+ * strip rows of the filter output are kept and converted back. Strips are
+ * at least min_strip_rows high, for filters working on blocks of rows. */
+static inline void half_strips( const int rows, const int cols, const int step, const uint16_t src[], uint16_t dst[]
+                              , const int halo_top, const int halo_bottom, const int border_type, const float border_value
+                              , const int min_strip_rows, const half_strip_filter filter, const void *arguments
+                              )
+{
+    const int halo = halo_top + halo_bottom;
+    int strip_rows = HALF_STRIP_PIXELS / step;
+    // Keep the recomputed halo rows a small part of each strip
+    if ( strip_rows < 4 * halo )
+        strip_rows = 4 * halo;
+    if ( strip_rows < min_strip_rows )
+        strip_rows = min_strip_rows;
+    if ( strip_rows < 1 )
+        strip_rows = 1;
+    if ( strip_rows > rows )
+        strip_rows = rows;
+
+    float *in  = (float *)malloc(sizeof(float) * (strip_rows + halo) * step);
+    float *out = (float *)malloc(sizeof(float) * (strip_rows + halo) * step);
+    assert( in && out );
+
+    for ( int first = 0; first < rows; first += strip_rows )
+    {
+        const int strip = first + strip_rows <= rows ? strip_rows : rows - first;
+        for ( int q = 0; q < strip + halo; q++ )
+        {
+            const int row = first - halo_top + q;
+            if ( border_outside(row, rows, border_type) )
+            {
+                for ( int w = 0; w < cols; w++ )
+                    in[q * step + w] = border_value;
+            }
+            else
+                half_to_float_row( cols, src + border_index(row, rows, border_type) * step, in + q * step );
+        }
+        filter( strip + halo, cols, step, in, out, arguments );
+        for ( int q = 0; q < strip; q++ )
+            float_to_half_row( cols, out + (halo_top + q) * step, dst + (first + q) * step );
+    }
+    free(in);
+    free(out);
+}
+#endif /* __cplusplus */
+
+#endif /* HALF_PENCIL_H */
@@ -0,0 +1,152 @@
+//Implementation file. Included once per operation with MORPH_COLUMN_LINES
+//(function name), MORPH_TYPE (element type) and MORPH_OP (ubmax to dilate,
+//ubmin to erode) defined. MORPH_ROW_LINES, only for uint8_t elements, also
+//names the horizontal pass.
+
+#ifdef MORPH_ROW_LINES
+
+/* dst[i][w] = op src[first + i][w + offset + t] for t in [0, length), with
+ * rows and columns outside src extrapolated. steps is morph_log2(length),
+ * line holds one padded row. */
+static void MORPH_ROW_LINES( const int src_rows
+                           , const int cols
+                           , const int src_step
+                           , const uint8_t src[static const restrict src_rows][src_step]
+                           , const int first
+                           , const int count
+                           , const int length
+                           , const int offset
+                           , const int steps
+                           , const int border_type
+                           , const uint8_t border_value
+                           , uint8_t line[static const restrict cols + length - 1]
+                           , const int dst_step
+                           , uint8_t dst[static const restrict count][dst_step]
+                           )
+{
+#pragma scop
+    __pencil_assume(src_rows >  0);
+    __pencil_assume(cols     >  0);
+    __pencil_assume(src_step >= cols);
+    __pencil_assume(dst_step >= cols);
+    __pencil_assume(count    >  0);
+    __pencil_assume(length   >  0);
+    __pencil_assume(steps    >= 0);
+
+    __pencil_kill(dst);
+    {
+        const int padded = cols + length - 1;
+        // Padded columns [left, right) are inside the image
+        const int left  = iclampi(-offset, 0, padded);
+        const int right = iclampi(cols - offset, left, padded);
+        const int span  = 1 << steps;
+
+        // One line buffer: the rows are processed in turn
+        for ( int i = 0; i < count; i++ )
+        {
+            const int q = border_index(first + i, src_rows, border_type);
+            if ( border_outside(first + i, src_rows, border_type) )
+            {
+                #pragma pencil independent
+                for ( int w = 0; w < cols; w++ )
+                    dst[i][w] = border_value;
+            }
+            else
+            {
+                #pragma pencil independent
+                for ( int j = left; j < right; j++ )
+                    line[j] = src[q][j + offset];
+                #pragma pencil independent
+                for ( int k = 0; k < left + padded - right; k++ )
+                {
+                    const int j = k < left ? k : right + k - left;
+                    line[j] = border_fetch(src, q, j + offset, src_rows, cols, border_type, border_value);
+                }
+
+                // line[j] becomes the op of the 2^s pixels from j
+                for ( int s = 0; s < steps; s++ )
+                {
+                    for ( int j = 0; j < padded - (1 << s); j++ )
+                        line[j] = MORPH_OP(line[j], line[j + (1 << s)]);
+                }
+                #pragma pencil independent
+                for ( int w = 0; w < cols; w++ )
+                    dst[i][w] = MORPH_OP(line[w], line[w + length - span]);
+            }
+        }
+    }
+    __pencil_kill(line);
+#pragma endscop
+}
+#endif
+
+/* dst[i][w] = op src[i + t][w] for t in [0, length), or the op of that and
+ * dst[i][w] if accumulate != 0. blocks is scratch for the block prefixes of
+ * van Herk/Gil-Werman, suffix holds one row. */
+static void MORPH_COLUMN_LINES( const int rows
+                              , const int cols
+                              , const int length
+                              , const int src_step
+                              , const MORPH_TYPE src[static const restrict rows + length - 1][src_step]
+                              , const int accumulate
+                              , MORPH_TYPE blocks[static const restrict rows + length - 1][cols]
+                              , MORPH_TYPE suffix[static const restrict cols]
+                              , const int dst_step
+                              , MORPH_TYPE dst[static const restrict rows][dst_step]
+                              )
+{
+#pragma scop
+    __pencil_assume(rows     >  0);
+    __pencil_assume(cols     >  0);
+    __pencil_assume(src_step >= cols);
+    __pencil_assume(dst_step >= cols);
+    __pencil_assume(length   >  0);
+
+    if ( length < MORPH_VHGW_MIN_LENGTH )
+    {
+        #pragma pencil independent
+        for ( int i = 0; i < rows; i++ )
+        {
+            for ( int t = 0; t < length; t++ )
+            {
+                const int first = t == 0 && !accumulate;
+                #pragma pencil independent
+                for ( int w = 0; w < cols; w++ )
+                    dst[i][w] = first ? src[i + t][w] : MORPH_OP(dst[i][w], src[i + t][w]);
+            }
+        }
+    }
+    else
+    {
+        // Blocks of length rows start at source row 0
+        const int padded = rows + length - 1;
+
+        for ( int j = 0; j < padded; j++ )
+        {
+            const int start = j % length == 0;
+            #pragma pencil independent
+            for ( int w = 0; w < cols; w++ )
+                blocks[j][w] = start ? src[j][w] : MORPH_OP(blocks[imax(j - 1, 0)][w], src[j][w]);
+        }
+        // Window [i, i + length) = suffix of the block of i + prefix of the block of i + length - 1
+        for ( int j = padded - 1; j >= 0; j-- )
+        {
+            const int end = j % length == length - 1 || j == padded - 1;
+            #pragma pencil independent
+            for ( int w = 0; w < cols; w++ )
+                suffix[w] = end ? src[j][w] : MORPH_OP(suffix[w], src[j][w]);
+            if ( j < rows )
+            {
+                #pragma pencil independent
+                for ( int w = 0; w < cols; w++ )
+                {
+                    const MORPH_TYPE value = MORPH_OP(suffix[w], blocks[j + length - 1][w]);
+                    dst[j][w] = accumulate ? MORPH_OP(dst[j][w], value) : value;
+                }
+            }
+        }
+    }
+    __pencil_kill(blocks);
+    __pencil_kill(suffix);
+#pragma endscop
+}
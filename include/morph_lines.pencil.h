@@ -0,0 +1,374 @@
+#ifndef MORPH_LINES_PENCIL_H
+#define MORPH_LINES_PENCIL_H
+
+/* Line based grey-level erosion and dilation for arbitrary structuring
+ * elements.
+ *
+ * The structuring element is split exactly into rectangles: every row of the
+ * element is a set of runs, and rows with the same run form a band. Dilating
+ * by a rectangle is a horizontal line pass followed by a vertical one, and
+ * dilating by the union of the rectangles is the max of those dilations
+ * (erosion: min). A rectangle is one band, a cross three (two after merging,
+ * see below) and an ellipse about one band per distinct row width.
+ *
+ * Line passes cost almost nothing per extra pixel of length:
+ *  - vertical lines use the van Herk/Gil-Werman running max: block prefix and
+ *    suffix maxima, 3 comparisons per pixel whatever the length, vectorised
+ *    across the row. Short lines use one comparison per tap, which is cheaper
+ *    below MORPH_VHGW_MIN_LENGTH.
+ *  - horizontal lines use a log-step running max (lengths 1, 2, 4, ... then
+ *    one overlapping pair). The van Herk/Gil-Werman recurrences run along the
+ *    row and do not vectorise, log2(length)+1 vector passes are faster up to
+ *    very long lines.
+ *
+ * morph_stage() computes a strip of output rows. The horizontal passes write
+ * the rows the strip needs, extrapolated, into a strip buffer, so the vertical
+ * passes never see a border. Borders are exact: every PENCIL_BORDER_*
+ * extrapolates rows and columns independently, and a constant border row
+ * stays border_value through a line pass.
+ *
+ * Only for inclusion from .pencil.c files. Everything below the line passes
+ * is host code driving them.
+ */
+#include <pencil.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "border.pencil.h"
+
+/* Vertical lines from this length on use van Herk/Gil-Werman. */
+#ifndef MORPH_VHGW_MIN_LENGTH
+#define MORPH_VHGW_MIN_LENGTH 12
+#endif
+
+/* Bytes per horizontal strip buffer of morph_stage(), so the strip stays
+ * within a typical L2 cache between the line passes. */
+#ifndef MORPH_STRIP_PIXELS
+#define MORPH_STRIP_PIXELS (1 << 18)
+#endif
+
+/* floor(log2(length)) */
+static int morph_log2( const int length )
+{
+    int steps = 0;
+    while ( (2 << steps) <= length )
+        steps++;
+    return steps;
+}
+
+#define MORPH_ROW_LINES    morph_dilate_row_lines
+#define MORPH_COLUMN_LINES morph_dilate_column_lines
+#define MORPH_TYPE         uint8_t
+#define MORPH_OP           ubmax
+#include "morph_lines.pencil.detail.h"
+#undef MORPH_ROW_LINES
+#undef MORPH_COLUMN_LINES
+#undef MORPH_TYPE
+#undef MORPH_OP
+
+#define MORPH_ROW_LINES    morph_erode_row_lines
+#define MORPH_COLUMN_LINES morph_erode_column_lines
+#define MORPH_TYPE         uint8_t
+#define MORPH_OP           ubmin
+#include "morph_lines.pencil.detail.h"
+#undef MORPH_ROW_LINES
+#undef MORPH_COLUMN_LINES
+#undef MORPH_TYPE
+#undef MORPH_OP
+
+/* Rows [row, row + rows) x columns [col, col + cols) of the structuring element */
+typedef struct
+{
+    int row, rows;
+    int col, cols;
+} morph_rect;
+
+typedef struct
+{
+    int         count;
+    morph_rect *rects;  // sorted by column run, so rectangles share horizontal passes
+    int         taps;   // non-zero elements, the cost of the direct kernel
+    int         cost;   // estimated cost of the line passes in the same unit
+    int         max_length;
+    int         se_rows;
+    int         anchor_row;
+    int         anchor_col;
+} morph_plan;
+
+static int morph_column_cost( const int length )
+{
+    return length < MORPH_VHGW_MIN_LENGTH ? length : MORPH_VHGW_MIN_LENGTH;
+}
+
+static int morph_row_cost( const int length, const int offset )
+{
+    // A one pixel run at the anchor column reads the source as is
+    return length == 1 && offset == 0 ? 0 : morph_log2(length) + 1;
+}
+
+static int morph_run_contained( const int se_step, const uint8_t se[], const int row, const int col, const int cols )
+{
+    for ( int r = col; r < col + cols; r++ )
+        if ( se[row * se_step + r] == 0 )
+            return 0;
+    return 1;
+}
+
+/* Splits the structuring element into rectangles. Returns 0 on allocation
+ * failure. */
+static int morph_plan_init( morph_plan *plan
+                          , const int se_rows
+                          , const int se_cols
+                          , const int se_step
+                          , const uint8_t se[]
+                          , const int anchor_row
+                          , const int anchor_col
+                          )
+{
+    plan->count = 0;
+    plan->taps  = 0;
+    plan->cost  = 0;
+    plan->max_length = 1;
+    plan->se_rows    = se_rows;
+    plan->anchor_row = anchor_row;
+    plan->anchor_col = anchor_col;
+    plan->rects = (morph_rect *)malloc(sizeof(morph_rect) * se_rows * ((se_cols + 1) / 2));
+    if ( !plan->rects )
+        return 0;
+
+    // Bands: a run extends the band of the same run in the row above
+    int open = 0;
+    for ( int e = 0; e < se_rows; e++ )
+    {
+        const int previous = open;
+        open = plan->count;
+        for ( int r = 0; r < se_cols; )
+        {
+            if ( se[e * se_step + r] == 0 )
+            {
+                r++;
+                continue;
+            }
+            int end = r;
+            while ( end < se_cols && se[e * se_step + end] != 0 )
+                end++;
+            plan->taps += end - r;
+
+            int band = -1;
+            for ( int i = previous; i < open; i++ )
+                if ( plan->rects[i].col == r && plan->rects[i].cols == end - r && plan->rects[i].row + plan->rects[i].rows == e )
+                    band = i;
+            if ( band >= 0 )
+            {
+                // Keep the bands still growing at the end of the list
+                const morph_rect grown = { plan->rects[band].row, plan->rects[band].rows + 1, r, end - r };
+                for ( int i = band; i + 1 < plan->count; i++ )
+                    plan->rects[i] = plan->rects[i + 1];
+                plan->rects[plan->count - 1] = grown;
+                open--;
+            }
+            else
+            {
+                const morph_rect created = { e, 1, r, end - r };
+                plan->rects[plan->count++] = created;
+            }
+            r = end;
+        }
+    }
+
+    // Merge bands of one run across the rows between them if they contain
+    // the run too and one longer vertical line is cheaper than two
+    for ( int a = 0; a < plan->count; a++ )
+    {
+        for ( int b = 0; b < plan->count; b++ )
+        {
+            morph_rect *upper = &plan->rects[a], *lower = &plan->rects[b];
+            if ( a == b || upper->rows == 0 || lower->rows == 0 )
+                continue;
+            if ( upper->col != lower->col || upper->cols != lower->cols || lower->row < upper->row + upper->rows )
+                continue;
+            const int rows = lower->row + lower->rows - upper->row;
+            if ( morph_column_cost(rows) >= morph_column_cost(upper->rows) + morph_column_cost(lower->rows) )
+                continue;
+            int contained = 1;
+            for ( int e = upper->row + upper->rows; e < lower->row && contained; e++ )
+                contained = morph_run_contained(se_step, se, e, upper->col, upper->cols);
+            if ( !contained )
+                continue;
+            upper->rows = rows;
+            lower->rows = 0;
+            b = -1;
+        }
+    }
+    int merged = 0;
+    for ( int i = 0; i < plan->count; i++ )
+        if ( plan->rects[i].rows > 0 )
+            plan->rects[merged++] = plan->rects[i];
+    plan->count = merged;
+
+    // Group the rectangles of one run
+    for ( int i = 1; i < plan->count; i++ )
+    {
+        const morph_rect rect = plan->rects[i];
+        int j = i;
+        for ( ; j > 0 && ( plan->rects[j - 1].col > rect.col || (plan->rects[j - 1].col == rect.col && plan->rects[j - 1].cols > rect.cols) ); j-- )
+            plan->rects[j] = plan->rects[j - 1];
+        plan->rects[j] = rect;
+    }
+
+    for ( int i = 0; i < plan->count; i++ )
+    {
+        const morph_rect *rect = &plan->rects[i];
+        if ( i == 0 || rect->col != rect[-1].col || rect->cols != rect[-1].cols )
+            plan->cost += morph_row_cost(rect->cols, rect->col - anchor_col);
+        plan->cost += morph_column_cost(rect->rows);
+        plan->max_length = imax(plan->max_length, imax(rect->rows, rect->cols));
+    }
+    return 1;
+}
+
+static void morph_plan_free( morph_plan *plan )
+{
+    free(plan->rects);
+}
+
+typedef struct
+{
+    int      strip_rows;  // most output rows of one morph_stage() call
+    uint8_t *horizontal;  // (strip_rows + se_rows - 1) x cols
+    uint8_t *blocks;      // (strip_rows + max_length - 1) x cols
+    uint8_t *line;        // cols + max_length - 1
+} morph_scratch;
+
+/* Returns 0 on allocation failure. */
+static int morph_scratch_init( morph_scratch *scratch, const morph_plan *plan, const int strip_rows, const int cols )
+{
+    scratch->strip_rows = strip_rows;
+    scratch->horizontal = (uint8_t *)malloc(sizeof(uint8_t) * (strip_rows + plan->se_rows - 1) * cols);
+    scratch->blocks     = (uint8_t *)malloc(sizeof(uint8_t) * (strip_rows + plan->max_length - 1) * cols);
+    scratch->line       = (uint8_t *)malloc(sizeof(uint8_t) * (cols + plan->max_length - 1));
+    return scratch->horizontal && scratch->blocks && scratch->line;
+}
+
+static void morph_scratch_free( morph_scratch *scratch )
+{
+    free(scratch->horizontal);
+    free(scratch->blocks);
+    free(scratch->line);
+}
+
+/* Output rows per strip: the strip buffers stay cache sized, and the rows
+ * recomputed around each strip a small part of it. */
+static int morph_strip_rows( const morph_plan *plan, const int rows, const int cols )
+{
+    int strip_rows = MORPH_STRIP_PIXELS / cols;
+    if ( strip_rows < 4 * plan->se_rows )
+        strip_rows = 4 * plan->se_rows;
+    if ( strip_rows > rows )
+        strip_rows = rows;
+    return strip_rows;
+}
+
+/* Writes rows [first, first + count) of the erosion (erode != 0) or dilation
+ * of src to dst. count must be at most scratch->strip_rows and the plan must
+ * have at least one rectangle. */
+static void morph_stage( const morph_plan *plan
+                       , const int erode
+                       , const int src_rows
+                       , const int cols
+                       , const int src_step
+                       , const uint8_t src[]
+                       , const int first
+                       , const int count
+                       , const int border_type
+                       , const uint8_t border_value
+                       , morph_scratch *scratch
+                       , const int dst_step
+                       , uint8_t dst[]
+                       )
+{
+    // Row k of the horizontal strip is source row base + k
+    const int base = first - plan->anchor_row;
+
+    for ( int i = 0; i < plan->count; )
+    {
+        const morph_rect *run = &plan->rects[i];
+        const int offset = run->col - plan->anchor_col;
+        int end = i + 1, top = run->row, bottom = run->row + run->rows;
+        for ( ; end < plan->count && plan->rects[end].col == run->col && plan->rects[end].cols == run->cols; end++ )
+        {
+            top    = imin(top, plan->rects[end].row);
+            bottom = imax(bottom, plan->rects[end].row + plan->rects[end].rows);
+        }
+        // Rows [top, bottom - 1 + count) of the strip are read
+        const int needed = bottom - 1 + count - top;
+
+        // A one pixel run at the anchor column is the source itself, unless
+        // the rows need extrapolating
+        const int direct = run->cols == 1 && offset == 0 && base + top >= 0 && base + top + needed <= src_rows;
+        if ( !direct )
+        {
+            if ( erode )
+                morph_erode_row_lines( src_rows, cols, src_step, (const uint8_t(*)[src_step])src
+                                     , base + top, needed, run->cols, offset, morph_log2(run->cols)
+                                     , border_type, border_value, scratch->line
+                                     , cols, (uint8_t(*)[cols])(scratch->horizontal + top * cols)
+                                     );
+            else
+                morph_dilate_row_lines( src_rows, cols, src_step, (const uint8_t(*)[src_step])src
+                                      , base + top, needed, run->cols, offset, morph_log2(run->cols)
+                                      , border_type, border_value, scratch->line
+                                      , cols, (uint8_t(*)[cols])(scratch->horizontal + top * cols)
+                                      );
+        }
+
+        for ( ; i < end; i++ )
+        {
+            const morph_rect *rect = &plan->rects[i];
+            const int lines_step = direct ? src_step : cols;
+            const uint8_t *lines = direct ? src + (base + rect->row) * src_step : scratch->horizontal + rect->row * cols;
+            if ( erode )
+                morph_erode_column_lines( count, cols, rect->rows, lines_step, (const uint8_t(*)[lines_step])lines
+                                        , i > 0, (uint8_t(*)[cols])scratch->blocks, scratch->line
+                                        , dst_step, (uint8_t(*)[dst_step])dst
+                                        );
+            else
+                morph_dilate_column_lines( count, cols, rect->rows, lines_step, (const uint8_t(*)[lines_step])lines
+                                         , i > 0, (uint8_t(*)[cols])scratch->blocks, scratch->line
+                                         , dst_step, (uint8_t(*)[dst_step])dst
+                                         );
+        }
+    }
+}
+
+/* Erodes (erode != 0) or dilates the whole of src strip by strip. The plan
+ * must have at least one rectangle. Returns 0 on allocation failure. */
+static int morph_apply( const morph_plan *plan
+                      , const int erode
+                      , const int rows
+                      , const int cols
+                      , const int src_step
+                      , const uint8_t src[]
+                      , const int dst_step
+                      , uint8_t dst[]
+                      , const int border_type
+                      , const uint8_t border_value
+                      )
+{
+    morph_scratch scratch;
+    if ( !morph_scratch_init(&scratch, plan, morph_strip_rows(plan, rows, cols), cols) )
+    {
+        morph_scratch_free(&scratch);
+        return 0;
+    }
+    for ( int first = 0; first < rows; first += scratch.strip_rows )
+    {
+        const int count = imin(scratch.strip_rows, rows - first);
+        morph_stage( plan, erode, rows, cols, src_step, src, first, count
+                   , border_type, border_value, &scratch, dst_step, dst + first * dst_step
+                   );
+    }
+    morph_scratch_free(&scratch);
+    return 1;
+}
+
+#endif /* MORPH_LINES_PENCIL_H */
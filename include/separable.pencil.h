@@ -0,0 +1,127 @@
+#ifndef SEPARABLE_PENCIL_H
+#define SEPARABLE_PENCIL_H
+
+/* Two-pass separable filter shared by the kernels which convolve with a
+ * row kernel followed by a column kernel (gaussian, filter2D).
+ *
+ * Only for inclusion from .pencil.c files. border_valueX pads the source
+ * for the horizontal pass, border_valueY pads the intermediate image for
+ * the vertical one (border_valueX * sum(kernelX) for PENCIL_BORDER_CONSTANT).
+ *
+ * cols counts pixels of channels interleaved elements each. The horizontal
+ * taps step over whole pixels; the vertical pass does not see the channels
+ * and runs over cols * channels elements.
+ */
+#include <pencil.h>
+#include <stdlib.h>
+#include "border.pencil.h"
+
+static void separable_filter( const int rows
+                            , const int cols
+                            , const int channels
+                            , const int step
+                            , const float src[static const restrict rows][step]
+                            , const int kernelX_length
+                            , const float kernelX[static const restrict kernelX_length]
+                            , const int kernelY_length
+                            , const float kernelY[static const restrict kernelY_length]
+                            , const int border_type
+                            , const float border_valueX
+                            , const float border_valueY
+                            , float conv[static const restrict rows][step]
+                            )
+{
+#pragma scop
+    __pencil_assume(rows         >  0);
+    __pencil_assume(cols         >  0);
+    __pencil_assume(channels     >  0);
+    __pencil_assume(step         >= cols * channels);
+    __pencil_assume(kernelX_length >  0);
+    __pencil_assume(kernelX_length <= 64);
+    __pencil_assume(kernelY_length >  0);
+    __pencil_assume(kernelY_length <= 64);
+    
+    __pencil_kill(conv);
+    {
+#if __PENCIL__
+        float temp[rows][step];
+#else
+        float (*temp)[step] = (float (*)[step])malloc(sizeof(float)*rows*step);
+#endif
+        const int halfX  = kernelX_length / 2;
+        const int halfY  = kernelY_length / 2;
+        const int left   = imin(halfX, cols);
+        const int right  = imax(cols - (kernelX_length - 1 - halfX), left);
+        const int top    = imin(halfY, rows);
+        const int bottom = imax(rows - (kernelY_length - 1 - halfY), top);
+
+        #pragma pencil independent
+        for ( int q = 0; q < rows; q++ )
+        {
+            // Accumulating tap by tap keeps the innermost loop contiguous over w
+            #pragma pencil independent
+            for ( int w = left * channels; w < right * channels; w++ )
+                temp[q][w] = src[q][w - halfX * channels] * kernelX[0];
+            for ( int r = 1; r < kernelX_length; r++ )
+            {
+                #pragma pencil independent
+                for ( int w = left * channels; w < right * channels; w++ )
+                    temp[q][w] += src[q][w + (r - halfX) * channels] * kernelX[r];
+            }
+            #pragma pencil independent
+            for ( int i = 0; i < (left + cols - right) * channels; i++ )
+            {
+                const int x = i / channels;
+                const int w = (x < left) ? x : right + x - left;
+                const int c = i % channels;
+                float prod1 = 0.;
+                #pragma pencil independent reduction (+: prod1);
+                for ( int r = 0; r < kernelX_length; r++ )
+                {
+                    const int p = w + r - halfX;
+                    prod1 += (border_outside(p, cols, border_type) ? border_valueX : src[q][border_index(p, cols, border_type) * channels + c]) * kernelX[r];
+                }
+                temp[q][w * channels + c] = prod1;
+            }
+        }
+        #pragma pencil independent
+        for ( int q = 0; q < rows; q++ )
+        {
+            if ( q >= top && q < bottom )
+            {
+                #pragma pencil independent
+                for ( int w = 0; w < cols * channels; w++ )
+                    conv[q][w] = temp[q - halfY][w] * kernelY[0];
+                for ( int e = 1; e < kernelY_length; e++ )
+                {
+                    #pragma pencil independent
+                    for ( int w = 0; w < cols * channels; w++ )
+                        conv[q][w] += temp[q + e - halfY][w] * kernelY[e];
+                }
+            }
+            else
+            {
+                // Extrapolate the row index once per tap, not per pixel
+                #pragma pencil independent
+                for ( int w = 0; w < cols * channels; w++ )
+                    conv[q][w] = 0.;
+                for ( int e = 0; e < kernelY_length; e++ )
+                {
+                    const int p = q + e - halfY;
+                    const int row = border_index(p, rows, border_type);
+                    const int outside = border_outside(p, rows, border_type);
+                    #pragma pencil independent
+                    for ( int w = 0; w < cols * channels; w++ )
+                        conv[q][w] += (outside ? border_valueY : temp[row][w]) * kernelY[e];
+                }
+            }
+        }
+#if !__PENCIL__
+        free(temp);
+#endif
+    }
+    __pencil_kill(src);
+#pragma endscop
+}
+
+#endif /* SEPARABLE_PENCIL_H */
@@ -0,0 +1,95 @@
+#ifndef TILE_HIST_PENCIL_H
+#define TILE_HIST_PENCIL_H
+
+/* 256 bin histograms of a grid of tiles of an 8-bit image, in one pass.
+ *
+ * Each tile counts into TILE_HIST_WAYS sub histograms interleaved over the
+ * columns, so runs of equal pixels increment different counters instead of
+ * waiting on one, and the tiles are independent: parallel targets give each
+ * its own histogram instead of contending on atomics. A grid of one column
+ * of row blocks is the privatised histogram of the whole image.
+ *
+ * Tiles are tile_rows x tile_cols. Tiles reaching past the image are clipped
+ * to it for PENCIL_BORDER_CONSTANT and count extrapolated pixels otherwise,
+ * like a histogram of the image padded by cv::copyMakeBorder.
+ *
+ * Only for inclusion from .pencil.c files.
+ */
+#include <pencil.h>
+#include <stdint.h>
+#include "border.pencil.h"
+
+#define TILE_HIST_BINS 256
+#define TILE_HIST_WAYS 4    // the unrolled loop of tile_hist assumes 4
+
+/* hist[ty][tx] = histogram of tile (ty, tx), through the sub histograms in
+ * sub. */
+static void tile_hist( const int rows
+                     , const int cols
+                     , const int step
+                     , const uint8_t image[static const restrict rows][step]
+                     , const int tiles_y
+                     , const int tiles_x
+                     , const int tile_rows
+                     , const int tile_cols
+                     , const int border_type
+                     , int sub[static const restrict tiles_y][tiles_x][TILE_HIST_WAYS][TILE_HIST_BINS]
+                     , int hist[static const restrict tiles_y][tiles_x][TILE_HIST_BINS]    //out
+                     )
+{
+#pragma scop
+    __pencil_assume(rows      >  0);
+    __pencil_assume(cols      >  0);
+    __pencil_assume(step      >= cols);
+    __pencil_assume(tiles_y   >  0);
+    __pencil_assume(tiles_x   >  0);
+    __pencil_assume(tile_rows >  0);
+    __pencil_assume(tile_cols >  0);
+
+    __pencil_kill(sub);
+    __pencil_kill(hist);
+
+    #pragma pencil independent
+    for(int ty = 0; ty < tiles_y; ++ty)
+    {
+        #pragma pencil independent
+        for(int tx = 0; tx < tiles_x; ++tx)
+        {
+            const int clip  = border_type == PENCIL_BORDER_CONSTANT;
+            const int first = ty * tile_rows;
+            const int last  = clip ? imin(first + tile_rows, rows) : first + tile_rows;
+            const int left  = tx * tile_cols;
+            // Columns [left, inner) are in the image, [inner, right) extrapolated
+            const int inner = imin(left + tile_cols, cols);
+            const int right = clip ? inner : left + tile_cols;
+
+            for(int w = 0; w < TILE_HIST_WAYS; ++w)
+                for(int b = 0; b < TILE_HIST_BINS; ++b)
+                    sub[ty][tx][w][b] = 0;
+
+            for(int r = first; r < last; ++r)
+            {
+                const int q = border_index(r, rows, border_type);
+                int c = left;
+                for(; c + TILE_HIST_WAYS <= inner; c += TILE_HIST_WAYS)
+                {
+                    sub[ty][tx][0][image[q][c    ]]++;
+                    sub[ty][tx][1][image[q][c + 1]]++;
+                    sub[ty][tx][2][image[q][c + 2]]++;
+                    sub[ty][tx][3][image[q][c + 3]]++;
+                }
+                for(; c < inner; ++c)
+                    sub[ty][tx][c % TILE_HIST_WAYS][image[q][c]]++;
+                for(; c < right; ++c)
+                    sub[ty][tx][c % TILE_HIST_WAYS][image[q][border_index(c, cols, border_type)]]++;
+            }
+
+            #pragma pencil independent
+            for(int b = 0; b < TILE_HIST_BINS; ++b)
+                hist[ty][tx][b] = sub[ty][tx][0][b] + sub[ty][tx][1][b] + sub[ty][tx][2][b] + sub[ty][tx][3][b];
+        }
+    }
+#pragma endscop
+}
+
+#endif /* TILE_HIST_PENCIL_H */
@@ -12,7 +12,13 @@
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
 #include <stdexcept>
+#include <vector>
+
+#include <prl.h>
+
+#include "half.pencil.h"
 
 namespace carp {
 
@@ -64,6 +70,198 @@ public:
 };
 
 
+// Single channel image of IEEE half floats for the *_f16 kernels (OpenCV 2.4
+// has no half type). Rows are packed: step1() == cols().
+class half_mat {
+private:
+    int m_rows, m_cols;
+    std::vector<uint16_t> m_data;
+
+public:
+    half_mat( int rows, int cols ) : m_rows(rows), m_cols(cols), m_data(rows * cols) { }
+
+    // Rounds a CV_32F image to half precision
+    explicit half_mat( const cv::Mat & image ) : m_rows(image.rows), m_cols(image.cols), m_data(image.rows * image.cols)
+    {
+        if ( image.type() != CV_32F )
+            throw std::runtime_error("half_mat can only be built from CV_32F images.");
+        for ( int q = 0; q < m_rows; q++ )
+            float_to_half_row( m_cols, image.ptr<float>(q), ptr() + q * m_cols );
+    }
+
+    // Widens back to a CV_32F image
+    cv::Mat to_mat() const {
+        cv::Mat image( m_rows, m_cols, CV_32F );
+        for ( int q = 0; q < m_rows; q++ )
+            half_to_float_row( m_cols, ptr() + q * m_cols, image.ptr<float>(q) );
+        return image;
+    }
+
+    int rows() const { return m_rows; }
+    int cols() const { return m_cols; }
+    int step1() const { return m_cols; }
+    size_t total() const { return m_data.size(); }
+
+    uint16_t * ptr() { return m_data.data(); }
+    const uint16_t * ptr() const { return m_data.data(); }
+};
+
+// The border modes the *_borders sweeps compare against OpenCV
+const std::vector<std::pair<const char*, int>> border_modes = { {"CONSTANT"   , cv::BORDER_CONSTANT   }
+                                                              , {"REPLICATE"  , cv::BORDER_REPLICATE  }
+                                                              , {"REFLECT_101", cv::BORDER_REFLECT_101}
+                                                              , {"WRAP"       , cv::BORDER_WRAP       }
+                                                              };
+
+// OpenCV filters do not support BORDER_WRAP: runs filter( padded, result )
+// on src padded periodically by halo pixels on every side and crops the
+// result back to the size of src.
+template <class Filter>
+cv::Mat wrap_filter( const cv::Mat & src, int halo, Filter filter )
+{
+    cv::Mat padded, result;
+    cv::copyMakeBorder( src, padded, halo, halo, halo, halo, cv::BORDER_WRAP );
+    filter( padded, result );
+    return result( cv::Rect(halo, halo, src.cols, src.rows) ).clone();
+}
+
+// Compares pencil( src, size, border ) against reference( src, size, border )
+// for every size (labelled size_name) and border mode, each returning its
+// result. src is the gray version of every image of the pool (scaled to
+// [0, 1] for CV_32F depth), timed, and then a crop of it smaller than size,
+// whose halo folds over the image several times. Throws if the results
+// differ by more than tolerance.
+template <class Reference, class Pencil>
+void time_borders( const std::vector<record_t>& pool, const std::string & name, const std::string & size_name, const std::vector<int>& sizes
+                 , int depth, double tolerance, Reference reference, Pencil pencil )
+{
+    std::cout << "Measuring " << name << " border modes" << std::endl;
+    std::cout << "     border " << std::setw(6) << size_name << "  OpenCV (ms)  PENCIL (ms)  max error" << std::endl;
+
+    for ( auto & size : sizes ) {
+        for ( auto & border : border_modes ) {
+            std::chrono::duration<double,std::milli> elapsed_time_cpu(0), elapsed_time_pen(0);
+            double max_error = 0;
+
+            for ( auto & item : pool ) {
+                cv::Mat cpu_gray;
+                cv::cvtColor( item.cpuimg(), cpu_gray, CV_RGB2GRAY );
+                if ( depth == CV_32F )
+                    cpu_gray.convertTo( cpu_gray, CV_32F, 1.0/255. );
+
+                cv::Mat cpu_result, pen_result;
+                {
+                    const auto cpu_start = std::chrono::high_resolution_clock::now();
+                    cpu_result = reference( cpu_gray, size, border.second );
+                    const auto cpu_end = std::chrono::high_resolution_clock::now();
+                    elapsed_time_cpu += cpu_end - cpu_start;
+                }
+                {
+                    const auto pen_start = std::chrono::high_resolution_clock::now();
+                    pen_result = pencil( cpu_gray, size, border.second );
+                    const auto pen_end = std::chrono::high_resolution_clock::now();
+                    elapsed_time_pen += pen_end - pen_start;
+                }
+                max_error = std::max( max_error, cv::norm(cpu_result, pen_result, cv::NORM_INF) );
+
+                const cv::Mat crop = cpu_gray( cv::Rect(0, 0, std::max(2, size / 3), std::max(1, size / 4)) ).clone();
+                max_error = std::max( max_error, cv::norm(reference(crop, size, border.second), pencil(crop, size, border.second), cv::NORM_INF) );
+            }
+            std::cout << std::fixed << std::setprecision(3);
+            std::cout << std::setw(11) << border.first << " " << std::setw(6) << size << " "
+                      << std::setw(12) << elapsed_time_cpu.count() << " " << std::setw(12) << elapsed_time_pen.count() << " "
+                      << std::setw(10) << max_error << std::endl;
+
+            if ( max_error > tolerance )
+                throw std::runtime_error("The PENCIL results are not equivalent with the C++ results.");
+        }
+    }
+}
+
+// Times cpu, gpu and pencil on the gray version of every image of the pool
+// with an elliptic structuring element of every size centred on its anchor,
+// iteration times over. Each is called as f( gray, structuring_element,
+// anchor ) and returns its result; gpu includes its copies to the device and
+// back. The first gpu and pencil calls compile their kernels and are not
+// timed. Writes the three results as <name>_*.png and throws if they differ.
+template <class CPU, class GPU, class Pencil>
+void time_morphology( const std::vector<record_t>& pool, const std::string & name, const std::vector<int>& elemsizes, int iteration
+                    , CPU cpu, GPU gpu, Pencil pencil )
+{
+    bool first_execution_opencv = true, first_execution_pencil = true;
+
+    Timing timing(name);
+
+    for ( int q=0; q<iteration; q++ ) {
+        for ( auto & item : pool ) {
+            for ( auto & elemsize : elemsizes ) {
+                // acquiring the image for the test
+                cv::Mat cpu_gray;
+                cv::cvtColor( item.cpuimg(), cpu_gray, CV_RGB2GRAY );
+
+                cv::Point anchor( elemsize/2, elemsize/2 );
+                cv::Size ksize(elemsize, elemsize);
+                cv::Mat structuring_element = cv::getStructuringElement( cv::MORPH_ELLIPSE, ksize, anchor );
+
+                cv::Mat cpu_result, gpu_result, pen_result;
+                std::chrono::duration<double> elapsed_time_cpu, elapsed_time_gpu_p_copy;
+
+                {
+                    const auto cpu_start = std::chrono::high_resolution_clock::now();
+                    cpu_result = cpu( cpu_gray, structuring_element, anchor );
+                    const auto cpu_end = std::chrono::high_resolution_clock::now();
+                    elapsed_time_cpu = cpu_end - cpu_start;
+                }
+                {
+                    // Execute the kernel at least once before starting to take time measurements so that the OpenCV kernel gets compiled. The following run is not included in time measurements.
+                    if (first_execution_opencv)
+                    {
+                        gpu( cpu_gray, structuring_element, anchor );
+                        first_execution_opencv = false;
+                    }
+
+                    const auto gpu_start_copy = std::chrono::high_resolution_clock::now();
+                    gpu_result = gpu( cpu_gray, structuring_element, anchor );
+                    const auto gpu_end_copy = std::chrono::high_resolution_clock::now();
+                    elapsed_time_gpu_p_copy = gpu_end_copy - gpu_start_copy;
+                }
+                {
+                    if (first_execution_pencil)
+                    {
+                        pencil( cpu_gray, structuring_element, anchor );
+                        first_execution_pencil = false;
+                    }
+
+                    prl_timings_reset();
+                    prl_timings_start();
+                    pen_result = pencil( cpu_gray, structuring_element, anchor );
+                    prl_timings_stop();
+                    // Dump execution times for PENCIL code.
+                    prl_timings_dump();
+                }
+                // Verifying the results
+                if ( (cv::norm(cpu_result - gpu_result) > 0.01) || (cv::norm(cpu_result - pen_result) > 0.01) ) {
+                    std::cerr << "ERROR: Results don't match. Writing calculated images." << std::endl;
+                    std::cerr << "CPU norm:" << cv::norm(cpu_result) << std::endl;
+                    std::cerr << "GPU norm:" << cv::norm(gpu_result) << std::endl;
+                    std::cerr << "PEN norm:" << cv::norm(pen_result) << std::endl;
+                    std::cerr << "GPU-CPU norm:" << cv::norm(gpu_result, cpu_result) << std::endl;
+                    std::cerr << "PEN-CPU norm:" << cv::norm(pen_result, cpu_result) << std::endl;
+
+                    cv::imwrite( name + "_cpu.png", cpu_result );
+                    cv::imwrite( name + "_gpu.png", gpu_result );
+                    cv::imwrite( name + "_pen.png", pen_result );
+                    cv::imwrite( name + "_cpugpu.png", cv::abs(cpu_result-gpu_result) );
+                    cv::imwrite( name + "_cpupen.png", cv::abs(cpu_result-pen_result) );
+                    throw std::runtime_error("The OpenCL or PENCIL results are not equivalent with the C++ results.");
+                }
+                // Dump execution times for OpenCV calls.
+                timing.print( elapsed_time_cpu, elapsed_time_gpu_p_copy );
+            }
+        }
+    }
+}
+
 bool file_exists (char *name) {
 
     std::ifstream f(name);
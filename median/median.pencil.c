@@ -0,0 +1,270 @@
+#include "median.pencil.h"
+#include <pencil.h>
+#include <assert.h>
+#include <stdlib.h>
+
+// Compare-exchange of the sorting networks: p[a] = min, p[b] = max
+#define median_op(p, a, b) { const uint8_t t = p[a]; p[a] = ubmin(t, p[b]); p[b] = ubmax(t, p[b]); }
+
+// p[i + dx] = line[col(c + dx - radius)] for the dx of a row of the window
+#define median_inside(c) (c)
+#define median_clamp(c)  iclampi((c), 0, cols - 1)
+#define median_row3(p, i, line, c, col) { p[(i)    ] = line[col((c) - 1)]; p[(i) + 1] = line[col(c)    ]; p[(i) + 2] = line[col((c) + 1)]; }
+#define median_row5(p, i, line, c, col) { p[(i)    ] = line[col((c) - 2)]; p[(i) + 1] = line[col((c) - 1)]; p[(i) + 2] = line[col(c)]; \
+                                          p[(i) + 3] = line[col((c) + 1)]; p[(i) + 4] = line[col((c) + 2)]; }
+
+// Median of 9 in p[4]
+#define MEDIAN_NETWORK_9 \
+    median_op(p, 1, 2); median_op(p, 4, 5); median_op(p, 7, 8); median_op(p, 0, 1); median_op(p, 3, 4); median_op(p, 6, 7); median_op(p, 1, 2); \
+    median_op(p, 4, 5); median_op(p, 7, 8); median_op(p, 0, 3); median_op(p, 5, 8); median_op(p, 4, 7); median_op(p, 3, 6); median_op(p, 1, 4); \
+    median_op(p, 2, 5); median_op(p, 4, 7); median_op(p, 4, 2); median_op(p, 6, 4); median_op(p, 4, 2);
+// Median of 25 in p[12]: Batcher's odd-even merge sort of 32 inputs, 3 of
+// them below and 4 above all pixels, pruned to the comparators the middle
+// output depends on. Checked exhaustively on 0-1 inputs.
+#define MEDIAN_NETWORK_25 \
+    median_op(p,  1,  2); median_op(p,  3,  4); median_op(p,  1,  3); median_op(p,  2,  4); median_op(p,  2,  3); median_op(p,  0,  4); \
+    median_op(p,  0,  2); median_op(p,  0,  1); median_op(p,  2,  3); median_op(p,  5,  6); median_op(p,  7,  8); median_op(p,  5,  7); \
+    median_op(p,  6,  8); median_op(p,  6,  7); median_op(p,  9, 10); median_op(p, 11, 12); median_op(p,  9, 11); median_op(p, 10, 12); \
+    median_op(p, 10, 11); median_op(p,  5,  9); median_op(p,  7, 11); median_op(p,  7,  9); median_op(p,  6, 10); median_op(p,  8, 12); \
+    median_op(p,  8, 10); median_op(p,  6,  7); median_op(p,  8,  9); median_op(p, 10, 11); median_op(p,  1,  9); median_op(p,  1,  5); \
+    median_op(p,  3, 11); median_op(p,  3,  7); median_op(p,  3,  5); median_op(p,  7,  9); median_op(p,  2, 10); median_op(p,  2,  6); \
+    median_op(p,  0,  8); median_op(p,  4, 12); median_op(p,  4,  8); median_op(p,  0,  2); median_op(p,  4,  6); median_op(p,  8, 10); \
+    median_op(p,  0,  1); median_op(p,  2,  3); median_op(p,  4,  5); median_op(p,  6,  7); median_op(p,  8,  9); median_op(p, 10, 11); \
+    median_op(p, 13, 14); median_op(p, 15, 16); median_op(p, 13, 15); median_op(p, 14, 16); median_op(p, 14, 15); median_op(p, 17, 18); \
+    median_op(p, 19, 20); median_op(p, 17, 19); median_op(p, 18, 20); median_op(p, 18, 19); median_op(p, 13, 17); median_op(p, 15, 19); \
+    median_op(p, 15, 17); median_op(p, 14, 18); median_op(p, 16, 20); median_op(p, 16, 18); median_op(p, 14, 15); median_op(p, 16, 17); \
+    median_op(p, 18, 19); median_op(p, 21, 22); median_op(p, 23, 24); median_op(p, 21, 23); median_op(p, 22, 24); median_op(p, 22, 23); \
+    median_op(p, 13, 21); median_op(p, 17, 21); median_op(p, 15, 23); median_op(p, 19, 23); median_op(p, 15, 17); median_op(p, 19, 21); \
+    median_op(p, 14, 22); median_op(p, 18, 22); median_op(p, 16, 24); median_op(p, 20, 24); median_op(p, 16, 18); median_op(p, 20, 22); \
+    median_op(p, 14, 15); median_op(p, 16, 17); median_op(p, 18, 19); median_op(p, 20, 21); median_op(p, 22, 23); median_op(p,  5, 21); \
+    median_op(p,  5, 13); median_op(p,  1, 17); median_op(p,  9, 17); median_op(p,  9, 13); median_op(p,  7, 23); median_op(p,  7, 15); \
+    median_op(p,  3, 19); median_op(p, 11, 19); median_op(p, 11, 15); median_op(p, 11, 13); median_op(p,  6, 22); median_op(p,  6, 14); \
+    median_op(p,  2, 18); median_op(p, 10, 18); median_op(p, 10, 14); median_op(p,  0, 16); median_op(p,  8, 24); median_op(p,  8, 16); \
+    median_op(p,  4, 20); median_op(p, 12, 20); median_op(p, 12, 16); median_op(p, 12, 14); median_op(p, 12, 13);
+
+#define MEDIAN_NAME    median_3x3
+#define MEDIAN_KSIZE   3
+#define MEDIAN_ROW     median_row3
+#define MEDIAN_NETWORK MEDIAN_NETWORK_9
+#include "median.pencil.detail.h"
+#undef MEDIAN_NAME
+#undef MEDIAN_KSIZE
+#undef MEDIAN_ROW
+#undef MEDIAN_NETWORK
+
+#define MEDIAN_NAME    median_5x5
+#define MEDIAN_KSIZE   5
+#define MEDIAN_ROW     median_row5
+#define MEDIAN_NETWORK MEDIAN_NETWORK_25
+#include "median.pencil.detail.h"
+#undef MEDIAN_NAME
+#undef MEDIAN_KSIZE
+#undef MEDIAN_ROW
+#undef MEDIAN_NETWORK
+
+#define MEDIAN_BINS   256
+#define MEDIAN_COARSE 16    // coarse bins, of MEDIAN_FINE fine bins each
+#define MEDIAN_FINE   (MEDIAN_BINS / MEDIAN_COARSE)
+
+/* Constant-time median of Perreault and Hebert over vertical stripes of
+ * stripe_cols columns, each filtered independently.
+ *
+ * A stripe keeps the histogram of the ksize rows around the current row for
+ * each of its columns and the radius columns either side, as 16 coarse bins
+ * and 256 fine ones: moving down a row removes one pixel from each column
+ * histogram and adds one. Along the row the kernel coarse histogram adds
+ * the column entering the window and removes the one leaving it. Its fine
+ * bins are only kept for the coarse bins the medians fall in, brought up to
+ * date lazily from the column they were last used at, which for smooth
+ * images is the previous one. The 16-bit counters allow ksize up to 255. */
+static void median_stripes( const int rows
+                          , const int cols
+                          , const int src_step
+                          , const uint8_t src[static const restrict rows][src_step]
+                          , const int radius
+                          , const int stripes
+                          , const int stripe_cols
+                          , uint16_t coarse[static const restrict stripes][stripe_cols + 2 * radius][MEDIAN_COARSE]
+                          , uint16_t fine[static const restrict stripes][stripe_cols + 2 * radius][MEDIAN_BINS]
+                          , uint16_t kernel_coarse[static const restrict stripes][MEDIAN_COARSE]
+                          , uint16_t kernel_fine[static const restrict stripes][MEDIAN_BINS]
+                          , int updated[static const restrict stripes][MEDIAN_COARSE]
+                          , const int dst_step
+                          , uint8_t dst[static const restrict rows][dst_step]    //out
+                          )
+{
+#pragma scop
+    __pencil_assume(rows        >  0);
+    __pencil_assume(cols        >  0);
+    __pencil_assume(src_step    >= cols);
+    __pencil_assume(dst_step    >= cols);
+    __pencil_assume(radius      >  0);
+    __pencil_assume(radius      <= MEDIAN_MAX_KSIZE / 2);
+    __pencil_assume(stripes     >  0);
+    __pencil_assume(stripe_cols >  0);
+
+    __pencil_kill(coarse);
+    __pencil_kill(fine);
+    __pencil_kill(kernel_coarse);
+    __pencil_kill(kernel_fine);
+    __pencil_kill(updated);
+    __pencil_kill(dst);
+
+    #pragma pencil independent
+    for(int s = 0; s < stripes; ++s)
+    {
+        const int ksize = 2 * radius + 1;
+        const int half  = ksize * ksize / 2;
+        const int left  = s * stripe_cols;
+        const int width = imin(stripe_cols, cols - left);
+        // Column j of the histograms is image column left - radius + j
+        const int span  = width + 2 * radius;
+
+        for(int j = 0; j < span; ++j)
+        {
+            for(int b = 0; b < MEDIAN_COARSE; ++b)
+                coarse[s][j][b] = 0;
+            for(int b = 0; b < MEDIAN_BINS; ++b)
+                fine[s][j][b] = 0;
+        }
+        for(int d = -radius; d <= radius; ++d)
+        {
+            const int r = iclampi(d, 0, rows - 1);
+            for(int j = 0; j < span; ++j)
+            {
+                const int v = src[r][iclampi(left - radius + j, 0, cols - 1)];
+                coarse[s][j][v / MEDIAN_FINE]++;
+                fine[s][j][v]++;
+            }
+        }
+
+        for(int q = 0; q < rows; ++q)
+        {
+            const int leaving  = iclampi(q - radius - 1, 0, rows - 1);
+            const int entering = iclampi(q + radius, 0, rows - 1);
+            // Rows past the bottom or top replicate the same row
+            if ( q > 0 && leaving != entering )
+            {
+                for(int j = 0; j < span; ++j)
+                {
+                    const int c   = iclampi(left - radius + j, 0, cols - 1);
+                    const int out = src[leaving][c];
+                    const int in  = src[entering][c];
+                    coarse[s][j][out / MEDIAN_FINE]--;
+                    fine[s][j][out]--;
+                    coarse[s][j][in / MEDIAN_FINE]++;
+                    fine[s][j][in]++;
+                }
+            }
+
+            for(int b = 0; b < MEDIAN_COARSE; ++b)
+            {
+                kernel_coarse[s][b] = 0;
+                // Far enough behind column 0 to be rebuilt there
+                updated[s][b] = -ksize;
+            }
+            for(int j = 0; j < ksize - 1; ++j)
+                for(int b = 0; b < MEDIAN_COARSE; ++b)
+                    kernel_coarse[s][b] += coarse[s][j][b];
+
+            for(int w = 0; w < width; ++w)
+            {
+                // The window covers the histogram columns [w, w + ksize)
+                for(int b = 0; b < MEDIAN_COARSE; ++b)
+                    kernel_coarse[s][b] += coarse[s][w + ksize - 1][b];
+
+                // The median is in the first coarse bin taking the count
+                // past half. Counting the prefix sums not past it instead
+                // of searching keeps the loops free of branches, and the
+                // counts vectorise.
+                int prefix[MEDIAN_COARSE];
+                int sum = 0;
+                for(int b = 0; b < MEDIAN_COARSE; ++b)
+                {
+                    sum += kernel_coarse[s][b];
+                    prefix[b] = sum;
+                }
+                int bin = 0;
+                for(int b = 0; b < MEDIAN_COARSE; ++b)
+                    bin += prefix[b] <= half;
+                const int below = bin > 0 ? prefix[imax(bin - 1, 0)] : 0;
+
+                const int first = bin * MEDIAN_FINE;
+                if ( w - updated[s][bin] >= ksize )
+                {
+                    for(int f = 0; f < MEDIAN_FINE; ++f)
+                        kernel_fine[s][first + f] = 0;
+                    for(int j = w; j < w + ksize; ++j)
+                        for(int f = 0; f < MEDIAN_FINE; ++f)
+                            kernel_fine[s][first + f] += fine[s][j][first + f];
+                }
+                else
+                {
+                    for(int j = updated[s][bin]; j < w; ++j)
+                        for(int f = 0; f < MEDIAN_FINE; ++f)
+                            kernel_fine[s][first + f] += fine[s][j + ksize][first + f] - fine[s][j][first + f];
+                }
+                updated[s][bin] = w;
+
+                sum = below;
+                for(int f = 0; f < MEDIAN_FINE; ++f)
+                {
+                    sum += kernel_fine[s][first + f];
+                    prefix[f] = sum;
+                }
+                int value = first;
+                for(int f = 0; f < MEDIAN_FINE; ++f)
+                    value += prefix[f] <= half;
+                dst[q][left + w] = value;
+
+                for(int b = 0; b < MEDIAN_COARSE; ++b)
+                    kernel_coarse[s][b] -= coarse[s][w][b];
+            }
+        }
+    }
+#pragma endscop
+}
+
+void pencil_medianBlur( const int rows
+                      , const int cols
+                      , const int src_step
+                      , const uint8_t src[]
+                      , const int dst_step
+                      , uint8_t dst[]
+                      , const int ksize
+                      )
+{
+    assert( ksize > 0 && ksize % 2 == 1 && ksize <= MEDIAN_MAX_KSIZE );
+
+    if ( ksize == 1 )
+    {
+        for ( int q = 0; q < rows; q++ )
+            for ( int w = 0; w < cols; w++ )
+                dst[q * dst_step + w] = src[q * src_step + w];
+    }
+    else if ( ksize == 3 )
+        median_3x3( rows, cols, src_step, (const uint8_t(*)[src_step])src, dst_step, (uint8_t(*)[dst_step])dst );
+    else if ( ksize == 5 )
+        median_5x5( rows, cols, src_step, (const uint8_t(*)[src_step])src, dst_step, (uint8_t(*)[dst_step])dst );
+    else
+    {
+        const int radius  = ksize / 2;
+        const int stripes = (cols + MEDIAN_STRIPE_COLS - 1) / MEDIAN_STRIPE_COLS;
+        const int span    = MEDIAN_STRIPE_COLS + 2 * radius;
+        uint16_t (*coarse)[span][MEDIAN_COARSE] = malloc(sizeof(uint16_t) * stripes * span * MEDIAN_COARSE);
+        uint16_t (*fine)[span][MEDIAN_BINS] = malloc(sizeof(uint16_t) * stripes * span * MEDIAN_BINS);
+        uint16_t (*kernel_coarse)[MEDIAN_COARSE] = malloc(sizeof(uint16_t) * stripes * MEDIAN_COARSE);
+        uint16_t (*kernel_fine)[MEDIAN_BINS] = malloc(sizeof(uint16_t) * stripes * MEDIAN_BINS);
+        int (*updated)[MEDIAN_COARSE] = malloc(sizeof(int) * stripes * MEDIAN_COARSE);
+        assert( coarse && fine && kernel_coarse && kernel_fine && updated );
+
+        median_stripes( rows, cols, src_step, (const uint8_t(*)[src_step])src, radius, stripes, MEDIAN_STRIPE_COLS
+                      , coarse, fine, kernel_coarse, kernel_fine, updated, dst_step, (uint8_t(*)[dst_step])dst );
+
+        free(coarse);
+        free(fine);
+        free(kernel_coarse);
+        free(kernel_fine);
+        free(updated);
+    }
+}
@@ -0,0 +1,58 @@
+//Implementation file. Included multiple times with different MEDIAN_* defines:
+//  MEDIAN_NAME     name of the function
+//  MEDIAN_KSIZE    aperture, a compile time constant so the window unrolls
+//  MEDIAN_ROW      loads one row of the window into p[], unrolled
+//  MEDIAN_NETWORK  compare-exchanges leaving the median of p[] in
+//                  p[MEDIAN_KSIZE * MEDIAN_KSIZE / 2]
+//
+// Every pixel loads its window into p[] and runs the network on it. The
+// network has no data dependent control flow, so the loop over the columns
+// vectorises into elementwise minima and maxima of whole vectors of pixels.
+// Only the columns within the radius of the image edges clamp.
+
+static void MEDIAN_NAME( const int rows
+                       , const int cols
+                       , const int src_step
+                       , const uint8_t src[static const restrict rows][src_step]
+                       , const int dst_step
+                       , uint8_t dst[static const restrict rows][dst_step]    //out
+                       )
+{
+#pragma scop
+    __pencil_assume(rows     >  0);
+    __pencil_assume(cols     >  0);
+    __pencil_assume(src_step >= cols);
+    __pencil_assume(dst_step >= cols);
+
+    __pencil_kill(dst);
+
+    #pragma pencil independent
+    for(int q = 0; q < rows; ++q)
+    {
+        const int radius = MEDIAN_KSIZE / 2;
+        const int lo = imin(radius, cols);
+        const int hi = imax(cols - radius, lo);
+
+        #pragma pencil independent
+        for(int w = lo; w < hi; ++w)
+        {
+            uint8_t p[MEDIAN_KSIZE * MEDIAN_KSIZE];
+            for(int dy = 0; dy < MEDIAN_KSIZE; ++dy)
+                MEDIAN_ROW(p, dy * MEDIAN_KSIZE, src[iclampi(q + dy - radius, 0, rows - 1)], w, median_inside)
+            MEDIAN_NETWORK
+            dst[q][w] = p[MEDIAN_KSIZE * MEDIAN_KSIZE / 2];
+        }
+        // The columns [0, lo) and [hi, cols)
+        #pragma pencil independent
+        for(int e = 0; e < cols - hi + lo; ++e)
+        {
+            const int w = e < lo ? e : e - lo + hi;
+            uint8_t p[MEDIAN_KSIZE * MEDIAN_KSIZE];
+            for(int dy = 0; dy < MEDIAN_KSIZE; ++dy)
+                MEDIAN_ROW(p, dy * MEDIAN_KSIZE, src[iclampi(q + dy - radius, 0, rows - 1)], w, median_clamp)
+            MEDIAN_NETWORK
+            dst[q][w] = p[MEDIAN_KSIZE * MEDIAN_KSIZE / 2];
+        }
+    }
+#pragma endscop
+}
@@ -0,0 +1,35 @@
+#ifndef MEDIAN_PENCIL_H
+#define MEDIAN_PENCIL_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    // Largest supported aperture: the 16-bit kernel histograms hold up to
+    // ksize * ksize pixels
+    #define MEDIAN_MAX_KSIZE 255
+
+    // Columns of the vertical stripes filtered independently by the
+    // constant-time median
+    #define MEDIAN_STRIPE_COLS 512
+
+    // Median of the ksize x ksize neighbourhood of every pixel of an 8-bit
+    // image, like cv::medianBlur: ksize is odd and at most MEDIAN_MAX_KSIZE,
+    // the border replicates. 3x3 and 5x5 go through sorting networks, larger
+    // apertures through sliding histograms in time independent of ksize.
+    void pencil_medianBlur( const int rows
+                          , const int cols
+                          , const int src_step
+                          , const uint8_t src[]
+                          , const int dst_step
+                          , uint8_t dst[]    //out
+                          , const int ksize
+                          );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
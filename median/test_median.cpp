@@ -0,0 +1,150 @@
+#include "utility.hpp"
+#include "median.pencil.h"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/ocl/ocl.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <prl.h>
+#include <chrono>
+
+// cv::ocl::medianFilter only implements the 3x3 and 5x5 apertures, the larger
+// ones are compared against the CPU alone
+void time_median( const std::vector<carp::record_t>& pool, const std::vector<int>& ksizes, int iteration )
+{
+    bool first_execution_opencv = true, first_execution_pencil = true;
+
+    carp::Timing timing("median");
+
+    for ( int q=0; q<iteration; q++ ) {
+        for ( auto & item : pool ) {
+            for ( auto & ksize : ksizes ) {
+                // acquiring the image for the test
+                cv::Mat cpu_gray;
+                cv::cvtColor( item.cpuimg(), cpu_gray, CV_RGB2GRAY );
+
+                cv::Mat cpu_result, gpu_result, pen_result;
+                std::chrono::duration<double> elapsed_time_cpu, elapsed_time_gpu_p_copy(0);
+
+                {
+                    const auto cpu_start = std::chrono::high_resolution_clock::now();
+                    cv::medianBlur( cpu_gray, cpu_result, ksize );
+                    const auto cpu_end = std::chrono::high_resolution_clock::now();
+                    elapsed_time_cpu = cpu_end - cpu_start;
+                }
+                if ( ksize <= 5 )
+                {
+                    // Execute the kernel at least once before starting to take time measurements so that the OpenCV kernel gets compiled. The following run is not included in time measurements.
+                    if (first_execution_opencv)
+                    {
+                        cv::ocl::oclMat gpu_gray(cpu_gray);
+                        cv::ocl::oclMat result;
+                        cv::ocl::medianFilter( gpu_gray, result, 3 );
+                        cv::ocl::medianFilter( gpu_gray, result, 5 );
+                        first_execution_opencv = false;
+                    }
+
+                    const auto gpu_start_copy = std::chrono::high_resolution_clock::now();
+                    cv::ocl::oclMat gpu_gray(cpu_gray);
+                    cv::ocl::oclMat result;
+                    cv::ocl::medianFilter( gpu_gray, result, ksize );
+                    gpu_result = result;
+                    const auto gpu_end_copy = std::chrono::high_resolution_clock::now();
+                    elapsed_time_gpu_p_copy = gpu_end_copy - gpu_start_copy;
+                }
+                else
+                    gpu_result = cpu_result;
+                {
+                    pen_result = cv::Mat(cpu_gray.size(), CV_8U);
+
+                    if (first_execution_pencil)
+                    {
+                        pencil_medianBlur( cpu_gray.rows, cpu_gray.cols, cpu_gray.step1(), cpu_gray.ptr(), pen_result.step1(), pen_result.ptr(), ksize );
+                        first_execution_pencil = false;
+                    }
+
+                    prl_timings_reset();
+                    prl_timings_start();
+                    pencil_medianBlur( cpu_gray.rows, cpu_gray.cols, cpu_gray.step1(), cpu_gray.ptr(), pen_result.step1(), pen_result.ptr(), ksize );
+                    prl_timings_stop();
+                    // Dump execution times for PENCIL code.
+                    prl_timings_dump();
+                }
+                // Verifying the results
+                if ( (cv::norm(cpu_result, gpu_result, cv::NORM_INF) > 0) || (cv::norm(cpu_result, pen_result, cv::NORM_INF) > 0) ) {
+                    std::cerr << "ERROR: Results don't match for ksize " << ksize << ". Writing calculated images." << std::endl;
+                    std::cerr << "GPU-CPU max error:" << cv::norm(gpu_result, cpu_result, cv::NORM_INF) << std::endl;
+                    std::cerr << "PEN-CPU max error:" << cv::norm(pen_result, cpu_result, cv::NORM_INF) << std::endl;
+
+                    cv::imwrite( "median_cpu.png", cpu_result );
+                    cv::imwrite( "median_gpu.png", gpu_result );
+                    cv::imwrite( "median_pen.png", pen_result );
+                    throw std::runtime_error("The OpenCL or PENCIL results are not equivalent with the C++ results.");
+                }
+                // Dump execution times for OpenCV calls.
+                timing.print( elapsed_time_cpu, elapsed_time_gpu_p_copy );
+            }
+        }
+    }
+}
+
+// The sliding histograms cost the same for every aperture; the sorting
+// networks, and cv::medianBlur below 7x7, grow with it
+void time_median_ksizes( const std::vector<carp::record_t>& pool, const std::vector<int>& ksizes )
+{
+    std::cout << "Measuring the median against cv::medianBlur" << std::endl;
+    std::cout << "  ksize  OpenCV (ms)  PENCIL (ms)" << std::endl;
+
+    for ( auto & ksize : ksizes ) {
+        std::chrono::duration<double,std::milli> elapsed_time_cpu(0), elapsed_time_pen(0);
+
+        for ( auto & item : pool ) {
+            cv::Mat cpu_gray;
+            cv::cvtColor( item.cpuimg(), cpu_gray, CV_RGB2GRAY );
+
+            cv::Mat cpu_result, pen_result( cpu_gray.size(), CV_8U );
+            {
+                const auto cpu_start = std::chrono::high_resolution_clock::now();
+                cv::medianBlur( cpu_gray, cpu_result, ksize );
+                const auto cpu_end = std::chrono::high_resolution_clock::now();
+                elapsed_time_cpu += cpu_end - cpu_start;
+            }
+            {
+                const auto pen_start = std::chrono::high_resolution_clock::now();
+                pencil_medianBlur( cpu_gray.rows, cpu_gray.cols, cpu_gray.step1(), cpu_gray.ptr(), pen_result.step1(), pen_result.ptr(), ksize );
+                const auto pen_end = std::chrono::high_resolution_clock::now();
+                elapsed_time_pen += pen_end - pen_start;
+            }
+            if ( cv::norm(cpu_result, pen_result, cv::NORM_INF) > 0 )
+                throw std::runtime_error("The PENCIL results are not equivalent with the C++ results.");
+        }
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << std::setw(7) << ksize << " " << std::setw(12) << elapsed_time_cpu.count() << " " << std::setw(12) << elapsed_time_pen.count() << std::endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    prl_init((prl_init_flags)(PRL_TARGET_DEVICE_DYNAMIC | PRL_PROFILING_ENABLED));
+
+    try {
+	std::cout << "This executable is iterating over all the files passed to it as an argument. " << std::endl;
+
+	auto pool = carp::get_pool(argc, argv);
+
+#ifdef RUN_ONLY_ONE_EXPERIMENT
+        time_median( pool, { 3 }, 1 );
+#else
+        time_median( pool, { 3, 5, 7, 15 }, 25 );
+        time_median_ksizes( pool, { 3, 5, 7, 9, 15, 31, 51, 101, 201 } );
+#endif
+
+        prl_shutdown();
+        return EXIT_SUCCESS;
+    }catch(const std::exception& e) {
+        std::cout << e.what() << std::endl;
+
+        prl_shutdown();
+        return EXIT_FAILURE;
+    }
+}
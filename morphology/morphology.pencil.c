@@ -0,0 +1,508 @@
+#include "morphology.pencil.h"
+
+#include <pencil.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "border.pencil.h"
+#include "binary.pencil.h"
+#include "morph_lines.pencil.h"
+
+// dst - src (reversed: src - dst), saturated at 0 like cv::subtract
+static void morphology_difference( const int rows
+                                 , const int cols
+                                 , const int src_step
+                                 , const uint8_t src[static const restrict rows][src_step]
+                                 , const int reversed
+                                 , const int dst_step
+                                 , uint8_t dst[static const restrict rows][dst_step]
+                                 )
+{
+#pragma scop
+    __pencil_assume(rows     >  0);
+    __pencil_assume(cols     >  0);
+    __pencil_assume(src_step >= cols);
+    __pencil_assume(dst_step >= cols);
+
+    #pragma pencil independent
+    for ( int q = 0; q < rows; q++ )
+    {
+        #pragma pencil independent
+        for ( int w = 0; w < cols; w++ )
+        {
+            const uint8_t a = reversed ? src[q][w] : dst[q][w];
+            const uint8_t b = reversed ? dst[q][w] : src[q][w];
+            dst[q][w] = a > b ? a - b : 0;
+        }
+    }
+#pragma endscop
+}
+
+/* Rows [first - anchor_row, first + count + se_rows - 1 - anchor_row) of the
+ * first stage of an opening or closing into padded, extrapolated as the
+ * second stage would see them, so that stage reads no row border. Rows
+ * outside the image come from the image rows they extrapolate, computed into
+ * side (se_rows rows) first. */
+static void morphology_padded_stage( const morph_plan *plan
+                                   , const int erode
+                                   , const int rows
+                                   , const int cols
+                                   , const int src_step
+                                   , const uint8_t src[]
+                                   , const int first
+                                   , const int count
+                                   , const int border_type
+                                   , const uint8_t stage_value
+                                   , const uint8_t padded_value
+                                   , morph_scratch *scratch
+                                   , uint8_t side[]
+                                   , uint8_t padded[]
+                                   )
+{
+    const int begin = first - plan->anchor_row;
+    const int end   = first + count + plan->se_rows - 1 - plan->anchor_row;
+
+    const int inner_begin = imax(begin, 0);
+    const int inner_end   = imin(end, rows);
+    if ( inner_begin < inner_end )
+        morph_stage( plan, erode, rows, cols, src_step, src, inner_begin, inner_end - inner_begin
+                   , border_type, stage_value, scratch, cols, padded + (inner_begin - begin) * cols
+                   );
+
+    // Above the image, then below it
+    for ( int below = 0; below < 2; below++ )
+    {
+        const int from = below ? imax(rows, begin) : begin;
+        const int to   = below ? end : imin(end, 0);
+        if ( from >= to )
+            continue;
+        if ( border_type == PENCIL_BORDER_CONSTANT )
+        {
+            memset( padded + (from - begin) * cols, padded_value, (to - from) * cols );
+            continue;
+        }
+        int low = rows, high = -1;
+        for ( int p = from; p < to; p++ )
+        {
+            low  = imin(low , border_index(p, rows, border_type));
+            high = imax(high, border_index(p, rows, border_type));
+        }
+        morph_stage( plan, erode, rows, cols, src_step, src, low, high + 1 - low
+                   , border_type, stage_value, scratch, cols, side
+                   );
+        for ( int p = from; p < to; p++ )
+            memcpy( padded + (p - begin) * cols, side + (border_index(p, rows, border_type) - low) * cols, cols );
+    }
+}
+
+/* Opening, closing, gradient and top-hat, one strip of rows at a time: the
+ * intermediate images only exist for the rows around the current strip.
+ * Returns 0 on allocation failure. */
+static int morphology_fused( const morph_plan *plan
+                           , const int op
+                           , const int rows
+                           , const int cols
+                           , const int src_step
+                           , const uint8_t src[]
+                           , const int dst_step
+                           , uint8_t dst[]
+                           , const int border_type
+                           , const uint8_t erode_value
+                           , const uint8_t dilate_value
+                           )
+{
+    const int strip_rows  = morph_strip_rows(plan, rows, cols);
+    const int padded_rows = strip_rows + plan->se_rows - 1;
+    // Opening and top-hat erode first, closing dilates first
+    const int erode_first = op != PENCIL_MORPH_CLOSE;
+
+    morph_scratch scratch;
+    const int allocated = morph_scratch_init(&scratch, plan, padded_rows, cols);
+    uint8_t *padded = (uint8_t *)malloc(sizeof(uint8_t) * padded_rows * cols);
+    uint8_t *side   = (uint8_t *)malloc(sizeof(uint8_t) * plan->se_rows * cols);
+    if ( allocated && padded && side )
+    {
+        for ( int first = 0; first < rows; first += strip_rows )
+        {
+            const int count = imin(strip_rows, rows - first);
+            uint8_t *strip = dst + first * dst_step;
+            if ( op == PENCIL_MORPH_GRADIENT )
+            {
+                morph_stage( plan, 0, rows, cols, src_step, src, first, count
+                           , border_type, dilate_value, &scratch, dst_step, strip
+                           );
+                morph_stage( plan, 1, rows, cols, src_step, src, first, count
+                           , border_type, erode_value, &scratch, cols, padded
+                           );
+                morphology_difference( count, cols, cols, (const uint8_t(*)[cols])padded, 0, dst_step, (uint8_t(*)[dst_step])strip );
+            }
+            else
+            {
+                morphology_padded_stage( plan, erode_first, rows, cols, src_step, src, first, count
+                                       , border_type, erode_first ? erode_value : dilate_value, erode_first ? dilate_value : erode_value
+                                       , &scratch, side, padded
+                                       );
+                morph_stage( plan, !erode_first, count + plan->se_rows - 1, cols, cols, padded, plan->anchor_row, count
+                           , border_type, erode_first ? dilate_value : erode_value, &scratch, dst_step, strip
+                           );
+                if ( op == PENCIL_MORPH_TOPHAT )
+                    morphology_difference( count, cols, src_step, (const uint8_t(*)[src_step])(src + first * src_step), 1, dst_step, (uint8_t(*)[dst_step])strip );
+            }
+        }
+    }
+    morph_scratch_free(&scratch);
+    free(padded);
+    free(side);
+    return allocated && padded && side;
+}
+
+void pencil_morphology( const int op
+                      , const int rows
+                      , const int cols
+                      , const int src_step
+                      , const uint8_t src[]
+                      , const int dst_step
+                      , uint8_t dst[]
+                      , const int se_rows
+                      , const int se_cols
+                      , const int se_step
+                      , const uint8_t se[]
+                      , const int anchor_row
+                      , const int anchor_col
+                      , const int border_type
+                      , const int border_value
+                      )
+{
+    const int default_value   = border_value == PENCIL_MORPH_DEFAULT_BORDER_VALUE;
+    const uint8_t erode_value  = default_value ? 255 : border_value;
+    const uint8_t dilate_value = default_value ? 0   : border_value;
+    assert( op >= PENCIL_MORPH_ERODE && op <= PENCIL_MORPH_TOPHAT );
+
+    // The plan and the strip buffers are the only allocations: without them
+    // nothing is written, so a failure must not pass for a result
+    morph_plan plan;
+    int done = morph_plan_init(&plan, se_rows, se_cols, se_step, se, anchor_row, anchor_col);
+    if ( done && plan.count == 0 )
+    {
+        for ( int q = 0; q < rows; q++ )
+            memcpy( dst + q * dst_step, src + q * src_step, cols );
+    }
+    else if ( done && (op == PENCIL_MORPH_ERODE || op == PENCIL_MORPH_DILATE) )
+    {
+        const int erode = op == PENCIL_MORPH_ERODE;
+        done = morph_apply( &plan, erode, rows, cols, src_step, src, dst_step, dst
+                          , border_type, erode ? erode_value : dilate_value
+                          );
+    }
+    else if ( done )
+        done = morphology_fused( &plan, op, rows, cols, src_step, src, dst_step, dst
+                               , border_type, erode_value, dilate_value
+                               );
+    morph_plan_free(&plan);
+    assert( done );
+}
+
+/* Binary morphology on packed images. Erosion is the complement of the
+ * dilation of the complement, so the passes only OR words: the horizontal
+ * pass complements what it reads and binary_finish() what is written. */
+static inline uint64_t binary_or( const uint64_t a, const uint64_t b )
+{
+    return a | b;
+}
+
+#define MORPH_COLUMN_LINES binary_column_lines
+#define MORPH_TYPE         uint64_t
+#define MORPH_OP           binary_or
+#include "morph_lines.pencil.detail.h"
+#undef MORPH_COLUMN_LINES
+#undef MORPH_TYPE
+#undef MORPH_OP
+
+// Bits [bit, bit + 64) of a packed line. The split shift is 0 for aligned
+// bits, without a branch the word loops would not vectorise over.
+#define binary_bits(line, bit) ( (line[(bit) >> 6] >> ((bit) & 63)) | ((line[((bit) >> 6) + 1] << 1) << (63 - ((bit) & 63))) )
+
+/* dst[i] = OR of the pixels [w + offset, w + offset + length) of row first + i
+ * of src xor invert, with rows and columns outside src extrapolated (border_bit
+ * for PENCIL_BORDER_CONSTANT). Runs of 2^s pixels double by shifting the
+ * packed line by 2^s bits, 64 pixels per operation. line holds one padded
+ * row and a few spare words. */
+static void binary_row_lines( const int src_rows
+                            , const int cols
+                            , const int src_step
+                            , const uint64_t src[static const restrict src_rows][src_step]
+                            , const int first
+                            , const int count
+                            , const int length
+                            , const int offset
+                            , const int steps
+                            , const int border_type
+                            , const int border_bit
+                            , const uint64_t invert
+                            , const int line_words
+                            , uint64_t line[static const restrict line_words]
+                            , const int dst_step
+                            , uint64_t dst[static const restrict count][dst_step]
+                            )
+{
+#pragma scop
+    __pencil_assume(src_rows >  0);
+    __pencil_assume(cols     >  0);
+    __pencil_assume(count    >  0);
+    __pencil_assume(length   >  0);
+    __pencil_assume(steps    >= 0);
+
+    __pencil_kill(dst);
+    {
+        const int words = binary_words(cols);
+        // Line bit j is column j - pad: whole words of padding keep the row copy aligned
+        const int pad_words = (imax(-offset, 0) + 63) / 64;
+        const int pad   = 64 * pad_words;
+        const int begin = pad + offset;                     // column offset
+        const int end   = pad + cols + offset + length - 1; // past the last column read
+        const int used  = (end + 63) / 64;
+        const int span  = 1 << steps;
+        // Bits past cols in the last word of a row
+        const uint64_t tail = cols % 64 ? ~(uint64_t)0 << (cols % 64) : 0;
+
+        // One line buffer: the rows are processed in turn
+        for ( int i = 0; i < count; i++ )
+        {
+            const int q = border_index(first + i, src_rows, border_type);
+            if ( border_outside(first + i, src_rows, border_type) )
+            {
+                #pragma pencil independent
+                for ( int k = 0; k < words; k++ )
+                    dst[i][k] = (border_bit ? ~(uint64_t)0 : 0) ^ invert;
+            }
+            else
+            {
+                #pragma pencil independent
+                for ( int k = 0; k < words; k++ )
+                    line[pad_words + k] = src[q][k] ^ invert;
+                if ( border_type == PENCIL_BORDER_CONSTANT || border_type == PENCIL_BORDER_REPLICATE )
+                {
+                    const int left  = border_type == PENCIL_BORDER_CONSTANT ? border_bit : (int)(src[q][0] & 1);
+                    const int right = border_type == PENCIL_BORDER_CONSTANT ? border_bit : (int)((src[q][(cols - 1) / 64] >> ((cols - 1) % 64)) & 1);
+                    const uint64_t left_word  = (left  ? ~(uint64_t)0 : 0) ^ invert;
+                    const uint64_t right_word = (right ? ~(uint64_t)0 : 0) ^ invert;
+                    for ( int k = 0; k < pad_words; k++ )
+                        line[k] = left_word;
+                    line[pad_words + words - 1] = (line[pad_words + words - 1] & ~tail) | (right_word & tail);
+                    for ( int k = pad_words + words; k <= used; k++ )
+                        line[k] = right_word;
+                }
+                else
+                {
+                    // Bit by bit, at most length - 1 of them
+                    for ( int k = 0; k < imax(-offset, 0) + imax(offset + length - 1, 0); k++ )
+                    {
+                        const int c = k < imax(-offset, 0) ? offset + k : cols + k - imax(-offset, 0);
+                        const int x = border_index(c, cols, border_type);
+                        const uint64_t bit = ((src[q][x / 64] >> (x % 64)) ^ invert) & 1;
+                        const int j = pad + c;
+                        line[j / 64] = (line[j / 64] & ~((uint64_t)1 << (j % 64))) | (bit << (j % 64));
+                    }
+                }
+
+                // Bit j becomes the OR of the 2^s bits from j
+                for ( int s = 0; s < steps; s++ )
+                {
+                    for ( int k = 0; k < used; k++ )
+                        line[k] |= binary_bits(line, 64 * k + (1 << s));
+                }
+                #pragma pencil independent
+                for ( int k = 0; k < words; k++ )
+                    dst[i][k] = binary_bits(line, 64 * k + begin) | binary_bits(line, 64 * k + begin + length - span);
+            }
+        }
+    }
+    __pencil_kill(line);
+#pragma endscop
+}
+
+/* Takes erosions back from the complement (invert = ~0) and clears the bits
+ * past cols. */
+static void binary_finish( const int rows
+                         , const int cols
+                         , const uint64_t invert
+                         , const int dst_step
+                         , uint64_t dst[static const restrict rows][dst_step]
+                         )
+{
+#pragma scop
+    __pencil_assume(rows >  0);
+    __pencil_assume(cols >  0);
+    {
+        const int words = binary_words(cols);
+        const uint64_t tail = cols % 64 ? ~(uint64_t)0 << (cols % 64) : 0;
+
+        #pragma pencil independent
+        for ( int q = 0; q < rows; q++ )
+        {
+            #pragma pencil independent
+            for ( int k = 0; k < words; k++ )
+                dst[q][k] ^= invert;
+            dst[q][words - 1] &= ~tail;
+        }
+    }
+#pragma endscop
+}
+
+typedef struct
+{
+    int       strip_rows;  // most output rows of one binary_stage() call
+    int       line_words;
+    uint64_t *horizontal;  // (strip_rows + se_rows - 1) x words
+    uint64_t *blocks;      // (strip_rows + max_length - 1) x words
+    uint64_t *suffix;      // words
+    uint64_t *line;        // line_words
+} binary_scratch;
+
+/* Returns 0 on allocation failure. */
+static int binary_scratch_init( binary_scratch *scratch, const morph_plan *plan, const int strip_rows, const int cols, const int se_cols )
+{
+    const int words = binary_words(cols);
+    // Padding of whole words on the left, up to se_cols - 1 columns on the
+    // right, and the spare words the shifted reads go past the end
+    scratch->strip_rows = strip_rows;
+    scratch->line_words = binary_words(64 * binary_words(plan->anchor_col) + cols + se_cols) + plan->max_length / 64 + 2;
+    scratch->horizontal = (uint64_t *)malloc(sizeof(uint64_t) * (strip_rows + plan->se_rows - 1) * words);
+    scratch->blocks     = (uint64_t *)malloc(sizeof(uint64_t) * (strip_rows + plan->max_length - 1) * words);
+    scratch->suffix     = (uint64_t *)malloc(sizeof(uint64_t) * words);
+    scratch->line       = (uint64_t *)calloc(scratch->line_words, sizeof(uint64_t));
+    return scratch->horizontal && scratch->blocks && scratch->suffix && scratch->line;
+}
+
+static void binary_scratch_free( binary_scratch *scratch )
+{
+    free(scratch->horizontal);
+    free(scratch->blocks);
+    free(scratch->suffix);
+    free(scratch->line);
+}
+
+/* morph_stage() for packed images. */
+static void binary_stage( const morph_plan *plan
+                        , const int erode
+                        , const int src_rows
+                        , const int cols
+                        , const int src_step
+                        , const uint64_t src[]
+                        , const int first
+                        , const int count
+                        , const int border_type
+                        , const int border_bit
+                        , binary_scratch *scratch
+                        , const int dst_step
+                        , uint64_t dst[]
+                        )
+{
+    const int words = binary_words(cols);
+    const uint64_t invert = erode ? ~(uint64_t)0 : 0;
+    // Row k of the horizontal strip is source row base + k
+    const int base = first - plan->anchor_row;
+
+    for ( int i = 0; i < plan->count; )
+    {
+        const morph_rect *run = &plan->rects[i];
+        const int offset = run->col - plan->anchor_col;
+        int end = i + 1, top = run->row, bottom = run->row + run->rows;
+        for ( ; end < plan->count && plan->rects[end].col == run->col && plan->rects[end].cols == run->cols; end++ )
+        {
+            top    = imin(top, plan->rects[end].row);
+            bottom = imax(bottom, plan->rects[end].row + plan->rects[end].rows);
+        }
+        const int needed = bottom - 1 + count - top;
+
+        const int direct = !erode && run->cols == 1 && offset == 0 && base + top >= 0 && base + top + needed <= src_rows;
+        if ( !direct )
+            binary_row_lines( src_rows, cols, src_step, (const uint64_t(*)[src_step])src
+                            , base + top, needed, run->cols, offset, morph_log2(run->cols)
+                            , border_type, border_bit, invert, scratch->line_words, scratch->line
+                            , words, (uint64_t(*)[words])(scratch->horizontal + top * words)
+                            );
+
+        for ( ; i < end; i++ )
+        {
+            const morph_rect *rect = &plan->rects[i];
+            const int lines_step = direct ? src_step : words;
+            const uint64_t *lines = direct ? src + (base + rect->row) * src_step : scratch->horizontal + rect->row * words;
+            binary_column_lines( count, words, rect->rows, lines_step, (const uint64_t(*)[lines_step])lines
+                               , i > 0, (uint64_t(*)[words])scratch->blocks, scratch->suffix
+                               , dst_step, (uint64_t(*)[dst_step])dst
+                               );
+        }
+    }
+    binary_finish( count, cols, invert, dst_step, (uint64_t(*)[dst_step])dst );
+}
+
+void pencil_binary_pack( const int rows
+                       , const int cols
+                       , const int src_step
+                       , const uint8_t src[]
+                       , const int dst_step
+                       , uint64_t dst[]
+                       )
+{
+    for ( int q = 0; q < rows; q++ )
+        binary_pack_row( cols, src + q * src_step, dst + q * dst_step );
+}
+
+void pencil_binary_unpack( const int rows
+                         , const int cols
+                         , const int src_step
+                         , const uint64_t src[]
+                         , const int dst_step
+                         , uint8_t dst[]
+                         )
+{
+    for ( int q = 0; q < rows; q++ )
+        binary_unpack_row( cols, src + q * src_step, dst + q * dst_step );
+}
+
+void pencil_binary_morphology( const int op
+                             , const int rows
+                             , const int cols
+                             , const int src_step
+                             , const uint64_t src[]
+                             , const int dst_step
+                             , uint64_t dst[]
+                             , const int se_rows
+                             , const int se_cols
+                             , const int se_step
+                             , const uint8_t se[]
+                             , const int anchor_row
+                             , const int anchor_col
+                             , const int border_type
+                             , const int border_value
+                             )
+{
+    assert( op == PENCIL_MORPH_ERODE || op == PENCIL_MORPH_DILATE );
+    const int erode = op == PENCIL_MORPH_ERODE;
+    const int border_bit = border_value == PENCIL_MORPH_DEFAULT_BORDER_VALUE ? erode : border_value != 0;
+
+    morph_plan plan;
+    binary_scratch scratch = { 0, 0, NULL, NULL, NULL, NULL };
+    int done = morph_plan_init(&plan, se_rows, se_cols, se_step, se, anchor_row, anchor_col);
+    if ( done )
+    {
+        // 8 bytes per word for the strip height
+        const int strip_rows = morph_strip_rows(&plan, rows, 8 * binary_words(cols));
+        if ( plan.count == 0 )
+        {
+            for ( int q = 0; q < rows; q++ )
+                memcpy( dst + q * dst_step, src + q * src_step, sizeof(uint64_t) * binary_words(cols) );
+        }
+        else if ( (done = binary_scratch_init(&scratch, &plan, strip_rows, cols, se_cols)) )
+        {
+            for ( int first = 0; first < rows; first += strip_rows )
+                binary_stage( &plan, erode, rows, cols, src_step, src, first, imin(strip_rows, rows - first)
+                            , border_type, border_bit, &scratch, dst_step, dst + first * dst_step
+                            );
+        }
+    }
+    binary_scratch_free(&scratch);
+    morph_plan_free(&plan);
+    assert( done );
+}
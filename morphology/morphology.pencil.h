@@ -0,0 +1,85 @@
+#include <stdint.h>
+#include "border.pencil.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Operations of pencil_morphology(), the values match cv::MORPH_*
+#define PENCIL_MORPH_ERODE    0
+#define PENCIL_MORPH_DILATE   1
+#define PENCIL_MORPH_OPEN     2
+#define PENCIL_MORPH_CLOSE    3
+#define PENCIL_MORPH_GRADIENT 4
+#define PENCIL_MORPH_TOPHAT   5
+
+// border_value selecting the neutral element of each erosion (255) and
+// dilation (0), like cv::morphologyDefaultBorderValue()
+#define PENCIL_MORPH_DEFAULT_BORDER_VALUE (-1)
+
+// op is one of PENCIL_MORPH_*. border_type is one of PENCIL_BORDER_*,
+// border_value (0-255 or PENCIL_MORPH_DEFAULT_BORDER_VALUE) is used by
+// PENCIL_BORDER_CONSTANT. The compound operations extrapolate their
+// intermediate images like cv::morphologyEx does. A structuring element
+// without non-zero elements leaves the image unchanged. Any other op, or
+// running out of memory for the strip buffers, fails an assertion.
+void pencil_morphology( const int op
+                      , const int rows
+                      , const int cols
+                      , const int src_step
+                      , const uint8_t src[]
+                      , const int dst_step
+                      , uint8_t dst[]
+                      , const int se_rows
+                      , const int se_cols
+                      , const int se_step
+                      , const uint8_t se[]
+                      , const int anchor_row
+                      , const int anchor_col
+                      , const int border_type
+                      , const int border_value
+                      );
+
+// Binary images for the pencil_binary_* functions: 1 bit per pixel, packed
+// in rows of (cols + 63) / 64 words, see binary.pencil.h. Steps are in
+// words. pencil_binary_pack() sets the pixels whose byte is non-zero,
+// pencil_binary_unpack() writes 0 and 255.
+void pencil_binary_pack( const int rows
+                       , const int cols
+                       , const int src_step
+                       , const uint8_t src[]
+                       , const int dst_step
+                       , uint64_t dst[]
+                       );
+
+void pencil_binary_unpack( const int rows
+                         , const int cols
+                         , const int src_step
+                         , const uint64_t src[]
+                         , const int dst_step
+                         , uint8_t dst[]
+                         );
+
+// pencil_morphology() on binary images, for PENCIL_MORPH_ERODE and
+// PENCIL_MORPH_DILATE only. A non-zero border_value sets the constant
+// border. Failures assert like pencil_morphology().
+void pencil_binary_morphology( const int op
+                             , const int rows
+                             , const int cols
+                             , const int src_step
+                             , const uint64_t src[]
+                             , const int dst_step
+                             , uint64_t dst[]
+                             , const int se_rows
+                             , const int se_cols
+                             , const int se_step
+                             , const uint8_t se[]
+                             , const int anchor_row
+                             , const int anchor_col
+                             , const int border_type
+                             , const int border_value
+                             );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
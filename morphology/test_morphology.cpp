@@ -0,0 +1,190 @@
+#include "utility.hpp"
+#include "morphology.pencil.h"
+#include "binary.pencil.h"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/ocl/ocl.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <prl.h>
+#include <chrono>
+
+// Single channel binary image, 1 bit per pixel, for the pencil_binary_*
+// kernels. Rows are packed: step1() == binary_words(cols()) words.
+class binary_mat {
+private:
+    int m_rows, m_cols;
+    std::vector<uint64_t> m_data;
+
+public:
+    binary_mat( int rows, int cols ) : m_rows(rows), m_cols(cols), m_data(rows * binary_words(cols)) { }
+
+    int rows() const { return m_rows; }
+    int cols() const { return m_cols; }
+    int step1() const { return binary_words(m_cols); }
+
+    uint64_t * ptr() { return m_data.data(); }
+    const uint64_t * ptr() const { return m_data.data(); }
+};
+
+void time_morphology( const std::vector<carp::record_t>& pool, const std::vector<int>& ops, const std::vector<int>& elemsizes, int iteration )
+{
+    for ( auto & op : ops ) {
+        carp::time_morphology( pool, "morphology", elemsizes, iteration
+                             , [&]( const cv::Mat & gray, const cv::Mat & structuring_element, cv::Point anchor ) -> cv::Mat {
+                                   cv::Mat result;
+                                   cv::morphologyEx( gray, result, op, structuring_element, anchor, 1, cv::BORDER_CONSTANT );
+                                   return result;
+                               }
+                             , [&]( const cv::Mat & gray, const cv::Mat & structuring_element, cv::Point anchor ) -> cv::Mat {
+                                   cv::ocl::oclMat gpu_gray(gray);
+                                   cv::ocl::oclMat result;
+                                   cv::ocl::morphologyEx( gpu_gray, result, op, structuring_element, anchor, 1, cv::BORDER_CONSTANT );
+                                   return result;
+                               }
+                             , [&]( const cv::Mat & gray, const cv::Mat & structuring_element, cv::Point anchor ) -> cv::Mat {
+                                   cv::Mat result( gray.size(), CV_8U );
+                                   // cv::morphologyEx pads BORDER_CONSTANT with the neutral element of each stage
+                                   pencil_morphology( op, gray.rows, gray.cols, gray.step1(), gray.ptr()
+                                                    , result.step1(), result.ptr()
+                                                    , structuring_element.rows, structuring_element.cols, structuring_element.step1(), structuring_element.ptr()
+                                                    , anchor.y, anchor.x
+                                                    , PENCIL_BORDER_CONSTANT, PENCIL_MORPH_DEFAULT_BORDER_VALUE
+                                                    );
+                                   return result;
+                               }
+                             );
+    }
+}
+
+void time_morphology_borders( const std::vector<carp::record_t>& pool, const std::vector<int>& elemsizes )
+{
+    const std::vector<std::pair<const char*, int>> operations = { {"ERODE"   , cv::MORPH_ERODE   }
+                                                                , {"DILATE"  , cv::MORPH_DILATE  }
+                                                                , {"OPEN"    , cv::MORPH_OPEN    }
+                                                                , {"CLOSE"   , cv::MORPH_CLOSE   }
+                                                                , {"GRADIENT", cv::MORPH_GRADIENT}
+                                                                , {"TOPHAT"  , cv::MORPH_TOPHAT  }
+                                                                };
+    const auto element = []( int elemsize ) { return cv::getStructuringElement( cv::MORPH_ELLIPSE, cv::Size(elemsize, elemsize) ); };
+
+    for ( auto & operation : operations ) {
+        carp::time_borders( pool, std::string("morphology ") + operation.first, "ksize", elemsizes, CV_8U, 0
+                          , [&]( const cv::Mat & src, int elemsize, int border ) -> cv::Mat {
+                                const cv::Point anchor( elemsize/2, elemsize/2 );
+                                cv::Mat result;
+                                // Two structuring elements of padding keep the intermediate
+                                // of the compound operations periodic where the result reads it
+                                if ( border == cv::BORDER_WRAP )
+                                    return carp::wrap_filter( src, 2*elemsize, [&]( const cv::Mat & padded, cv::Mat & dst ) { cv::morphologyEx( padded, dst, operation.second, element(elemsize), anchor, 1, cv::BORDER_REPLICATE ); } );
+                                cv::morphologyEx( src, result, operation.second, element(elemsize), anchor, 1, border );
+                                return result;
+                            }
+                          , [&]( const cv::Mat & src, int elemsize, int border ) -> cv::Mat {
+                                const cv::Mat structuring_element = element(elemsize);
+                                cv::Mat result( src.size(), CV_8U );
+                                pencil_morphology( operation.second, src.rows, src.cols, src.step1(), src.ptr()
+                                                 , result.step1(), result.ptr()
+                                                 , structuring_element.rows, structuring_element.cols, structuring_element.step1(), structuring_element.ptr()
+                                                 , elemsize/2, elemsize/2
+                                                 , border, PENCIL_MORPH_DEFAULT_BORDER_VALUE
+                                                 );
+                                return result;
+                            }
+                          );
+    }
+}
+
+void time_binary_morphology( const std::vector<carp::record_t>& pool, const std::vector<int>& elemsizes )
+{
+    std::cout << "Measuring bit-packed binary morphology against byte morphology on thresholded images" << std::endl;
+    std::cout << "  operation  ksize  OpenCV (ms)  byte (ms)  binary (ms)  pack+binary+unpack (ms)" << std::endl;
+
+    const std::vector<std::pair<const char*, int>> operations = { {"ERODE" , cv::MORPH_ERODE }
+                                                                , {"DILATE", cv::MORPH_DILATE}
+                                                                };
+
+    for ( auto & operation : operations ) {
+        for ( auto & elemsize : elemsizes ) {
+            cv::Point anchor( elemsize/2, elemsize/2 );
+            cv::Mat structuring_element = cv::getStructuringElement( cv::MORPH_ELLIPSE, cv::Size(elemsize, elemsize), anchor );
+
+            std::chrono::duration<double,std::milli> elapsed_time_cpu(0), elapsed_time_byte(0), elapsed_time_binary(0), elapsed_time_convert(0);
+
+            for ( auto & item : pool ) {
+                cv::Mat cpu_gray, cpu_mask;
+                cv::cvtColor( item.cpuimg(), cpu_gray, CV_RGB2GRAY );
+                cv::threshold( cpu_gray, cpu_mask, 127, 255, cv::THRESH_BINARY );
+
+                cv::Mat cpu_result, byte_result( cpu_mask.size(), CV_8U ), binary_result( cpu_mask.size(), CV_8U );
+                binary_mat binary_mask( cpu_mask.rows, cpu_mask.cols ), binary_dst( cpu_mask.rows, cpu_mask.cols );
+                {
+                    const auto cpu_start = std::chrono::high_resolution_clock::now();
+                    cv::morphologyEx( cpu_mask, cpu_result, operation.second, structuring_element, anchor, 1, cv::BORDER_CONSTANT );
+                    const auto cpu_end = std::chrono::high_resolution_clock::now();
+                    elapsed_time_cpu += cpu_end - cpu_start;
+                }
+                {
+                    const auto byte_start = std::chrono::high_resolution_clock::now();
+                    pencil_morphology( operation.second, cpu_mask.rows, cpu_mask.cols, cpu_mask.step1(), cpu_mask.ptr()
+                                     , byte_result.step1(), byte_result.ptr()
+                                     , structuring_element.rows, structuring_element.cols, structuring_element.step1(), structuring_element.ptr()
+                                     , anchor.y, anchor.x
+                                     , PENCIL_BORDER_CONSTANT, PENCIL_MORPH_DEFAULT_BORDER_VALUE
+                                     );
+                    const auto byte_end = std::chrono::high_resolution_clock::now();
+                    elapsed_time_byte += byte_end - byte_start;
+                }
+                {
+                    const auto pack_start = std::chrono::high_resolution_clock::now();
+                    pencil_binary_pack( cpu_mask.rows, cpu_mask.cols, cpu_mask.step1(), cpu_mask.ptr(), binary_mask.step1(), binary_mask.ptr() );
+                    const auto binary_start = std::chrono::high_resolution_clock::now();
+                    pencil_binary_morphology( operation.second, binary_mask.rows(), binary_mask.cols(), binary_mask.step1(), binary_mask.ptr()
+                                            , binary_dst.step1(), binary_dst.ptr()
+                                            , structuring_element.rows, structuring_element.cols, structuring_element.step1(), structuring_element.ptr()
+                                            , anchor.y, anchor.x
+                                            , PENCIL_BORDER_CONSTANT, PENCIL_MORPH_DEFAULT_BORDER_VALUE
+                                            );
+                    const auto binary_end = std::chrono::high_resolution_clock::now();
+                    pencil_binary_unpack( binary_dst.rows(), binary_dst.cols(), binary_dst.step1(), binary_dst.ptr(), binary_result.step1(), binary_result.ptr() );
+                    const auto unpack_end = std::chrono::high_resolution_clock::now();
+                    elapsed_time_binary  += binary_end - binary_start;
+                    elapsed_time_convert += unpack_end - pack_start;
+                }
+                if ( cv::norm(cpu_result, byte_result, cv::NORM_INF) > 0 || cv::norm(cpu_result, binary_result, cv::NORM_INF) > 0 )
+                    throw std::runtime_error("The binary PENCIL results are not equivalent with the C++ results.");
+            }
+            std::cout << std::fixed << std::setprecision(3);
+            std::cout << std::setw(11) << operation.first << " " << std::setw(6) << elemsize << " "
+                      << std::setw(12) << elapsed_time_cpu.count() << " " << std::setw(10) << elapsed_time_byte.count() << " "
+                      << std::setw(12) << elapsed_time_binary.count() << " " << std::setw(24) << elapsed_time_convert.count() << std::endl;
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    prl_init((prl_init_flags)(PRL_TARGET_DEVICE_DYNAMIC | PRL_PROFILING_ENABLED));
+
+    try {
+	std::cout << "This executable is iterating over all the files passed to it as an argument. " << std::endl;
+
+	auto pool = carp::get_pool(argc, argv);
+
+#ifdef RUN_ONLY_ONE_EXPERIMENT
+        time_morphology( pool, { cv::MORPH_OPEN }, { 5 }, 1 );
+#else
+        time_morphology( pool, { cv::MORPH_ERODE, cv::MORPH_DILATE, cv::MORPH_OPEN, cv::MORPH_CLOSE, cv::MORPH_GRADIENT, cv::MORPH_TOPHAT }, { 3, 5 }, 25 );
+        time_morphology_borders( pool, { 3, 5, 9, 15 } );
+        time_binary_morphology( pool, { 3, 5, 9, 15, 31 } );
+#endif
+
+        prl_shutdown();
+        return EXIT_SUCCESS;
+    }catch(const std::exception& e) {
+        std::cout << e.what() << std::endl;
+
+        prl_shutdown();
+        return EXIT_FAILURE;
+    }
+}
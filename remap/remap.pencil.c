@@ -0,0 +1,193 @@
+#include "remap.pencil.h"
+#include <pencil.h>
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+#define REMAP_NAME remap
+#include "remap.pencil.detail.h"
+#undef REMAP_NAME
+
+#define REMAP_NAME perspective
+#define REMAP_PERSPECTIVE
+#include "remap.pencil.detail.h"
+#undef REMAP_NAME
+#undef REMAP_PERSPECTIVE
+
+/* Bilinear remap through a compiled map: xy[n_r][n_c] holds the source
+ * column and row of the top left tap, fraction[n_r][n_c] the index of its
+ * four weights in table, ordered top left, top right, bottom left, bottom
+ * right. */
+static void remap_compiled( const int src_rows, const int src_cols, const int src_step, const float src[static const restrict src_rows][src_step]
+                          , const int dst_rows, const int dst_cols, const int dst_step,       float dst[static const restrict dst_rows][dst_step]
+                          , const int16_t xy[static const restrict dst_rows][dst_cols][2]
+                          , const uint16_t fraction[static const restrict dst_rows][dst_cols]
+                          , const float table[static const restrict REMAP_TABLE_SIZE][4]
+                          , const int border_type, const float border_value
+                          )
+{
+#pragma scop
+    __pencil_assume(src_rows >  0);
+    __pencil_assume(src_cols >  0);
+    __pencil_assume(src_step >= src_cols);
+    __pencil_assume(dst_rows >  0);
+    __pencil_assume(dst_cols >  0);
+    __pencil_assume(dst_step >= dst_cols);
+
+    __pencil_kill(dst);
+
+    #pragma pencil independent
+    for ( int n_r=0; n_r<dst_rows; n_r++ )
+    {
+        #pragma pencil independent
+        for ( int n_c=0; n_c<dst_cols; n_c++ )
+        {
+            const int col = xy[n_r][n_c][0];
+            const int row = xy[n_r][n_c][1];
+            const int f   = fraction[n_r][n_c];
+
+            if ( row >= 0 && row < src_rows - 1 && col >= 0 && col < src_cols - 1 )
+            {
+                dst[n_r][n_c] = table[f][0] * src[row    ][col] + table[f][1] * src[row    ][col + 1]
+                              + table[f][2] * src[row + 1][col] + table[f][3] * src[row + 1][col + 1];
+            }
+            else
+            {
+                const float A00 = border_fetch(src, row    , col    , src_rows, src_cols, border_type, border_value);
+                const float A01 = border_fetch(src, row    , col + 1, src_rows, src_cols, border_type, border_value);
+                const float A10 = border_fetch(src, row + 1, col    , src_rows, src_cols, border_type, border_value);
+                const float A11 = border_fetch(src, row + 1, col + 1, src_rows, src_cols, border_type, border_value);
+                dst[n_r][n_c] = table[f][0] * A00 + table[f][1] * A01 + table[f][2] * A10 + table[f][3] * A11;
+            }
+        }
+    }
+    __pencil_kill(src);
+#pragma endscop
+}
+
+struct pencil_remap_map
+{
+    int rows, cols;
+    int16_t (*xy)[2];
+    uint16_t *fraction;
+    float table[REMAP_TABLE_SIZE][4];
+};
+
+static pencil_remap_map * remap_map_alloc( const int dst_rows, const int dst_cols )
+{
+    pencil_remap_map *map = (pencil_remap_map *)malloc(sizeof(pencil_remap_map));
+    assert( map );
+    map->rows = dst_rows;
+    map->cols = dst_cols;
+    map->xy = malloc( sizeof(int16_t) * dst_rows * dst_cols * 2 );
+    map->fraction = malloc( sizeof(uint16_t) * dst_rows * dst_cols );
+    assert( map->xy && map->fraction );
+
+    for ( int f_y = 0; f_y < (1 << REMAP_INTER_BITS); f_y++ )
+        for ( int f_x = 0; f_x < (1 << REMAP_INTER_BITS); f_x++ )
+        {
+            const float r = (float)f_y / (1 << REMAP_INTER_BITS);
+            const float c = (float)f_x / (1 << REMAP_INTER_BITS);
+            float *weights = map->table[(f_y << REMAP_INTER_BITS) + f_x];
+            weights[0] = (1.f - r) * (1.f - c);
+            weights[1] = (1.f - r) * c;
+            weights[2] = r * (1.f - c);
+            weights[3] = r * c;
+        }
+    return map;
+}
+
+/* x rounded to int and saturated, like cv::saturate_cast<int>. */
+static int remap_round( const double x )
+{
+    return x >= 2147483647. ? 2147483647 : x <= -2147483648. ? (-2147483647 - 1) : (int)lrint(x);
+}
+
+/* Stores source point (x, y) for dst element i of map: rounded to
+ * REMAP_INTER_BITS, the integer parts saturated to int16 and the fractions
+ * kept, as cv::convertMaps does. */
+static void remap_map_store( pencil_remap_map *map, const int i, const double x, const double y )
+{
+    const double one = 1 << REMAP_INTER_BITS;
+    const int x_q = remap_round( x * one );
+    const int y_q = remap_round( y * one );
+    map->xy[i][0] = iclampi( x_q >> REMAP_INTER_BITS, BORDER_COORD_MIN, BORDER_COORD_MAX );
+    map->xy[i][1] = iclampi( y_q >> REMAP_INTER_BITS, BORDER_COORD_MIN, BORDER_COORD_MAX );
+    map->fraction[i] = ((y_q & ((1 << REMAP_INTER_BITS) - 1)) << REMAP_INTER_BITS) + (x_q & ((1 << REMAP_INTER_BITS) - 1));
+}
+
+pencil_remap_map * pencil_remap_map_create( const int dst_rows, const int dst_cols
+                                          , const int map_step, const float map_x[], const float map_y[]
+                                          )
+{
+    pencil_remap_map *map = remap_map_alloc( dst_rows, dst_cols );
+    for ( int n_r = 0; n_r < dst_rows; n_r++ )
+        for ( int n_c = 0; n_c < dst_cols; n_c++ )
+            remap_map_store( map, n_r * dst_cols + n_c, map_x[n_r * map_step + n_c], map_y[n_r * map_step + n_c] );
+    return map;
+}
+
+pencil_remap_map * pencil_remap_map_create_perspective( const int dst_rows, const int dst_cols, const float M[] )
+{
+    pencil_remap_map *map = remap_map_alloc( dst_rows, dst_cols );
+    for ( int n_r = 0; n_r < dst_rows; n_r++ )
+        for ( int n_c = 0; n_c < dst_cols; n_c++ )
+        {
+            const double w = (double)M[6] * n_c + (double)M[7] * n_r + M[8];
+            const double inv_w = w != 0. ? 1. / w : 0.;
+            remap_map_store( map, n_r * dst_cols + n_c
+                           , ((double)M[0] * n_c + (double)M[1] * n_r + M[2]) * inv_w
+                           , ((double)M[3] * n_c + (double)M[4] * n_r + M[5]) * inv_w
+                           );
+        }
+    return map;
+}
+
+void pencil_remap_map_destroy( pencil_remap_map *map )
+{
+    if ( !map )
+        return;
+    free(map->xy);
+    free(map->fraction);
+    free(map);
+}
+
+void pencil_remap_linear( const int src_rows, const int src_cols, const int src_step, const float src[]
+                        , const int dst_rows, const int dst_cols, const int dst_step,       float dst[]
+                        , const int map_step, const float map_x[], const float map_y[]
+                        , const int border_type, const float border_value
+                        )
+{
+    remap( src_rows, src_cols, src_step, (const float(*)[src_step])src
+         , dst_rows, dst_cols, dst_step, (      float(*)[dst_step])dst
+         , map_step, (const float(*)[map_step])map_x, (const float(*)[map_step])map_y
+         , border_type, border_value
+         );
+}
+
+void pencil_warpPerspective_linear( const int src_rows, const int src_cols, const int src_step, const float src[]
+                                  , const int dst_rows, const int dst_cols, const int dst_step,       float dst[]
+                                  , const float M[]
+                                  , const int border_type, const float border_value
+                                  )
+{
+    perspective( src_rows, src_cols, src_step, (const float(*)[src_step])src
+               , dst_rows, dst_cols, dst_step, (      float(*)[dst_step])dst
+               , (const float(*)[3])M
+               , border_type, border_value
+               );
+}
+
+void pencil_remap_linear_map( const pencil_remap_map *map
+                            , const int src_rows, const int src_cols, const int src_step, const float src[]
+                            , const int dst_step, float dst[]
+                            , const int border_type, const float border_value
+                            )
+{
+    assert( src_rows < 32767 && src_cols < 32767 );
+    remap_compiled( src_rows, src_cols, src_step, (const float(*)[src_step])src
+                  , map->rows, map->cols, dst_step, (float(*)[dst_step])dst
+                  , (const int16_t(*)[map->cols][2])map->xy, (const uint16_t(*)[map->cols])map->fraction, (const float(*)[4])map->table
+                  , border_type, border_value
+                  );
+}
@@ -0,0 +1,71 @@
+//Implementation file. Included once per coordinate source with REMAP_NAME
+//(function name) defined: the float maps map_x and map_y, or with
+//REMAP_PERSPECTIVE the homography m. Interpolation is in float.
+//
+//Pixels whose four taps are inside src read them directly, the others
+//extrapolate with border_type, their integer parts saturated to the
+//BORDER_COORD_* range first.
+
+static void REMAP_NAME( const int src_rows, const int src_cols, const int src_step, const float src[static const restrict src_rows][src_step]
+                      , const int dst_rows, const int dst_cols, const int dst_step,       float dst[static const restrict dst_rows][dst_step]
+#ifdef REMAP_PERSPECTIVE
+                      , const float m[static const restrict 3][3]
+#else
+                      , const int map_step
+                      , const float map_x[static const restrict dst_rows][map_step]
+                      , const float map_y[static const restrict dst_rows][map_step]
+#endif
+                      , const int border_type, const float border_value
+                      )
+{
+#pragma scop
+    __pencil_assume(src_rows >  0);
+    __pencil_assume(src_cols >  0);
+    __pencil_assume(src_step >= src_cols);
+    __pencil_assume(dst_rows >  0);
+    __pencil_assume(dst_cols >  0);
+    __pencil_assume(dst_step >= dst_cols);
+#ifndef REMAP_PERSPECTIVE
+    __pencil_assume(map_step >= dst_cols);
+#endif
+
+    __pencil_kill(dst);
+
+    #pragma pencil independent
+    for ( int n_r=0; n_r<dst_rows; n_r++ )
+    {
+        #pragma pencil independent
+        for ( int n_c=0; n_c<dst_cols; n_c++ )
+        {
+#ifdef REMAP_PERSPECTIVE
+            const float w = m[2][0] * n_c + m[2][1] * n_r + m[2][2];
+            const float inv_w = w != 0.f ? 1.f / w : 0.f;
+            const float x = (m[0][0] * n_c + m[0][1] * n_r + m[0][2]) * inv_w;
+            const float y = (m[1][0] * n_c + m[1][1] * n_r + m[1][2]) * inv_w;
+#else
+            const float x = map_x[n_r][n_c];
+            const float y = map_y[n_r][n_c];
+#endif
+            const int col = fminf(fmaxf(floorf(x), BORDER_COORD_MIN), BORDER_COORD_MAX);
+            const int row = fminf(fmaxf(floorf(y), BORDER_COORD_MIN), BORDER_COORD_MAX);
+            const float c = x - floorf(x);
+            const float r = y - floorf(y);
+
+            if ( row >= 0 && row < src_rows - 1 && col >= 0 && col < src_cols - 1 )
+            {
+                dst[n_r][n_c] = mixf( mixf(src[row][col    ], src[row + 1][col    ], r)
+                                    , mixf(src[row][col + 1], src[row + 1][col + 1], r), c);
+            }
+            else
+            {
+                const float A00 = border_fetch(src, row    , col    , src_rows, src_cols, border_type, border_value);
+                const float A10 = border_fetch(src, row + 1, col    , src_rows, src_cols, border_type, border_value);
+                const float A01 = border_fetch(src, row    , col + 1, src_rows, src_cols, border_type, border_value);
+                const float A11 = border_fetch(src, row + 1, col + 1, src_rows, src_cols, border_type, border_value);
+                dst[n_r][n_c] = mixf( mixf(A00, A10, r), mixf(A01, A11, r), c);
+            }
+        }
+    }
+    __pencil_kill(src);
+#pragma endscop
+}
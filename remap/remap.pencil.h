@@ -0,0 +1,62 @@
+#ifndef REMAP_PENCIL_H
+#define REMAP_PENCIL_H
+
+#include <stdint.h>
+#include "border.pencil.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    // Fractional bits of the coordinates of a compiled map, like
+    // cv::INTER_BITS: the weights of a pixel come from a table of
+    // REMAP_TABLE_SIZE entries
+    #define REMAP_INTER_BITS 5
+    #define REMAP_TABLE_SIZE (1 << (2 * REMAP_INTER_BITS))
+
+    // Bilinear remap like cv::remap with INTER_LINEAR: dst[n_r][n_c] is src at
+    // column map_x[n_r][n_c] and row map_y[n_r][n_c], interpolated in float.
+    // map_step counts floats. border_type is one of PENCIL_BORDER_*,
+    // border_value is used by PENCIL_BORDER_CONSTANT.
+    void pencil_remap_linear( const int src_rows, const int src_cols, const int src_step, const float src[]
+                            , const int dst_rows, const int dst_cols, const int dst_step,       float dst[]
+                            , const int map_step, const float map_x[], const float map_y[]
+                            , const int border_type, const float border_value
+                            );
+
+    // Bilinear perspective warp like cv::warpPerspective with INTER_LINEAR |
+    // WARP_INVERSE_MAP: M is the row-major 3x3 matrix taking the homogeneous
+    // dst (column, row, 1) to src.
+    void pencil_warpPerspective_linear( const int src_rows, const int src_cols, const int src_step, const float src[]
+                                      , const int dst_rows, const int dst_cols, const int dst_step,       float dst[]
+                                      , const float M[]
+                                      , const int border_type, const float border_value
+                                      );
+
+    // A map converted once for many pencil_remap_linear_map calls, like
+    // cv::convertMaps to CV_16SC2: each dst pixel holds the int16 source
+    // column and row and the REMAP_INTER_BITS fractions of both, an index
+    // into a table of the four weights. Sources are limited to 32767 pixels
+    // a side.
+    typedef struct pencil_remap_map pencil_remap_map;
+
+    pencil_remap_map * pencil_remap_map_create( const int dst_rows, const int dst_cols
+                                              , const int map_step, const float map_x[], const float map_y[]
+                                              );
+    // The map of pencil_warpPerspective_linear with M
+    pencil_remap_map * pencil_remap_map_create_perspective( const int dst_rows, const int dst_cols, const float M[] );
+    void pencil_remap_map_destroy( pencil_remap_map * map );
+
+    // pencil_remap_linear through a compiled map of dst's size, the result
+    // of cv::remap with the converted maps
+    void pencil_remap_linear_map( const pencil_remap_map * map
+                                , const int src_rows, const int src_cols, const int src_step, const float src[]
+                                , const int dst_step, float dst[]
+                                , const int border_type, const float border_value
+                                );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
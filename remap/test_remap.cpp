@@ -0,0 +1,265 @@
+#include "utility.hpp"
+#include "remap.pencil.h"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/ocl/ocl.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <prl.h>
+#include <chrono>
+
+namespace
+{
+    // Maps of a radial lens undistortion about the image centre
+    void undistort_maps( const cv::Size& size, cv::Mat& map_x, cv::Mat& map_y )
+    {
+        const float k = 4e-7f * 1600 * 1600 / (size.width * size.width);
+        const float c_x = size.width / 2.f, c_y = size.height / 2.f;
+        map_x.create( size, CV_32F );
+        map_y.create( size, CV_32F );
+        for ( int n_r = 0; n_r < size.height; n_r++ )
+            for ( int n_c = 0; n_c < size.width; n_c++ ) {
+                const float d_x = n_c - c_x, d_y = n_r - c_y;
+                const float scale = 1 + k * (d_x * d_x + d_y * d_y);
+                map_x.at<float>(n_r, n_c) = c_x + d_x * scale;
+                map_y.at<float>(n_r, n_c) = c_y + d_y * scale;
+            }
+    }
+}
+
+void time_remap( const std::vector<carp::record_t>& pool, int iteration )
+{
+    bool first_execution_opencv = true, first_execution_pencil = true;
+
+    carp::Timing timing("remap");
+
+    for ( int q=0; q<iteration; q++ ) {
+        for ( auto & item : pool ) {
+            cv::Mat cpu_gray;
+            cv::cvtColor( item.cpuimg(), cpu_gray, CV_RGB2GRAY );
+            cpu_gray.convertTo( cpu_gray, CV_32F, 1.0/255. );
+
+            cv::Mat map_x, map_y;
+            undistort_maps( cpu_gray.size(), map_x, map_y );
+
+            cv::Mat cpu_result, gpu_result, pen_result;
+            std::chrono::duration<double> elapsed_time_cpu, elapsed_time_gpu_p_copy;
+
+            {
+                const auto cpu_start = std::chrono::high_resolution_clock::now();
+                cv::remap( cpu_gray, cpu_result, map_x, map_y, cv::INTER_LINEAR, cv::BORDER_CONSTANT );
+                const auto cpu_end = std::chrono::high_resolution_clock::now();
+                elapsed_time_cpu = cpu_end - cpu_start;
+            }
+            {
+                // Execute the kernel at least once before starting to take time measurements so that the OpenCV kernel gets compiled. The following run is not included in time measurements.
+                if (first_execution_opencv)
+                {
+                    cv::ocl::oclMat gpu_gray(cpu_gray), gpu_map_x(map_x), gpu_map_y(map_y);
+                    cv::ocl::oclMat gpu_remap;
+                    cv::ocl::remap( gpu_gray, gpu_remap, gpu_map_x, gpu_map_y, cv::INTER_LINEAR, cv::BORDER_CONSTANT );
+                    first_execution_opencv = false;
+                }
+
+                const auto gpu_start_copy = std::chrono::high_resolution_clock::now();
+                cv::ocl::oclMat gpu_gray(cpu_gray), gpu_map_x(map_x), gpu_map_y(map_y);
+                cv::ocl::oclMat gpu_remap;
+                cv::ocl::remap( gpu_gray, gpu_remap, gpu_map_x, gpu_map_y, cv::INTER_LINEAR, cv::BORDER_CONSTANT );
+                gpu_result = gpu_remap;
+                const auto gpu_end_copy = std::chrono::high_resolution_clock::now();
+                elapsed_time_gpu_p_copy = gpu_end_copy - gpu_start_copy;
+            }
+            {
+                // verifying the pencil code
+                pen_result.create( cpu_gray.size(), CV_32F );
+
+                if (first_execution_pencil)
+                {
+                    pencil_remap_linear( cpu_gray.rows, cpu_gray.cols, cpu_gray.step1(), cpu_gray.ptr<float>(), pen_result.rows, pen_result.cols, pen_result.step1(), pen_result.ptr<float>(), map_x.step1(), map_x.ptr<float>(), map_y.ptr<float>(), PENCIL_BORDER_CONSTANT, 0.f );
+                    first_execution_pencil = false;
+                }
+
+                prl_timings_reset();
+                prl_timings_start();
+                pencil_remap_linear( cpu_gray.rows, cpu_gray.cols, cpu_gray.step1(), cpu_gray.ptr<float>()
+                                   , pen_result.rows, pen_result.cols, pen_result.step1(), pen_result.ptr<float>()
+                                   , map_x.step1(), map_x.ptr<float>(), map_y.ptr<float>()
+                                   , PENCIL_BORDER_CONSTANT, 0.f
+                                   );
+                prl_timings_stop();
+                // Dump execution times for PENCIL code.
+                prl_timings_dump();
+            }
+            // Verifying the results. OpenCV quantises the interpolation
+            // weights to INTER_BITS.
+            if ( (cv::norm(cpu_result, gpu_result, cv::NORM_INF) > 0.05) || (cv::norm(cpu_result, pen_result, cv::NORM_INF) > 0.05) )
+            {
+                cv::Mat gpu_result8;
+                cv::Mat cpu_result8;
+                cv::Mat pen_result8;
+
+                gpu_result.convertTo( gpu_result8, CV_8UC1, 255. );
+                cpu_result.convertTo( cpu_result8, CV_8UC1, 255. );
+                pen_result.convertTo( pen_result8, CV_8UC1, 255. );
+
+                cv::imwrite( "gpu_remap.png", gpu_result8 );
+                cv::imwrite( "cpu_remap.png", cpu_result8 );
+                cv::imwrite( "pencil_remap.png", pen_result8 );
+
+                throw std::runtime_error("The GPU results are not equivalent with the CPU results.");
+            }
+            // Dump execution times for OpenCV calls.
+            timing.print( elapsed_time_cpu, elapsed_time_gpu_p_copy );
+        }
+    }
+}
+
+// The same maps every frame, as for a fixed camera: converted on every call
+// (cache off) or once for all frames (cache on). The compiled map gives the
+// result of cv::remap with cv::convertMaps' CV_16SC2 maps.
+void time_remap_map_cache( const std::vector<carp::record_t>& pool, int frames )
+{
+    std::cout << "Measuring remap with the compiled map cache on and off" << std::endl;
+    std::cout << "  OpenCV (ms)  float maps (ms)  cache off (ms)  cache on (ms)  cache off (Mpixel/s)  cache on (Mpixel/s)" << std::endl;
+
+    for ( auto & item : pool ) {
+        cv::Mat cpu_gray;
+        cv::cvtColor( item.cpuimg(), cpu_gray, CV_RGB2GRAY );
+        cpu_gray.convertTo( cpu_gray, CV_32F, 1.0/255. );
+
+        cv::Mat map_x, map_y, map_xy, map_fraction;
+        undistort_maps( cpu_gray.size(), map_x, map_y );
+        cv::convertMaps( map_x, map_y, map_xy, map_fraction, CV_16SC2 );
+
+        cv::Mat cpu_result, float_result( cpu_gray.size(), CV_32F ), off_result( cpu_gray.size(), CV_32F ), on_result( cpu_gray.size(), CV_32F );
+        std::chrono::duration<double> elapsed_time_cpu(0), elapsed_time_float(0), elapsed_time_off(0), elapsed_time_on(0);
+
+        for ( int frame = 0; frame < frames; frame++ ) {
+            const auto cpu_start = std::chrono::high_resolution_clock::now();
+            cv::remap( cpu_gray, cpu_result, map_x, map_y, cv::INTER_LINEAR, cv::BORDER_CONSTANT );
+            const auto cpu_end = std::chrono::high_resolution_clock::now();
+            elapsed_time_cpu += cpu_end - cpu_start;
+        }
+        for ( int frame = 0; frame < frames; frame++ ) {
+            const auto float_start = std::chrono::high_resolution_clock::now();
+            pencil_remap_linear( cpu_gray.rows, cpu_gray.cols, cpu_gray.step1(), cpu_gray.ptr<float>()
+                               , float_result.rows, float_result.cols, float_result.step1(), float_result.ptr<float>()
+                               , map_x.step1(), map_x.ptr<float>(), map_y.ptr<float>()
+                               , PENCIL_BORDER_CONSTANT, 0.f
+                               );
+            const auto float_end = std::chrono::high_resolution_clock::now();
+            elapsed_time_float += float_end - float_start;
+        }
+        for ( int frame = 0; frame < frames; frame++ ) {
+            const auto off_start = std::chrono::high_resolution_clock::now();
+            pencil_remap_map *map = pencil_remap_map_create( cpu_gray.rows, cpu_gray.cols, map_x.step1(), map_x.ptr<float>(), map_y.ptr<float>() );
+            pencil_remap_linear_map( map, cpu_gray.rows, cpu_gray.cols, cpu_gray.step1(), cpu_gray.ptr<float>(), off_result.step1(), off_result.ptr<float>(), PENCIL_BORDER_CONSTANT, 0.f );
+            pencil_remap_map_destroy( map );
+            const auto off_end = std::chrono::high_resolution_clock::now();
+            elapsed_time_off += off_end - off_start;
+        }
+        {
+            pencil_remap_map *map = pencil_remap_map_create( cpu_gray.rows, cpu_gray.cols, map_x.step1(), map_x.ptr<float>(), map_y.ptr<float>() );
+            for ( int frame = 0; frame < frames; frame++ ) {
+                const auto on_start = std::chrono::high_resolution_clock::now();
+                pencil_remap_linear_map( map, cpu_gray.rows, cpu_gray.cols, cpu_gray.step1(), cpu_gray.ptr<float>(), on_result.step1(), on_result.ptr<float>(), PENCIL_BORDER_CONSTANT, 0.f );
+                const auto on_end = std::chrono::high_resolution_clock::now();
+                elapsed_time_on += on_end - on_start;
+            }
+            pencil_remap_map_destroy( map );
+        }
+
+        cv::Mat fixed_result;
+        cv::remap( cpu_gray, fixed_result, map_xy, map_fraction, cv::INTER_LINEAR, cv::BORDER_CONSTANT );
+        if ( cv::norm(cpu_result, float_result, cv::NORM_INF) > 0.05 || cv::norm(fixed_result, on_result, cv::NORM_INF) > 1e-5 || cv::norm(off_result, on_result, cv::NORM_INF) > 0 )
+            throw std::runtime_error("The PENCIL remap results are not equivalent with the C++ results.");
+
+        const double pixels = double(cpu_gray.total()) * frames;
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << std::setw(13) << elapsed_time_cpu.count() * 1e3 << " " << std::setw(16) << elapsed_time_float.count() * 1e3 << " "
+                  << std::setw(15) << elapsed_time_off.count() * 1e3 << " " << std::setw(14) << elapsed_time_on.count() * 1e3 << " "
+                  << std::setw(21) << pixels / elapsed_time_off.count() * 1e-6 << " " << std::setw(20) << pixels / elapsed_time_on.count() * 1e-6 << std::endl;
+    }
+}
+
+void time_warpPerspective( const std::vector<carp::record_t>& pool )
+{
+    std::cout << "Measuring perspective warp" << std::endl;
+    std::cout << "  OpenCV (ms)  direct (ms)  compiled map (ms)  direct max error  map max error" << std::endl;
+
+    // Inverse map (dst -> src) of a mild homography
+    std::vector<float> transform_data = {  0.9f  ,  0.05f , 30.0f
+                                        , -0.03f ,  1.02f , 10.0f
+                                        ,  2e-5f , -1e-5f ,  1.0f
+                                        };
+    const cv::Mat transform( 3, 3, CV_32F, transform_data.data() );
+
+    for ( auto & item : pool ) {
+        cv::Mat cpu_gray;
+        cv::cvtColor( item.cpuimg(), cpu_gray, CV_RGB2GRAY );
+        cpu_gray.convertTo( cpu_gray, CV_32F, 1.0/255. );
+
+        cv::Mat cpu_result, direct_result( cpu_gray.size(), CV_32F ), map_result( cpu_gray.size(), CV_32F );
+        std::chrono::duration<double,std::milli> elapsed_time_cpu, elapsed_time_direct, elapsed_time_map;
+        {
+            const auto cpu_start = std::chrono::high_resolution_clock::now();
+            cv::warpPerspective( cpu_gray, cpu_result, transform, cpu_gray.size(), cv::INTER_LINEAR | cv::WARP_INVERSE_MAP, cv::BORDER_CONSTANT );
+            const auto cpu_end = std::chrono::high_resolution_clock::now();
+            elapsed_time_cpu = cpu_end - cpu_start;
+        }
+        {
+            const auto direct_start = std::chrono::high_resolution_clock::now();
+            pencil_warpPerspective_linear( cpu_gray.rows, cpu_gray.cols, cpu_gray.step1(), cpu_gray.ptr<float>()
+                                         , direct_result.rows, direct_result.cols, direct_result.step1(), direct_result.ptr<float>()
+                                         , transform.ptr<float>()
+                                         , PENCIL_BORDER_CONSTANT, 0.f
+                                         );
+            const auto direct_end = std::chrono::high_resolution_clock::now();
+            elapsed_time_direct = direct_end - direct_start;
+        }
+        {
+            pencil_remap_map *map = pencil_remap_map_create_perspective( cpu_gray.rows, cpu_gray.cols, transform.ptr<float>() );
+            const auto map_start = std::chrono::high_resolution_clock::now();
+            pencil_remap_linear_map( map, cpu_gray.rows, cpu_gray.cols, cpu_gray.step1(), cpu_gray.ptr<float>(), map_result.step1(), map_result.ptr<float>(), PENCIL_BORDER_CONSTANT, 0.f );
+            const auto map_end = std::chrono::high_resolution_clock::now();
+            elapsed_time_map = map_end - map_start;
+            pencil_remap_map_destroy( map );
+        }
+        const double direct_error = cv::norm(cpu_result, direct_result, cv::NORM_INF);
+        const double map_error    = cv::norm(cpu_result, map_result, cv::NORM_INF);
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << std::setw(13) << elapsed_time_cpu.count() << " " << std::setw(12) << elapsed_time_direct.count() << " "
+                  << std::setw(18) << elapsed_time_map.count() << " " << std::setw(17) << direct_error << " " << std::setw(14) << map_error << std::endl;
+
+        // OpenCV quantises the interpolation weights to INTER_BITS
+        if ( direct_error > 0.05 || map_error > 0.05 )
+            throw std::runtime_error("The PENCIL results are not equivalent with the C++ results.");
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    prl_init((prl_init_flags)(PRL_TARGET_DEVICE_DYNAMIC | PRL_PROFILING_ENABLED));
+
+    try {
+        std::cout << "This executable is iterating over all the files passed to it as an argument. " << std::endl;
+
+        auto pool = carp::get_pool(argc, argv);
+
+#ifdef RUN_ONLY_ONE_EXPERIMENT
+        time_remap( pool, 1 );
+#else
+        time_remap( pool, 20 );
+        time_remap_map_cache( pool, 10 );
+        time_warpPerspective( pool );
+#endif
+
+        prl_shutdown();
+        return EXIT_SUCCESS;
+    } catch(const std::exception& e) {
+        std::cout << e.what() << std::endl;
+
+        prl_shutdown();
+        return EXIT_FAILURE;
+    }
+}
@@ -1,15 +1,60 @@
 #include "resize.pencil.h"
 #include <pencil.h>
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
 
-static void resize( const int original_rows
-                  , const int original_cols
-                  , const int original_step
-                  , const unsigned char original[static const restrict original_rows][original_step]
-                  , const int resampled_rows
-                  , const int resampled_cols
-                  , const int resampled_step
-                  , unsigned char resampled[static const restrict resampled_rows][resampled_step]
-                  )
+#define RESIZE_COEF_BITS  11    // fixed point weights, 1.0 = 1 << RESIZE_COEF_BITS
+#define RESIZE_COEF_SCALE (1 << RESIZE_COEF_BITS)
+#define RESIZE_LINEAR_TAPS 2
+#define RESIZE_CUBIC_TAPS  4
+#define RESIZE_LANCZOS4_TAPS 8
+
+#define RESIZE_NAME     resize_linear
+#define RESIZE_CHANNELS 1
+#include "resize.pencil.detail.h"
+#undef RESIZE_NAME
+#undef RESIZE_CHANNELS
+
+#define RESIZE_NAME     resize_linear_c3
+#define RESIZE_CHANNELS 3
+#include "resize.pencil.detail.h"
+#undef RESIZE_NAME
+#undef RESIZE_CHANNELS
+
+#define RESIZE_NAME     resize_linear_c4
+#define RESIZE_CHANNELS 4
+#include "resize.pencil.detail.h"
+#undef RESIZE_NAME
+#undef RESIZE_CHANNELS
+
+/* Area averaging for downscaling: resampled pixel (n_r, n_c) is
+ * sum over i, j of y_weight[n_r][i] * x_weight[n_c][j]
+ *              * original[y_index[n_r][i]][x_index[n_c][j]]
+ * in float, the weights being the fractions of the resampled pixel the
+ * original pixels cover. Padding taps have weight 0.
+ *
+ * Each band of rows first blends the original rows of a resampled row into
+ * column, whole rows at a time and two rows per pass over column, then
+ * blends the columns of column. Every original pixel is read about once and
+ * the horizontal pass gathers from a single row. */
+static void resize_area( const int original_rows
+                       , const int original_cols
+                       , const int original_step
+                       , const uint8_t original[static const restrict original_rows][original_step]
+                       , const int resampled_rows
+                       , const int resampled_cols
+                       , const int resampled_step
+                       , uint8_t resampled[static const restrict resampled_rows][resampled_step]    //out
+                       , const int x_taps
+                       , const int x_index[static const restrict resampled_cols][x_taps]
+                       , const float x_weight[static const restrict resampled_cols][x_taps]
+                       , const int y_taps
+                       , const int y_index[static const restrict resampled_rows][y_taps]
+                       , const float y_weight[static const restrict resampled_rows][y_taps]
+                       , const int bands
+                       , float column[static const restrict bands][original_cols]
+                       )
 {
 #pragma scop
     __pencil_assume(original_rows  >  0);
@@ -18,62 +63,628 @@ static void resize( const int original_rows
     __pencil_assume(resampled_rows >  0);
     __pencil_assume(resampled_cols >  0);
     __pencil_assume(resampled_step >= resampled_cols);
+    __pencil_assume(x_taps         >  0);
+    __pencil_assume(y_taps         >  0);
+    __pencil_assume(bands          >  0);
+    __pencil_assume(bands          <= resampled_rows);
 
     __pencil_kill(resampled);
-    {
-        int o_h = original_rows;
-        int o_w = original_cols;
-        int n_h = resampled_rows;
-        int n_w = resampled_cols;
+    __pencil_kill(column);
 
-        #pragma pencil independent
-        for ( int n_r = 0; n_r < resampled_rows; n_r++ )
+    #pragma pencil independent
+    for ( int b = 0; b < bands; b++ )
+    {
+        for ( int n_r = b * resampled_rows / bands; n_r < (b + 1) * resampled_rows / bands; n_r++ )
         {
+            #pragma pencil independent
+            for ( int o_c = 0; o_c < original_cols; o_c++ )
+                column[b][o_c] = 0;
+            for ( int t = 0; t + 1 < y_taps; t += 2 )
+            {
+                const int   row_0    = y_index[n_r][t];
+                const int   row_1    = y_index[n_r][t + 1];
+                const float weight_0 = y_weight[n_r][t];
+                const float weight_1 = y_weight[n_r][t + 1];
+                #pragma pencil independent
+                for ( int o_c = 0; o_c < original_cols; o_c++ )
+                    column[b][o_c] += weight_0 * original[row_0][o_c] + weight_1 * original[row_1][o_c];
+            }
+            if ( y_taps % 2 )
+            {
+                const int   row    = y_index[n_r][y_taps - 1];
+                const float weight = y_weight[n_r][y_taps - 1];
+                #pragma pencil independent
+                for ( int o_c = 0; o_c < original_cols; o_c++ )
+                    column[b][o_c] += weight * original[row][o_c];
+            }
+
             #pragma pencil independent
             for ( int n_c = 0; n_c < resampled_cols; n_c++ )
             {
-                float o_r = ( n_r + 0.5 ) * (o_h) / (n_h) - 0.5;
-                float o_c = ( n_c + 0.5 ) * (o_w) / (n_w) - 0.5;
+                float sum = 0;
+                for ( int t = 0; t < x_taps; t++ )
+                    sum += x_weight[n_c][t] * column[b][x_index[n_c][t]];
+                resampled[n_r][n_c] = iclampi((int)rintf(sum), 0, 255);
+            }
+        }
+    }
+#pragma endscop
+}
+
+#define RESIZE_NAME  resize_decimate_2
+#define RESIZE_SHIFT 1
+#include "resize.pencil.detail.h"
+#undef RESIZE_NAME
+#undef RESIZE_SHIFT
+
+#define RESIZE_NAME  resize_decimate_4
+#define RESIZE_SHIFT 2
+#include "resize.pencil.detail.h"
+#undef RESIZE_NAME
+#undef RESIZE_SHIFT
 
-                float r = o_r - floorf(o_r);
-                float c = o_c - floorf(o_c);
+#define RESIZE_NAME  resize_decimate_8
+#define RESIZE_SHIFT 3
+#include "resize.pencil.detail.h"
+#undef RESIZE_NAME
+#undef RESIZE_SHIFT
 
-                int coord_00_r = iclampi( (int) floorf(o_r), 0, o_h - 1 );
-                int coord_00_c = iclampi( (int) floorf(o_c), 0, o_w - 1 );
+#define RESIZE_NAME        resize_cubic
+#define RESIZE_SHRINK_NAME resize_cubic_shrink
+#define RESIZE_TAPS        RESIZE_CUBIC_TAPS
+#include "resize.pencil.detail.h"
+#undef RESIZE_NAME
+#undef RESIZE_SHRINK_NAME
+#undef RESIZE_TAPS
 
-                int coord_01_r = coord_00_r;
-                int coord_01_c = iclampi( coord_00_c + 1, 0, o_w - 1 );
+#define RESIZE_NAME        resize_lanczos4
+#define RESIZE_SHRINK_NAME resize_lanczos4_shrink
+#define RESIZE_TAPS        RESIZE_LANCZOS4_TAPS
+#include "resize.pencil.detail.h"
+#undef RESIZE_NAME
+#undef RESIZE_SHRINK_NAME
+#undef RESIZE_TAPS
 
-                int coord_10_r = iclampi( coord_00_r + 1, 0, o_h - 1 );
-                int coord_10_c = coord_00_c;
+/* Source indices and weights of the resampled coordinates along one axis,
+ * like cv::resize with INTER_LINEAR, or with INTER_AREA when it enlarges:
+ * then a resampled pixel only blends the two original pixels it straddles,
+ * and copies the one it falls within. Samples left of the first original
+ * pixel or right of the last take that pixel alone. */
+static void resize_axis_linear( const int original, const int resampled, const int area, int index[][RESIZE_LINEAR_TAPS], int16_t weight[][RESIZE_LINEAR_TAPS] )
+{
+    const double inv_scale = (double)resampled / original;
+    const double scale     = 1. / inv_scale;
+    for ( int n = 0; n < resampled; n++ )
+    {
+        float f;
+        int   s;
+        if ( area )
+        {
+            s = (int)floor(n * scale);
+            f = (float)((n + 1) - (s + 1) * inv_scale);
+            f = f <= 0 ? 0.f : f - floorf(f);
+        }
+        else
+        {
+            f = (float)((n + 0.5) * scale - 0.5);
+            s = (int)floorf(f);
+            f -= s;
+        }
+        if ( s < 0 )
+        {
+            s = 0;
+            f = 0;
+        }
+        if ( s >= original - 1 )
+        {
+            s = original - 1;
+            f = 0;
+        }
+        index[n][0]  = s;
+        index[n][1]  = imin(s + 1, original - 1);
+        weight[n][0] = (int16_t)lrintf((1.f - f) * RESIZE_COEF_SCALE);
+        weight[n][1] = (int16_t)lrintf(f * RESIZE_COEF_SCALE);
+    }
+}
 
-                int coord_11_r = iclampi( coord_00_r + 1, 0, o_h - 1 );
-                int coord_11_c = iclampi( coord_00_c + 1, 0, o_w - 1 );
+/* Most original pixels one resampled pixel overlaps when downscaling. */
+static int resize_area_taps( const int original, const int resampled )
+{
+    return (int)ceil((double)original / resampled) + 1;
+}
 
-                unsigned char A00 = original[coord_00_r][coord_00_c];
-                unsigned char A10 = original[coord_10_r][coord_10_c];
-                unsigned char A01 = original[coord_01_r][coord_01_c];
-                unsigned char A11 = original[coord_11_r][coord_11_c];
+/* The overlaps of the resampled pixels with the original ones along one
+ * axis, like cv::resize with INTER_AREA when it shrinks: the partial pixels
+ * at both ends of a resampled pixel weigh what they cover of it. */
+static void resize_axis_area( const int original, const int resampled, const int taps, int index[][taps], float weight[][taps] )
+{
+    const double scale = 1. / ((double)resampled / original);
+    for ( int n = 0; n < resampled; n++ )
+    {
+        const double first = n * scale;
+        const double last  = first + scale;
+        const double width = fmin(scale, original - first);
+        int s1 = (int)ceil(first);
+        int s2 = imin((int)floor(last), original - 1);
+        s1 = imin(s1, s2);
 
-                resampled[n_r][n_c] = mixf( mixf(A00, A10, r), mixf(A01, A11, r), c);
-            }
+        int t = 0;
+        if ( s1 - first > 1e-3 )
+        {
+            index[n][t]    = s1 - 1;
+            weight[n][t++] = (float)((s1 - first) / width);
+        }
+        for ( int s = s1; s < s2; s++ )
+        {
+            index[n][t]    = s;
+            weight[n][t++] = (float)(1.0 / width);
+        }
+        if ( last - s2 > 1e-3 )
+        {
+            index[n][t]    = s2;
+            weight[n][t++] = (float)(fmin(fmin(last - s2, 1.), width) / width);
+        }
+        for ( ; t < taps; t++ )
+        {
+            index[n][t]  = index[n][t - 1];
+            weight[n][t] = 0;
         }
     }
-    __pencil_kill(original);
-#pragma endscop
+}
+
+/* The weights of the 4 taps around x, the fraction past the second one,
+ * of the Keys cubic with a = -0.75 like cv::resize with INTER_CUBIC. */
+static void resize_cubic_weights( const float x, float weight[RESIZE_CUBIC_TAPS] )
+{
+    const float a = -0.75f;
+    weight[0] = ((a * (x + 1) - 5 * a) * (x + 1) + 8 * a) * (x + 1) - 4 * a;
+    weight[1] = ((a + 2) * x - (a + 3)) * x * x + 1;
+    weight[2] = ((a + 2) * (1 - x) - (a + 3)) * (1 - x) * (1 - x) + 1;
+    weight[3] = 1.f - weight[0] - weight[1] - weight[2];
+}
+
+/* The weights of the 8 taps around x, the fraction past the fourth one, of
+ * the Lanczos window with a = 4 like cv::resize with INTER_LANCZOS4,
+ * normalised to sum to 1. The sines of the taps are those of the first tap
+ * rotated by multiples of pi / 4. */
+static void resize_lanczos4_weights( const float x, float weight[RESIZE_LANCZOS4_TAPS] )
+{
+    static const double s45 = 0.70710678118654752440084436210485;
+    static const double rotation[RESIZE_LANCZOS4_TAPS][2] = { { 1, 0 }, { -s45, -s45 }, { 0, 1 }, { s45, -s45 }
+                                                            , { -1, 0 }, { s45, s45 }, { 0, -1 }, { -s45, s45 } };
+    if ( x < 1.1920929e-07f )    // FLT_EPSILON
+    {
+        for ( int t = 0; t < RESIZE_LANCZOS4_TAPS; t++ )
+            weight[t] = 0;
+        weight[3] = 1;
+        return;
+    }
+
+    const double y0 = -(x + 3) * 3.14159265358979323846 * 0.25;
+    const double s0 = sin(y0);
+    const double c0 = cos(y0);
+    float sum = 0;
+    for ( int t = 0; t < RESIZE_LANCZOS4_TAPS; t++ )
+    {
+        const double y = -(x + 3 - t) * 3.14159265358979323846 * 0.25;
+        weight[t] = (float)((rotation[t][0] * s0 + rotation[t][1] * c0) / (y * y));
+        sum += weight[t];
+    }
+    for ( int t = 0; t < RESIZE_LANCZOS4_TAPS; t++ )
+        weight[t] *= 1.f / sum;
+}
+
+/* Source indices and fixed point weights of the resampled coordinates along
+ * one axis for the cubic (4 taps) or Lanczos (8 taps) interpolation: the
+ * taps centre on the sample like INTER_LINEAR's and replicate the border. */
+static void resize_axis_interpolate( const int original, const int resampled, const int taps, int index[][taps], int16_t weight[][taps] )
+{
+    const double scale = 1. / ((double)resampled / original);
+    for ( int n = 0; n < resampled; n++ )
+    {
+        float f = (float)((n + 0.5) * scale - 0.5);
+        const int s = (int)floorf(f);
+        f -= s;
+
+        float w[RESIZE_LANCZOS4_TAPS];
+        if ( taps == RESIZE_CUBIC_TAPS )
+            resize_cubic_weights( f, w );
+        else
+            resize_lanczos4_weights( f, w );
+        for ( int t = 0; t < taps; t++ )
+        {
+            index[n][t]  = iclampi(s + t - (taps / 2 - 1), 0, original - 1);
+            weight[n][t] = (int16_t)lrintf(w[t] * RESIZE_COEF_SCALE);
+        }
+    }
+}
+
+#define RESIZE_TABLES_LINEAR  0    // fixed point, RESIZE_LINEAR_TAPS taps
+#define RESIZE_TABLES_AREA_UP 1    // fixed point, RESIZE_LINEAR_TAPS taps
+#define RESIZE_TABLES_AREA    2    // float, resize_area_taps() taps
+#define RESIZE_TABLES_CUBIC    3    // fixed point, RESIZE_CUBIC_TAPS taps
+#define RESIZE_TABLES_LANCZOS4 4    // fixed point, RESIZE_LANCZOS4_TAPS taps
+
+/* The tables of one geometry. They depend only on the sizes, so the last
+ * RESIZE_CACHE_ENTRIES geometries are kept for the calls that repeat them,
+ * the oldest replaced first. The cache is not thread safe. */
+typedef struct
+{
+    int kind;          // RESIZE_TABLES_*
+    int original_rows;
+    int original_cols;
+    int resampled_rows;
+    int resampled_cols;
+    int x_taps;
+    int y_taps;
+    int *x_index;      // resampled_cols x x_taps
+    int *y_index;      // resampled_rows x y_taps
+    void *x_weight;    // resampled_cols x x_taps, int16_t or float
+    void *y_weight;    // resampled_rows x y_taps
+} resize_tables;
+
+static resize_tables resize_cache[RESIZE_CACHE_ENTRIES];
+static int resize_cache_next = 0;
+
+static const resize_tables *resize_tables_get( const int kind, const int original_rows, const int original_cols, const int resampled_rows, const int resampled_cols )
+{
+    for ( int e = 0; e < RESIZE_CACHE_ENTRIES; e++ )
+    {
+        const resize_tables *tables = &resize_cache[e];
+        if ( tables->x_index && tables->kind == kind
+                             && tables->original_rows  == original_rows  && tables->original_cols  == original_cols
+                             && tables->resampled_rows == resampled_rows && tables->resampled_cols == resampled_cols )
+            return tables;
+    }
+
+    resize_tables *tables = &resize_cache[resize_cache_next];
+    resize_cache_next = (resize_cache_next + 1) % RESIZE_CACHE_ENTRIES;
+    free(tables->x_index);
+    free(tables->y_index);
+    free(tables->x_weight);
+    free(tables->y_weight);
+
+    const int fixed = kind != RESIZE_TABLES_AREA;
+    const int taps  = kind == RESIZE_TABLES_CUBIC ? RESIZE_CUBIC_TAPS : kind == RESIZE_TABLES_LANCZOS4 ? RESIZE_LANCZOS4_TAPS : RESIZE_LINEAR_TAPS;
+    tables->kind           = kind;
+    tables->original_rows  = original_rows;
+    tables->original_cols  = original_cols;
+    tables->resampled_rows = resampled_rows;
+    tables->resampled_cols = resampled_cols;
+    tables->x_taps   = fixed ? taps : resize_area_taps( original_cols, resampled_cols );
+    tables->y_taps   = fixed ? taps : resize_area_taps( original_rows, resampled_rows );
+    tables->x_index  = malloc(sizeof(int) * tables->x_taps * resampled_cols);
+    tables->y_index  = malloc(sizeof(int) * tables->y_taps * resampled_rows);
+    tables->x_weight = malloc((fixed ? sizeof(int16_t) : sizeof(float)) * tables->x_taps * resampled_cols);
+    tables->y_weight = malloc((fixed ? sizeof(int16_t) : sizeof(float)) * tables->y_taps * resampled_rows);
+    assert( tables->x_index && tables->y_index && tables->x_weight && tables->y_weight );
+    if ( kind == RESIZE_TABLES_CUBIC || kind == RESIZE_TABLES_LANCZOS4 )
+    {
+        resize_axis_interpolate( original_cols, resampled_cols, taps, (int(*)[taps])tables->x_index, (int16_t(*)[taps])tables->x_weight );
+        resize_axis_interpolate( original_rows, resampled_rows, taps, (int(*)[taps])tables->y_index, (int16_t(*)[taps])tables->y_weight );
+    }
+    else if ( fixed )
+    {
+        resize_axis_linear( original_cols, resampled_cols, kind == RESIZE_TABLES_AREA_UP, (int(*)[RESIZE_LINEAR_TAPS])tables->x_index, (int16_t(*)[RESIZE_LINEAR_TAPS])tables->x_weight );
+        resize_axis_linear( original_rows, resampled_rows, kind == RESIZE_TABLES_AREA_UP, (int(*)[RESIZE_LINEAR_TAPS])tables->y_index, (int16_t(*)[RESIZE_LINEAR_TAPS])tables->y_weight );
+    }
+    else
+    {
+        resize_axis_area( original_cols, resampled_cols, tables->x_taps, (int(*)[tables->x_taps])tables->x_index, (float(*)[tables->x_taps])tables->x_weight );
+        resize_axis_area( original_rows, resampled_rows, tables->y_taps, (int(*)[tables->y_taps])tables->y_index, (float(*)[tables->y_taps])tables->y_weight );
+    }
+    return tables;
+}
+
+/* resize_linear() of the resampled rows [first_row, last_row) through
+ * tables, or its channels = 3 or 4 version. */
+static void resize_linear_rows( const resize_tables *tables, const int first_row, const int last_row, const int channels
+                              , const int original_rows, const int original_cols, const int original_step, const uint8_t original[]
+                              , const int resampled_cols, const int resampled_step, uint8_t resampled[]
+                              )
+{
+    const int rows  = last_row - first_row;
+    const int bands = imin(rows, RESIZE_BANDS);
+    int (*ring)[RESIZE_LINEAR_TAPS][resampled_cols * channels] = malloc(sizeof(int) * bands * RESIZE_LINEAR_TAPS * resampled_cols * channels);
+    int (*held)[RESIZE_LINEAR_TAPS] = malloc(sizeof(int) * bands * RESIZE_LINEAR_TAPS);
+    assert( ring && held );
+    const int (*x_index)[RESIZE_LINEAR_TAPS]      = (const int(*)[RESIZE_LINEAR_TAPS])tables->x_index;
+    const int (*y_index)[RESIZE_LINEAR_TAPS]      = (const int(*)[RESIZE_LINEAR_TAPS])tables->y_index + first_row;
+    const int16_t (*x_weight)[RESIZE_LINEAR_TAPS] = (const int16_t(*)[RESIZE_LINEAR_TAPS])tables->x_weight;
+    const int16_t (*y_weight)[RESIZE_LINEAR_TAPS] = (const int16_t(*)[RESIZE_LINEAR_TAPS])tables->y_weight + first_row;
+    const uint8_t (*source)[original_step] = (const uint8_t(*)[original_step])original;
+    uint8_t (*target)[resampled_step] = (uint8_t(*)[resampled_step])(resampled + first_row * resampled_step);
+
+    switch ( channels )
+    {
+    case 1: resize_linear(    original_rows, original_cols, original_step, source, rows, resampled_cols, resampled_step, target, x_index, x_weight, y_index, y_weight, bands, ring, held ); break;
+    case 3: resize_linear_c3( original_rows, original_cols, original_step, source, rows, resampled_cols, resampled_step, target, x_index, x_weight, y_index, y_weight, bands, ring, held ); break;
+    case 4: resize_linear_c4( original_rows, original_cols, original_step, source, rows, resampled_cols, resampled_step, target, x_index, x_weight, y_index, y_weight, bands, ring, held ); break;
+    }
+
+    free(ring);
+    free(held);
+}
+
+/* resize_linear() through the tables of kind. */
+static void resize_linear_tables( const int kind
+                                , const int original_rows,  const int original_cols,  const int original_step,  const uint8_t original[]
+                                , const int resampled_rows, const int resampled_cols, const int resampled_step,       uint8_t resampled[]
+                                )
+{
+    const resize_tables *tables = resize_tables_get( kind, original_rows, original_cols, resampled_rows, resampled_cols );
+    resize_linear_rows( tables, 0, resampled_rows, 1, original_rows, original_cols, original_step, original, resampled_cols, resampled_step, resampled );
+}
+
+/* Marks the original rows the fixed point tables read. */
+static void resize_rows_touched( const resize_tables *tables, char touched[] )
+{
+    const int (*y_index)[RESIZE_LINEAR_TAPS] = (const int(*)[RESIZE_LINEAR_TAPS])tables->y_index;
+    for ( int n = 0; n < tables->resampled_rows; n++ )
+        for ( int t = 0; t < RESIZE_LINEAR_TAPS; t++ )
+            touched[y_index[n][t]] = 1;
+}
+
+/* Bytes of the rows marked in touched, clearing them. */
+static long resize_rows_read( const int rows, const int cols, char touched[] )
+{
+    long read = 0;
+    for ( int r = 0; r < rows; r++ )
+    {
+        read += touched[r] ? cols : 0;
+        touched[r] = 0;
+    }
+    return read;
 }
 
 void pencil_resize_LN( const int original_rows
                      , const int original_cols
                      , const int original_step
-                     , const unsigned char original[]
+                     , const uint8_t original[]
                      , const int resampled_rows
                      , const int resampled_cols
                      , const int resampled_step
-                     , unsigned char resampled[]
+                     , uint8_t resampled[]
                      )
 {
-    resize(  original_rows,  original_cols,  original_step, (const unsigned char(*)[ original_step])original
-          , resampled_rows, resampled_cols, resampled_step, (      unsigned char(*)[resampled_step])resampled
-          );
+    resize_linear_tables( RESIZE_TABLES_LINEAR, original_rows, original_cols, original_step, original, resampled_rows, resampled_cols, resampled_step, resampled );
+}
+
+void pencil_resize_AREA( const int original_rows
+                       , const int original_cols
+                       , const int original_step
+                       , const uint8_t original[]
+                       , const int resampled_rows
+                       , const int resampled_cols
+                       , const int resampled_step
+                       , uint8_t resampled[]
+                       )
+{
+    if ( original_rows < resampled_rows || original_cols < resampled_cols )
+    {
+        resize_linear_tables( RESIZE_TABLES_AREA_UP, original_rows, original_cols, original_step, original, resampled_rows, resampled_cols, resampled_step, resampled );
+        return;
+    }
+
+    // The same power of two in both directions averages whole blocks
+    const int factor = original_rows / resampled_rows;
+    if ( original_rows == resampled_rows * factor && original_cols == resampled_cols * factor )
+    {
+        switch ( factor )
+        {
+        case 2: resize_decimate_2( original_rows, original_cols, original_step, (const uint8_t(*)[original_step])original, resampled_rows, resampled_cols, resampled_step, (uint8_t(*)[resampled_step])resampled ); return;
+        case 4: resize_decimate_4( original_rows, original_cols, original_step, (const uint8_t(*)[original_step])original, resampled_rows, resampled_cols, resampled_step, (uint8_t(*)[resampled_step])resampled ); return;
+        case 8: resize_decimate_8( original_rows, original_cols, original_step, (const uint8_t(*)[original_step])original, resampled_rows, resampled_cols, resampled_step, (uint8_t(*)[resampled_step])resampled ); return;
+        }
+    }
+
+    const resize_tables *tables = resize_tables_get( RESIZE_TABLES_AREA, original_rows, original_cols, resampled_rows, resampled_cols );
+    const int x_taps = tables->x_taps;
+    const int y_taps = tables->y_taps;
+    const int bands  = imin(resampled_rows, RESIZE_BANDS);
+    float (*column)[original_cols] = malloc(sizeof(float) * bands * original_cols);
+    assert( column );
+
+    resize_area(  original_rows,  original_cols,  original_step, (const uint8_t(*)[ original_step])original
+               , resampled_rows, resampled_cols, resampled_step, (      uint8_t(*)[resampled_step])resampled
+               , x_taps, (const int(*)[x_taps])tables->x_index, (const float(*)[x_taps])tables->x_weight
+               , y_taps, (const int(*)[y_taps])tables->y_index, (const float(*)[y_taps])tables->y_weight
+               , bands, column
+               );
+
+    free(column);
+}
+
+void pencil_resize_LN_cn( const int original_rows
+                        , const int original_cols
+                        , const int original_step
+                        , const uint8_t original[]
+                        , const int resampled_rows
+                        , const int resampled_cols
+                        , const int resampled_step
+                        , uint8_t resampled[]
+                        , const int channels
+                        )
+{
+    assert( channels == 1 || channels == 3 || channels == 4 );
+    const resize_tables *tables = resize_tables_get( RESIZE_TABLES_LINEAR, original_rows, original_cols, resampled_rows, resampled_cols );
+    resize_linear_rows( tables, 0, resampled_rows, channels, original_rows, original_cols, original_step, original, resampled_cols, resampled_step, resampled );
+}
+
+/* The outputs are planned from the largest to the smallest. One that an
+ * earlier output no larger than the original covers RESIZE_LADDER_CASCADE
+ * times in both directions is resized from the smallest such output: that
+ * parent resolves more than twice the detail the output keeps, so the
+ * extra interpolation costs less than a bilinear shrink by as much already
+ * aliases. The others are resized from the original, together: the
+ * original streams by strips of RESIZE_LADDER_STRIP rows, and each of them
+ * makes the rows whose source rows the strip completes while the strip is
+ * still in cache. The cascades then run from their parents, which are
+ * already resampled. */
+void pencil_resize_LN_ladder( const int original_rows
+                            , const int original_cols
+                            , const int original_step
+                            , const uint8_t original[]
+                            , const int count
+                            , const int resampled_rows[]
+                            , const int resampled_cols[]
+                            , const int resampled_step[]
+                            , uint8_t *resampled[]
+                            , int parent[]
+                            , long *bytes_read
+                            )
+{
+    assert( count >= 0 && count <= RESIZE_LADDER_MAX );
+
+    // Largest first, stable
+    int order[RESIZE_LADDER_MAX];
+    for ( int i = 0; i < count; i++ )
+    {
+        int j = i;
+        for ( ; j > 0 && (long)resampled_rows[order[j - 1]] * resampled_cols[order[j - 1]] < (long)resampled_rows[i] * resampled_cols[i]; j-- )
+            order[j] = order[j - 1];
+        order[j] = i;
+    }
+
+    char *touched = calloc(original_rows, 1);
+    assert( touched );
+    for ( int i = 0; i < count; i++ )
+    {
+        const int k = order[i];
+        parent[k] = -1;
+        for ( int j = 0; j < i; j++ )
+        {
+            const int p = order[j];
+            if ( resampled_rows[p] <= original_rows && resampled_cols[p] <= original_cols
+              && resampled_rows[p] >= RESIZE_LADDER_CASCADE * resampled_rows[k] && resampled_cols[p] >= RESIZE_LADDER_CASCADE * resampled_cols[k] )
+                parent[k] = p;
+        }
+        if ( parent[k] < 0 )
+            resize_rows_touched( resize_tables_get( RESIZE_TABLES_LINEAR, original_rows, original_cols, resampled_rows[k], resampled_cols[k] ), touched );
+    }
+    long read = resize_rows_read( original_rows, original_cols, touched );
+
+    // The tables are looked up again for every strip: another output's may
+    // have replaced them in the cache
+    int done[RESIZE_LADDER_MAX] = { 0 };
+    for ( int strip_end = 0; strip_end < original_rows; )
+    {
+        strip_end = imin(strip_end + RESIZE_LADDER_STRIP, original_rows);
+        for ( int i = 0; i < count; i++ )
+        {
+            const int k = order[i];
+            if ( parent[k] >= 0 )
+                continue;
+            const resize_tables *tables = resize_tables_get( RESIZE_TABLES_LINEAR, original_rows, original_cols, resampled_rows[k], resampled_cols[k] );
+            const int (*y_index)[RESIZE_LINEAR_TAPS] = (const int(*)[RESIZE_LINEAR_TAPS])tables->y_index;
+            int last = done[k];
+            while ( last < resampled_rows[k] && (strip_end == original_rows || y_index[last][RESIZE_LINEAR_TAPS - 1] < strip_end) )
+                last++;
+            if ( last > done[k] )
+                resize_linear_rows( tables, done[k], last, 1, original_rows, original_cols, original_step, original, resampled_cols[k], resampled_step[k], resampled[k] );
+            done[k] = last;
+        }
+    }
+
+    for ( int i = 0; i < count; i++ )
+    {
+        const int k = order[i];
+        const int p = parent[k];
+        if ( p < 0 )
+            continue;
+        const resize_tables *tables = resize_tables_get( RESIZE_TABLES_LINEAR, resampled_rows[p], resampled_cols[p], resampled_rows[k], resampled_cols[k] );
+        resize_linear_rows( tables, 0, resampled_rows[k], 1, resampled_rows[p], resampled_cols[p], resampled_step[p], resampled[p], resampled_cols[k], resampled_step[k], resampled[k] );
+        resize_rows_touched( tables, touched );
+        read += resize_rows_read( resampled_rows[p], resampled_cols[p], touched );
+    }
+
+    free(touched);
+    if ( bytes_read )
+        *bytes_read = read;
+}
+
+void pencil_resize_CUBIC( const int original_rows
+                        , const int original_cols
+                        , const int original_step
+                        , const uint8_t original[]
+                        , const int resampled_rows
+                        , const int resampled_cols
+                        , const int resampled_step
+                        , uint8_t resampled[]
+                        )
+{
+    const resize_tables *tables = resize_tables_get( RESIZE_TABLES_CUBIC, original_rows, original_cols, resampled_rows, resampled_cols );
+    const int (*x_index)[RESIZE_CUBIC_TAPS]      = (const int(*)[RESIZE_CUBIC_TAPS])tables->x_index;
+    const int (*y_index)[RESIZE_CUBIC_TAPS]      = (const int(*)[RESIZE_CUBIC_TAPS])tables->y_index;
+    const int16_t (*x_weight)[RESIZE_CUBIC_TAPS] = (const int16_t(*)[RESIZE_CUBIC_TAPS])tables->x_weight;
+    const int16_t (*y_weight)[RESIZE_CUBIC_TAPS] = (const int16_t(*)[RESIZE_CUBIC_TAPS])tables->y_weight;
+    const int bands = imin(resampled_rows, RESIZE_BANDS);
+
+    if ( resampled_rows < original_rows )
+    {
+        int (*column)[original_cols] = malloc(sizeof(int) * bands * original_cols);
+        assert( column );
+        resize_cubic_shrink(  original_rows,  original_cols,  original_step, (const uint8_t(*)[ original_step])original
+                           , resampled_rows, resampled_cols, resampled_step, (      uint8_t(*)[resampled_step])resampled
+                           , x_index, x_weight, y_index, y_weight, bands, column
+                           );
+        free(column);
+    }
+    else
+    {
+        int (*ring)[RESIZE_CUBIC_TAPS][resampled_cols] = malloc(sizeof(int) * bands * RESIZE_CUBIC_TAPS * resampled_cols);
+        int (*held)[RESIZE_CUBIC_TAPS] = malloc(sizeof(int) * bands * RESIZE_CUBIC_TAPS);
+        int (*wide)[original_cols] = malloc(sizeof(int) * bands * original_cols);
+        assert( ring && held && wide );
+        resize_cubic(  original_rows,  original_cols,  original_step, (const uint8_t(*)[ original_step])original
+                    , resampled_rows, resampled_cols, resampled_step, (      uint8_t(*)[resampled_step])resampled
+                    , x_index, x_weight, y_index, y_weight, bands, ring, held, wide
+                    );
+        free(ring);
+        free(held);
+        free(wide);
+    }
+}
+
+void pencil_resize_LANCZOS4( const int original_rows
+                           , const int original_cols
+                           , const int original_step
+                           , const uint8_t original[]
+                           , const int resampled_rows
+                           , const int resampled_cols
+                           , const int resampled_step
+                           , uint8_t resampled[]
+                           )
+{
+    const resize_tables *tables = resize_tables_get( RESIZE_TABLES_LANCZOS4, original_rows, original_cols, resampled_rows, resampled_cols );
+    const int (*x_index)[RESIZE_LANCZOS4_TAPS]      = (const int(*)[RESIZE_LANCZOS4_TAPS])tables->x_index;
+    const int (*y_index)[RESIZE_LANCZOS4_TAPS]      = (const int(*)[RESIZE_LANCZOS4_TAPS])tables->y_index;
+    const int16_t (*x_weight)[RESIZE_LANCZOS4_TAPS] = (const int16_t(*)[RESIZE_LANCZOS4_TAPS])tables->x_weight;
+    const int16_t (*y_weight)[RESIZE_LANCZOS4_TAPS] = (const int16_t(*)[RESIZE_LANCZOS4_TAPS])tables->y_weight;
+    const int bands = imin(resampled_rows, RESIZE_BANDS);
+
+    if ( resampled_rows < original_rows )
+    {
+        int (*column)[original_cols] = malloc(sizeof(int) * bands * original_cols);
+        assert( column );
+        resize_lanczos4_shrink(  original_rows,  original_cols,  original_step, (const uint8_t(*)[ original_step])original
+                              , resampled_rows, resampled_cols, resampled_step, (      uint8_t(*)[resampled_step])resampled
+                              , x_index, x_weight, y_index, y_weight, bands, column
+                              );
+        free(column);
+    }
+    else
+    {
+        int (*ring)[RESIZE_LANCZOS4_TAPS][resampled_cols] = malloc(sizeof(int) * bands * RESIZE_LANCZOS4_TAPS * resampled_cols);
+        int (*held)[RESIZE_LANCZOS4_TAPS] = malloc(sizeof(int) * bands * RESIZE_LANCZOS4_TAPS);
+        int (*wide)[original_cols] = malloc(sizeof(int) * bands * original_cols);
+        assert( ring && held && wide );
+        resize_lanczos4(  original_rows,  original_cols,  original_step, (const uint8_t(*)[ original_step])original
+                       , resampled_rows, resampled_cols, resampled_step, (      uint8_t(*)[resampled_step])resampled
+                       , x_index, x_weight, y_index, y_weight, bands, ring, held, wide
+                       );
+        free(ring);
+        free(held);
+        free(wide);
+    }
 }
@@ -0,0 +1,309 @@
+//Implementation file. Included multiple times with different RESIZE_* defines:
+//  RESIZE_NAME         name of the function
+//  RESIZE_SHIFT        log2 of the decimation factor, for an area decimator
+//  RESIZE_TAPS         taps per axis, for a separable interpolator
+//  RESIZE_SHRINK_NAME  name of the interpolator for fewer resampled rows
+//  RESIZE_CHANNELS     interleaved channels, for a bilinear resize
+//
+// RESIZE_SHIFT: exact area decimation by 1 << RESIZE_SHIFT in both
+// directions: the average of each factor x factor block of the original.
+// With the factor a constant the block loops unroll and the loop over the
+// columns vectorises into adds of neighbouring lanes. The exact sums round
+// like cv::resize with INTER_AREA: half up for the 2x2 averages, to even for
+// larger ones.
+//
+// RESIZE_TAPS: resampled pixel (n_r, n_c) is
+//   sum over i, j of y_weight[n_r][i] * x_weight[n_c][j]
+//                * original[y_index[n_r][i]][x_index[n_c][j]]
+// in RESIZE_COEF_BITS fixed point, like the 8-bit INTER_CUBIC and
+// INTER_LANCZOS4 paths of cv::resize. A window of taps consecutive (clamped)
+// source rows maps each row r to ring slot r % taps, so every band of rows
+// resamples a source row horizontally once, as resize_linear() does, from a
+// copy widened to int that the taps gather from in vectors. The sums of
+// both passes fit in an int for the cubic and Lanczos weights.
+//
+// When the rows shrink, few source rows are shared and horizontally
+// resampling them all would gather bytes for taps times the resampled rows.
+// RESIZE_SHRINK_NAME blends the rows vertically first instead, whole
+// contiguous rows at a time, then gathers from the blended int row. The
+// sums are exact, so both orders give the same result.
+
+// RESIZE_CHANNELS: bilinear resize through separable tables of
+// RESIZE_CHANNELS interleaved channels: resampled pixel (n_r, n_c) is
+//   sum over i, j of y_weight[n_r][i] * x_weight[n_c][j]
+//                * original[y_index[n_r][i]][x_index[n_c][j]]
+// in RESIZE_COEF_BITS fixed point, the indices already clamped to the image.
+// The channels of a pixel share its indices and weights.
+//
+// The rows of resampled are split into bands of consecutive rows. A band
+// resamples each source row it needs horizontally once, into a ring of
+// RESIZE_LINEAR_TAPS rows: source row r goes to slot r % taps, and held
+// records which row a slot holds. Upscaled rows share their source rows
+// with their neighbours and skip the horizontal pass. The vertical pass,
+// over the elements of every channel at once, rounds like the SIMD path of
+// cv::resize.
+
+#ifdef RESIZE_CHANNELS
+static void RESIZE_NAME( const int original_rows
+                       , const int original_cols
+                       , const int original_step
+                       , const uint8_t original[static const restrict original_rows][original_step]
+                       , const int resampled_rows
+                       , const int resampled_cols
+                       , const int resampled_step
+                       , uint8_t resampled[static const restrict resampled_rows][resampled_step]    //out
+                       , const int x_index[static const restrict resampled_cols][RESIZE_LINEAR_TAPS]
+                       , const int16_t x_weight[static const restrict resampled_cols][RESIZE_LINEAR_TAPS]
+                       , const int y_index[static const restrict resampled_rows][RESIZE_LINEAR_TAPS]
+                       , const int16_t y_weight[static const restrict resampled_rows][RESIZE_LINEAR_TAPS]
+                       , const int bands
+                       , int ring[static const restrict bands][RESIZE_LINEAR_TAPS][resampled_cols * RESIZE_CHANNELS]
+                       , int held[static const restrict bands][RESIZE_LINEAR_TAPS]
+                       )
+{
+#pragma scop
+    __pencil_assume(original_rows  >  0);
+    __pencil_assume(original_cols  >  0);
+    __pencil_assume(original_step  >= original_cols * RESIZE_CHANNELS);
+    __pencil_assume(resampled_rows >  0);
+    __pencil_assume(resampled_cols >  0);
+    __pencil_assume(resampled_step >= resampled_cols * RESIZE_CHANNELS);
+    __pencil_assume(bands          >  0);
+    __pencil_assume(bands          <= resampled_rows);
+
+    __pencil_kill(resampled);
+    __pencil_kill(ring);
+    __pencil_kill(held);
+
+    #pragma pencil independent
+    for ( int b = 0; b < bands; b++ )
+    {
+        for ( int t = 0; t < RESIZE_LINEAR_TAPS; t++ )
+            held[b][t] = -1;
+
+        for ( int n_r = b * resampled_rows / bands; n_r < (b + 1) * resampled_rows / bands; n_r++ )
+        {
+            for ( int t = 0; t < RESIZE_LINEAR_TAPS; t++ )
+            {
+                const int row  = y_index[n_r][t];
+                const int slot = row % RESIZE_LINEAR_TAPS;
+                if ( held[b][slot] != row )
+                {
+                    #pragma pencil independent
+                    for ( int n_c = 0; n_c < resampled_cols; n_c++ )
+                    {
+                        const int x_0 = x_index[n_c][0] * RESIZE_CHANNELS;
+                        const int x_1 = x_index[n_c][1] * RESIZE_CHANNELS;
+                        for ( int ch = 0; ch < RESIZE_CHANNELS; ch++ )
+                            ring[b][slot][n_c * RESIZE_CHANNELS + ch] = original[row][x_0 + ch] * x_weight[n_c][0]
+                                                                      + original[row][x_1 + ch] * x_weight[n_c][1];
+                    }
+                    held[b][slot] = row;
+                }
+            }
+
+            const int slot_0   = y_index[n_r][0] % RESIZE_LINEAR_TAPS;
+            const int slot_1   = y_index[n_r][1] % RESIZE_LINEAR_TAPS;
+            const int weight_0 = y_weight[n_r][0];
+            const int weight_1 = y_weight[n_r][1];
+            // (w0 * s0 + w1 * s1) >> 22 in 16-bit products
+            #pragma pencil independent
+            for ( int e = 0; e < resampled_cols * RESIZE_CHANNELS; e++ )
+                resampled[n_r][e] = ( ((weight_0 * (ring[b][slot_0][e] >> 4)) >> 16)
+                                    + ((weight_1 * (ring[b][slot_1][e] >> 4)) >> 16) + 2 ) >> 2;
+        }
+    }
+#pragma endscop
+}
+#endif
+
+#ifdef RESIZE_SHIFT
+static void RESIZE_NAME( const int original_rows
+                       , const int original_cols
+                       , const int original_step
+                       , const uint8_t original[static const restrict original_rows][original_step]
+                       , const int resampled_rows
+                       , const int resampled_cols
+                       , const int resampled_step
+                       , uint8_t resampled[static const restrict resampled_rows][resampled_step]    //out
+                       )
+{
+#pragma scop
+    __pencil_assume(resampled_rows >  0);
+    __pencil_assume(resampled_cols >  0);
+    __pencil_assume(original_rows  == resampled_rows << RESIZE_SHIFT);
+    __pencil_assume(original_cols  == resampled_cols << RESIZE_SHIFT);
+    __pencil_assume(original_step  >= original_cols);
+    __pencil_assume(resampled_step >= resampled_cols);
+
+    __pencil_kill(resampled);
+
+    #pragma pencil independent
+    for ( int n_r = 0; n_r < resampled_rows; n_r++ )
+    {
+        #pragma pencil independent
+        for ( int n_c = 0; n_c < resampled_cols; n_c++ )
+        {
+            int sum = 0;
+            for ( int dy = 0; dy < (1 << RESIZE_SHIFT); dy++ )
+                for ( int dx = 0; dx < (1 << RESIZE_SHIFT); dx++ )
+                    sum += original[n_r * (1 << RESIZE_SHIFT) + dy][n_c * (1 << RESIZE_SHIFT) + dx];
+#if RESIZE_SHIFT == 1
+            resampled[n_r][n_c] = (sum + 2) >> 2;
+#else
+            // Half to even: a half rounds up when the truncated average is odd
+            resampled[n_r][n_c] = (sum + (1 << (2 * RESIZE_SHIFT - 1)) - 1 + ((sum >> (2 * RESIZE_SHIFT)) & 1)) >> (2 * RESIZE_SHIFT);
+#endif
+        }
+    }
+#pragma endscop
+}
+#endif
+
+#ifdef RESIZE_TAPS
+static void RESIZE_NAME( const int original_rows
+                       , const int original_cols
+                       , const int original_step
+                       , const uint8_t original[static const restrict original_rows][original_step]
+                       , const int resampled_rows
+                       , const int resampled_cols
+                       , const int resampled_step
+                       , uint8_t resampled[static const restrict resampled_rows][resampled_step]    //out
+                       , const int x_index[static const restrict resampled_cols][RESIZE_TAPS]
+                       , const int16_t x_weight[static const restrict resampled_cols][RESIZE_TAPS]
+                       , const int y_index[static const restrict resampled_rows][RESIZE_TAPS]
+                       , const int16_t y_weight[static const restrict resampled_rows][RESIZE_TAPS]
+                       , const int bands
+                       , int ring[static const restrict bands][RESIZE_TAPS][resampled_cols]
+                       , int held[static const restrict bands][RESIZE_TAPS]
+                       , int wide[static const restrict bands][original_cols]
+                       )
+{
+#pragma scop
+    __pencil_assume(original_rows  >  0);
+    __pencil_assume(original_cols  >  0);
+    __pencil_assume(original_step  >= original_cols);
+    __pencil_assume(resampled_rows >  0);
+    __pencil_assume(resampled_cols >  0);
+    __pencil_assume(resampled_step >= resampled_cols);
+    __pencil_assume(bands          >  0);
+    __pencil_assume(bands          <= resampled_rows);
+
+    __pencil_kill(resampled);
+    __pencil_kill(ring);
+    __pencil_kill(held);
+    __pencil_kill(wide);
+
+    #pragma pencil independent
+    for ( int b = 0; b < bands; b++ )
+    {
+        for ( int t = 0; t < RESIZE_TAPS; t++ )
+            held[b][t] = -1;
+
+        for ( int n_r = b * resampled_rows / bands; n_r < (b + 1) * resampled_rows / bands; n_r++ )
+        {
+            for ( int t = 0; t < RESIZE_TAPS; t++ )
+            {
+                const int row  = y_index[n_r][t];
+                const int slot = row % RESIZE_TAPS;
+                if ( held[b][slot] != row )
+                {
+                    // Widened first, the taps gather ints
+                    #pragma pencil independent
+                    for ( int o_c = 0; o_c < original_cols; o_c++ )
+                        wide[b][o_c] = original[row][o_c];
+                    #pragma pencil independent
+                    for ( int n_c = 0; n_c < resampled_cols; n_c++ )
+                    {
+                        int sum = 0;
+                        for ( int k = 0; k < RESIZE_TAPS; k++ )
+                            sum += wide[b][x_index[n_c][k]] * x_weight[n_c][k];
+                        ring[b][slot][n_c] = sum;
+                    }
+                    held[b][slot] = row;
+                }
+            }
+
+            int slot[RESIZE_TAPS];
+            int weight[RESIZE_TAPS];
+            for ( int t = 0; t < RESIZE_TAPS; t++ )
+            {
+                slot[t]   = y_index[n_r][t] % RESIZE_TAPS;
+                weight[t] = y_weight[n_r][t];
+            }
+            #pragma pencil independent
+            for ( int n_c = 0; n_c < resampled_cols; n_c++ )
+            {
+                int sum = 1 << (2 * RESIZE_COEF_BITS - 1);
+                for ( int t = 0; t < RESIZE_TAPS; t++ )
+                    sum += weight[t] * ring[b][slot[t]][n_c];
+                resampled[n_r][n_c] = iclampi(sum >> (2 * RESIZE_COEF_BITS), 0, 255);
+            }
+        }
+    }
+#pragma endscop
+}
+
+static void RESIZE_SHRINK_NAME( const int original_rows
+                              , const int original_cols
+                              , const int original_step
+                              , const uint8_t original[static const restrict original_rows][original_step]
+                              , const int resampled_rows
+                              , const int resampled_cols
+                              , const int resampled_step
+                              , uint8_t resampled[static const restrict resampled_rows][resampled_step]    //out
+                              , const int x_index[static const restrict resampled_cols][RESIZE_TAPS]
+                              , const int16_t x_weight[static const restrict resampled_cols][RESIZE_TAPS]
+                              , const int y_index[static const restrict resampled_rows][RESIZE_TAPS]
+                              , const int16_t y_weight[static const restrict resampled_rows][RESIZE_TAPS]
+                              , const int bands
+                              , int column[static const restrict bands][original_cols]
+                              )
+{
+#pragma scop
+    __pencil_assume(original_rows  >  0);
+    __pencil_assume(original_cols  >  0);
+    __pencil_assume(original_step  >= original_cols);
+    __pencil_assume(resampled_rows >  0);
+    __pencil_assume(resampled_cols >  0);
+    __pencil_assume(resampled_step >= resampled_cols);
+    __pencil_assume(bands          >  0);
+    __pencil_assume(bands          <= resampled_rows);
+
+    __pencil_kill(resampled);
+    __pencil_kill(column);
+
+    #pragma pencil independent
+    for ( int b = 0; b < bands; b++ )
+    {
+        for ( int n_r = b * resampled_rows / bands; n_r < (b + 1) * resampled_rows / bands; n_r++ )
+        {
+            int row[RESIZE_TAPS];
+            int weight[RESIZE_TAPS];
+            for ( int t = 0; t < RESIZE_TAPS; t++ )
+            {
+                row[t]    = y_index[n_r][t];
+                weight[t] = y_weight[n_r][t];
+            }
+            #pragma pencil independent
+            for ( int o_c = 0; o_c < original_cols; o_c++ )
+            {
+                int sum = 0;
+                for ( int t = 0; t < RESIZE_TAPS; t++ )
+                    sum += weight[t] * original[row[t]][o_c];
+                column[b][o_c] = sum;
+            }
+
+            #pragma pencil independent
+            for ( int n_c = 0; n_c < resampled_cols; n_c++ )
+            {
+                int sum = 1 << (2 * RESIZE_COEF_BITS - 1);
+                for ( int k = 0; k < RESIZE_TAPS; k++ )
+                    sum += x_weight[n_c][k] * column[b][x_index[n_c][k]];
+                resampled[n_r][n_c] = iclampi(sum >> (2 * RESIZE_COEF_BITS), 0, 255);
+            }
+        }
+    }
+#pragma endscop
+}
+#endif
@@ -7,12 +7,68 @@
 extern "C" {
 #endif
 
+// Bands of resampled rows filtered independently, each resampling the
+// source rows it needs once
+#define RESIZE_BANDS 16
+// Geometries whose coordinate tables are kept between calls. The cache is a
+// static array without locking: the pencil_resize_* functions must not be
+// called from several threads at once
+#define RESIZE_CACHE_ENTRIES 8
+
+// Outputs of one pencil_resize_LN_ladder call, at most the cached geometries
+#define RESIZE_LADDER_MAX 8
+// An output is resized from an earlier one at least this many times its
+// size in both directions rather than from the original
+#define RESIZE_LADDER_CASCADE 2
+// Rows of the original streamed at once to the outputs resized from it
+#define RESIZE_LADDER_STRIP 256
+
+// Bilinear resize like cv::resize with INTER_LINEAR, in 11-bit fixed point
 void pencil_resize_LN( const int original_rows,  const int original_cols,  const int original_step,  const uint8_t original[]
                      , const int resampled_rows, const int resampled_cols, const int resampled_step,       uint8_t resampled[]
                      );
 
+// pencil_resize_LN of an interleaved image of channels (1, 3 or 4) bytes per
+// pixel, the steps counting bytes
+void pencil_resize_LN_cn( const int original_rows,  const int original_cols,  const int original_step,  const uint8_t original[]
+                        , const int resampled_rows, const int resampled_cols, const int resampled_step,       uint8_t resampled[]
+                        , const int channels
+                        );
+
+// Bilinear resize of original to count sizes at once, reading it a single
+// time. Small outputs are resized from larger ones instead of the original
+// when that keeps their quality, see RESIZE_LADDER_CASCADE; parent[k]
+// receives the index of the output resampled[k] was made from, or -1 for
+// the original. bytes_read, unless NULL, receives the bytes of the rows of
+// the original and of the parents read.
+void pencil_resize_LN_ladder( const int original_rows, const int original_cols, const int original_step, const uint8_t original[]
+                            , const int count
+                            , const int resampled_rows[], const int resampled_cols[], const int resampled_step[], uint8_t *resampled[]
+                            , int parent[]    //out
+                            , long *bytes_read    //out
+                            );
+
+// Area resize like cv::resize with INTER_AREA. Downscaling averages the
+// original pixels under each resampled one, exactly for the same factor of
+// 2, 4 or 8 in both directions; upscaling blends like pencil_resize_LN,
+// with INTER_AREA's weights.
+void pencil_resize_AREA( const int original_rows,  const int original_cols,  const int original_step,  const uint8_t original[]
+                       , const int resampled_rows, const int resampled_cols, const int resampled_step,       uint8_t resampled[]
+                       );
+
+// Bicubic resize like cv::resize with INTER_CUBIC, in 11-bit fixed point
+void pencil_resize_CUBIC( const int original_rows,  const int original_cols,  const int original_step,  const uint8_t original[]
+                        , const int resampled_rows, const int resampled_cols, const int resampled_step,       uint8_t resampled[]
+                        );
+
+// Lanczos resize over 8x8 neighbourhoods like cv::resize with
+// INTER_LANCZOS4, in 11-bit fixed point
+void pencil_resize_LANCZOS4( const int original_rows,  const int original_cols,  const int original_step,  const uint8_t original[]
+                           , const int resampled_rows, const int resampled_cols, const int resampled_step,       uint8_t resampled[]
+                           );
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
 
-#endif
\ No newline at end of file
+#endif
@@ -7,9 +7,47 @@
 
 #include <prl.h>
 #include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 namespace
 {
+    // Hardware event counter of the calling thread in user mode. count() is
+    // -1 where the kernel or the machine does not provide the event.
+    class perf_counter
+    {
+    public:
+        perf_counter( uint32_t type, uint64_t config )
+        {
+            perf_event_attr attr;
+            std::memset( &attr, 0, sizeof(attr) );
+            attr.size           = sizeof(attr);
+            attr.type           = type;
+            attr.config         = config;
+            attr.disabled       = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv     = 1;
+            fd = syscall( __NR_perf_event_open, &attr, 0, -1, -1, 0 );
+        }
+        ~perf_counter() { if ( fd >= 0 ) close(fd); }
+
+        void start() { if ( fd >= 0 ) { ioctl( fd, PERF_EVENT_IOC_RESET, 0 ); ioctl( fd, PERF_EVENT_IOC_ENABLE, 0 ); } }
+        void stop()  { if ( fd >= 0 ) ioctl( fd, PERF_EVENT_IOC_DISABLE, 0 ); }
+        long long count() const
+        {
+            long long value;
+            return fd >= 0 && read( fd, &value, sizeof(value) ) == sizeof(value) ? value : -1;
+        }
+
+    private:
+        int fd;
+    };
+
     template <class T0>
     void convert_coeffs(T0 * M)
     {
@@ -115,6 +153,459 @@ void time_affine( const std::vector<carp::record_t>& pool, int iteration )
     }
 }
 
+// A mild rotation that leaves a wide border around the source image, and the
+// scale and shear of time_affine, whose corners land several images away.
+// The "size" only sets the crop, 8x6 pixels, which is warped into a 64x48
+// dst so that most of its points fold over the source many times.
+void time_affine_borders( const std::vector<carp::record_t>& pool )
+{
+    const std::vector<std::vector<float>> transforms = { { 0.9f , 0.3f, -40.0f
+                                                         , -0.25f, 1.1f,  30.0f }
+                                                       , { 2.0f, 0.5f, -500.0f
+                                                         , 0.333f, 3.0f, -500.0f }
+                                                       };
+    const float border_value = 0.5f;
+
+    for ( auto & transform_data : transforms ) {
+        // Inverse map (dst -> src)
+        const cv::Mat transform( 2, 3, CV_32F, const_cast<float*>(transform_data.data()) );
+        const auto dst_size = []( const cv::Mat & src ) { return src.rows < 48 ? cv::Size(64, 48) : src.size(); };
+
+        // OpenCV quantises the interpolation weights to INTER_BITS
+        carp::time_borders( pool, "affine transform", "size", {24}, CV_32F, 0.05
+                          , [&]( const cv::Mat & src, int, int border ) -> cv::Mat {
+                                cv::Mat result;
+                                cv::warpAffine( src, result, transform, dst_size(src), cv::INTER_LINEAR | cv::WARP_INVERSE_MAP, border, cv::Scalar(border_value) );
+                                return result;
+                            }
+                          , [&]( const cv::Mat & src, int, int border ) -> cv::Mat {
+                                cv::Mat result( dst_size(src), CV_32F );
+                                pencil_affine_linear_border( src.rows, src.cols, src.step1(), src.ptr<float>()
+                                                           , result.rows, result.cols, result.step1(), result.ptr<float>()
+                                                           , transform.at<float>(0,0), transform.at<float>(0,1), transform.at<float>(1,0), transform.at<float>(1,1)
+                                                           , transform.at<float>(1,2), transform.at<float>(0,2)
+                                                           , border, border_value
+                                                           );
+                                return result;
+                            }
+                          );
+    }
+}
+
+void time_affine_f16( const std::vector<carp::record_t>& pool )
+{
+    std::cout << "Measuring half precision storage of affine transform against float" << std::endl;
+    std::cout << "      border  float (ms)  half (ms)  float (Mpix/s)  half (Mpix/s)  float (GB/s)  half (GB/s)  max error" << std::endl;
+
+    const std::vector<std::pair<const char*, int>> borders = { {"CONSTANT"   , cv::BORDER_CONSTANT   }
+                                                             , {"REPLICATE"  , cv::BORDER_REPLICATE  }
+                                                             };
+
+    std::vector<float> transform_data = { 0.9f , 0.3f, -40.0f
+                                        , -0.25f, 1.1f,  30.0f
+                                        };
+    const cv::Mat transform( 2, 3, CV_32F, transform_data.data() );
+    const float border_value = 0.5f;
+
+    for ( auto & border : borders ) {
+        std::chrono::duration<double> elapsed_time_float(0), elapsed_time_half(0);
+        double pixels = 0, max_error = 0;
+
+        for ( auto & item : pool ) {
+            cv::Mat cpu_gray;
+            cv::cvtColor( item.cpuimg(), cpu_gray, CV_RGB2GRAY );
+            cpu_gray.convertTo( cpu_gray, CV_32F, 1.0/255. );
+
+            const carp::half_mat half_gray( cpu_gray );
+            cv::Mat float_result( cpu_gray.size(), CV_32F );
+            carp::half_mat half_result( cpu_gray.rows, cpu_gray.cols );
+            {
+                const auto float_start = std::chrono::high_resolution_clock::now();
+                pencil_affine_linear_border( cpu_gray.rows, cpu_gray.cols, cpu_gray.step1(), cpu_gray.ptr<float>()
+                                           , float_result.rows, float_result.cols, float_result.step1(), float_result.ptr<float>()
+                                           , transform.at<float>(0,0), transform.at<float>(0,1), transform.at<float>(1,0), transform.at<float>(1,1)
+                                           , transform.at<float>(1,2), transform.at<float>(0,2)
+                                           , border.second, border_value
+                                           );
+                const auto float_end = std::chrono::high_resolution_clock::now();
+                elapsed_time_float += float_end - float_start;
+            }
+            {
+                const auto half_start = std::chrono::high_resolution_clock::now();
+                pencil_affine_linear_f16( half_gray.rows(), half_gray.cols(), half_gray.step1(), half_gray.ptr()
+                                        , half_result.rows(), half_result.cols(), half_result.step1(), half_result.ptr()
+                                        , transform.at<float>(0,0), transform.at<float>(0,1), transform.at<float>(1,0), transform.at<float>(1,1)
+                                        , transform.at<float>(1,2), transform.at<float>(0,2)
+                                        , border.second, border_value
+                                        );
+                const auto half_end = std::chrono::high_resolution_clock::now();
+                elapsed_time_half += half_end - half_start;
+            }
+            pixels += cpu_gray.total();
+            max_error = std::max( max_error, cv::norm(float_result, half_result.to_mat(), cv::NORM_INF) );
+        }
+        // Bytes moved per pixel: one read and one write, 4 bytes each in float, 2 in half
+        std::cout << std::fixed << std::setprecision(2);
+        std::cout << std::setw(11) << border.first << " "
+                  << std::setw(11) << elapsed_time_float.count() * 1e3 << " " << std::setw(10) << elapsed_time_half.count() * 1e3 << " "
+                  << std::setw(15) << pixels / elapsed_time_float.count() * 1e-6 << " " << std::setw(14) << pixels / elapsed_time_half.count() * 1e-6 << " "
+                  << std::setw(12) << 8 * pixels / elapsed_time_float.count() * 1e-9 << " " << std::setw(11) << 4 * pixels / elapsed_time_half.count() * 1e-9 << " "
+                  << std::setprecision(6) << std::setw(10) << max_error << std::endl;
+
+        // Half precision rounding of the source and of the result, 2^-11 each
+        if ( max_error > 0.002 )
+            throw std::runtime_error("The half precision PENCIL results are not equivalent with the float results.");
+    }
+}
+
+// The colour image at once against cv::split, a pencil_affine_linear_border
+// per plane and cv::merge
+void time_affine_cn( const std::vector<carp::record_t>& pool )
+{
+    std::cout << "Measuring affine transform of interleaved channels against split planes" << std::endl;
+    std::cout << "  channels  interleaved (ms)  split (ms)  max error" << std::endl;
+
+    std::vector<float> transform_data = { 0.9f , 0.3f, -40.0f
+                                        , -0.25f, 1.1f,  30.0f
+                                        };
+    const cv::Mat transform( 2, 3, CV_32F, transform_data.data() );
+
+    for ( int channels : { 3, 4 } ) {
+        std::chrono::duration<double,std::milli> elapsed_time_cn(0), elapsed_time_split(0);
+        double max_error = 0;
+
+        for ( auto & item : pool ) {
+            cv::Mat cpu_color;
+            if ( channels == 4 )
+                cv::cvtColor( item.cpuimg(), cpu_color, CV_RGB2RGBA );
+            else
+                cpu_color = item.cpuimg();
+            cpu_color.convertTo( cpu_color, CV_32FC(channels), 1.0/255. );
+
+            cv::Mat cn_result( cpu_color.size(), CV_32FC(channels) ), split_result;
+            {
+                const auto cn_start = std::chrono::high_resolution_clock::now();
+                pencil_affine_linear_cn( cpu_color.rows, cpu_color.cols, cpu_color.step1(), cpu_color.ptr<float>()
+                                       , cn_result.rows, cn_result.cols, cn_result.step1(), cn_result.ptr<float>()
+                                       , transform.at<float>(0,0), transform.at<float>(0,1), transform.at<float>(1,0), transform.at<float>(1,1)
+                                       , transform.at<float>(1,2), transform.at<float>(0,2)
+                                       , cv::BORDER_REFLECT_101, 0.f
+                                       , channels
+                                       );
+                const auto cn_end = std::chrono::high_resolution_clock::now();
+                elapsed_time_cn += cn_end - cn_start;
+            }
+            {
+                const auto split_start = std::chrono::high_resolution_clock::now();
+                std::vector<cv::Mat> planes;
+                cv::split( cpu_color, planes );
+                for ( auto & plane : planes ) {
+                    cv::Mat warped( plane.size(), CV_32F );
+                    pencil_affine_linear_border( plane.rows, plane.cols, plane.step1(), plane.ptr<float>()
+                                               , warped.rows, warped.cols, warped.step1(), warped.ptr<float>()
+                                               , transform.at<float>(0,0), transform.at<float>(0,1), transform.at<float>(1,0), transform.at<float>(1,1)
+                                               , transform.at<float>(1,2), transform.at<float>(0,2)
+                                               , cv::BORDER_REFLECT_101, 0.f
+                                               );
+                    plane = warped;
+                }
+                cv::merge( planes, split_result );
+                const auto split_end = std::chrono::high_resolution_clock::now();
+                elapsed_time_split += split_end - split_start;
+            }
+            max_error = std::max( max_error, cv::norm(cn_result, split_result, cv::NORM_INF) );
+        }
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << std::setw(10) << channels << " "
+                  << std::setw(17) << elapsed_time_cn.count() << " " << std::setw(11) << elapsed_time_split.count() << " "
+                  << std::setw(10) << max_error << std::endl;
+
+        if ( max_error > 0 )
+            throw std::runtime_error("The interleaved PENCIL results are not equivalent with the per plane results.");
+    }
+}
+
+// The float coordinates of pencil_affine_linear_border against the fixed
+// point ones of pencil_affine_linear_dda, both checked against OpenCV
+void time_affine_dda( const std::vector<carp::record_t>& pool )
+{
+    std::cout << "Measuring incremental fixed point affine coordinates" << std::endl;
+    std::cout << "     border  OpenCV (ms)   float (ms)     DDA (ms)  max error" << std::endl;
+
+    const std::vector<std::pair<const char*, int>> borders = { {"CONSTANT"   , cv::BORDER_CONSTANT   }
+                                                             , {"REPLICATE"  , cv::BORDER_REPLICATE  }
+                                                             , {"REFLECT_101", cv::BORDER_REFLECT_101}
+                                                             , {"WRAP"       , cv::BORDER_WRAP       }
+                                                             };
+
+    std::vector<float> transform_data = { 0.9f , 0.3f, -40.0f
+                                        , -0.25f, 1.1f,  30.0f
+                                        };
+    const cv::Mat transform( 2, 3, CV_32F, transform_data.data() );
+    const float border_value = 0.5f;
+
+    for ( auto & border : borders ) {
+        std::chrono::duration<double,std::milli> elapsed_time_cpu(0), elapsed_time_float(0), elapsed_time_dda(0);
+        double max_error = 0;
+
+        for ( auto & item : pool ) {
+            cv::Mat cpu_gray;
+            cv::cvtColor( item.cpuimg(), cpu_gray, CV_RGB2GRAY );
+            cpu_gray.convertTo( cpu_gray, CV_32F, 1.0/255. );
+
+            cv::Mat cpu_result, float_result( cpu_gray.size(), CV_32F ), dda_result( cpu_gray.size(), CV_32F );
+            {
+                const auto cpu_start = std::chrono::high_resolution_clock::now();
+                cv::warpAffine( cpu_gray, cpu_result, transform, cpu_gray.size(), cv::INTER_LINEAR | cv::WARP_INVERSE_MAP, border.second, cv::Scalar(border_value) );
+                const auto cpu_end = std::chrono::high_resolution_clock::now();
+                elapsed_time_cpu += cpu_end - cpu_start;
+            }
+            {
+                const auto float_start = std::chrono::high_resolution_clock::now();
+                pencil_affine_linear_border( cpu_gray.rows, cpu_gray.cols, cpu_gray.step1(), cpu_gray.ptr<float>()
+                                           , float_result.rows, float_result.cols, float_result.step1(), float_result.ptr<float>()
+                                           , transform.at<float>(0,0), transform.at<float>(0,1), transform.at<float>(1,0), transform.at<float>(1,1)
+                                           , transform.at<float>(1,2), transform.at<float>(0,2)
+                                           , border.second, border_value
+                                           );
+                const auto float_end = std::chrono::high_resolution_clock::now();
+                elapsed_time_float += float_end - float_start;
+            }
+            {
+                const auto dda_start = std::chrono::high_resolution_clock::now();
+                pencil_affine_linear_dda( cpu_gray.rows, cpu_gray.cols, cpu_gray.step1(), cpu_gray.ptr<float>()
+                                        , dda_result.rows, dda_result.cols, dda_result.step1(), dda_result.ptr<float>()
+                                        , transform.at<float>(0,0), transform.at<float>(0,1), transform.at<float>(1,0), transform.at<float>(1,1)
+                                        , transform.at<float>(1,2), transform.at<float>(0,2)
+                                        , border.second, border_value
+                                        );
+                const auto dda_end = std::chrono::high_resolution_clock::now();
+                elapsed_time_dda += dda_end - dda_start;
+            }
+            max_error = std::max( max_error, cv::norm(cpu_result, dda_result, cv::NORM_INF) );
+        }
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << std::setw(11) << border.first << " "
+                  << std::setw(12) << elapsed_time_cpu.count() << " " << std::setw(12) << elapsed_time_float.count() << " "
+                  << std::setw(12) << elapsed_time_dda.count() << " " << std::setw(10) << max_error << std::endl;
+
+        // OpenCV quantises the interpolation weights to INTER_BITS
+        if ( max_error > 0.05 )
+            throw std::runtime_error("The fixed point PENCIL results are not equivalent with the C++ results.");
+    }
+}
+
+// Rotations about the image centre walk the source along ever steeper
+// diagonals. The row by row DDA, the blocked traversal and the tiled source
+// are compared in time, data TLB misses and cache misses.
+void time_affine_rotations( const std::vector<carp::record_t>& pool, const std::vector<int>& angles )
+{
+    std::cout << "Measuring affine rotations: row order, blocked and tiled source" << std::endl;
+    std::cout << "  angle   rows (ms)  blocked (ms)  tiled (ms)   rows dTLB  blocked dTLB  tiled dTLB   rows miss  blocked miss  tiled miss" << std::endl;
+
+    const uint64_t dtlb_read_miss = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    perf_counter dtlb( PERF_TYPE_HW_CACHE, dtlb_read_miss );
+    perf_counter miss( PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES );
+
+    for ( auto & angle : angles ) {
+        std::chrono::duration<double,std::milli> elapsed_time[3] = {};
+        long long dtlb_misses[3] = {}, cache_misses[3] = {};
+
+        for ( auto & item : pool ) {
+            cv::Mat cpu_gray;
+            cv::cvtColor( item.cpuimg(), cpu_gray, CV_RGB2GRAY );
+            cpu_gray.convertTo( cpu_gray, CV_32F, 1.0/255. );
+
+            // dst (n_r, n_c) reads src at the centre plus the rotated offset
+            const float cos_a = std::cos( angle * 3.14159265358979323846 / 180 );
+            const float sin_a = std::sin( angle * 3.14159265358979323846 / 180 );
+            const float c_r = cpu_gray.rows / 2.f, c_c = cpu_gray.cols / 2.f;
+            const float a00 = cos_a, a01 = -sin_a, a10 = sin_a, a11 = cos_a;
+            const float b00 = c_r - a10 * c_c - a11 * c_r;
+            const float b10 = c_c - a00 * c_c - a01 * c_r;
+
+            pencil_affine_tiled_source *source = pencil_affine_tiled_source_create( cpu_gray.rows, cpu_gray.cols, cpu_gray.step1(), cpu_gray.ptr<float>() );
+            cv::Mat results[3];
+            for ( int k = 0; k < 3; k++ ) {
+                results[k].create( cpu_gray.size(), CV_32F );
+                dtlb.start();
+                miss.start();
+                const auto start = std::chrono::high_resolution_clock::now();
+                if ( k == 0 )
+                    pencil_affine_linear_dda( cpu_gray.rows, cpu_gray.cols, cpu_gray.step1(), cpu_gray.ptr<float>()
+                                            , results[k].rows, results[k].cols, results[k].step1(), results[k].ptr<float>()
+                                            , a00, a01, a10, a11, b00, b10, cv::BORDER_CONSTANT, 0.f
+                                            );
+                else if ( k == 1 )
+                    pencil_affine_linear_blocked( cpu_gray.rows, cpu_gray.cols, cpu_gray.step1(), cpu_gray.ptr<float>()
+                                                , results[k].rows, results[k].cols, results[k].step1(), results[k].ptr<float>()
+                                                , a00, a01, a10, a11, b00, b10, cv::BORDER_CONSTANT, 0.f
+                                                );
+                else
+                    pencil_affine_linear_tiled( source
+                                              , results[k].rows, results[k].cols, results[k].step1(), results[k].ptr<float>()
+                                              , a00, a01, a10, a11, b00, b10, cv::BORDER_CONSTANT, 0.f
+                                              );
+                const auto end = std::chrono::high_resolution_clock::now();
+                miss.stop();
+                dtlb.stop();
+                elapsed_time[k] += end - start;
+                dtlb_misses[k]  += dtlb.count();
+                cache_misses[k] += miss.count();
+            }
+            pencil_affine_tiled_source_destroy( source );
+
+            // The traversals only reorder the same computation
+            if ( cv::norm(results[0], results[1], cv::NORM_INF) > 0 || cv::norm(results[0], results[2], cv::NORM_INF) > 0 )
+                throw std::runtime_error("The blocked PENCIL results are not equivalent with the row order results.");
+        }
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << std::setw(7) << angle << " "
+                  << std::setw(11) << elapsed_time[0].count() << " " << std::setw(13) << elapsed_time[1].count() << " " << std::setw(11) << elapsed_time[2].count() << " "
+                  << std::setw(11) << dtlb_misses[0] << " " << std::setw(13) << dtlb_misses[1] << " " << std::setw(11) << dtlb_misses[2] << " "
+                  << std::setw(11) << cache_misses[0] << " " << std::setw(13) << cache_misses[1] << " " << std::setw(11) << cache_misses[2] << std::endl;
+    }
+}
+
+// Data augmentation: count random rotations, scales and shifts of the same
+// source into half size crops, as one pencil_affine_linear_batch call and as
+// count calls of pencil_affine_linear_dda
+void time_affine_batch( const std::vector<carp::record_t>& pool, const std::vector<int>& counts )
+{
+    std::cout << "Measuring batched affine transforms of one source against one call each" << std::endl;
+    std::cout << "  count  batch (ms)  single (ms)  batch (Mpixel/s)  single (Mpixel/s)" << std::endl;
+
+    cv::RNG rng( 0xA5 );
+    for ( auto & count : counts ) {
+        std::chrono::duration<double> elapsed_time_batch(0), elapsed_time_single(0);
+        double pixels = 0;
+
+        for ( auto & item : pool ) {
+            cv::Mat cpu_gray;
+            cv::cvtColor( item.cpuimg(), cpu_gray, CV_RGB2GRAY );
+            cpu_gray.convertTo( cpu_gray, CV_32F, 1.0/255. );
+            const cv::Size size( cpu_gray.cols / 2, cpu_gray.rows / 2 );
+
+            // Row-major 2x3 dst -> src matrices about a jittered centre
+            std::vector<float> transforms( 6 * count );
+            for ( int k = 0; k < count; k++ ) {
+                const double angle = rng.uniform( -30., 30. ) * 3.14159265358979323846 / 180, scale = rng.uniform( 0.8, 1.25 );
+                const double c = std::cos(angle) * scale, s = std::sin(angle) * scale;
+                const double c_x = cpu_gray.cols / 2. + rng.uniform( -cpu_gray.cols / 8., cpu_gray.cols / 8. );
+                const double c_y = cpu_gray.rows / 2. + rng.uniform( -cpu_gray.rows / 8., cpu_gray.rows / 8. );
+                const double m[6] = { c, -s, c_x - c * size.width / 2 + s * size.height / 2
+                                    , s,  c, c_y - s * size.width / 2 - c * size.height / 2 };
+                std::copy( m, m + 6, transforms.begin() + 6 * k );
+            }
+
+            cv::Mat batch_result( size.height * count, size.width, CV_32F ), single_result( size.height * count, size.width, CV_32F );
+            {
+                const auto batch_start = std::chrono::high_resolution_clock::now();
+                pencil_affine_linear_batch( cpu_gray.rows, cpu_gray.cols, cpu_gray.step1(), cpu_gray.ptr<float>()
+                                          , count, transforms.data()
+                                          , size.height, size.width, batch_result.step1(), batch_result.ptr<float>()
+                                          , cv::BORDER_REFLECT_101, 0.f
+                                          );
+                const auto batch_end = std::chrono::high_resolution_clock::now();
+                elapsed_time_batch += batch_end - batch_start;
+            }
+            {
+                const auto single_start = std::chrono::high_resolution_clock::now();
+                for ( int k = 0; k < count; k++ ) {
+                    const float *m = &transforms[6 * k];
+                    pencil_affine_linear_dda( cpu_gray.rows, cpu_gray.cols, cpu_gray.step1(), cpu_gray.ptr<float>()
+                                            , size.height, size.width, single_result.step1(), single_result.ptr<float>(k * size.height)
+                                            , m[0], m[1], m[3], m[4], m[5], m[2]
+                                            , cv::BORDER_REFLECT_101, 0.f
+                                            );
+                }
+                const auto single_end = std::chrono::high_resolution_clock::now();
+                elapsed_time_single += single_end - single_start;
+            }
+            pixels += double(size.area()) * count;
+
+            if ( cv::norm(batch_result, single_result, cv::NORM_INF) > 0 )
+                throw std::runtime_error("The batched PENCIL results are not equivalent with the single transform results.");
+        }
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << std::setw(7) << count << " " << std::setw(11) << elapsed_time_batch.count() * 1e3 << " " << std::setw(12) << elapsed_time_single.count() * 1e3 << " "
+                  << std::setw(17) << pixels / elapsed_time_batch.count() * 1e-6 << " " << std::setw(18) << pixels / elapsed_time_single.count() * 1e-6 << std::endl;
+    }
+}
+
+// The 8-bit frames warped as they are against converting them to float for
+// pencil_affine_linear_border and back, both timed with their conversions;
+// the 8-bit results are checked against cv::warpAffine on CV_8U for the mild
+// rotation and the scale and shear of time_affine_borders in every border mode
+void time_affine_u8( const std::vector<carp::record_t>& pool )
+{
+    std::cout << "Measuring 8-bit affine transform against the float one with conversions" << std::endl;
+    std::cout << "   transform      border  OpenCV (ms)  float (ms)  8-bit (ms)  max error" << std::endl;
+
+    // dst -> src, passed to OpenCV with WARP_INVERSE_MAP
+    const std::vector<std::pair<const char*, std::vector<float>>> transforms = { {"rotation"   , { 0.9f , 0.3f, -40.0f
+                                                                                                 , -0.25f, 1.1f,  30.0f }}
+                                                                               , {"scale+shear", { 2.0f, 0.5f, -500.0f
+                                                                                                 , 0.333f, 3.0f, -500.0f }}
+                                                                               };
+    const uint8_t border_value = 128;
+
+    for ( auto & transform_data : transforms ) {
+        const cv::Mat transform( 2, 3, CV_32F, const_cast<float*>(transform_data.second.data()) );
+
+        for ( auto & border : carp::border_modes ) {
+            std::chrono::duration<double,std::milli> elapsed_time_cpu(0), elapsed_time_float(0), elapsed_time_u8(0);
+            double max_error = 0;
+
+            for ( auto & item : pool ) {
+                cv::Mat cpu_gray;
+                cv::cvtColor( item.cpuimg(), cpu_gray, CV_RGB2GRAY );
+
+                cv::Mat cpu_result, float_result, u8_result( cpu_gray.size(), CV_8U );
+                {
+                    const auto cpu_start = std::chrono::high_resolution_clock::now();
+                    cv::warpAffine( cpu_gray, cpu_result, transform, cpu_gray.size(), cv::INTER_LINEAR | cv::WARP_INVERSE_MAP, border.second, cv::Scalar::all(border_value) );
+                    const auto cpu_end = std::chrono::high_resolution_clock::now();
+                    elapsed_time_cpu += cpu_end - cpu_start;
+                }
+                {
+                    const auto float_start = std::chrono::high_resolution_clock::now();
+                    cv::Mat float_gray, float_warped( cpu_gray.size(), CV_32F );
+                    cpu_gray.convertTo( float_gray, CV_32F );
+                    pencil_affine_linear_border( float_gray.rows, float_gray.cols, float_gray.step1(), float_gray.ptr<float>()
+                                               , float_warped.rows, float_warped.cols, float_warped.step1(), float_warped.ptr<float>()
+                                               , transform.at<float>(0,0), transform.at<float>(0,1), transform.at<float>(1,0), transform.at<float>(1,1)
+                                               , transform.at<float>(1,2), transform.at<float>(0,2)
+                                               , border.second, border_value
+                                               );
+                    float_warped.convertTo( float_result, CV_8U );
+                    const auto float_end = std::chrono::high_resolution_clock::now();
+                    elapsed_time_float += float_end - float_start;
+                }
+                {
+                    const auto u8_start = std::chrono::high_resolution_clock::now();
+                    pencil_affine_linear_u8( cpu_gray.rows, cpu_gray.cols, cpu_gray.step1(), cpu_gray.ptr()
+                                           , u8_result.rows, u8_result.cols, u8_result.step1(), u8_result.ptr()
+                                           , transform.at<float>(0,0), transform.at<float>(0,1), transform.at<float>(1,0), transform.at<float>(1,1)
+                                           , transform.at<float>(1,2), transform.at<float>(0,2)
+                                           , border.second, border_value
+                                           );
+                    const auto u8_end = std::chrono::high_resolution_clock::now();
+                    elapsed_time_u8 += u8_end - u8_start;
+                }
+                max_error = std::max( max_error, cv::norm(cpu_result, u8_result, cv::NORM_INF) );
+            }
+            std::cout << std::fixed << std::setprecision(3);
+            std::cout << std::setw(12) << transform_data.first << " " << std::setw(11) << border.first << " "
+                      << std::setw(12) << elapsed_time_cpu.count() << " " << std::setw(11) << elapsed_time_float.count() << " "
+                      << std::setw(11) << elapsed_time_u8.count() << " " << std::setprecision(0) << std::setw(10) << max_error << std::endl;
+
+            if ( max_error > 1 )
+                throw std::runtime_error("The 8-bit PENCIL results are not equivalent with the C++ results.");
+        }
+    }
+}
+
 int main(int argc, char* argv[])
 {
     prl_init((prl_init_flags)(PRL_TARGET_DEVICE_DYNAMIC | PRL_PROFILING_ENABLED));
@@ -127,6 +618,13 @@ int main(int argc, char* argv[])
     time_affine( pool,  1 );
 #else
     time_affine( pool, 20 );
+    time_affine_borders( pool );
+    time_affine_f16( pool );
+    time_affine_cn( pool );
+    time_affine_dda( pool );
+    time_affine_rotations( pool, {0, 15, 30, 45, 60, 75, 90} );
+    time_affine_batch( pool, {16, 32, 64} );
+    time_affine_u8( pool );
 #endif
 
     prl_shutdown();
@@ -1,10 +1,107 @@
 #include "warpAffine.pencil.h"
 #include <pencil.h>
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "half.pencil.h"
 
-static void affine( const int src_rows, const int src_cols, const int src_step, const float src[static const restrict src_rows][src_step]
-                  , const int dst_rows, const int dst_cols, const int dst_step,       float dst[static const restrict dst_rows][dst_step]
-                  , const float a00, const float a01, const float a10, const float a11, const float b00, const float b10
-                  )
+// Fractional bits of the source coordinates of affine_dda(): sources up to
+// 32767 pixels keep them in int
+#define AFFINE_DDA_BITS 16
+// Pixels on a side of a tile of pencil_affine_tiled_source, which also holds
+// the row and column after them: 33 x 33 floats, about a page
+#define AFFINE_TILE_BITS 5
+#define AFFINE_TILE (1 << AFFINE_TILE_BITS)
+
+static inline int64_t affine_floor_div( const int64_t a, const int64_t b )
+{
+    return a / b - ( a % b != 0 && (a < 0) != (b < 0) );
+}
+
+/* The columns n in [first, last) with 0 <= origin + n * step < limit are
+ * [affine_span_first(), affine_span_last()). */
+static inline int affine_span_first( const int64_t origin, const int step, const int64_t limit, const int first, const int last )
+{
+    const int64_t lo = step == 0 ? ( origin >= 0 && origin < limit ? first : last )
+                     : step >  0 ? -affine_floor_div( origin, step )
+                     :             -affine_floor_div( origin - limit + 1, step );
+    return lo > first ? ( lo < last ? (int)lo : last ) : first;
+}
+
+static inline int affine_span_last( const int64_t origin, const int step, const int64_t limit, const int first, const int last )
+{
+    const int lo = affine_span_first( origin, step, limit, first, last );
+    const int64_t hi = step == 0 ? last
+                     : step >  0 ? affine_floor_div( limit - 1 - origin, step ) + 1
+                     :             affine_floor_div( -origin, step ) + 1;
+    return hi < last ? ( hi > lo ? (int)hi : lo ) : last;
+}
+
+// Fixed point of the coordinates of affine_u8(), like cv::warpAffine: the
+// row and column terms in AFFINE_AB_BITS, their sum rounded to
+// AFFINE_INTER_BITS, the bits of the bilinear weights
+#define AFFINE_AB_BITS 10
+#define AFFINE_INTER_BITS 5
+#define AFFINE_INTER_SIZE (1 << AFFINE_INTER_BITS)
+
+#define AFFINE_NAME affine
+#define AFFINE_DDA_NAME affine_dda
+#define AFFINE_BLOCKED_NAME affine_blocked
+#define AFFINE_BATCH_NAME affine_batch
+#define AFFINE_TYPE float
+#define AFFINE_LOAD(x) (x)
+#define AFFINE_CHANNELS 1
+#include "warpAffine.pencil.detail.h"
+#undef AFFINE_NAME
+#undef AFFINE_DDA_NAME
+#undef AFFINE_BLOCKED_NAME
+#undef AFFINE_BATCH_NAME
+
+#define AFFINE_BLOCKED_NAME affine_blocked_tiled
+#define AFFINE_TILED
+#include "warpAffine.pencil.detail.h"
+#undef AFFINE_BLOCKED_NAME
+#undef AFFINE_TILED
+#undef AFFINE_CHANNELS
+
+#define AFFINE_NAME affine_c3
+#define AFFINE_CHANNELS 3
+#include "warpAffine.pencil.detail.h"
+#undef AFFINE_NAME
+#undef AFFINE_CHANNELS
+
+#define AFFINE_NAME affine_c4
+#define AFFINE_CHANNELS 4
+#include "warpAffine.pencil.detail.h"
+#undef AFFINE_NAME
+#undef AFFINE_TYPE
+#undef AFFINE_LOAD
+#undef AFFINE_CHANNELS
+
+#define AFFINE_NAME affine_f16
+#define AFFINE_TYPE uint16_t
+#define AFFINE_LOAD(x) half_value(x, half_scale)
+#define AFFINE_HALF
+#define AFFINE_CHANNELS 1
+#include "warpAffine.pencil.detail.h"
+#undef AFFINE_NAME
+#undef AFFINE_HALF
+#undef AFFINE_TYPE
+#undef AFFINE_LOAD
+#undef AFFINE_CHANNELS
+
+/* 8-bit bilinear warp rounding like cv::warpAffine on CV_8U. The source
+ * point of dst (n_r, n_c) is (row_y[n_r] + col_y[n_c], row_x[n_r] + col_x[n_c])
+ * in AFFINE_AB_BITS fixed point, rounded to AFFINE_INTER_BITS; the weights
+ * are the products of the fractions, at most 1024 so they and the taps fit
+ * int16, summed in int32 and rounded back to 8 bits. */
+static void affine_u8( const int src_rows, const int src_cols, const int src_step, const uint8_t src[static const restrict src_rows][src_step]
+                     , const int dst_rows, const int dst_cols, const int dst_step,       uint8_t dst[static const restrict dst_rows][dst_step]
+                     , const int row_x[static const restrict dst_rows], const int row_y[static const restrict dst_rows]
+                     , const int col_x[static const restrict dst_cols], const int col_y[static const restrict dst_cols]
+                     , const int border_type, const uint8_t border_value
+                     )
 {
 #pragma scop
     __pencil_assume(src_rows >  0);
@@ -22,36 +119,30 @@ static void affine( const int src_rows, const int src_cols, const int src_step,
         #pragma pencil independent
         for ( int n_c=0; n_c<dst_cols; n_c++ )
         {
-            float o_r = a11 * n_r + a10 * n_c + b00;
-            float o_c = a01 * n_r + a00 * n_c + b10;
-
-            float r = o_r - floorf(o_r);
-            float c = o_c - floorf(o_c);
-
-            int coord_00_r = floorf(o_r);
-            int coord_00_c = floorf(o_c);
-            int coord_01_r = coord_00_r;
-            int coord_01_c = coord_00_c + 1;
-            int coord_10_r = coord_00_r + 1;
-            int coord_10_c = coord_00_c;
-            int coord_11_r = coord_00_r + 1;
-            int coord_11_c = coord_00_c + 1;
-
-            coord_00_r = iclampi(coord_00_r, 0, src_rows);
-            coord_00_c = iclampi(coord_00_c, 0, src_cols);
-            coord_01_r = iclampi(coord_01_r, 0, src_rows);
-            coord_01_c = iclampi(coord_01_c, 0, src_cols);
-            coord_10_r = iclampi(coord_10_r, 0, src_rows);
-            coord_10_c = iclampi(coord_10_c, 0, src_cols);
-            coord_11_r = iclampi(coord_11_r, 0, src_rows);
-            coord_11_c = iclampi(coord_11_c, 0, src_cols);
-
-            float A00 = src[coord_00_r][coord_00_c];
-            float A10 = src[coord_10_r][coord_10_c];
-            float A01 = src[coord_01_r][coord_01_c];
-            float A11 = src[coord_11_r][coord_11_c];
-
-            dst[n_r][n_c] = mixf( mixf(A00, A10, r), mixf(A01, A11, r), c);
+            const int x = (row_x[n_r] + col_x[n_c]) >> (AFFINE_AB_BITS - AFFINE_INTER_BITS);
+            const int y = (row_y[n_r] + col_y[n_c]) >> (AFFINE_AB_BITS - AFFINE_INTER_BITS);
+            const int col = iclampi(x >> AFFINE_INTER_BITS, BORDER_COORD_MIN, BORDER_COORD_MAX);
+            const int row = iclampi(y >> AFFINE_INTER_BITS, BORDER_COORD_MIN, BORDER_COORD_MAX);
+            const int f_x = x & (AFFINE_INTER_SIZE - 1);
+            const int f_y = y & (AFFINE_INTER_SIZE - 1);
+            const int w00 = (AFFINE_INTER_SIZE - f_y) * (AFFINE_INTER_SIZE - f_x);
+            const int w01 = (AFFINE_INTER_SIZE - f_y) * f_x;
+            const int w10 = f_y * (AFFINE_INTER_SIZE - f_x);
+            const int w11 = f_y * f_x;
+
+            if ( row >= 0 && row < src_rows - 1 && col >= 0 && col < src_cols - 1 )
+            {
+                const int sum = w00 * src[row][col] + w01 * src[row][col + 1] + w10 * src[row + 1][col] + w11 * src[row + 1][col + 1];
+                dst[n_r][n_c] = (sum + (1 << (2 * AFFINE_INTER_BITS - 1))) >> (2 * AFFINE_INTER_BITS);
+            }
+            else
+            {
+                const int sum = w00 * border_fetch(src, row    , col    , src_rows, src_cols, border_type, border_value)
+                              + w01 * border_fetch(src, row    , col + 1, src_rows, src_cols, border_type, border_value)
+                              + w10 * border_fetch(src, row + 1, col    , src_rows, src_cols, border_type, border_value)
+                              + w11 * border_fetch(src, row + 1, col + 1, src_rows, src_cols, border_type, border_value);
+                dst[n_r][n_c] = (sum + (1 << (2 * AFFINE_INTER_BITS - 1))) >> (2 * AFFINE_INTER_BITS);
+            }
         }
     }
     __pencil_kill(src);
@@ -62,9 +153,396 @@ void pencil_affine_linear( const int src_rows, const int src_cols, const int src
                          , const int dst_rows, const int dst_cols, const int dst_step,       float dst[]
                          , const float a00, const float a01, const float a10, const float a11, const float b00, const float b10
                          )
+{
+    pencil_affine_linear_border( src_rows, src_cols, src_step, src
+                               , dst_rows, dst_cols, dst_step, dst
+                               , a00, a01, a10, a11, b00, b10
+                               , PENCIL_BORDER_REPLICATE, 0.f
+                               );
+}
+
+void pencil_affine_linear_border( const int src_rows, const int src_cols, const int src_step, const float src[]
+                                , const int dst_rows, const int dst_cols, const int dst_step,       float dst[]
+                                , const float a00, const float a01, const float a10, const float a11, const float b00, const float b10
+                                , const int border_type, const float border_value
+                                )
 {
     affine( src_rows, src_cols, src_step, (const float(*)[src_step])src
           , dst_rows, dst_cols, dst_step, (      float(*)[dst_step])dst
           , a00, a01, a10, a11, b00, b10
+          , border_type, border_value
           );
 }
+
+/* Narrows [*first, *last) to the columns n with 0 <= origin + n * step < limit. */
+static void affine_span( const int64_t origin, const int step, const int64_t limit, int *first, int *last )
+{
+    const int lo = affine_span_first( origin, step, limit, *first, *last );
+    *last  = affine_span_last( origin, step, limit, *first, *last );
+    *first = lo;
+}
+
+/* The tables of affine_dda(): the fixed-point steps along a dst row, and per
+ * row its origin, the span of columns whose taps are inside src and their
+ * coordinates at the start of the span. */
+typedef struct
+{
+    int step_r, step_c;
+    int64_t (*origin)[2];
+    int (*start)[2];
+    int (*span)[2];
+} affine_dda_tables;
+
+static affine_dda_tables affine_dda_tables_create( const int src_rows, const int src_cols, const int dst_rows, const int dst_cols
+                                                 , const float a00, const float a01, const float a10, const float a11, const float b00, const float b10
+                                                 )
+{
+    const double one = 1 << AFFINE_DDA_BITS;
+    assert( src_rows < (1 << (31 - AFFINE_DDA_BITS)) && src_cols < (1 << (31 - AFFINE_DDA_BITS)) );
+    assert( fabs(a10) * one < 0x7fffffff && fabs(a00) * one < 0x7fffffff );
+
+    affine_dda_tables tables;
+    tables.step_r = (int)llrint( a10 * one );
+    tables.step_c = (int)llrint( a00 * one );
+    tables.origin = malloc( sizeof(int64_t) * dst_rows * 2 );
+    tables.start  = malloc( sizeof(int) * dst_rows * 2 );
+    tables.span   = malloc( sizeof(int) * dst_rows * 2 );
+    assert( tables.origin && tables.start && tables.span );
+
+    for ( int n_r = 0; n_r < dst_rows; n_r++ )
+    {
+        int64_t *origin = tables.origin[n_r];
+        int *span = tables.span[n_r];
+        origin[0] = llrint( ((double)a11 * n_r + b00) * one );
+        origin[1] = llrint( ((double)a01 * n_r + b10) * one );
+        span[0] = 0;
+        span[1] = dst_cols;
+        affine_span( origin[0], tables.step_r, (int64_t)(src_rows - 1) << AFFINE_DDA_BITS, &span[0], &span[1] );
+        affine_span( origin[1], tables.step_c, (int64_t)(src_cols - 1) << AFFINE_DDA_BITS, &span[0], &span[1] );
+        tables.start[n_r][0] = (int)(origin[0] + (int64_t)span[0] * tables.step_r);
+        tables.start[n_r][1] = (int)(origin[1] + (int64_t)span[0] * tables.step_c);
+    }
+    return tables;
+}
+
+static void affine_dda_tables_free( affine_dda_tables *tables )
+{
+    free(tables->origin);
+    free(tables->start);
+    free(tables->span);
+}
+
+/* Bytes of the cache lines the source of an h x w tile of dst covers: the
+ * parallelogram of |det| h w pixels, 16 floats a line, plus a partial line
+ * at each end of the rows it crosses. */
+static double affine_block_bytes( const float a00, const float a01, const float a10, const float a11, const double h, const double w )
+{
+    const double area  = fabs((double)a00 * a11 - (double)a01 * a10) * h * w;
+    const double rows  = fabs(a11) * h + fabs(a10) * w + 1;
+    return 64 * (area / 16 + rows);
+}
+
+/* Tiles of affine_blocked(): full rows of dst when the source of one row
+ * fits in AFFINE_BLOCK_BYTES, as many as fit, else the largest square that
+ * fits. */
+static void affine_block_size( const int dst_cols, const float a00, const float a01, const float a10, const float a11, int *tile_rows, int *tile_cols )
+{
+    if ( affine_block_bytes( a00, a01, a10, a11, 1, dst_cols ) <= AFFINE_BLOCK_BYTES )
+    {
+        int rows = 1;
+        while ( rows < AFFINE_BLOCK_MAX && affine_block_bytes( a00, a01, a10, a11, 2 * rows, dst_cols ) <= AFFINE_BLOCK_BYTES )
+            rows *= 2;
+        *tile_rows = rows;
+        *tile_cols = dst_cols;
+        return;
+    }
+    int side = AFFINE_BLOCK_MAX;
+    while ( side > AFFINE_BLOCK_MIN && affine_block_bytes( a00, a01, a10, a11, side, side ) > AFFINE_BLOCK_BYTES )
+        side /= 2;
+    *tile_rows = side;
+    *tile_cols = side;
+}
+
+void pencil_affine_linear_dda( const int src_rows, const int src_cols, const int src_step, const float src[]
+                             , const int dst_rows, const int dst_cols, const int dst_step,       float dst[]
+                             , const float a00, const float a01, const float a10, const float a11, const float b00, const float b10
+                             , const int border_type, const float border_value
+                             )
+{
+    affine_dda_tables tables = affine_dda_tables_create( src_rows, src_cols, dst_rows, dst_cols, a00, a01, a10, a11, b00, b10 );
+
+    affine_dda( src_rows, src_cols, src_step, (const float(*)[src_step])src
+              , dst_rows, dst_cols, dst_step, (      float(*)[dst_step])dst
+              , tables.step_r, tables.step_c, tables.origin, tables.start, tables.span
+              , border_type, border_value
+              );
+
+    affine_dda_tables_free( &tables );
+}
+
+void pencil_affine_linear_blocked( const int src_rows, const int src_cols, const int src_step, const float src[]
+                                 , const int dst_rows, const int dst_cols, const int dst_step,       float dst[]
+                                 , const float a00, const float a01, const float a10, const float a11, const float b00, const float b10
+                                 , const int border_type, const float border_value
+                                 )
+{
+    affine_dda_tables tables = affine_dda_tables_create( src_rows, src_cols, dst_rows, dst_cols, a00, a01, a10, a11, b00, b10 );
+    int tile_rows, tile_cols;
+    affine_block_size( dst_cols, a00, a01, a10, a11, &tile_rows, &tile_cols );
+
+    affine_blocked( src_rows, src_cols, src_step, (const float(*)[src_step])src
+                  , dst_rows, dst_cols, dst_step, (float(*)[dst_step])dst
+                  , tile_rows, tile_cols
+                  , tables.step_r, tables.step_c, tables.origin, tables.start, tables.span
+                  , border_type, border_value
+                  );
+
+    affine_dda_tables_free( &tables );
+}
+
+struct pencil_affine_tiled_source
+{
+    int rows, cols;
+    int tiles_across, tiles;
+    float (*tile)[AFFINE_TILE + 1][AFFINE_TILE + 1];
+};
+
+pencil_affine_tiled_source * pencil_affine_tiled_source_create( const int rows, const int cols, const int step, const float src[] )
+{
+    assert( rows < (1 << (31 - AFFINE_DDA_BITS)) && cols < (1 << (31 - AFFINE_DDA_BITS)) );
+
+    pencil_affine_tiled_source *source = (pencil_affine_tiled_source *)malloc(sizeof(pencil_affine_tiled_source));
+    assert( source );
+    source->rows = rows;
+    source->cols = cols;
+    source->tiles_across = (cols + AFFINE_TILE - 1) >> AFFINE_TILE_BITS;
+    source->tiles = ((rows + AFFINE_TILE - 1) >> AFFINE_TILE_BITS) * source->tiles_across;
+    source->tile = malloc( sizeof(float) * source->tiles * (AFFINE_TILE + 1) * (AFFINE_TILE + 1) );
+    assert( source->tile );
+
+    // The row and column after a tile, past the image, replicate its edge;
+    // affine_blocked_tiled() never reads them
+    for ( int t = 0; t < source->tiles; t++ )
+    {
+        const int row = (t / source->tiles_across) << AFFINE_TILE_BITS;
+        const int col = (t % source->tiles_across) << AFFINE_TILE_BITS;
+        for ( int i = 0; i <= AFFINE_TILE; i++ )
+            for ( int j = 0; j <= AFFINE_TILE; j++ )
+                source->tile[t][i][j] = src[imin(row + i, rows - 1) * step + imin(col + j, cols - 1)];
+    }
+    return source;
+}
+
+void pencil_affine_tiled_source_destroy( pencil_affine_tiled_source *source )
+{
+    if ( !source )
+        return;
+    free(source->tile);
+    free(source);
+}
+
+void pencil_affine_linear_tiled( const pencil_affine_tiled_source *source
+                               , const int dst_rows, const int dst_cols, const int dst_step, float dst[]
+                               , const float a00, const float a01, const float a10, const float a11, const float b00, const float b10
+                               , const int border_type, const float border_value
+                               )
+{
+    affine_dda_tables tables = affine_dda_tables_create( source->rows, source->cols, dst_rows, dst_cols, a00, a01, a10, a11, b00, b10 );
+    int tile_rows, tile_cols;
+    affine_block_size( dst_cols, a00, a01, a10, a11, &tile_rows, &tile_cols );
+
+    affine_blocked_tiled( source->rows, source->cols, source->tiles, source->tiles_across, (const float(*)[AFFINE_TILE + 1][AFFINE_TILE + 1])source->tile
+                        , dst_rows, dst_cols, dst_step, (float(*)[dst_step])dst
+                        , tile_rows, tile_cols
+                        , tables.step_r, tables.step_c, tables.origin, tables.start, tables.span
+                        , border_type, border_value
+                        );
+
+    affine_dda_tables_free( &tables );
+}
+
+/* Rows [first, last) of a dst_rows x dst_cols dst whose source points,
+ * src = A dst + b in (row, column) order, may have their top left tap in
+ * rows [row_0, row_1) and columns [col_0, col_1) of src: the box, one pixel
+ * larger for the fixed-point rounding, taken back to dst. */
+static void affine_batch_rows( const double a00, const double a01, const double a10, const double a11, const double b00, const double b10
+                             , const int row_0, const int row_1, const int col_0, const int col_1, const int dst_rows
+                             , int *first, int *last
+                             )
+{
+    const double det = a11 * a00 - a10 * a01;
+    if ( fabs(det) < 1e-12 )
+    {
+        *first = 0;
+        *last  = dst_rows;
+        return;
+    }
+    double lo = HUGE_VAL, hi = -HUGE_VAL;
+    for ( int corner = 0; corner < 4; corner++ )
+    {
+        const double o_r = (corner & 1 ? row_1 + 1 : row_0 - 1) - b00;
+        const double o_c = (corner & 2 ? col_1 + 1 : col_0 - 1) - b10;
+        const double n_r = (a00 * o_r - a10 * o_c) / det;
+        lo = fmin(lo, n_r);
+        hi = fmax(hi, n_r);
+    }
+    *first = (int)fmax( floor(lo) - 1, 0 );
+    *last  = (int)fmin( ceil(hi) + 2, dst_rows );
+    if ( *last < *first )
+        *last = *first;
+}
+
+void pencil_affine_linear_batch( const int src_rows, const int src_cols, const int src_step, const float src[]
+                               , const int count, const float M[]
+                               , const int dst_rows, const int dst_cols, const int dst_step, float dst[]
+                               , const int border_type, const float border_value
+                               )
+{
+    assert( src_rows > 1 && src_cols > 1 && count > 0 );
+    const int tiles_down   = (src_rows - 1 + AFFINE_BATCH_TILE - 1) / AFFINE_BATCH_TILE;
+    const int tiles_across = (src_cols - 1 + AFFINE_BATCH_TILE - 1) / AFFINE_BATCH_TILE;
+
+    int (*step)[2] = malloc( sizeof(int) * count * 2 );
+    int64_t (*origin)[dst_rows][2] = malloc( sizeof(int64_t) * count * dst_rows * 2 );
+    int (*start)[dst_rows][2] = malloc( sizeof(int) * count * dst_rows * 2 );
+    int (*span)[dst_rows][2]  = malloc( sizeof(int) * count * dst_rows * 2 );
+    int (*rows)[tiles_across][count][2] = malloc( sizeof(int) * tiles_down * tiles_across * count * 2 );
+    assert( step && origin && start && span && rows );
+
+    for ( int k = 0; k < count; k++ )
+    {
+        // cv's (x, y) = (column, row) matrix in the (row, column) order of a00..b10
+        const float *m = M + 6 * k;
+        const float a00 = m[0], a01 = m[1], b10 = m[2], a10 = m[3], a11 = m[4], b00 = m[5];
+        affine_dda_tables tables = affine_dda_tables_create( src_rows, src_cols, dst_rows, dst_cols, a00, a01, a10, a11, b00, b10 );
+        step[k][0] = tables.step_r;
+        step[k][1] = tables.step_c;
+        memcpy( origin[k], tables.origin, sizeof(int64_t) * dst_rows * 2 );
+        memcpy( start[k],  tables.start,  sizeof(int) * dst_rows * 2 );
+        memcpy( span[k],   tables.span,   sizeof(int) * dst_rows * 2 );
+        affine_dda_tables_free( &tables );
+
+        for ( int t_r = 0; t_r < tiles_down; t_r++ )
+            for ( int t_c = 0; t_c < tiles_across; t_c++ )
+                affine_batch_rows( a00, a01, a10, a11, b00, b10
+                                 , t_r * AFFINE_BATCH_TILE, imin((t_r + 1) * AFFINE_BATCH_TILE, src_rows - 1)
+                                 , t_c * AFFINE_BATCH_TILE, imin((t_c + 1) * AFFINE_BATCH_TILE, src_cols - 1)
+                                 , dst_rows, &rows[t_r][t_c][k][0], &rows[t_r][t_c][k][1]
+                                 );
+    }
+
+    affine_batch( src_rows, src_cols, src_step, (const float(*)[src_step])src
+                , count, dst_rows, dst_cols, dst_step, (float(*)[dst_rows][dst_step])dst
+                , AFFINE_BATCH_TILE, AFFINE_BATCH_TILE, tiles_down, tiles_across, rows
+                , step, origin, start, span
+                , border_type, border_value
+                );
+
+    free(step);
+    free(origin);
+    free(start);
+    free(span);
+    free(rows);
+}
+
+/* x rounded to int and saturated, like cv::saturate_cast<int>. */
+static int affine_round( const double x )
+{
+    return x >= 2147483647. ? 2147483647 : x <= -2147483648. ? (-2147483647 - 1) : (int)lrint(x);
+}
+
+void pencil_affine_linear_u8( const int src_rows, const int src_cols, const int src_step, const uint8_t src[]
+                            , const int dst_rows, const int dst_cols, const int dst_step,       uint8_t dst[]
+                            , const float a00, const float a01, const float a10, const float a11, const float b00, const float b10
+                            , const int border_type, const uint8_t border_value
+                            )
+{
+    const double one = 1 << AFFINE_AB_BITS;
+    // Rounds the sum to the nearest AFFINE_INTER_BITS fraction
+    const int round_delta = 1 << (AFFINE_AB_BITS - AFFINE_INTER_BITS - 1);
+    int *row_x = malloc( sizeof(int) * dst_rows );
+    int *row_y = malloc( sizeof(int) * dst_rows );
+    int *col_x = malloc( sizeof(int) * dst_cols );
+    int *col_y = malloc( sizeof(int) * dst_cols );
+    assert( row_x && row_y && col_x && col_y );
+
+    for ( int n_r = 0; n_r < dst_rows; n_r++ )
+    {
+        row_x[n_r] = affine_round( ((double)a01 * n_r + b10) * one ) + round_delta;
+        row_y[n_r] = affine_round( ((double)a11 * n_r + b00) * one ) + round_delta;
+    }
+    for ( int n_c = 0; n_c < dst_cols; n_c++ )
+    {
+        col_x[n_c] = affine_round( (double)a00 * n_c * one );
+        col_y[n_c] = affine_round( (double)a10 * n_c * one );
+    }
+
+    affine_u8( src_rows, src_cols, src_step, (const uint8_t(*)[src_step])src
+             , dst_rows, dst_cols, dst_step, (      uint8_t(*)[dst_step])dst
+             , row_x, row_y, col_x, col_y
+             , border_type, border_value
+             );
+
+    free(row_x);
+    free(row_y);
+    free(col_x);
+    free(col_y);
+}
+
+void pencil_affine_linear_cn( const int src_rows, const int src_cols, const int src_step, const float src[]
+                            , const int dst_rows, const int dst_cols, const int dst_step,       float dst[]
+                            , const float a00, const float a01, const float a10, const float a11, const float b00, const float b10
+                            , const int border_type, const float border_value
+                            , const int channels
+                            )
+{
+    assert( channels == 1 || channels == 3 || channels == 4 );
+    switch ( channels )
+    {
+    case 1:
+        pencil_affine_linear_border( src_rows, src_cols, src_step, src, dst_rows, dst_cols, dst_step, dst, a00, a01, a10, a11, b00, b10, border_type, border_value );
+        break;
+    case 3:
+        affine_c3( src_rows, src_cols, src_step, (const float(*)[src_step])src
+                 , dst_rows, dst_cols, dst_step, (      float(*)[dst_step])dst
+                 , a00, a01, a10, a11, b00, b10
+                 , border_type, border_value
+                 );
+        break;
+    case 4:
+        affine_c4( src_rows, src_cols, src_step, (const float(*)[src_step])src
+                 , dst_rows, dst_cols, dst_step, (      float(*)[dst_step])dst
+                 , a00, a01, a10, a11, b00, b10
+                 , border_type, border_value
+                 );
+        break;
+    }
+}
+
+void pencil_affine_linear_f16( const int src_rows, const int src_cols, const int src_step, const uint16_t src[]
+                             , const int dst_rows, const int dst_cols, const int dst_step,       uint16_t dst[]
+                             , const float a00, const float a01, const float a10, const float a11, const float b00, const float b10
+                             , const int border_type, const float border_value
+                             )
+{
+    // The scop decodes the halves itself but writes float, a strip of rows at
+    // a time, which the host rounds back to half while it is still in cache
+    const int strip = imax(1, imin(dst_rows, HALF_STRIP_PIXELS / dst_cols));
+    float half_scale[HALF_SCALE_SIZE][2];
+    float *out = malloc( sizeof(float) * strip * dst_cols );
+    assert( out );
+    half_scale_init( half_scale );
+
+    for ( int first = 0; first < dst_rows; first += strip )
+    {
+        const int rows = imin(strip, dst_rows - first);
+        affine_f16( src_rows, src_cols, src_step, (const uint16_t(*)[src_step])src
+                  , rows, dst_cols, dst_cols, (float(*)[dst_cols])out
+                  , a00, a01, a10, a11, b00 + a11 * first, b10 + a01 * first
+                  , border_type, float_to_half(border_value), half_scale
+                  );
+        for ( int q = 0; q < rows; q++ )
+            float_to_half_row( dst_cols, out + q * dst_cols, dst + (first + q) * dst_step );
+    }
+    free(out);
+}
@@ -0,0 +1,393 @@
+//Implementation file. Included once per source pixel storage type with
+//AFFINE_NAME (function name), AFFINE_TYPE (element type), AFFINE_LOAD (element
+//to float) and AFFINE_CHANNELS (interleaved elements per pixel) defined.
+//Interpolation and dst are always float. With AFFINE_HALF, AFFINE_NAME also
+//takes the half_scale table of half_value(), which AFFINE_LOAD may use.
+//
+//The source coordinates, weights and border extrapolation of a pixel are
+//computed once and shared by its channels.
+//
+//AFFINE_DDA_NAME, if defined, names a second version generating the source
+//coordinates along each row in AFFINE_DDA_BITS fixed point. AFFINE_BLOCKED_NAME
+//names its traversal in tiles of dst, reading src as rows or, with
+//AFFINE_TILED, as the tiles of a pencil_affine_tiled_source; it requires
+//AFFINE_CHANNELS 1, as does AFFINE_BATCH_NAME, many transforms of one src in
+//a pass over its tiles. Without AFFINE_NAME only the latter are generated.
+
+#ifdef AFFINE_NAME
+static void AFFINE_NAME( const int src_rows, const int src_cols, const int src_step, const AFFINE_TYPE src[static const restrict src_rows][src_step]
+                       , const int dst_rows, const int dst_cols, const int dst_step,       float dst[static const restrict dst_rows][dst_step]
+                       , const float a00, const float a01, const float a10, const float a11, const float b00, const float b10
+                       , const int border_type, const AFFINE_TYPE border_value
+#ifdef AFFINE_HALF
+                       , const float half_scale[static const restrict HALF_SCALE_SIZE][2]
+#endif
+                       )
+{
+#pragma scop
+    __pencil_assume(src_rows >  0);
+    __pencil_assume(src_cols >  0);
+    __pencil_assume(src_step >= src_cols * AFFINE_CHANNELS);
+    __pencil_assume(dst_rows >  0);
+    __pencil_assume(dst_cols >  0);
+    __pencil_assume(dst_step >= dst_cols * AFFINE_CHANNELS);
+
+    __pencil_kill(dst);
+
+    #pragma pencil independent
+    for ( int n_r=0; n_r<dst_rows; n_r++ )
+    {
+        #pragma pencil independent
+        for ( int n_c=0; n_c<dst_cols; n_c++ )
+        {
+            float o_r = a11 * n_r + a10 * n_c + b00;
+            float o_c = a01 * n_r + a00 * n_c + b10;
+
+            float r = o_r - floorf(o_r);
+            float c = o_c - floorf(o_c);
+
+            int coord_00_r = fminf(fmaxf(floorf(o_r), BORDER_COORD_MIN), BORDER_COORD_MAX);
+            int coord_00_c = fminf(fmaxf(floorf(o_c), BORDER_COORD_MIN), BORDER_COORD_MAX);
+
+            if ( coord_00_r >= 0 && coord_00_r < src_rows - 1 && coord_00_c >= 0 && coord_00_c < src_cols - 1 )
+            {
+                // All four taps are inside the source image
+                for ( int ch = 0; ch < AFFINE_CHANNELS; ch++ )
+                {
+                    const float A00 = AFFINE_LOAD(src[coord_00_r    ][ coord_00_c      * AFFINE_CHANNELS + ch]);
+                    const float A10 = AFFINE_LOAD(src[coord_00_r + 1][ coord_00_c      * AFFINE_CHANNELS + ch]);
+                    const float A01 = AFFINE_LOAD(src[coord_00_r    ][(coord_00_c + 1) * AFFINE_CHANNELS + ch]);
+                    const float A11 = AFFINE_LOAD(src[coord_00_r + 1][(coord_00_c + 1) * AFFINE_CHANNELS + ch]);
+                    dst[n_r][n_c * AFFINE_CHANNELS + ch] = mixf( mixf(A00, A10, r), mixf(A01, A11, r), c);
+                }
+            }
+            else
+            {
+                const int row_0 = border_index(coord_00_r    , src_rows, border_type);
+                const int row_1 = border_index(coord_00_r + 1, src_rows, border_type);
+                const int col_0 = border_index(coord_00_c    , src_cols, border_type) * AFFINE_CHANNELS;
+                const int col_1 = border_index(coord_00_c + 1, src_cols, border_type) * AFFINE_CHANNELS;
+                const int outside_r0 = border_outside(coord_00_r    , src_rows, border_type);
+                const int outside_r1 = border_outside(coord_00_r + 1, src_rows, border_type);
+                const int outside_c0 = border_outside(coord_00_c    , src_cols, border_type);
+                const int outside_c1 = border_outside(coord_00_c + 1, src_cols, border_type);
+                for ( int ch = 0; ch < AFFINE_CHANNELS; ch++ )
+                {
+                    const float A00 = AFFINE_LOAD(outside_r0 || outside_c0 ? border_value : src[row_0][col_0 + ch]);
+                    const float A10 = AFFINE_LOAD(outside_r1 || outside_c0 ? border_value : src[row_1][col_0 + ch]);
+                    const float A01 = AFFINE_LOAD(outside_r0 || outside_c1 ? border_value : src[row_0][col_1 + ch]);
+                    const float A11 = AFFINE_LOAD(outside_r1 || outside_c1 ? border_value : src[row_1][col_1 + ch]);
+                    dst[n_r][n_c * AFFINE_CHANNELS + ch] = mixf( mixf(A00, A10, r), mixf(A01, A11, r), c);
+                }
+            }
+        }
+    }
+    __pencil_kill(src);
+#pragma endscop
+}
+#endif
+
+#ifdef AFFINE_DDA_NAME
+// origin[n_r] is the fixed-point source (row, col) of dst column 0, and every
+// column adds (step_r, step_c). span[n_r] holds the columns [first, last)
+// whose four taps are inside the source, start[n_r] their coordinates at
+// first. Inside the span the coordinates are n_c - first steps from start
+// and never leave the image, so they stay in int and need no clamping; the
+// columns outside it extrapolate with border_type.
+static void AFFINE_DDA_NAME( const int src_rows, const int src_cols, const int src_step, const AFFINE_TYPE src[static const restrict src_rows][src_step]
+                           , const int dst_rows, const int dst_cols, const int dst_step,       float dst[static const restrict dst_rows][dst_step]
+                           , const int step_r, const int step_c
+                           , const int64_t origin[static const restrict dst_rows][2]
+                           , const int start[static const restrict dst_rows][2]
+                           , const int span[static const restrict dst_rows][2]
+                           , const int border_type, const AFFINE_TYPE border_value
+                           )
+{
+#pragma scop
+    __pencil_assume(src_rows >  0);
+    __pencil_assume(src_cols >  0);
+    __pencil_assume(src_step >= src_cols * AFFINE_CHANNELS);
+    __pencil_assume(dst_rows >  0);
+    __pencil_assume(dst_cols >  0);
+    __pencil_assume(dst_step >= dst_cols * AFFINE_CHANNELS);
+
+    __pencil_kill(dst);
+
+    #pragma pencil independent
+    for ( int n_r=0; n_r<dst_rows; n_r++ )
+    {
+        const int first = span[n_r][0];
+        const int last  = span[n_r][1];
+
+        // One add per coordinate once the multiply is strength reduced
+        #pragma pencil independent
+        for ( int n_c=first; n_c<last; n_c++ )
+        {
+            const int o_r = start[n_r][0] + (n_c - first) * step_r;
+            const int o_c = start[n_r][1] + (n_c - first) * step_c;
+            const int coord_00_r = o_r >> AFFINE_DDA_BITS;
+            const int coord_00_c = (o_c >> AFFINE_DDA_BITS) * AFFINE_CHANNELS;
+            const float r = (o_r & ((1 << AFFINE_DDA_BITS) - 1)) * (1.f / (1 << AFFINE_DDA_BITS));
+            const float c = (o_c & ((1 << AFFINE_DDA_BITS) - 1)) * (1.f / (1 << AFFINE_DDA_BITS));
+            for ( int ch = 0; ch < AFFINE_CHANNELS; ch++ )
+            {
+                const float A00 = AFFINE_LOAD(src[coord_00_r    ][coord_00_c                   + ch]);
+                const float A10 = AFFINE_LOAD(src[coord_00_r + 1][coord_00_c                   + ch]);
+                const float A01 = AFFINE_LOAD(src[coord_00_r    ][coord_00_c + AFFINE_CHANNELS + ch]);
+                const float A11 = AFFINE_LOAD(src[coord_00_r + 1][coord_00_c + AFFINE_CHANNELS + ch]);
+                dst[n_r][n_c * AFFINE_CHANNELS + ch] = mixf( mixf(A00, A10, r), mixf(A01, A11, r), c);
+            }
+        }
+
+        // The columns left of the span, then those right of it, their taps
+        // saturated to the BORDER_COORD_* range.
+        #pragma pencil independent
+        for ( int k=0; k<dst_cols - (last - first); k++ )
+        {
+            const int n_c = k < first ? k : k + (last - first);
+            const int64_t o_r = origin[n_r][0] + (int64_t)n_c * step_r;
+            const int64_t o_c = origin[n_r][1] + (int64_t)n_c * step_c;
+            const int64_t floor_r = o_r >> AFFINE_DDA_BITS;
+            const int64_t floor_c = o_c >> AFFINE_DDA_BITS;
+            const int coord_00_r = floor_r < BORDER_COORD_MIN ? BORDER_COORD_MIN : floor_r > BORDER_COORD_MAX ? BORDER_COORD_MAX : (int)floor_r;
+            const int coord_00_c = floor_c < BORDER_COORD_MIN ? BORDER_COORD_MIN : floor_c > BORDER_COORD_MAX ? BORDER_COORD_MAX : (int)floor_c;
+            const float r = (o_r & ((1 << AFFINE_DDA_BITS) - 1)) * (1.f / (1 << AFFINE_DDA_BITS));
+            const float c = (o_c & ((1 << AFFINE_DDA_BITS) - 1)) * (1.f / (1 << AFFINE_DDA_BITS));
+
+            const int row_0 = border_index(coord_00_r    , src_rows, border_type);
+            const int row_1 = border_index(coord_00_r + 1, src_rows, border_type);
+            const int col_0 = border_index(coord_00_c    , src_cols, border_type) * AFFINE_CHANNELS;
+            const int col_1 = border_index(coord_00_c + 1, src_cols, border_type) * AFFINE_CHANNELS;
+            const int outside_r0 = border_outside(coord_00_r    , src_rows, border_type);
+            const int outside_r1 = border_outside(coord_00_r + 1, src_rows, border_type);
+            const int outside_c0 = border_outside(coord_00_c    , src_cols, border_type);
+            const int outside_c1 = border_outside(coord_00_c + 1, src_cols, border_type);
+            for ( int ch = 0; ch < AFFINE_CHANNELS; ch++ )
+            {
+                const float A00 = AFFINE_LOAD(outside_r0 || outside_c0 ? border_value : src[row_0][col_0 + ch]);
+                const float A10 = AFFINE_LOAD(outside_r1 || outside_c0 ? border_value : src[row_1][col_0 + ch]);
+                const float A01 = AFFINE_LOAD(outside_r0 || outside_c1 ? border_value : src[row_0][col_1 + ch]);
+                const float A11 = AFFINE_LOAD(outside_r1 || outside_c1 ? border_value : src[row_1][col_1 + ch]);
+                dst[n_r][n_c * AFFINE_CHANNELS + ch] = mixf( mixf(A00, A10, r), mixf(A01, A11, r), c);
+            }
+        }
+    }
+    __pencil_kill(src);
+#pragma endscop
+}
+#endif
+
+#ifdef AFFINE_BLOCKED_NAME
+#ifdef AFFINE_TILED
+#define AFFINE_SOURCE const int src_tiles, const int tiles_across, const AFFINE_TYPE src[static const restrict src_tiles][AFFINE_TILE + 1][AFFINE_TILE + 1]
+#define AFFINE_TAP(row, col, d_r, d_c) src[((row) >> AFFINE_TILE_BITS) * tiles_across + ((col) >> AFFINE_TILE_BITS)][((row) & (AFFINE_TILE - 1)) + (d_r)][((col) & (AFFINE_TILE - 1)) + (d_c)]
+#else
+#define AFFINE_SOURCE const int src_step, const AFFINE_TYPE src[static const restrict src_rows][src_step]
+#define AFFINE_TAP(row, col, d_r, d_c) src[(row) + (d_r)][(col) + (d_c)]
+#endif
+// AFFINE_DDA_NAME over tile_rows x tile_cols tiles of dst, so the source
+// pixels a tile reads stay in cache while it is filled. The tables are those
+// of AFFINE_DDA_NAME; each row of a tile clips its span to the tile columns.
+// A tiled src keeps both rows of every tap pair in one tile, so the four
+// taps of a pixel inside the span share their tile.
+static void AFFINE_BLOCKED_NAME( const int src_rows, const int src_cols, AFFINE_SOURCE
+                               , const int dst_rows, const int dst_cols, const int dst_step, float dst[static const restrict dst_rows][dst_step]
+                               , const int tile_rows, const int tile_cols
+                               , const int step_r, const int step_c
+                               , const int64_t origin[static const restrict dst_rows][2]
+                               , const int start[static const restrict dst_rows][2]
+                               , const int span[static const restrict dst_rows][2]
+                               , const int border_type, const AFFINE_TYPE border_value
+                               )
+{
+#pragma scop
+    __pencil_assume(src_rows  >  0);
+    __pencil_assume(src_cols  >  0);
+#ifdef AFFINE_TILED
+    __pencil_assume(src_tiles >  0);
+    __pencil_assume(tiles_across > 0);
+#else
+    __pencil_assume(src_step  >= src_cols * AFFINE_CHANNELS);
+#endif
+    __pencil_assume(dst_rows  >  0);
+    __pencil_assume(dst_cols  >  0);
+    __pencil_assume(dst_step  >= dst_cols * AFFINE_CHANNELS);
+    __pencil_assume(tile_rows >  0);
+    __pencil_assume(tile_cols >  0);
+
+    __pencil_kill(dst);
+
+    #pragma pencil independent
+    for ( int b_r=0; b_r<(dst_rows + tile_rows - 1) / tile_rows; b_r++ )
+    {
+        #pragma pencil independent
+        for ( int b_c=0; b_c<(dst_cols + tile_cols - 1) / tile_cols; b_c++ )
+        {
+            const int c_0 = b_c * tile_cols;
+            const int c_1 = imin(c_0 + tile_cols, dst_cols);
+
+            for ( int n_r=b_r * tile_rows; n_r<imin((b_r + 1) * tile_rows, dst_rows); n_r++ )
+            {
+                const int first = iclampi(span[n_r][0], c_0, c_1);
+                const int last  = iclampi(span[n_r][1], first, c_1);
+
+                #pragma pencil independent
+                for ( int n_c=first; n_c<last; n_c++ )
+                {
+                    const int o_r = start[n_r][0] + (n_c - span[n_r][0]) * step_r;
+                    const int o_c = start[n_r][1] + (n_c - span[n_r][0]) * step_c;
+                    const int coord_00_r = o_r >> AFFINE_DDA_BITS;
+                    const int coord_00_c = o_c >> AFFINE_DDA_BITS;
+                    const float r = (o_r & ((1 << AFFINE_DDA_BITS) - 1)) * (1.f / (1 << AFFINE_DDA_BITS));
+                    const float c = (o_c & ((1 << AFFINE_DDA_BITS) - 1)) * (1.f / (1 << AFFINE_DDA_BITS));
+                    const float A00 = AFFINE_LOAD(AFFINE_TAP(coord_00_r, coord_00_c, 0, 0));
+                    const float A10 = AFFINE_LOAD(AFFINE_TAP(coord_00_r, coord_00_c, 1, 0));
+                    const float A01 = AFFINE_LOAD(AFFINE_TAP(coord_00_r, coord_00_c, 0, 1));
+                    const float A11 = AFFINE_LOAD(AFFINE_TAP(coord_00_r, coord_00_c, 1, 1));
+                    dst[n_r][n_c] = mixf( mixf(A00, A10, r), mixf(A01, A11, r), c);
+                }
+
+                #pragma pencil independent
+                for ( int k=0; k<(c_1 - c_0) - (last - first); k++ )
+                {
+                    const int n_c = k < first - c_0 ? c_0 + k : c_0 + k + (last - first);
+                    const int64_t o_r = origin[n_r][0] + (int64_t)n_c * step_r;
+                    const int64_t o_c = origin[n_r][1] + (int64_t)n_c * step_c;
+                    const int64_t floor_r = o_r >> AFFINE_DDA_BITS;
+                    const int64_t floor_c = o_c >> AFFINE_DDA_BITS;
+                    const int coord_00_r = floor_r < BORDER_COORD_MIN ? BORDER_COORD_MIN : floor_r > BORDER_COORD_MAX ? BORDER_COORD_MAX : (int)floor_r;
+                    const int coord_00_c = floor_c < BORDER_COORD_MIN ? BORDER_COORD_MIN : floor_c > BORDER_COORD_MAX ? BORDER_COORD_MAX : (int)floor_c;
+                    const float r = (o_r & ((1 << AFFINE_DDA_BITS) - 1)) * (1.f / (1 << AFFINE_DDA_BITS));
+                    const float c = (o_c & ((1 << AFFINE_DDA_BITS) - 1)) * (1.f / (1 << AFFINE_DDA_BITS));
+
+                    const int row_0 = border_index(coord_00_r    , src_rows, border_type);
+                    const int row_1 = border_index(coord_00_r + 1, src_rows, border_type);
+                    const int col_0 = border_index(coord_00_c    , src_cols, border_type);
+                    const int col_1 = border_index(coord_00_c + 1, src_cols, border_type);
+                    const float A00 = AFFINE_LOAD(border_outside(coord_00_r    , src_rows, border_type) || border_outside(coord_00_c    , src_cols, border_type) ? border_value : AFFINE_TAP(row_0, col_0, 0, 0));
+                    const float A10 = AFFINE_LOAD(border_outside(coord_00_r + 1, src_rows, border_type) || border_outside(coord_00_c    , src_cols, border_type) ? border_value : AFFINE_TAP(row_1, col_0, 0, 0));
+                    const float A01 = AFFINE_LOAD(border_outside(coord_00_r    , src_rows, border_type) || border_outside(coord_00_c + 1, src_cols, border_type) ? border_value : AFFINE_TAP(row_0, col_1, 0, 0));
+                    const float A11 = AFFINE_LOAD(border_outside(coord_00_r + 1, src_rows, border_type) || border_outside(coord_00_c + 1, src_cols, border_type) ? border_value : AFFINE_TAP(row_1, col_1, 0, 0));
+                    dst[n_r][n_c] = mixf( mixf(A00, A10, r), mixf(A01, A11, r), c);
+                }
+            }
+        }
+    }
+    __pencil_kill(src);
+#pragma endscop
+}
+#undef AFFINE_SOURCE
+#undef AFFINE_TAP
+#endif
+
+#ifdef AFFINE_BATCH_NAME
+// count transforms of src at once, each with the tables of AFFINE_DDA_NAME,
+// src read tile by tile: for every tile, the pixels of every dst whose top
+// left tap lies in it. Along a dst row those are the columns of its span
+// whose fixed-point row and column both fall in the tile, an interval, so
+// every interior pixel is written by exactly one tile. rows[t_r][t_c][k]
+// bounds the rows of dst k that may reach tile (t_r, t_c). The columns
+// outside the spans are extrapolated afterwards, a dst at a time.
+static void AFFINE_BATCH_NAME( const int src_rows, const int src_cols, const int src_step, const AFFINE_TYPE src[static const restrict src_rows][src_step]
+                             , const int count
+                             , const int dst_rows, const int dst_cols, const int dst_step, float dst[static const restrict count][dst_rows][dst_step]
+                             , const int tile_rows, const int tile_cols, const int tiles_down, const int tiles_across
+                             , const int rows[static const restrict tiles_down][tiles_across][count][2]
+                             , const int step[static const restrict count][2]
+                             , const int64_t origin[static const restrict count][dst_rows][2]
+                             , const int start[static const restrict count][dst_rows][2]
+                             , const int span[static const restrict count][dst_rows][2]
+                             , const int border_type, const AFFINE_TYPE border_value
+                             )
+{
+#pragma scop
+    __pencil_assume(src_rows   >  1);
+    __pencil_assume(src_cols   >  1);
+    __pencil_assume(src_step   >= src_cols);
+    __pencil_assume(count      >  0);
+    __pencil_assume(dst_rows   >  0);
+    __pencil_assume(dst_cols   >  0);
+    __pencil_assume(dst_step   >= dst_cols);
+    __pencil_assume(tile_rows  >  0);
+    __pencil_assume(tile_cols  >  0);
+    __pencil_assume(tiles_down   == (src_rows - 1 + tile_rows - 1) / tile_rows);
+    __pencil_assume(tiles_across == (src_cols - 1 + tile_cols - 1) / tile_cols);
+
+    __pencil_kill(dst);
+
+    #pragma pencil independent
+    for ( int t_r=0; t_r<tiles_down; t_r++ )
+    {
+        #pragma pencil independent
+        for ( int t_c=0; t_c<tiles_across; t_c++ )
+        {
+            // Top left taps in [row_0, row_1) x [col_0, col_1), fixed point
+            const int64_t row_0 = (int64_t)(t_r * tile_rows) << AFFINE_DDA_BITS;
+            const int64_t col_0 = (int64_t)(t_c * tile_cols) << AFFINE_DDA_BITS;
+            const int64_t row_1 = (int64_t)imin((t_r + 1) * tile_rows, src_rows - 1) << AFFINE_DDA_BITS;
+            const int64_t col_1 = (int64_t)imin((t_c + 1) * tile_cols, src_cols - 1) << AFFINE_DDA_BITS;
+
+            for ( int k=0; k<count; k++ )
+            {
+                for ( int n_r=rows[t_r][t_c][k][0]; n_r<rows[t_r][t_c][k][1]; n_r++ )
+                {
+                    // Columns relative to the start of the span
+                    const int length  = span[k][n_r][1] - span[k][n_r][0];
+                    const int first_r = affine_span_first(start[k][n_r][0] - row_0, step[k][0], row_1 - row_0, 0, length);
+                    const int last_r  = affine_span_last( start[k][n_r][0] - row_0, step[k][0], row_1 - row_0, 0, length);
+                    const int first   = affine_span_first(start[k][n_r][1] - col_0, step[k][1], col_1 - col_0, first_r, last_r);
+                    const int last    = affine_span_last( start[k][n_r][1] - col_0, step[k][1], col_1 - col_0, first_r, last_r);
+
+                    #pragma pencil independent
+                    for ( int n=first; n<last; n++ )
+                    {
+                        const int o_r = start[k][n_r][0] + n * step[k][0];
+                        const int o_c = start[k][n_r][1] + n * step[k][1];
+                        const int coord_00_r = o_r >> AFFINE_DDA_BITS;
+                        const int coord_00_c = o_c >> AFFINE_DDA_BITS;
+                        const float r = (o_r & ((1 << AFFINE_DDA_BITS) - 1)) * (1.f / (1 << AFFINE_DDA_BITS));
+                        const float c = (o_c & ((1 << AFFINE_DDA_BITS) - 1)) * (1.f / (1 << AFFINE_DDA_BITS));
+                        const float A00 = AFFINE_LOAD(src[coord_00_r    ][coord_00_c    ]);
+                        const float A10 = AFFINE_LOAD(src[coord_00_r + 1][coord_00_c    ]);
+                        const float A01 = AFFINE_LOAD(src[coord_00_r    ][coord_00_c + 1]);
+                        const float A11 = AFFINE_LOAD(src[coord_00_r + 1][coord_00_c + 1]);
+                        dst[k][n_r][span[k][n_r][0] + n] = mixf( mixf(A00, A10, r), mixf(A01, A11, r), c);
+                    }
+                }
+            }
+        }
+    }
+
+    #pragma pencil independent
+    for ( int k=0; k<count; k++ )
+    {
+        #pragma pencil independent
+        for ( int n_r=0; n_r<dst_rows; n_r++ )
+        {
+            const int first = span[k][n_r][0];
+            const int last  = span[k][n_r][1];
+
+            #pragma pencil independent
+            for ( int i=0; i<dst_cols - (last - first); i++ )
+            {
+                const int n_c = i < first ? i : i + (last - first);
+                const int64_t o_r = origin[k][n_r][0] + (int64_t)n_c * step[k][0];
+                const int64_t o_c = origin[k][n_r][1] + (int64_t)n_c * step[k][1];
+                const int64_t floor_r = o_r >> AFFINE_DDA_BITS;
+                const int64_t floor_c = o_c >> AFFINE_DDA_BITS;
+                const int coord_00_r = floor_r < BORDER_COORD_MIN ? BORDER_COORD_MIN : floor_r > BORDER_COORD_MAX ? BORDER_COORD_MAX : (int)floor_r;
+                const int coord_00_c = floor_c < BORDER_COORD_MIN ? BORDER_COORD_MIN : floor_c > BORDER_COORD_MAX ? BORDER_COORD_MAX : (int)floor_c;
+                const float r = (o_r & ((1 << AFFINE_DDA_BITS) - 1)) * (1.f / (1 << AFFINE_DDA_BITS));
+                const float c = (o_c & ((1 << AFFINE_DDA_BITS) - 1)) * (1.f / (1 << AFFINE_DDA_BITS));
+                const float A00 = AFFINE_LOAD(border_fetch(src, coord_00_r    , coord_00_c    , src_rows, src_cols, border_type, border_value));
+                const float A10 = AFFINE_LOAD(border_fetch(src, coord_00_r + 1, coord_00_c    , src_rows, src_cols, border_type, border_value));
+                const float A01 = AFFINE_LOAD(border_fetch(src, coord_00_r    , coord_00_c + 1, src_rows, src_cols, border_type, border_value));
+                const float A11 = AFFINE_LOAD(border_fetch(src, coord_00_r + 1, coord_00_c + 1, src_rows, src_cols, border_type, border_value));
+                dst[k][n_r][n_c] = mixf( mixf(A00, A10, r), mixf(A01, A11, r), c);
+            }
+        }
+    }
+    __pencil_kill(src);
+#pragma endscop
+}
+#endif
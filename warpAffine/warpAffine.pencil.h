@@ -1,15 +1,108 @@
 #ifndef WARPAFFINE_PENCIL_H
 #define WARPAFFINE_PENCIL_H
 
+#include <stdint.h>
+#include "border.pencil.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// Source bytes the dst tiles of pencil_affine_linear_blocked and
+// pencil_affine_linear_tiled may read, about half an L2 cache
+#define AFFINE_BLOCK_BYTES (128 * 1024)
+// Bounds of the side of square tiles, in dst pixels
+#define AFFINE_BLOCK_MIN 16
+#define AFFINE_BLOCK_MAX 256
+// Side of the source tiles pencil_affine_linear_batch reads once for all
+// its transforms, 64 KiB of floats
+#define AFFINE_BATCH_TILE 128
+
 void pencil_affine_linear( const int src_rows, const int src_cols, const int src_step, const float src[]
                          , const int dst_rows, const int dst_cols, const int dst_step,       float dst[]
                          , const float a00, const float a01, const float a10, const float a11, const float b00, const float b10
                          );
 
+// border_type is one of PENCIL_BORDER_*, border_value is used by PENCIL_BORDER_CONSTANT
+void pencil_affine_linear_border( const int src_rows, const int src_cols, const int src_step, const float src[]
+                                , const int dst_rows, const int dst_cols, const int dst_step,       float dst[]
+                                , const float a00, const float a01, const float a10, const float a11, const float b00, const float b10
+                                , const int border_type, const float border_value
+                                );
+
+// pencil_affine_linear_border generating the source coordinates of a row
+// incrementally in 16-bit fixed point. The span of each row whose taps are
+// all inside the source is found up front and interpolated without clamping
+// or branches; only the columns around it extrapolate the border.
+void pencil_affine_linear_dda( const int src_rows, const int src_cols, const int src_step, const float src[]
+                             , const int dst_rows, const int dst_cols, const int dst_step,       float dst[]
+                             , const float a00, const float a01, const float a10, const float a11, const float b00, const float b10
+                             , const int border_type, const float border_value
+                             );
+
+// pencil_affine_linear_dda filling dst in tiles whose source fits in
+// AFFINE_BLOCK_BYTES: strips of full rows when a row's source fits, else
+// squares. Rotations and shears then reuse the cache lines and pages a tile
+// reads instead of crossing the source diagonally along every row.
+void pencil_affine_linear_blocked( const int src_rows, const int src_cols, const int src_step, const float src[]
+                                 , const int dst_rows, const int dst_cols, const int dst_step,       float dst[]
+                                 , const float a00, const float a01, const float a10, const float a11, const float b00, const float b10
+                                 , const int border_type, const float border_value
+                                 );
+
+// A source image copied into square tiles of about a page each, for warping
+// the same image repeatedly: pixels close in both directions share pages and
+// cache lines, whatever the angle.
+typedef struct pencil_affine_tiled_source pencil_affine_tiled_source;
+
+pencil_affine_tiled_source * pencil_affine_tiled_source_create( const int rows, const int cols, const int step, const float src[] );
+void pencil_affine_tiled_source_destroy( pencil_affine_tiled_source * source );
+
+// pencil_affine_linear_blocked of a tiled source
+void pencil_affine_linear_tiled( const pencil_affine_tiled_source * source
+                               , const int dst_rows, const int dst_cols, const int dst_step, float dst[]
+                               , const float a00, const float a01, const float a10, const float a11, const float b00, const float b10
+                               , const int border_type, const float border_value
+                               );
+
+// count warps of one source in a single pass, as for data augmentation. M
+// holds count row-major 2x3 matrices taking dst (column, row, 1) to src, like
+// cv::warpAffine with WARP_INVERSE_MAP; dst holds the count dst_rows x
+// dst_step results one after the other. The source is read a tile of
+// AFFINE_BATCH_TILE pixels at a time, feeding every transform sampling it.
+// The results are those of pencil_affine_linear_dda.
+void pencil_affine_linear_batch( const int src_rows, const int src_cols, const int src_step, const float src[]
+                               , const int count, const float M[]
+                               , const int dst_rows, const int dst_cols, const int dst_step, float dst[]
+                               , const int border_type, const float border_value
+                               );
+
+// Interleaved image of channels (1, 3 or 4) floats per pixel, the steps
+// counting floats. border_value fills every channel.
+void pencil_affine_linear_cn( const int src_rows, const int src_cols, const int src_step, const float src[]
+                            , const int dst_rows, const int dst_cols, const int dst_step,       float dst[]
+                            , const float a00, const float a01, const float a10, const float a11, const float b00, const float b10
+                            , const int border_type, const float border_value
+                            , const int channels
+                            );
+
+// 8-bit images in and out, like cv::warpAffine on CV_8U with INTER_LINEAR:
+// source points in 1/32 pixel steps, 5-bit bilinear weights and integer
+// sums, without converting to float.
+void pencil_affine_linear_u8( const int src_rows, const int src_cols, const int src_step, const uint8_t src[]
+                            , const int dst_rows, const int dst_cols, const int dst_step,       uint8_t dst[]
+                            , const float a00, const float a01, const float a10, const float a11, const float b00, const float b10
+                            , const int border_type, const uint8_t border_value
+                            );
+
+// Half precision storage: src and dst hold IEEE half bit patterns, the
+// interpolation is in float as in pencil_affine_linear_border.
+void pencil_affine_linear_f16( const int src_rows, const int src_cols, const int src_step, const uint16_t src[]
+                             , const int dst_rows, const int dst_cols, const int dst_step,       uint16_t dst[]
+                             , const float a00, const float a01, const float a10, const float a11, const float b00, const float b10
+                             , const int border_type, const float border_value
+                             );
+
 #ifdef __cplusplus
 } // extern "C"
 #endif